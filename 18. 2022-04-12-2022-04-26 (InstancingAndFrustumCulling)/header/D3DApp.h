@@ -9,6 +9,7 @@
 #include "FrameResource.h"
 #include "GeometryGenerator.h"
 #include "Camera.h"
+#include "JobSystem.h"
 
 #include <iostream>
 #include <string>
@@ -83,6 +84,7 @@ namespace Mawi1e {
 
 		std::vector<InstanceConstants> Instances;
 		UINT InstanceCount;
+		UINT InstanceOffset = 0;
 		BoundingBox Bounds;
 
 		D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -288,10 +290,14 @@ namespace Mawi1e {
 		/** -----------------------------------------------------------------------------------
 		[                                 InstancingFrustumCulling                            ]
 		----------------------------------------------------------------------------------- **/
+		static const size_t gMinCullChunk = 1024;
+
 		UINT m_InstanceCount = 0;
 		UINT m_SkullCounts = 0;
 		bool m_isFrustumCulling = 0;
 		BoundingFrustum m_LocalProjFrustum;
+		std::vector<UINT> m_VisibleInstances;
+		std::vector<UINT> m_ChunkOffsets;
 
 	};
 }
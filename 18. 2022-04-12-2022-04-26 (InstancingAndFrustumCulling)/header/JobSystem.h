@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	class JobSystem {
+	public:
+		// (first, last) range of a chunk and the index of the chunk itself.
+		using RangeJob = std::function<void(size_t, size_t, size_t)>;
+
+		JobSystem();
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		~JobSystem();
+
+		static JobSystem* Get();
+
+		void Initialize(UINT workerCount = 0);
+		void Shutdown();
+
+		UINT GetWorkerCount() const;
+		size_t GetChunkCount(size_t count, size_t minChunkSize) const;
+
+		// Splits [0, count) into GetChunkCount() contiguous chunks and blocks until all of them ran.
+		// The calling thread takes part in the work. Nested calls (from inside a job) run inline.
+		void ParallelFor(size_t count, size_t minChunkSize, const RangeJob& job);
+
+	private:
+		void WorkerLoop();
+		void RunChunks();
+
+	private:
+		std::vector<std::thread> m_Workers;
+		std::mutex m_Mutex;
+		std::condition_variable m_WakeUp;
+		std::condition_variable m_Finished;
+
+		const RangeJob* m_Job = nullptr;
+		size_t m_Count = 0;
+		size_t m_ChunkCount = 0;
+		std::atomic<size_t> m_NextChunk{ 0 };
+		std::atomic<size_t> m_DoneChunks{ 0 };
+		std::atomic<bool> m_Busy{ false };
+		UINT m_ActiveWorkers = 0;
+		UINT64 m_Generation = 0;
+		bool m_Quit = false;
+
+	};
+}
\ No newline at end of file
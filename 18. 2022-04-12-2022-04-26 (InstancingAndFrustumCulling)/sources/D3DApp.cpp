@@ -20,6 +20,8 @@ namespace Mawi1e {
 	void D3DApp::Initialize(const D3DSettings& d3dSettings) {
 		m_d3dSettings = d3dSettings;
 
+		JobSystem::Get()->Initialize();
+
 #if defined(DEBUG) || defined(_DEBUG)
 		EnableDebugLayer();
 #endif
@@ -75,6 +77,8 @@ namespace Mawi1e {
 		if (m_SwapChain != nullptr) {
 			FlushCommandQueue();
 		}
+
+		JobSystem::Get()->Shutdown();
 	}
 
 	float D3DApp::AspectRatio() const {
@@ -831,35 +835,86 @@ namespace Mawi1e {
 			&My_unmove(XMMatrixDeterminant(My_unmove(XMLoadFloat4x4(&My_unmove(m_Camera.GetViewMatrix()))))),
 			My_unmove(XMLoadFloat4x4(&My_unmove(m_Camera.GetViewMatrix()))));
 
-		size_t SkullCounts = 0;
+		// The frustum goes to world space once; instance bounds go to world space instead of the
+		// frustum going to every instance's local space.
+		BoundingFrustum frustumW;
+		m_LocalProjFrustum.Transform(frustumW, invView);
+
+		XMVECTOR planes[6];
+		frustumW.GetPlanes(&planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+
+		auto isVisible = [&planes](const BoundingBox& box) {
+			XMVECTOR center = XMLoadFloat3(&box.Center);
+			XMVECTOR extents = XMLoadFloat3(&box.Extents);
+
+			for (int i = 0; i < 6; ++i) {
+				float distance = XMVectorGetX(XMPlaneDotCoord(planes[i], center));
+				float radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(planes[i]), extents));
+
+				if (distance > radius) return false;
+			}
+			return true;
+		};
+
+		auto jobs = JobSystem::Get();
+		UINT instanceBase = 0;
 
 		for (auto& e : m_AllRItems) {
 			const auto& instances = e->Instances;
-			size_t countObjView = 0;
+			const size_t chunkCount = jobs->GetChunkCount(instances.size(), gMinCullChunk);
 
-			for (size_t i = 0; i < instances.size(); ++i) {
-				XMMATRIX world = XMLoadFloat4x4(&instances[i].World);
-				XMMATRIX tex = XMLoadFloat4x4(&instances[i].TexTransform);
-				XMMATRIX invWorld = XMMatrixInverse(&My_unmove(XMMatrixDeterminant(world)), world);
+			m_VisibleInstances.resize(instances.size());
+			m_ChunkOffsets.assign(chunkCount + 1, 0);
 
-				XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+			// Each chunk lists its survivors at the front of its own range of m_VisibleInstances.
+			jobs->ParallelFor(instances.size(), gMinCullChunk, [&](size_t first, size_t last, size_t chunk) {
+				UINT visible = 0;
 
-				BoundingFrustum bFrustum;
-				m_LocalProjFrustum.Transform(bFrustum, toLocal);
+				for (size_t i = first; i < last; ++i) {
+					if (!m_isFrustumCulling) {
+						BoundingBox worldBounds;
+						e->Bounds.Transform(worldBounds, XMLoadFloat4x4(&instances[i].World));
+
+						if (!isVisible(worldBounds)) continue;
+					}
+
+					m_VisibleInstances[first + visible++] = (UINT)i;
+				}
+
+				m_ChunkOffsets[chunk + 1] = visible;
+			});
+
+			for (size_t c = 0; c < chunkCount; ++c) {
+				m_ChunkOffsets[c + 1] += m_ChunkOffsets[c];
+			}
+
+			// Same chunks again: every chunk owns [offset, nextOffset) of the compacted range, so the
+			// writes to the upload buffer never overlap.
+			jobs->ParallelFor(instances.size(), gMinCullChunk, [&](size_t first, size_t last, size_t chunk) {
+				const UINT dest = instanceBase + m_ChunkOffsets[chunk];
+				const UINT visible = m_ChunkOffsets[chunk + 1] - m_ChunkOffsets[chunk];
+
+				for (UINT k = 0; k < visible; ++k) {
+					const auto& instance = instances[m_VisibleInstances[first + k]];
+
+					XMMATRIX world = XMLoadFloat4x4(&instance.World);
+					XMMATRIX tex = XMLoadFloat4x4(&instance.TexTransform);
 
-				if ((bFrustum.Contains(e->Bounds) != DirectX::DISJOINT) || m_isFrustumCulling) {
 					InstanceConstants instanceConstants;
 					XMStoreFloat4x4(&instanceConstants.World, XMMatrixTranspose(world));
 					XMStoreFloat4x4(&instanceConstants.TexTransform, XMMatrixTranspose(tex));
-					instanceConstants.MaterialIndex = instances[i].MaterialIndex;
+					instanceConstants.MaterialIndex = instance.MaterialIndex;
 
-					currInstanceBuffer->CopyData(countObjView++, instanceConstants);
+					currInstanceBuffer->CopyData(dest + k, instanceConstants);
 				}
-			}
+			});
 
-			e->InstanceCount = countObjView;
-			m_SkullCounts = countObjView;
+			e->InstanceOffset = instanceBase;
+			e->InstanceCount = m_ChunkOffsets[chunkCount];
+			instanceBase += e->InstanceCount;
 		}
+
+		m_SkullCounts = instanceBase;
 	}
 
 	void D3DApp::UpdateMatetialCBs(const GameTimer* gameTimer) {
@@ -1234,7 +1289,8 @@ namespace Mawi1e {
 			cmdList->IASetIndexBuffer(&My_unmove(ri->Geo->IndexBufferView()));
 			cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
-			cmdList->SetGraphicsRootShaderResourceView(2, currInstanceBuf->GetGPUVirtualAddress());
+			cmdList->SetGraphicsRootShaderResourceView(2,
+				currInstanceBuf->GetGPUVirtualAddress() + (UINT64)ri->InstanceOffset * sizeof(InstanceConstants));
 
 			cmdList->DrawIndexedInstanced(ri->IndexCount, ri->InstanceCount,
 				ri->StartIndexLocation, ri->BaseVertexLocation, 0);
@@ -0,0 +1,138 @@
+#include "JobSystem.h"
+
+namespace Mawi1e {
+	JobSystem::JobSystem() {
+	}
+
+	JobSystem::~JobSystem() {
+		Shutdown();
+	}
+
+	JobSystem* JobSystem::Get() {
+		static JobSystem jobSystem;
+		return &jobSystem;
+	}
+
+	void JobSystem::Initialize(UINT workerCount) {
+		Shutdown();
+
+		if (workerCount == 0) {
+			UINT hardwareThreads = std::thread::hardware_concurrency();
+			workerCount = (hardwareThreads > 1) ? (hardwareThreads - 1) : 0;
+		}
+
+		m_Quit = false;
+		for (UINT i = 0; i < workerCount; ++i) {
+			m_Workers.emplace_back(&JobSystem::WorkerLoop, this);
+		}
+	}
+
+	void JobSystem::Shutdown() {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Quit = true;
+		}
+		m_WakeUp.notify_all();
+
+		for (auto& worker : m_Workers) {
+			if (worker.joinable()) {
+				worker.join();
+			}
+		}
+
+		m_Workers.clear();
+	}
+
+	UINT JobSystem::GetWorkerCount() const {
+		return (UINT)m_Workers.size();
+	}
+
+	size_t JobSystem::GetChunkCount(size_t count, size_t minChunkSize) const {
+		if (minChunkSize == 0) {
+			minChunkSize = 1;
+		}
+
+		// A few chunks per thread so that uneven chunks still balance out.
+		const size_t maxChunks = (m_Workers.size() + 1) * 4;
+		size_t chunks = (count + minChunkSize - 1) / minChunkSize;
+
+		return (chunks < maxChunks) ? chunks : maxChunks;
+	}
+
+	void JobSystem::ParallelFor(size_t count, size_t minChunkSize, const RangeJob& job) {
+		if (count == 0) {
+			return;
+		}
+
+		const size_t chunkCount = GetChunkCount(count, minChunkSize);
+
+		bool expected = false;
+		if (chunkCount <= 1 || m_Workers.empty() || !m_Busy.compare_exchange_strong(expected, true)) {
+			for (size_t c = 0; c < chunkCount; ++c) {
+				job((c * count) / chunkCount, ((c + 1) * count) / chunkCount, c);
+			}
+			return;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Finished.wait(lock, [this]() { return m_ActiveWorkers == 0; });
+
+			m_Job = &job;
+			m_Count = count;
+			m_ChunkCount = chunkCount;
+			m_DoneChunks = 0;
+			m_NextChunk = 0;
+			++m_Generation;
+		}
+		m_WakeUp.notify_all();
+
+		RunChunks();
+
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Finished.wait(lock, [this]() { return m_DoneChunks == m_ChunkCount && m_ActiveWorkers == 0; });
+			m_Job = nullptr;
+		}
+
+		m_Busy = false;
+	}
+
+	void JobSystem::WorkerLoop() {
+		UINT64 seenGeneration = 0;
+
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_WakeUp.wait(lock, [&]() { return m_Quit || m_Generation != seenGeneration; });
+
+				if (m_Quit) {
+					return;
+				}
+
+				seenGeneration = m_Generation;
+				++m_ActiveWorkers;
+			}
+
+			RunChunks();
+
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				--m_ActiveWorkers;
+			}
+			m_Finished.notify_all();
+		}
+	}
+
+	void JobSystem::RunChunks() {
+		for (;;) {
+			size_t c = m_NextChunk++;
+			if (c >= m_ChunkCount || m_Job == nullptr) {
+				break;
+			}
+
+			(*m_Job)((c * m_Count) / m_ChunkCount, ((c + 1) * m_Count) / m_ChunkCount, c);
+			++m_DoneChunks;
+		}
+	}
+}
@@ -1971,8 +1971,9 @@ namespace Mawi1e {
 		float cx = ((2.0f * sx) / m_d3dSettings.screenWidth - 1.0f) / P(0, 0);
 		float cy = ((-2.0f * sy) / m_d3dSettings.screenHeight + 1.0f) / P(1, 1);
 
-		XMVECTOR rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMVECTOR rayDir = XMVectorSet(cx, cy, 1.0f, 0.0f);
+		// View space; every item transforms its own copy into its local space.
+		XMVECTOR viewRayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		XMVECTOR viewRayDir = XMVectorSet(cx, cy, 1.0f, 0.0f);
 
 		m_PickedItem->Visible = false;
 
@@ -1981,8 +1982,8 @@ namespace Mawi1e {
 			XMMATRIX invWorld = XMMatrixInverse(&My_unmove(XMMatrixDeterminant(W)), W);
 			XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
 
-			rayOrigin = XMVector3TransformCoord(rayOrigin, toLocal);
-			rayDir = XMVector3TransformNormal(rayDir, toLocal);
+			XMVECTOR rayOrigin = XMVector3TransformCoord(viewRayOrigin, toLocal);
+			XMVECTOR rayDir = XMVector3TransformNormal(viewRayDir, toLocal);
 			rayDir = XMVector3Normalize(rayDir);
 
 			float fMax = 0.0f;
@@ -0,0 +1,83 @@
+// Vertex side of BakedAnimation, for the shaders compiled with SKINNED. Include it after cbPass:
+// the clips play from gTotalTime.
+
+// Palettes baked by BakedAnimation: the first three columns of each bone's matrix, one per row,
+// as floats or, with BAKED_HALF, as half pairs.
+struct BakedBone
+{
+#ifdef BAKED_HALF
+    uint2 Row0;
+    uint2 Row1;
+    uint2 Row2;
+#else
+    float4 Row0;
+    float4 Row1;
+    float4 Row2;
+#endif
+};
+
+// Mirror BakedAnimation::ClipInfo and BakedInstance on the CPU side.
+struct BakedClip
+{
+    uint FirstPalette;
+    uint BoneCount;
+    uint FrameCount;
+    float FrameRate;
+    float Duration;
+};
+
+struct BakedInstance
+{
+    uint Clip;
+    float TimeOffset;
+};
+
+// The table of every clip, the clips, and one BakedInstance per persistent slot.
+StructuredBuffer<BakedBone> gBakedPalettes : register(t4, space1);
+StructuredBuffer<BakedClip> gBakedClips : register(t5, space1);
+StructuredBuffer<BakedInstance> gBakedInstances : register(t6, space1);
+
+float4 UnpackHalf4(uint2 h)
+{
+    return float4(f16tof32(h.x), f16tof32(h.x >> 16), f16tof32(h.y), f16tof32(h.y >> 16));
+}
+
+float3x4 LoadBakedBone(uint index)
+{
+    BakedBone b = gBakedPalettes[index];
+#ifdef BAKED_HALF
+    return float3x4(UnpackHalf4(b.Row0), UnpackHalf4(b.Row1), UnpackHalf4(b.Row2));
+#else
+    return float3x4(b.Row0, b.Row1, b.Row2);
+#endif
+}
+
+// The same steps as BakedAnimation::Sample: the clip loops, and the two frames around the
+// instance's time are blended linearly.
+float3x4 BakedSkinMatrix(uint slot, float4 weights, uint4 bones)
+{
+    BakedInstance inst = gBakedInstances[slot];
+    BakedClip clip = gBakedClips[inst.Clip];
+
+    float time = gTotalTime + inst.TimeOffset;
+    float t = clip.Duration > 0.0f ? time - clip.Duration * floor(time / clip.Duration) : 0.0f;
+    float frame = t * clip.FrameRate;
+
+    uint frame0 = min((uint)frame, clip.FrameCount - 1);
+    uint frame1 = min(frame0 + 1, clip.FrameCount - 1);
+    float blend = frame - (float)frame0;
+
+    uint first0 = clip.FirstPalette + frame0 * clip.BoneCount;
+    uint first1 = clip.FirstPalette + frame1 * clip.BoneCount;
+
+    float3x4 skin = (float3x4)0.0f;
+
+    [unroll]
+    for (uint i = 0; i < 4; ++i)
+    {
+        skin += (weights[i] * (1.0f - blend)) * LoadBakedBone(first0 + bones[i]);
+        skin += (weights[i] * blend) * LoadBakedBone(first1 + bones[i]);
+    }
+
+    return skin;
+}
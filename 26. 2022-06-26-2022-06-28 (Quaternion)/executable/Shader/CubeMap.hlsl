@@ -199,16 +199,7 @@ SamplerState gsamAnisotropicWrap  : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
 
 
-cbuffer cbObject : register(b0)
-{
-    float4x4 gWorld;
-    float4x4 gTexTransform;
-
-    uint gMaterials;
-    uint matPad1;
-    uint matPad2;
-    uint matPad3;
-};
+#include "PackedInstance.hlsl"
 
 cbuffer cbPass : register(b1)
 {
@@ -250,12 +241,14 @@ struct VertexOut
     float2 TexC : TEXCOORD;
 };
 
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
 	VertexOut vout = (VertexOut)0.0f;
 
+    InstanceData inst = UnpackInstance(gVisibleSlots[instanceID]);
+
     vout.PosL = vin.PosL;
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(vin.PosL, 1.0f), inst.World);
     posW.xyz += gEyePosW;
 
     vout.PosH = mul(posW, gViewProj).xyww;
@@ -0,0 +1,40 @@
+// The instance slots shared by every pass that draws scene items: InstancePacker on the CPU side
+// fills gInstanceData, and the draws list the slots they use in gVisibleSlots.
+
+// Mirrors PackedInstance on the CPU side: 68 bytes per slot.
+struct PackedInstance
+{
+    float4 World0;      // columns of the affine world matrix
+    float4 World1;
+    float4 World2;
+    float2 TexOffset;
+    uint2 TexScale;     // 2x2 part of the texture transform, half pairs
+    uint MaterialIndex; // low 16 bits
+};
+
+struct InstanceData
+{
+    float4x4 World;
+    float4x4 TexTransform;
+    uint MaterialIndex;
+};
+
+// Persistent per-object slots, and the slots of the items drawn, one per instance.
+StructuredBuffer<PackedInstance> gInstanceData : register(t2, space1);
+StructuredBuffer<uint> gVisibleSlots : register(t3, space1);
+
+InstanceData UnpackInstance(uint slot)
+{
+    PackedInstance p = gInstanceData[slot];
+
+    InstanceData inst;
+    inst.World = transpose(float4x4(p.World0, p.World1, p.World2, float4(0.0f, 0.0f, 0.0f, 1.0f)));
+    inst.TexTransform = float4x4(
+        f16tof32(p.TexScale.x), f16tof32(p.TexScale.x >> 16), 0.0f, 0.0f,
+        f16tof32(p.TexScale.y), f16tof32(p.TexScale.y >> 16), 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        p.TexOffset.x, p.TexOffset.y, 0.0f, 1.0f);
+    inst.MaterialIndex = p.MaterialIndex & 0xffff;
+
+    return inst;
+}
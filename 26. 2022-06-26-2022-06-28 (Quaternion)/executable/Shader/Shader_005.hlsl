@@ -285,12 +285,12 @@ SamplerState gsamAnisotropicClamp : register(s5);
 SamplerComparisonState gsamShadow : register(s6);
 
 
-float3 NormalSampleToWorldSpace(float3 normalMapSample, float3 tangent, float3 normal) {
+float3 NormalSampleToWorldSpace(float3 normalMapSample, float4 tangent, float3 normal) {
     float3 normalT = 2.0f * normalMapSample - 1.0f;
 
     float3 N = normal;
-    float3 T = normalize(tangent - dot(tangent, N) * N);
-    float3 B = cross(N, T);
+    float3 T = normalize(tangent.xyz - dot(tangent.xyz, N) * N);
+    float3 B = tangent.w * cross(N, T);
 
     float3x3 TBN = float3x3(T, B, N);
     float3 bumpedNormal = mul(normalT, TBN);
@@ -332,16 +332,7 @@ float CalcShadowFactor(float4 ShadowPosH)
 }
 
 
-cbuffer cbObject : register(b0)
-{
-    float4x4 gWorld;
-    float4x4 gTexTransform;
-
-    uint gMaterials;
-    uint matPad1;
-    uint matPad2;
-    uint matPad3;
-};
+#include "PackedInstance.hlsl"
 
 cbuffer cbPass : register(b1)
 {
@@ -368,13 +359,22 @@ cbuffer cbPass : register(b1)
 
     Light gLights[MaxLights];
 };
+
+#ifdef SKINNED
+#include "BakedSkinning.hlsl"
+#endif
  
 struct VertexIn
 {
 	float3 PosL    : POSITION;
     float3 NormalL : NORMAL;
     float2 TexC : TEXCOORD;
-    float3 TangentU : TANGENT;
+    float4 TangentU : TANGENT;
+#ifdef SKINNED
+    // SkinInfluence, from a second vertex buffer.
+    float4 BoneWeights : WEIGHTS;
+    uint4 BoneIndices : BONEINDICES;
+#endif
 };
 
 struct VertexOut
@@ -383,28 +383,42 @@ struct VertexOut
     float4 ShadowPosH   : POSITION0;
     float3 PosW         : POSITION1;
     float3 NormalW      : NORMAL;
-    float3 TangentW     : TANGENT;
+    float4 TangentW     : TANGENT;
     float2 TexC : TEXCOORD;
+
+    nointerpolation uint MatIndex : MATINDEX;
 };
 
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
 	VertexOut vout = (VertexOut)0.0f;
+
+    uint slot = gVisibleSlots[instanceID];
+    InstanceData inst = UnpackInstance(slot);
+
+#ifdef SKINNED
+    // Into the pose of the frame first; normals and tangents go through the same matrix.
+    float3x4 skin = BakedSkinMatrix(slot, vin.BoneWeights, vin.BoneIndices);
+    vin.PosL = mul(skin, float4(vin.PosL, 1.0f));
+    vin.NormalL = mul((float3x3)skin, vin.NormalL);
+    vin.TangentU.xyz = mul((float3x3)skin, vin.TangentU.xyz);
+#endif
 	
     //  ķ ȯ
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(vin.PosL, 1.0f), inst.World);
     vout.PosW = posW.xyz;
 
     // if1. Ŀ յʰ ִٸ, ġ  ؾѴ.
     // if2. Ŀ յʰ ٸ,  ̿  ȯѴ.
-    vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
-    vout.TangentW = mul(vin.TangentU, (float3x3)gWorld);
+    vout.NormalW = mul(vin.NormalL, (float3x3)inst.World);
+    vout.TangentW = float4(mul(vin.TangentU.xyz, (float3x3)inst.World), vin.TangentU.w);
 
     // ܰ ȯ
     vout.PosH = mul(posW, gViewProj);
 
-    float4 texTrans = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
-    vout.TexC = mul(texTrans, gMaterialBuffer[gMaterials].MatTransform).xy;
+    float4 texTrans = mul(float4(vin.TexC, 0.0f, 1.0f), inst.TexTransform);
+    vout.TexC = mul(texTrans, gMaterialBuffer[inst.MaterialIndex].MatTransform).xy;
+    vout.MatIndex = inst.MaterialIndex;
 
     vout.ShadowPosH = mul(posW, gShadowTransform);
 
@@ -413,7 +427,7 @@ VertexOut VS(VertexIn vin)
 
 float4 PS(VertexOut pin) : SV_Target
 {
-    MaterialBuffer matBuffer = gMaterialBuffer[gMaterials];
+    MaterialBuffer matBuffer = gMaterialBuffer[pin.MatIndex];
     float4 diffuseAlbedo = matBuffer.DiffuseAlbedo;
     float3 FresnelR0 = matBuffer.FresnelR0;
     float Roughness = matBuffer.Roughness;
@@ -298,16 +298,7 @@ SamplerState gsamAnisotropicClamp : register(s5);
 SamplerComparisonState gsamShadow : register(s6);
 
 
-cbuffer cbObject : register(b0)
-{
-    float4x4 gWorld;
-    float4x4 gTexTransform;
-
-    uint gMaterials;
-    uint matPad1;
-    uint matPad2;
-    uint matPad3;
-};
+#include "PackedInstance.hlsl"
 
 cbuffer cbPass : register(b1)
 {
@@ -335,35 +326,54 @@ cbuffer cbPass : register(b1)
     Light gLights[MaxLights];
 };
 
+#ifdef SKINNED
+#include "BakedSkinning.hlsl"
+#endif
+
 struct VertexIn
 {
     float3 PosL    : POSITION;
     float2 TexC : TEXCOORD;
+#ifdef SKINNED
+    // SkinInfluence, from a second vertex buffer.
+    float4 BoneWeights : WEIGHTS;
+    uint4 BoneIndices : BONEINDICES;
+#endif
 };
 
 struct VertexOut
 {
     float4 PosH    : SV_POSITION;
     float2 TexC : TEXCOORD;
+
+    nointerpolation uint MatIndex : MATINDEX;
 };
 
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
     VertexOut vout = (VertexOut)0.0f;
 
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    uint slot = gVisibleSlots[instanceID];
+    InstanceData inst = UnpackInstance(slot);
+
+#ifdef SKINNED
+    vin.PosL = mul(BakedSkinMatrix(slot, vin.BoneWeights, vin.BoneIndices), float4(vin.PosL, 1.0f));
+#endif
+
+    float4 posW = mul(float4(vin.PosL, 1.0f), inst.World);
 
     vout.PosH = mul(posW, gViewProj);
 
-    float4 texTrans = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
-    vout.TexC = mul(texTrans, gMaterialBuffer[gMaterials].MatTransform).xy;
+    float4 texTrans = mul(float4(vin.TexC, 0.0f, 1.0f), inst.TexTransform);
+    vout.TexC = mul(texTrans, gMaterialBuffer[inst.MaterialIndex].MatTransform).xy;
+    vout.MatIndex = inst.MaterialIndex;
 
     return vout;
 }
 
 void PS(VertexOut pin)
 {
-    MaterialBuffer matBuffer = gMaterialBuffer[gMaterials];
+    MaterialBuffer matBuffer = gMaterialBuffer[pin.MatIndex];
     float4 diffuseAlbedo = matBuffer.DiffuseAlbedo;
     int diffuseMapIndex = matBuffer.DiffuseMapIndex;
 
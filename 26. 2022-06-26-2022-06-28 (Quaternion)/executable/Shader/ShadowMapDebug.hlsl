@@ -39,17 +39,6 @@ SamplerState gsamAnisotropicClamp : register(s5);
 SamplerComparisonState gsamShadow : register(s6);
 
 
-cbuffer cbObject : register(b0)
-{
-    float4x4 gWorld;
-    float4x4 gTexTransform;
-
-    uint gMaterials;
-    uint matPad1;
-    uint matPad2;
-    uint matPad3;
-};
-
 cbuffer cbPass : register(b1)
 {
     float4x4 gView;
@@ -0,0 +1,498 @@
+#ifndef NUM_DIR_LIGHTS
+    #define NUM_DIR_LIGHTS 3
+#endif
+
+#ifndef NUM_POINT_LIGHTS
+    #define NUM_POINT_LIGHTS 0
+#endif
+
+#ifndef NUM_SPOT_LIGHTS
+    #define NUM_SPOT_LIGHTS 0
+#endif
+
+#define MaxLights 16
+
+struct Light
+{
+    float3 Strength;
+    float FalloffStart; // /
+    float3 Direction;   // ౤/
+    float FalloffEnd;   // /
+    float3 Position;    // 
+    float SpotPower;    // 
+};
+
+struct Material
+{
+    float4 DiffuseAlbedo; // лݻ:   Ҷ   ǰ,   лǾ , ̶  лݻǴ ũ
+    float3 FresnelR0; // ڹĿ ϴ ٻ翡 R0:  
+    float Shininess; // (1 - Roughness)̸ ĥ ݴ: [0, 1]̸ 0  ĥ, 1  Ųϴ
+};
+
+float CalcAttenuation(float d, float falloffStart, float falloffEnd)
+{
+    //  Լ (falloff End - d / falloffEnd - falloffStart)
+    return saturate((falloffEnd - d) / (falloffEnd - falloffStart));
+}
+
+// ڹĿ ϴ ٻ(Schlick approximation)
+float3 SchlickFresnel(float3 R0, float3 normal, float3 lightVec)
+{
+    // ٻ: R(r) = R(0) x {(1 - R(0)) * (cos(O)^5)}
+    // Ʈ ڻιĢ: cos(O) = max(L (dot) n, 0)
+    // L: lightVec
+    // n: normal
+
+
+    float cosIncidentAngle = saturate(dot(normal, lightVec));
+
+    float f0 = 1.0f - cosIncidentAngle;
+    float3 reflectPercent = R0 + (1.0f - R0) * (f0 * f0 * f0 * f0 * f0);
+
+    return reflectPercent;
+}
+
+float3 BlinnPhong(float3 lightStrength, float3 lightVec, float3 normal, float3 toEye, Material mat)
+{
+    const float m = mat.Shininess * 256.0f;
+    float3 halfVec = normalize(toEye + lightVec);
+
+    float roughnessFactor = (m + 8.0f) * pow(max(dot(halfVec, normal), 0.0f), m) / 8.0f;
+    float3 fresnelFactor = SchlickFresnel(mat.FresnelR0, halfVec, lightVec);
+
+    float3 specAlbedo = fresnelFactor * roughnessFactor;
+
+    // LDR Ұ̱  ݿݻ [0, 1]̷ 
+    specAlbedo = specAlbedo / (specAlbedo + 1.0f);
+
+    return (mat.DiffuseAlbedo.rgb + specAlbedo) * lightStrength;
+}
+
+// ౤ 
+float3 ComputeDirectionalLight(Light L, Material mat, float3 normal, float3 toEye)
+{
+    //  ⿡ -1 ϸ Ͱ ȴ
+    float3 lightVec = -L.Direction;
+
+    // Ʈ ڻιĢ
+    float ndotl = max(dot(lightVec, normal), 0.0f);
+    float3 lightStrength = L.Strength * ndotl;
+
+    return BlinnPhong(lightStrength, lightVec, normal, toEye, mat);
+}
+
+//  
+float3 ComputePointLight(Light L, Material mat, float3 pos, float3 normal, float3 toEye)
+{
+    // x ġ  ġ  
+    float3 lightVec = L.Position - pos;
+
+    //  
+    float d = length(lightVec);
+
+    // ´ Ȯ
+    if (d > L.FalloffEnd)
+        return 0.0f;
+
+    //  Ϲȭ
+    lightVec /= d;
+    
+    // Ʈ ڻιĢ
+    float ndotl = max(dot(lightVec, normal), 0.0f);
+    float3 lightStrength = L.Strength * ndotl;
+
+    // Ǽ⿡ Լ  Ѵ.
+    float att = CalcAttenuation(d, L.FalloffStart, L.FalloffEnd);
+    lightStrength *= att;
+
+    return BlinnPhong(lightStrength, lightVec, normal, toEye, mat);
+}
+
+//  
+float3 ComputeSpotLight(Light L, Material mat, float3 pos, float3 normal, float3 toEye)
+{
+    // x ġ  ġ  
+    float3 lightVec = L.Position - pos;
+
+    //  
+    float d = length(lightVec);
+
+    // ´ Ȯ
+    if (d > L.FalloffEnd)
+        return 0.0f;
+
+    //  Ϲȭ
+    lightVec /= d;
+
+    // Ʈ ڻιĢ
+    float ndotl = max(dot(lightVec, normal), 0.0f);
+    float3 lightStrength = L.Strength * ndotl;
+
+    // Ǽ⿡ Լ  Ѵ.
+    float att = CalcAttenuation(d, L.FalloffStart, L.FalloffEnd);
+    lightStrength *= att;
+
+    // Ǽ⿡ max(-L (dot) d, 0)^s: s(L.SpotPower) ν  ũ⸦   ִ.
+    float spotFactor = pow(max(dot(-lightVec, L.Direction), 0.0f), L.SpotPower);
+    lightStrength *= spotFactor;
+
+    return BlinnPhong(lightStrength, lightVec, normal, toEye, mat);
+}
+
+float4 ComputeLighting(Light gLights[MaxLights], Material mat,
+    float3 pos, float3 normal, float3 toEye,
+    float3 shadowFactor)
+{
+    float3 result = 0.0f;
+
+    int i = 0;
+
+#if (NUM_DIR_LIGHTS > 0)
+    for (i = 0; i < NUM_DIR_LIGHTS; ++i)
+    {
+        result += shadowFactor[i] * ComputeDirectionalLight(gLights[i], mat, normal, toEye);
+    }
+#endif
+
+#if (NUM_POINT_LIGHTS > 0)
+    for (i = NUM_DIR_LIGHTS; i < NUM_DIR_LIGHTS + NUM_POINT_LIGHTS; ++i)
+    {
+        result += ComputePointLight(gLights[i], mat, pos, normal, toEye);
+    }
+#endif
+
+#if (NUM_SPOT_LIGHTS > 0)
+    for (i = NUM_DIR_LIGHTS + NUM_POINT_LIGHTS; i < NUM_DIR_LIGHTS + NUM_POINT_LIGHTS + NUM_SPOT_LIGHTS; ++i)
+    {
+        result += ComputeSpotLight(gLights[i], mat, pos, normal, toEye);
+    }
+#endif 
+
+    return float4(result, 0.0f);
+}
+
+float4 toonShading(float4 diffuse) {
+    float4 color = saturate(diffuse);
+    color = ceil(color * 5) / 5.0f;
+    color.a = diffuse.a;
+
+    return color;
+}
+
+float4 toonShading_kd(float4 kd) {
+    float4 color = saturate(kd);
+
+    if (color.x <= 0.0f) {
+        color.x = 0.4f;
+    }
+    else if (0.0f < color.x && color.x <= 0.5f) {
+        color.x = 0.6f;
+    }
+    else if (0.5f < color.x && color.x <= 1.0f) {
+        color.x = 1.0f;
+    }
+
+    if (color.y <= 0.0f) {
+        color.y = 0.4f;
+    }
+    else if (0.0f < color.y && color.y <= 0.5f) {
+        color.g = 0.6f;
+    }
+    else if (0.5f < color.y && color.y <= 1.0f) {
+        color.y = 1.0f;
+    }
+
+    if (color.z <= 0.0f) {
+        color.z = 0.4f;
+    }
+    else if (0.0f < color.z && color.z <= 0.5f) {
+        color.z = 0.6f;
+    }
+    else if (0.5f < color.z && color.z <= 1.0f) {
+        color.z = 1.0f;
+    }
+
+    color.a = saturate(kd).a;
+
+    return color;
+}
+
+float4 toonShading_ks(float4 ks) {
+    float4 color = saturate(ks);
+
+    if (0.0f < color.x && color.x <= 0.1f) {
+        color.x = 0.0f;
+    }
+    else if (0.1f < color.x && color.x <= 0.8f) {
+        color.x = 0.5f;
+    }
+    else if (0.8f < color.x && color.x <= 1.0f) {
+        color.x = 0.8f;
+    }
+
+    if (0.0f < color.y && color.y <= 0.1f) {
+        color.y = 0.0f;
+    }
+    else if (0.1f < color.y && color.y <= 0.8f) {
+        color.y = 0.5f;
+    }
+    else if (0.8f < color.y && color.y <= 1.0f) {
+        color.y = 0.8f;
+    }
+
+    if (0.0f < color.z && color.z <= 0.1f) {
+        color.z = 0.0f;
+    }
+    else if (0.1f < color.z && color.z <= 0.8f) {
+        color.z = 0.5f;
+    }
+    else if (0.8f < color.z && color.z <= 1.0f) {
+        color.z = 0.8f;
+    }
+
+    color.a = saturate(ks).a;
+
+    return color;
+}
+
+
+struct MaterialBuffer
+{
+    float4 DiffuseAlbedo;
+    float3 FresnelR0;
+    float  Roughness;
+    float4x4 MatTransform;
+
+    int DiffuseMapIndex;
+    int NormalSrvHeapIndex;
+    uint pad0;
+    uint pad1;
+};
+
+TextureCube gCubeMap : register(t0);
+Texture2D gShadowMap : register(t1);
+
+StructuredBuffer<MaterialBuffer> gMaterialBuffer : register(t0, space1);
+
+Texture2D gTextures[8] : register(t2);
+
+struct TerrainPatch
+{
+    float2 Offset;      // world xz of the patch's min corner
+    float  Scale;       // world side length of the patch
+    float  BaseHeight;
+
+    float  MorphStart;
+    float  MorphEnd;
+    uint   Lod;
+    uint   MaterialIndex;
+
+    float2 HeightUVOffset;  // gTerrainHeights uv = world xz * HeightUVScale + HeightUVOffset
+    float  HeightUVScale;
+    float  SampleSpacing;   // world distance between height samples
+};
+
+StructuredBuffer<TerrainPatch> gTerrainPatches : register(t1, space1);
+
+// Terrain's height grid, one sample per vertex of the finest patches, without BaseHeight.
+Texture2D gTerrainHeights : register(t10);
+
+SamplerState gsamPointWrap        : register(s0);
+SamplerState gsamPointClamp       : register(s1);
+SamplerState gsamLinearWrap       : register(s2);
+SamplerState gsamLinearClamp      : register(s3);
+SamplerState gsamAnisotropicWrap  : register(s4);
+SamplerState gsamAnisotropicClamp : register(s5);
+SamplerComparisonState gsamShadow : register(s6);
+
+
+float3 NormalSampleToWorldSpace(float3 normalMapSample, float4 tangent, float3 normal) {
+    float3 normalT = 2.0f * normalMapSample - 1.0f;
+
+    float3 N = normal;
+    float3 T = normalize(tangent.xyz - dot(tangent.xyz, N) * N);
+    float3 B = tangent.w * cross(N, T);
+
+    float3x3 TBN = float3x3(T, B, N);
+    float3 bumpedNormal = mul(normalT, TBN);
+
+    return bumpedNormal;
+}
+
+float CalcShadowFactor(float4 ShadowPosH)
+{
+    ShadowPosH.xyz /= ShadowPosH.w;
+
+    float depth = ShadowPosH.z;
+
+    uint width, height, mips;
+    gShadowMap.GetDimensions(0, width, height, mips);
+
+    float dx = 1.0f / (float)(width);
+
+    float percentLit = 0.0f;
+    const float2 offsets[9] =
+    {
+        float2(-dx, -dx),       float2(0.0f, -dx),      float2(dx, -dx),
+        float2(-dx, 0.0f),      float2(0.0f, 0.0f),     float2(dx, 0.0f),
+        float2(-dx, dx),        float2(0.0f, dx),       float2(dx, dx)
+    };
+
+    [unroll]
+    for (uint i = 0; i < 9; ++i)
+    {
+        percentLit += gShadowMap.SampleCmpLevelZero
+        (
+            gsamShadow,
+            ShadowPosH.xy + offsets[i],
+            depth
+        );
+    }
+
+    return percentLit / 9.0f;
+}
+
+
+cbuffer cbPass : register(b1)
+{
+    float4x4 gView;
+    float4x4 gInvView;
+    float4x4 gProj;
+    float4x4 gInvProj;
+    float4x4 gViewProj;
+    float4x4 gInvViewProj;
+    float4x4 gShadowTransform;
+    float3 gEyePosW;
+    float cbPerObjectPad1;
+    float2 gRenderTargetSize;
+    float2 gInvRenderTargetSize;
+    float gNearZ;
+    float gFarZ;
+    float gTotalTime;
+    float gDeltaTime;
+    float4 gAmbientLight;
+    float4 gFogColor;
+    float gFogStart;
+    float gFogRange;
+    float2 cbPerObjectPad2;
+
+    Light gLights[MaxLights];
+};
+ 
+#ifndef TERRAIN_GRID_DIM
+    #define TERRAIN_GRID_DIM 32
+#endif
+
+// Bilinear, as Terrain::GetHeight; at the patch vertices it returns the samples themselves.
+float TerrainHeight(TerrainPatch patch, float2 p)
+{
+    float2 uv = p * patch.HeightUVScale + patch.HeightUVOffset;
+    return gTerrainHeights.SampleLevel(gsamLinearClamp, uv, 0.0f).r;
+}
+
+// Central differences over the neighbouring samples.
+float3 TerrainNormal(TerrainPatch patch, float2 p)
+{
+    float2 uv = p * patch.HeightUVScale + patch.HeightUVOffset;
+
+    uint width, height;
+    gTerrainHeights.GetDimensions(width, height);
+    float2 texel = float2(1.0f / width, 1.0f / height);
+
+    float left  = gTerrainHeights.SampleLevel(gsamLinearClamp, uv - float2(texel.x, 0.0f), 0.0f).r;
+    float right = gTerrainHeights.SampleLevel(gsamLinearClamp, uv + float2(texel.x, 0.0f), 0.0f).r;
+    float back  = gTerrainHeights.SampleLevel(gsamLinearClamp, uv - float2(0.0f, texel.y), 0.0f).r;
+    float front = gTerrainHeights.SampleLevel(gsamLinearClamp, uv + float2(0.0f, texel.y), 0.0f).r;
+
+    return normalize(float3(left - right, 2.0f * patch.SampleSpacing, back - front));
+}
+
+// CDLOD: odd grid vertices slide onto the edge of the next coarser grid as morphK goes 0 -> 1.
+float2 MorphVertex(float2 gridPos, float2 worldXZ, float scale, float morphK)
+{
+    float2 fracPart = frac(gridPos * TERRAIN_GRID_DIM * 0.5f) * 2.0f / TERRAIN_GRID_DIM;
+    return worldXZ - fracPart * scale * morphK;
+}
+
+struct VertexIn
+{
+    float3 PosL    : POSITION;
+    float3 NormalL : NORMAL;
+    float2 TexC    : TEXCOORD;
+    float4 TangentU : TANGENT;
+};
+
+struct VertexOut
+{
+    float4 PosH         : SV_POSITION;
+    float4 ShadowPosH   : POSITION0;
+    float3 PosW         : POSITION1;
+    float3 NormalW      : NORMAL;
+    float2 TexC         : TEXCOORD;
+
+    nointerpolation uint MatIndex : MATINDEX;
+};
+
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
+{
+    VertexOut vout = (VertexOut)0.0f;
+
+    TerrainPatch patch = gTerrainPatches[instanceID];
+
+    float2 worldXZ = patch.Offset + vin.PosL.xz * patch.Scale;
+
+    float3 approxPosW = float3(worldXZ.x, patch.BaseHeight + TerrainHeight(patch, worldXZ), worldXZ.y);
+    float dist = distance(gEyePosW, approxPosW);
+    float morphK = saturate((dist - patch.MorphStart) / (patch.MorphEnd - patch.MorphStart));
+
+    worldXZ = MorphVertex(vin.PosL.xz, worldXZ, patch.Scale, morphK);
+
+    float3 posW = float3(worldXZ.x, patch.BaseHeight + TerrainHeight(patch, worldXZ), worldXZ.y);
+    vout.PosW = posW;
+    vout.NormalW = TerrainNormal(patch, worldXZ);
+
+    vout.PosH = mul(float4(posW, 1.0f), gViewProj);
+    vout.ShadowPosH = mul(float4(posW, 1.0f), gShadowTransform);
+
+    // world space uv, one texture repeat every 8 units
+    vout.TexC = mul(float4(worldXZ * 0.125f, 0.0f, 1.0f), gMaterialBuffer[patch.MaterialIndex].MatTransform).xy;
+    vout.MatIndex = patch.MaterialIndex;
+
+    return vout;
+}
+
+float4 PS(VertexOut pin) : SV_Target
+{
+    MaterialBuffer matBuffer = gMaterialBuffer[pin.MatIndex];
+    float4 diffuseAlbedo = matBuffer.DiffuseAlbedo;
+    float3 FresnelR0 = matBuffer.FresnelR0;
+    float Roughness = matBuffer.Roughness;
+
+    diffuseAlbedo *= gTextures[matBuffer.DiffuseMapIndex].Sample(gsamAnisotropicWrap, pin.TexC);
+
+    pin.NormalW = normalize(pin.NormalW);
+
+    float3 toEyeW = gEyePosW - pin.PosW;
+    float distToEye = length(toEyeW);
+    toEyeW /= distToEye;
+
+    float4 ambient = gAmbientLight * diffuseAlbedo;
+
+    Material mat = { diffuseAlbedo, FresnelR0, 1.0f - Roughness };
+
+    float3 shadowFactor = float3(1.0f, 1.0f, 1.0f);
+    shadowFactor[0] = CalcShadowFactor(pin.ShadowPosH);
+
+    float4 directLight = ComputeLighting(gLights, mat, pin.PosW,
+        pin.NormalW, toEyeW, shadowFactor);
+
+    float4 litColor = ambient + directLight;
+#ifdef FOG
+    float fogAmount = saturate((distToEye - gFogStart) / gFogRange);
+    litColor = lerp(litColor, gFogColor, fogAmount);
+#endif
+
+    litColor.a = diffuseAlbedo.a;
+
+    return litColor;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Camera.h"
+#include "CrowdAnimator.h"
+#include "Skeleton.h"
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Chooses every CrowdAnimator instance's level of detail from the camera: small characters update
+	// less often, distant ones use a reduced skeleton, culled ones only keep their clocks running.
+	class AnimationLod {
+	public:
+		struct Settings {
+			// Screen size is the bounding sphere's radius over half the view height at its distance.
+			// Every threshold it falls below doubles the update interval, from 1 up to 8.
+			float RateScreenSizes[3] = { 0.25f, 0.12f, 0.06f };
+
+			// Past each distance the next bone level applies.
+			float BoneLodDistances[CrowdAnimator::MaxBoneLods - 1] = { 25.0f, 50.0f, 100.0f };
+		};
+
+		AnimationLod() = delete;
+
+		// World space bounding spheres, one per animator instance. visible is what culling left of them,
+		// nullptr when everything is.
+		static void Apply(const Camera& camera, const Settings& settings, const DirectX::XMFLOAT3* centers,
+			const float* radii, const UINT8* visible, CrowdAnimator& animator);
+
+		static float GetScreenSize(const Camera& camera, const DirectX::XMFLOAT3& center, float radius);
+
+		// Keeps the bones that reach at least minExtent in the bind pose, counting their own length and
+		// their farthest descendant. Anything dropped moves a vertex by about minExtent at most, and
+		// since a parent always reaches further than its children, a kept bone never has a dropped
+		// ancestor. Roots are always kept.
+		static void BuildBoneLod(const Skeleton& skeleton, float minExtent, std::vector<UINT8>& outAnimated);
+
+	};
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "FrameResource.h"
+#include "Quaternion.h"
+#include "Skeleton.h"
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Clips of one skeleton sampled at load into finished palettes, for crowds that never blend. The
+	// table is indexed by (clip, frame, bone): GetClip(clip).FirstPalette + frame * GetBoneCount() + bone.
+	// Each palette matrix is kept as the first three columns of offset * toRoot, one per row, in floats
+	// or in halves. Once uploaded, an instance is only a BakedInstance in its slot; the vertex shader
+	// (BakedSkinning.hlsl, in the shaders compiled with SKINNED) finds its two frames and skins from the
+	// table, so the CPU does nothing per character per frame. D3DApp::BuildCrowd is the example.
+	class BakedAnimation {
+	public:
+		enum Format : UINT {
+			FormatFloat,	// 48 bytes a bone
+			FormatHalf,		// 24 bytes a bone; translations far from the root lose precision first
+		};
+
+		// Mirrors BakedClip in the shaders.
+		struct ClipInfo {
+			UINT FirstPalette = 0;		// first matrix of the clip in the table
+			UINT BoneCount = 0;			// matrices per frame
+			UINT FrameCount = 0;
+			float FrameRate = 0.0f;		// frames per second, (FrameCount - 1) / Duration
+			float Duration = 0.0f;
+		};
+
+		BakedAnimation();
+		BakedAnimation(const BakedAnimation&) = delete;
+		BakedAnimation& operator=(const BakedAnimation&) = delete;
+		~BakedAnimation();
+
+		// skeleton has to outlive the baker. Drops every clip and the GPU copy.
+		void Initialize(const Skeleton* skeleton, Format format = FormatHalf);
+
+		// clip holds one BoneAnimation per skeleton bone, with its time tables built. The clip plays
+		// from time 0 in the table, whatever its start time; frames in between are blended linearly.
+		UINT AddClip(const AnimationClip& clip, float sampleRate = 30.0f);
+
+		// The same palettes the shader builds, clip looping, for attachments and checks on the CPU.
+		void Sample(UINT clip, float time, DirectX::XMFLOAT4X4* palette) const;
+
+		// Records the copy of the table and the clip list into default heap buffers on cmdList, to be
+		// bound as root SRVs for gBakedPalettes and gBakedClips. The upload buffers are held until
+		// ReleaseUploaders, once the GPU is past cmdList.
+		void Upload(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList);
+		void ReleaseUploaders();
+
+		ID3D12Resource* GetPaletteBuffer() const;
+		ID3D12Resource* GetClipBuffer() const;
+
+		Format GetFormat() const;
+		UINT GetBoneCount() const;
+		UINT GetClipCount() const;
+		const ClipInfo& GetClip(UINT clip) const;
+
+		// Bytes of the palette table.
+		size_t GetByteSize() const;
+
+	private:
+		void LoadBone(UINT palette, float* out) const;
+
+	private:
+		const Skeleton* m_Skeleton = nullptr;
+		UINT m_BoneCount = 0;
+		Format m_Format = FormatHalf;
+
+		std::vector<ClipInfo> m_Clips;
+		std::vector<DirectX::XMFLOAT3X4> m_Palettes;		// FormatFloat
+		std::vector<UINT16> m_HalfPalettes;				// FormatHalf, 12 per matrix
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_PaletteBuffer = nullptr;
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_ClipBuffer = nullptr;
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_PaletteUploader = nullptr;
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_ClipUploader = nullptr;
+
+	};
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "FrameResource.h"
+
+#include <DirectXCollision.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Mawi1e {
+	class BoundingVolume {
+	public:
+		BoundingVolume() = delete;
+
+		// pPoints/stride follow BoundingBox::CreateFromPoints; 8 points per iteration under AVX2.
+		static void ComputeMinMax(const DirectX::XMFLOAT3* pPoints, size_t count, size_t stride,
+			DirectX::XMFLOAT3& outMin, DirectX::XMFLOAT3& outMax);
+
+		static DirectX::BoundingBox CreateBox(const DirectX::XMFLOAT3* pPoints, size_t count, size_t stride);
+
+		// Ritter's sphere, then a few shrink & regrow passes; never looser than the AABB's sphere.
+		static DirectX::BoundingSphere CreateSphere(const DirectX::XMFLOAT3* pPoints, size_t count, size_t stride);
+
+		// PCA box from DirectXCollision, replaced by the AABB when that one is smaller.
+		static DirectX::BoundingOrientedBox CreateOrientedBox(const DirectX::XMFLOAT3* pPoints, size_t count, size_t stride);
+
+		static DirectX::BoundingBox CreateBox(const std::vector<Vertex>& vertices);
+
+		// Fills Bounds/SphereBounds (and OrientedBounds on request) from the submesh's own vertices.
+		static void Compute(SubMeshGeometry& subMesh, const Vertex* vertices, size_t vertexCount, bool orientedBox = false);
+
+		// Arvo's method for a batch of instances: world AABB of each local box under an affine world,
+		// 8 boxes per iteration under AVX2.
+		static void TransformBoxes(const DirectX::BoundingBox* localBoxes, const DirectX::XMFLOAT4X4* worlds,
+			size_t count, DirectX::BoundingBox* outBoxes);
+		// Only the boxes named by indices; outBoxes[i] is the world AABB of item indices[i].
+		static void TransformBoxes(const DirectX::BoundingBox* localBoxes, const DirectX::XMFLOAT4X4* worlds,
+			const UINT* indices, size_t count, DirectX::BoundingBox* outBoxes);
+
+	};
+}
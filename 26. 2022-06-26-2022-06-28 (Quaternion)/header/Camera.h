@@ -17,6 +17,9 @@ public:
 	XMFLOAT4X4 GetProjectionMatrix() const;
 	XMFLOAT4X4 GetViewMatrix() const;
 	XMFLOAT3 GetPosition() const;
+	float GetFovY() const;
+	float GetNearZ() const;
+	float GetNearWindowHeight() const;
 
 	void SetPosition(float x, float y, float z);
 	void SetLens(float fovY, float ratio, float zn, float zf);
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Quaternion.h"
+#include "Skeleton.h"
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// An AnimationClip reduced for storage. Every bone keeps a rotation, translation and scale track:
+	// keys that interpolation between their neighbours reproduces are dropped, rotations are packed
+	// into 48 bits (smallest three) and translations and scales into 16 bits per axis relative to
+	// the track's range. A track that never changes is stored once, at full precision. Key times are
+	// 16 bit indices into one table of the clip's distinct key times.
+	class CompressedClip {
+	public:
+		// Per bone: rotation, translation, scale.
+		static const UINT TracksPerBone = 3;
+
+		CompressedClip();
+		CompressedClip(const CompressedClip&) = delete;
+		CompressedClip& operator=(const CompressedClip&) = delete;
+		~CompressedClip();
+
+		void Clear();
+
+		// clip holds one BoneAnimation per skeleton bone, with its time tables built. A key is dropped
+		// only while every point within shellDistance of each bone, and of everything that bone
+		// carries, stays within tolerance of where the uncompressed clip puts it in model space.
+		void Compress(const Skeleton& skeleton, const AnimationClip& clip, float tolerance, float shellDistance);
+
+		float GetClipStartTime() const;
+		float GetClipEndTime() const;
+		float WrapTime(float dt) const;
+
+		UINT GetBoneCount() const;
+
+		// Writes every bone's to-parent transform, as AnimationClip::Interpolate does. cursors holds
+		// TracksPerBone per bone.
+		void Interpolate(float dt, DirectX::XMFLOAT4X4* boneTransforms, AnimationCursor* cursors) const;
+
+		// Bytes held by the compressed data, against sizeof(Keyframe) per key of the source clip.
+		size_t GetByteSize() const;
+
+	private:
+		enum TrackKind : UINT {
+			TrackRotation,
+			TrackTranslation,
+			TrackScale,
+		};
+
+		// KeyCount 1 is a constant track: First indexes m_Constants. Otherwise First is the track's
+		// first key in its pool (m_RotationTimes/m_Rotations or m_VectorTimes/m_Vectors) and Range
+		// indexes m_Ranges for translation and scale.
+		struct Track {
+			UINT First = 0;
+			UINT16 KeyCount = 0;
+			UINT16 Range = 0;
+		};
+
+		// Min and extent of a vector track, the frame its 16 bit keys are relative to.
+		struct VectorRange {
+			DirectX::XMFLOAT3 Min;
+			DirectX::XMFLOAT3 Extent;
+		};
+
+		DirectX::XMVECTOR SampleTrack(const Track& track, UINT kind, float dt, AnimationCursor& cursor) const;
+		size_t FindKey(const UINT16* times, size_t count, float dt, AnimationCursor& cursor) const;
+
+	private:
+		std::vector<float> m_Times;
+		std::vector<Track> m_Tracks;					// TracksPerBone per bone
+		std::vector<DirectX::XMFLOAT4> m_Constants;
+		std::vector<VectorRange> m_Ranges;
+
+		std::vector<UINT16> m_RotationTimes;
+		std::vector<UINT16> m_Rotations;				// three per key
+		std::vector<UINT16> m_VectorTimes;
+		std::vector<UINT16> m_Vectors;					// three per key
+
+		float m_StartTime = 0.0f;
+		float m_EndTime = 0.0f;
+
+	};
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Quaternion.h"
+#include "Skeleton.h"
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Animates many characters that share one skeleton as a batch. Clips are resampled at a fixed
+	// rate when added. Update takes the active instances eight at a time, one per lane: every bone is
+	// sampled, blended and taken to model space in structure of arrays form (x[], y[], z[], w[] over
+	// the eight characters), and the chunks run in parallel on the JobSystem. All palettes end up in
+	// one buffer, GetBoneCount() matrices per instance in instance order. Each instance can be given a
+	// level of detail (SetLod): a lower update rate, a reduced skeleton, or only its clock kept running.
+	class CrowdAnimator {
+	public:
+		static const UINT NullClip = 0xffffffff;
+		static const UINT LaneCount = 8;
+		static const UINT MaxBoneLods = 4;
+		static const UINT MaxUpdateInterval = 8;
+
+		CrowdAnimator();
+		CrowdAnimator(const CrowdAnimator&) = delete;
+		CrowdAnimator& operator=(const CrowdAnimator&) = delete;
+		~CrowdAnimator();
+
+		// skeleton has to outlive the animator. Drops every clip and instance.
+		void Initialize(const Skeleton* skeleton);
+
+		// clip holds one BoneAnimation per skeleton bone, with its time tables built. Keys in between
+		// the resampled frames are lost, so sampleRate should not be below the rate the clip was keyed at.
+		UINT AddClip(const AnimationClip& clip, float sampleRate = 30.0f);
+
+		UINT AddInstance(UINT clip, float time = 0.0f, float rate = 1.0f);
+		void SetClip(UINT instance, UINT clip, float time);
+		void SetRate(UINT instance, float rate);
+
+		// Mixes a second clip in with weight in [0, 1]; both advance at the instance's rate. NullClip
+		// or a weight of 0 plays the first clip alone.
+		void SetBlend(UINT instance, UINT clip, float time, float weight);
+
+		// Inactive instances neither advance nor have their palettes rebuilt.
+		void SetActive(UINT instance, bool active);
+
+		// Where animated[bone] is 0 the bone holds its bind pose relative to its parent at that level
+		// instead of being sampled. Level 0 animates every bone; the others start out the same.
+		void SetBoneLod(UINT lod, const std::vector<UINT8>& animated);
+
+		// interval is 1, 2, 4 or MaxUpdateInterval: the pose is rebuilt on every interval-th Update and
+		// catches up the skipped time then. The frames an instance updates on are staggered by its id,
+		// so every frame carries an even share of each interval. An invisible instance only advances its
+		// clock, and is rebuilt on the first Update it is visible again.
+		void SetLod(UINT instance, UINT interval, UINT boneLod, bool visible);
+
+		// Advances every active instance by dt and rebuilds the palettes that are due.
+		void Update(float dt);
+
+		// Skeleton::BuildPalette's matrices, offset * toRoot per bone.
+		const DirectX::XMFLOAT4X4* GetPalette(UINT instance) const;
+		const DirectX::XMFLOAT4X4* GetPalettes() const;
+
+		float GetTime(UINT instance) const;
+		UINT GetBoneCount() const;
+		UINT GetInstanceCount() const;
+
+	private:
+		struct Clip {
+			UINT Offset = 0;				// first float of the clip in m_Keys
+			UINT FrameCount = 0;
+			float StartTime = 0.0f;
+			float Duration = 0.0f;
+			float FrameRate = 0.0f;			// frames per second, (FrameCount - 1) / Duration
+		};
+
+		// Instances of one chunk all share a bone level.
+		struct Chunk {
+			UINT First = 0;
+			UINT Count = 0;
+			UINT BoneLod = 0;
+		};
+
+		float WrapTime(UINT clip, float dt) const;
+		void AdvanceTime(UINT instance);
+		void AnimateChunk(const UINT* instances, UINT count, UINT boneLod, float* modelScratch);
+
+	private:
+		const Skeleton* m_Skeleton = nullptr;
+		UINT m_BoneCount = 0;
+		std::vector<float> m_BoneOffsets;			// 12 per bone, the affine part of each offset
+		std::vector<float> m_BindLocals;			// 12 per bone, its bind pose relative to its parent
+		std::vector<UINT8> m_BoneLods;				// MaxBoneLods masks of m_BoneCount
+
+		// Frame after frame, each frame every bone's rotation, translation and scale (10 floats), so
+		// that a character's key sits together in a line or two however many other lanes gather with it.
+		std::vector<Clip> m_Clips;
+		std::vector<float> m_Keys;
+
+		// Per instance.
+		std::vector<UINT> m_ClipA;
+		std::vector<float> m_TimeA;
+		std::vector<UINT> m_ClipB;
+		std::vector<float> m_TimeB;
+		std::vector<float> m_Weight;
+		std::vector<float> m_Rate;
+		std::vector<UINT8> m_Active;
+		std::vector<float> m_Pending;				// time since the clock last advanced
+		std::vector<UINT8> m_Interval;
+		std::vector<UINT8> m_BoneLod;
+		std::vector<UINT8> m_Visible;
+		std::vector<UINT8> m_Stale;					// palette older than the clock
+
+		UINT m_Frame = 0;
+		std::vector<UINT> m_LodInstances[MaxBoneLods];
+		std::vector<UINT> m_DueInstances;
+		std::vector<Chunk> m_Chunks;
+		std::vector<DirectX::XMFLOAT4X4> m_Palettes;
+
+	};
+}
@@ -12,6 +12,22 @@
 #include "Camera.h"
 #include "CubeRenderTarget.h"
 #include "ShadowMap.h"
+#include "TangentSpace.h"
+#include "BoundingVolume.h"
+#include "Terrain.h"
+#include "GeometryPool.h"
+#include "DynamicBVH.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "SceneGraph.h"
+#include "RenderWorld.h"
+#include "InstancePacker.h"
+#include "TriangleBVH.h"
+#include "InstanceBVH.h"
+#include "SceneQuery.h"
+#include "Skeleton.h"
+#include "Skinning.h"
+#include "BakedAnimation.h"
 
 #include <iostream>
 #include <string>
@@ -49,6 +65,9 @@ static const int gNumFrameResources = 3;
 #define SOURCE_SHADER_FILE_CUBEMAP_VS (L"./Shader/CubeMap.hlsl")
 #define SOURCE_SHADER_FILE_CUBEMAP_PS (L"./Shader/CubeMap.hlsl")
 
+#define SOURCE_SHADER_FILE_TERRAIN_VS (L"./Shader/Terrain.hlsl")
+#define SOURCE_SHADER_FILE_TERRAIN_PS (L"./Shader/Terrain.hlsl")
+
 #define THROWFAILEDIF(e, n) \
 { \
 	if(FAILED(n)) { \
@@ -65,6 +84,7 @@ enum class RenderLayer : int
 	Skull,
 	Sky,
 	DynamicCubemapOpaque,
+	Crowd,
 	Count,
 };
 
@@ -80,32 +100,6 @@ namespace Mawi1e {
 		Microsoft::WRL::ComPtr<ID3D12Resource> GPUUploader;
 	};
 
-	struct RenderItem {
-	public:
-		RenderItem() = default;
-
-		XMFLOAT4X4 World = VertexBuffer::GetMatrixIdentity4x4();
-		XMFLOAT4X4 TexTransform = VertexBuffer::GetMatrixIdentity4x4();
-
-		int NumFramesDirty = gNumFrameResources;
-		// UINT InstanceBufferIndex = -1;
-
-		MeshGeometry* Geo = nullptr;
-		Material* Mat = nullptr;
-
-		std::vector<InstanceConstants> Instances;
-		UINT InstanceCount;
-		BoundingBox Bounds;
-
-		D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-
-		UINT IndexCount = 0;
-		UINT StartIndexLocation = 0;
-		INT	BaseVertexLocation = 0;
-
-		bool Visible;
-	};
-
 	struct D3DSettings {
 		GameTimer** gameTimer = nullptr;
 		int screenWidth, screenHeight;
@@ -132,6 +126,9 @@ namespace Mawi1e {
 		LRESULT MessageHandler(HWND, UINT, WPARAM, LPARAM);
 		static D3DApp* GetD3DApp();
 
+		// Queries submitted during a frame are answered after the next Update.
+		SceneQuery& GetSceneQuery();
+
 	private:
 		void Pick(int sx, int sy);
 
@@ -174,34 +171,52 @@ namespace Mawi1e {
 		[                            Frame Resources & Render Items                           ]
 		----------------------------------------------------------------------------------- **/
 		void BuildFrameResources();
+		void BuildInstanceBuffer();
 
 		void UpdateObjectCB(const GameTimer*);
+		void UpdateCullViews();
+		void CullOccludedItems();
 		void UpdatePassCB();
 		void UpdateShadowPassCB();
 		void UpdateDynamicFaceCameraPassCBs();
 		\
 		void LoadTexture();
 		void BuildRenderItems();
+		void DestroyRenderItem(RenderHandle handle);
+		void ReleaseUnusedGeometry(MeshGeometry* geo);
+		void BuildSceneGraph();
+		void BuildSceneBVH();
+		void BuildOccluders();
+		void BuildMeshBVHs();
+		void BuildInstanceBVH();
 		void BuildDescriptorHeaps();
 		void BuildMaterials();
 		void BuildShapeGeometry();
 		void BuildPlaneGeometry();
 		void BuildQuadGeometry();
+		void BuildCrowd();
 
 		std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> GetStaticSamplers();
 
-		void DrawRenderItems(ID3D12GraphicsCommandList*, const std::vector<RenderItem*>&);
+		void CopyInstanceUpdates();
+		void DrawRenderItems(ID3D12GraphicsCommandList*, UINT, RenderLayer);
 		void DrawSceneToCubemap();
 		void DrawSceneToShadowMap();
+		void DrawCrowd(ID3D12GraphicsCommandList*, UINT);
 
 		float GetHillsHeight(float x, float z) const;
 		XMFLOAT3 GetHillsNormal(float x, float z) const;
 
+		void BuildTerrain();
+		void UpdateTerrainPatches();
+		void DrawTerrain(ID3D12GraphicsCommandList*);
+
 		void UpdateMatetialCBs(const GameTimer*);
 		void UpdateShadowTransform(const GameTimer*);
 		void OnKeyboardInput(const GameTimer*);
 		void UpdateWindowTitle(const GameTimer*);
 		void UpdateSkullPosition(float dt);
+		void UpdateSceneGraph();
 
 	private:
 		static bool m_isD3DSett;
@@ -260,6 +275,7 @@ namespace Mawi1e {
 
 		Microsoft::WRL::ComPtr<ID3DBlob> m_VsByteCode, m_PsByteCode;
 		std::vector<D3D12_INPUT_ELEMENT_DESC> m_InputElementDesc;
+		std::vector<D3D12_INPUT_ELEMENT_DESC> m_SkinnedInputElementDesc;
 		std::unique_ptr<MeshGeometry> m_ObjMeshGeo;
 		Microsoft::WRL::ComPtr<ID3D12PipelineState> m_PSO;
 
@@ -276,14 +292,13 @@ namespace Mawi1e {
 		/** -----------------------------------------------------------------------------------
 		[                                     Render Items                                    ]
 		----------------------------------------------------------------------------------- **/
-		std::vector<std::unique_ptr<RenderItem>> m_AllRItems;
-		std::vector<RenderItem*> m_OpaqueRItems;
-		std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
-		RenderItem* mWavesRitem = nullptr;
+		std::unique_ptr<RenderWorld> m_RenderWorld;
 
 		PassConstants m_MainPassCB;
 
 		std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> m_DrawArgs;
+		std::unique_ptr<GeometryPool> m_GeometryPool;
+		const float gMaxGeometryFragmentation = 0.5f;
 		std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3DBlob>> m_Shaders;
 		std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D12PipelineState>> m_PSOs;
 
@@ -312,13 +327,61 @@ namespace Mawi1e {
 		UINT m_SkullCounts = 0;
 		bool m_isFrustumCulling = 0;
 		BoundingFrustum m_LocalProjFrustum;
+		static const UINT gMainCullView = 0;
+		static const UINT gShadowCullView = 1;
+		static const UINT gCubeFaceCullView = 2;
+		static const UINT gCullViewCount = 8;
+
+		std::unique_ptr<DynamicBVH> m_SceneBVH;
+		FrustumCuller m_Culler;
+		FrustumCuller::View m_CullViews[gCullViewCount];
+		std::vector<UINT> m_ViewMasks;
+		std::vector<UINT> m_CullCandidates;
+		std::vector<UINT> m_CullCandidateMasks;
+		std::vector<UINT> m_RefitItems;
+		std::vector<DirectX::BoundingBox> m_RefitBounds;
+		std::vector<UINT> m_ViewLayers[gCullViewCount][(int)RenderLayer::Count];
+
+		// Instance data stays in one slot per item for the item's lifetime; a frame uploads the slots that
+		// changed and, for every view and layer, the slots it draws.
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_InstanceBuffer = nullptr;
+		std::vector<std::pair<UINT, UINT>> m_DirtyInstances;		// (slot, item)
+		std::vector<UINT> m_DirtyItems;
+		std::vector<PackedInstance> m_PackedInstances;
+		std::vector<std::pair<UINT, UINT>> m_InstanceCopies;		// (first slot, count)
+		UINT m_ViewLayerOffsets[gCullViewCount][(int)RenderLayer::Count];
+
+		// Smallest projected radius, in pixels, an object needs to be drawn in each pass.
+		const float gMainMinPixels = 1.0f;
+		const float gShadowMinPixels = 2.0f;
+		const float gCubeFaceMinPixels = 3.0f;
+
+		static const UINT gOcclusionWidth = 320;
+		static const UINT gOcclusionHeight = 192;
+		const float gOccluderShrink = 0.5f;
+
+		OcclusionCuller m_OcclusionCuller;
+		std::vector<std::pair<RenderHandle, OcclusionCuller::Mesh>> m_Occluders;
 
 		/** -----------------------------------------------------------------------------------
 		[                                        Picking                                      ]
 		----------------------------------------------------------------------------------- **/
-		RenderItem* m_PickedItem;
+		RenderHandle m_PickedItem;
+		RenderHandle m_PickTarget;		// the item under the highlight; Delete despawns it
+		UINT m_PickedMesh = RenderWorld::NullIndex;
 		bool m_PickingFromAll = false;
 
+		// Per RenderWorld mesh; null for meshes that cannot be hit.
+		std::vector<std::unique_ptr<TriangleBVH>> m_MeshBVHs;
+
+		// Top level over every item with a mesh BVH outside the Sky and Debug layers; m_PickInstances maps
+		// dense item indices to its instances, InstanceBVH::NullInstance for items it leaves out.
+		InstanceBVH m_InstanceBVH;
+		std::vector<UINT> m_PickInstances;
+
+		// Runs against m_InstanceBVH from the end of one Update to the start of the next.
+		SceneQuery m_SceneQuery;
+
 		/** -----------------------------------------------------------------------------------
 		[                                        CubeMap                                      ]
 		----------------------------------------------------------------------------------- **/
@@ -331,7 +394,7 @@ namespace Mawi1e {
 		UINT m_DynamicCubemapIndex;
 		Microsoft::WRL::ComPtr<ID3D12Resource> m_DynamicDepthStencilBuffer = nullptr;
 		Camera m_DynamicCubemapCamera[6];
-		RenderItem* m_SkullRitem = nullptr;
+		RenderHandle m_SkullRitem;
 
 		/** -----------------------------------------------------------------------------------
 		[                                        ShadowMap                                    ]
@@ -340,6 +403,7 @@ namespace Mawi1e {
 		std::unique_ptr<ShadowMap> m_ShadowMap = nullptr;
 		DirectX::BoundingSphere m_SceneBounds;
 		UINT m_ShadowMapIndex, mNullCubeSrvIndex, mNullTexSrvIndex;
+		UINT m_TerrainHeightSrvIndex = 0;
 		CD3DX12_GPU_DESCRIPTOR_HANDLE m_NullSrv;
 		const UINT m_ShadowMapPassIndex = 7;
 		
@@ -364,6 +428,38 @@ namespace Mawi1e {
 		----------------------------------------------------------------------------------- **/
 		std::unique_ptr<QuaternionManager> m_QuatManager;
 
+		/** -----------------------------------------------------------------------------------
+		[                                        SceneGraph                                   ]
+		----------------------------------------------------------------------------------- **/
+		SceneGraph m_SceneGraph;
+		UINT m_SphereRowNode = SceneGraph::NullNode;
+
+		/** -----------------------------------------------------------------------------------
+		[                                         Terrain                                     ]
+		----------------------------------------------------------------------------------- **/
+		HillsHeightField m_Hills;
+		std::unique_ptr<Terrain> m_Terrain;
+
+		/** -----------------------------------------------------------------------------------
+		[                                       Baked Crowd                                   ]
+		----------------------------------------------------------------------------------- **/
+		static const UINT gCrowdBoneCount = 5;
+		static const UINT gCrowdSide = 6;			// members per row and per column
+		const float gCrowdSpacing = 3.0f;
+
+		Skeleton m_CrowdSkeleton;
+		BakedAnimation m_CrowdAnimation;
+		UINT m_CrowdMesh = RenderWorld::NullIndex;
+
+		// The crowd mesh keeps its own buffers: the influences are a second vertex stream that has to
+		// line up with the first, and pool ranges start wherever the page had room.
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_CrowdInfluences = nullptr;
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_CrowdInfluenceUploader = nullptr;
+
+		// One BakedInstance per instance slot, sized like m_InstanceBuffer to the items built at load.
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_BakedInstanceBuffer = nullptr;
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_BakedInstanceUploader = nullptr;
+
 	};
 }
 
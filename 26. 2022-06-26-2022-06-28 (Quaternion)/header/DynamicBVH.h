@@ -0,0 +1,94 @@
+#pragma once
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include "FrustumCuller.h"
+
+#include <utility>
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Dynamic AABB tree over world-space bounds, one leaf per proxy. Leaves hold a box fattened by
+	// a margin so small movements cost nothing; larger ones refit the path to the root with tree
+	// rotations, and jumps reinsert the leaf with the SAH insertion cost.
+	class DynamicBVH {
+	public:
+		static const int NullNode = -1;
+
+		explicit DynamicBVH(float margin = 0.1f);
+		DynamicBVH(const DynamicBVH&) = delete;
+		DynamicBVH& operator=(const DynamicBVH&) = delete;
+		~DynamicBVH();
+
+		void Clear();
+
+		// Top-down binned SAH build. outProxies[i] receives the proxy of boxes[i].
+		void Build(const DirectX::BoundingBox* boxes, const UINT* userData, size_t count, int* outProxies);
+
+		int CreateProxy(const DirectX::BoundingBox& box, UINT userData);
+		void DestroyProxy(int proxy);
+
+		// Returns true when the tree changed.
+		bool MoveProxy(int proxy, const DirectX::BoundingBox& box);
+
+		// Appends the user data of every proxy that may intersect the frustum. Subtrees fully inside
+		// are taken without further tests; planes a node is inside of are not tested again below it.
+		// With outUntested, leaves reached while still straddling a plane go there untested.
+		void QueryFrustum(const DirectX::BoundingFrustum& frustum, std::vector<UINT>& outUserData,
+			std::vector<UINT>* outUntested = nullptr) const;
+
+		// One traversal for several views. Each node is tested only against the views still open for
+		// it. Subtrees fully inside a view OR its bit into inOutMasks[userData]; leaves still open for
+		// some views go to outUntested with those views in outUntestedMasks.
+		void QueryViews(const FrustumCuller::View* views, UINT viewCount, UINT* inOutMasks,
+			std::vector<UINT>& outUntested, std::vector<UINT>& outUntestedMasks) const;
+
+		UINT GetUserData(int proxy) const;
+		void SetUserData(int proxy, UINT userData);
+		int GetHeight() const;
+		UINT GetProxyCount() const;
+
+		// Sum of internal node areas over the root's area; lower is a better tree.
+		float GetAreaRatio() const;
+
+	private:
+		struct Node {
+			DirectX::XMFLOAT3 Min;
+			DirectX::XMFLOAT3 Max;
+
+			int Parent = NullNode;	// next free node while on the free list
+			int Child1 = NullNode;
+			int Child2 = NullNode;
+			int Height = 0;			// leaf 0, free -1
+			UINT UserData = 0;
+
+			bool IsLeaf() const { return Child1 == NullNode; }
+		};
+
+		int AllocateNode();
+		void FreeNode(int node);
+
+		void InsertLeaf(int leaf);
+		void RemoveLeaf(int leaf);
+
+		// Recomputes bounds and heights from node up to the root, rotating on the way.
+		void RefitAncestors(int node);
+		void Refit(int node);
+		void Rotate(int node);
+
+		int BuildRange(std::vector<int>& leaves, size_t first, size_t last, int depth);
+
+		void CollectLeaves(int node, std::vector<UINT>& outUserData) const;
+
+	private:
+		std::vector<Node> m_Nodes;
+		int m_Root = NullNode;
+		int m_FreeList = NullNode;
+		UINT m_ProxyCount = 0;
+		float m_Margin;
+
+	};
+}
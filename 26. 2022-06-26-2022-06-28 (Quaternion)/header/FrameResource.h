@@ -6,14 +6,36 @@
 #define MAXLIGHT 16
 
 namespace Mawi1e {
-	struct InstanceConstants {
-		DirectX::XMFLOAT4X4 World = VertexBuffer::GetMatrixIdentity4x4();
-		DirectX::XMFLOAT4X4 TexTransform = VertexBuffer::GetMatrixIdentity4x4();
-
-		UINT MaterialIndex;
-		UINT MatPad0;
-		UINT MatPad1;
-		UINT MatPad2;
+	// 68 bytes, tightly strided in a structured buffer; UnpackInstance in PackedInstance.hlsl rebuilds the matrices.
+	struct PackedInstance {
+		DirectX::XMFLOAT3X4 World;			// affine world, transposed, without its last column
+		DirectX::XMFLOAT2 TexOffset;		// translation of the texture transform
+		UINT TexScale[2];					// its 2x2 part as half pairs: (_11, _12), (_21, _22)
+		UINT16 MaterialIndex = 0;
+		UINT16 Reserved = 0;
+	};
+
+	// Per slot beside PackedInstance for items posed from a BakedAnimation: the vertex shader plays
+	// Clip from gTotalTime + TimeOffset, so nothing about the instance changes from frame to frame.
+	struct BakedInstance {
+		UINT Clip = 0;
+		float TimeOffset = 0.0f;
+	};
+
+	struct TerrainPatch {
+		DirectX::XMFLOAT2 Offset = { 0.0f, 0.0f };
+		float Scale = 1.0f;
+		float BaseHeight = 0.0f;
+
+		float MorphStart = 0.0f;
+		float MorphEnd = 1.0f;
+		UINT Lod = 0;
+		UINT MaterialIndex = 0;
+
+		// gTerrainHeights uv = world xz * HeightUVScale + HeightUVOffset; samples are SampleSpacing apart.
+		DirectX::XMFLOAT2 HeightUVOffset = { 0.0f, 0.0f };
+		float HeightUVScale = 0.0f;
+		float SampleSpacing = 1.0f;
 	};
 
 	struct PassConstants {
@@ -58,26 +80,30 @@ namespace Mawi1e {
 			Pos(x, y, z),
 			Normal(nx, ny, nz),
 			TexC(u, v),
-			Tangent(tx, ty, tz) {}
+			Tangent(tx, ty, tz, 1.0f) {}
 
 		DirectX::XMFLOAT3 Pos;
 		DirectX::XMFLOAT3 Normal;
 		DirectX::XMFLOAT2 TexC;
-		DirectX::XMFLOAT3 Tangent;
+		// w = bitangent sign, B = w * cross(N, T)
+		DirectX::XMFLOAT4 Tangent;
 	};
 
 	class FrameResource {
 	public:
-		FrameResource(ID3D12Device*, UINT, UINT, UINT);
+		FrameResource(ID3D12Device*, UINT, UINT, UINT, UINT, UINT);
 		FrameResource(const FrameResource&) = delete;
 		FrameResource operator=(const FrameResource&) = delete;
 		~FrameResource();
 
 		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_CommandAllocator = nullptr;
 
-		std::unique_ptr<UploadBuffer<InstanceConstants>> m_InstCB = nullptr;
+		// Changed instances, packed back to back and copied into their persistent slots.
+		std::unique_ptr<UploadBuffer<PackedInstance>> m_InstanceUploads = nullptr;
+		std::unique_ptr<UploadBuffer<UINT>> m_VisibleSlots = nullptr;
 		std::unique_ptr<UploadBuffer<PassConstants>> m_PassCB = nullptr;
 		std::unique_ptr<UploadBuffer<MaterialConstants>> m_MatVB = nullptr;
+		std::unique_ptr<UploadBuffer<TerrainPatch>> m_TerrainVB = nullptr;
 
 		UINT64 m_Fence = 0;
 	};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// World-space AABBs kept as SoA arrays and tested against six world-space planes, 8 boxes per
+	// iteration under AVX2. No per-object matrix work: bounds are transformed once when an object moves.
+	class FrustumCuller {
+	public:
+		static const UINT MaxViewPlanes = 12;
+		static const UINT MaxViews = 32;
+
+		// A convex volume of outward facing planes. Bit i of a view mask refers to the i-th view.
+		// Items whose bounding sphere projects to a radius below MinPixels are too small to contribute.
+		// PixelScale is pixels per world unit at distance 1 from Eye, or at any distance when the view
+		// is orthographic (Perspective 0). MinPixels 0 keeps everything.
+		struct View {
+			DirectX::XMFLOAT4 Planes[MaxViewPlanes];
+			UINT PlaneCount = 0;
+
+			DirectX::XMFLOAT3 Eye = { 0.0f, 0.0f, 0.0f };
+			float Perspective = 1.0f;
+			float PixelScale = 0.0f;
+			float MinPixels = 0.0f;
+		};
+
+		FrustumCuller();
+		FrustumCuller(const FrustumCuller&) = delete;
+		FrustumCuller& operator=(const FrustumCuller&) = delete;
+		~FrustumCuller();
+
+		void Resize(size_t count);
+		size_t GetCount() const;
+
+		void SetBounds(size_t index, const DirectX::BoundingBox& worldBox);
+		DirectX::BoundingBox GetBounds(size_t index) const;
+
+		// The contribution test uses the item's own sphere; SetBounds resets it to the box's sphere.
+		void SetSphere(size_t index, const DirectX::BoundingSphere& worldSphere);
+		DirectX::BoundingSphere GetSphere(size_t index) const;
+
+		// Outward facing planes (x, y, z, w) in the order of BoundingFrustum::GetPlanes.
+		static void ExtractPlanes(const DirectX::BoundingFrustum& frustumW, DirectX::XMFLOAT4 outPlanes[6]);
+		static void ExtractPlanes(DirectX::FXMMATRIX viewProj, DirectX::XMFLOAT4 outPlanes[6]);
+
+		static void BuildView(const DirectX::XMFLOAT4 planes[6], View& outView);
+
+		// viewportHeight pixels across the near window of a perspective view, or across the height of
+		// an orthographic volume.
+		static void SetPerspectiveContribution(View& view, const DirectX::XMFLOAT3& eye, float viewportHeight,
+			float nearZ, float nearWindowHeight, float minPixels);
+		static void SetOrthographicContribution(View& view, float viewportHeight, float volumeHeight, float minPixels);
+
+		// Everything that can throw a shadow into the receiver volume along lightDir: the receiver
+		// planes facing away from the light (its volume extruded toward the light) clipped by the
+		// light's own volume.
+		static void BuildShadowCasterView(const DirectX::XMFLOAT4 receiverPlanes[6], DirectX::FXMVECTOR lightDir,
+			const DirectX::XMFLOAT4 lightPlanes[6], View& outView);
+
+		// Appends the indices of the boxes not fully outside any plane.
+		void Cull(const DirectX::XMFLOAT4 planes[6], std::vector<UINT>& outVisible) const;
+		void Cull(const DirectX::XMFLOAT4 planes[6], const UINT* indices, size_t count, std::vector<UINT>& outVisible) const;
+
+		// Tests indices[i] against the views in testMasks[i] and ORs the views it is visible in
+		// into inOutMasks[indices[i]]. Each batch of boxes is loaded once for all views.
+		void CullViews(const View* views, UINT viewCount, const UINT* indices, const UINT* testMasks,
+			size_t count, UINT* inOutMasks) const;
+
+		// Clears the view bits of every sphere too small to contribute to that view. Runs over all items
+		// in order, so it also catches the ones a tree accepted without a leaf test.
+		void CullContribution(const View* views, UINT viewCount, UINT* inOutMasks) const;
+
+	private:
+		bool IsVisible(const DirectX::XMFLOAT4* planes, UINT planeCount, size_t index) const;
+		bool IsLargeEnough(const View& view, size_t index) const;
+
+	private:
+		std::vector<float> m_CenterX;
+		std::vector<float> m_CenterY;
+		std::vector<float> m_CenterZ;
+		std::vector<float> m_ExtentX;
+		std::vector<float> m_ExtentY;
+		std::vector<float> m_ExtentZ;
+		std::vector<float> m_SphereX;
+		std::vector<float> m_SphereY;
+		std::vector<float> m_SphereZ;
+		std::vector<float> m_Radius;
+
+	};
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "VertexBuffer.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Mawi1e {
+	// Static meshes sub-allocated from a few large default-heap buffers. Each page is one vertex buffer
+	// and one 32-bit index buffer, so items on the same page draw without rebinding the IA.
+	class GeometryPool {
+	public:
+		using Handle = UINT;
+		static const Handle InvalidHandle = 0xffffffff;
+
+		struct Range {
+			UINT Page = 0;
+			INT BaseVertexLocation = 0;
+			UINT StartIndexLocation = 0;
+			UINT VertexCount = 0;
+			UINT IndexCount = 0;
+		};
+
+		GeometryPool();
+		GeometryPool(const GeometryPool&) = delete;
+		GeometryPool& operator=(const GeometryPool&) = delete;
+		~GeometryPool();
+
+		void Initialize(ID3D12Device* device, UINT vertexStride,
+			UINT pageVertexCapacity = 1 << 18, UINT pageIndexCapacity = 1 << 20);
+
+		// Records the copy on cmdList. 16-bit indices are widened to the pool's 32-bit format.
+		Handle Upload(ID3D12GraphicsCommandList* cmdList, const void* vertices, UINT vertexCount,
+			const std::uint16_t* indices, UINT indexCount);
+		Handle Upload(ID3D12GraphicsCommandList* cmdList, const void* vertices, UINT vertexCount,
+			const std::uint32_t* indices, UINT indexCount);
+
+		// Returns the space to its page; a page left empty is released.
+		void Free(Handle handle);
+
+		// Repacks every live range into as few pages as possible. Ranges move, handles stay valid.
+		void Defragment(ID3D12GraphicsCommandList* cmdList);
+
+		// Share of the free space that sits in holes between ranges rather than at a page's end.
+		float GetFragmentation() const;
+
+		const Range& GetRange(Handle handle) const;
+		UINT GetPageCount() const;
+		D3D12_VERTEX_BUFFER_VIEW GetVertexBufferView(UINT page) const;
+		D3D12_INDEX_BUFFER_VIEW GetIndexBufferView(UINT page) const;
+
+		// Staging buffers and replaced pages stay alive until the GPU is past the submission using them.
+		void OnSubmitted(UINT64 fenceValue);
+		void ReleaseCompleted(UINT64 completedFenceValue);
+
+	private:
+		// First-fit free list over [0, capacity), coalesced on free.
+		struct FreeList {
+			struct Block {
+				UINT Offset;
+				UINT Size;
+			};
+
+			void Reset(UINT capacity);
+			bool Allocate(UINT size, UINT& outOffset);
+			void Free(UINT offset, UINT size);
+
+			UINT Capacity = 0;
+			UINT Used = 0;
+			std::vector<Block> Blocks;	// sorted by offset
+		};
+
+		struct Page {
+			Microsoft::WRL::ComPtr<ID3D12Resource> VertexBuffer;
+			Microsoft::WRL::ComPtr<ID3D12Resource> IndexBuffer;
+			FreeList Vertices;
+			FreeList Indices;
+			UINT RangeCount = 0;
+			D3D12_RESOURCE_STATES State = D3D12_RESOURCE_STATE_COMMON;	// shared by both buffers
+		};
+
+		struct Retired {
+			Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+			UINT64 FenceValue;
+		};
+
+		Handle Upload(ID3D12GraphicsCommandList* cmdList, const void* vertices, UINT vertexCount,
+			const void* indices, UINT indexCount, bool indices16);
+
+		std::unique_ptr<Page> CreatePage(UINT vertexCapacity, UINT indexCapacity);
+		UINT AllocateRange(UINT vertexCount, UINT indexCount, UINT& outBaseVertex, UINT& outStartIndex);
+		void ReleasePage(UINT page);
+		Handle NewHandle(const Range& range);
+
+		void Transition(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* resource,
+			D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after);
+		void Retire(const Microsoft::WRL::ComPtr<ID3D12Resource>& resource);
+
+	private:
+		ID3D12Device* m_Device = nullptr;
+		UINT m_VertexStride = 0;
+		UINT m_PageVertexCapacity = 0;
+		UINT m_PageIndexCapacity = 0;
+
+		std::vector<std::unique_ptr<Page>> m_Pages;	// null when released
+
+		std::vector<Range> m_Ranges;
+		std::vector<bool> m_Live;
+		std::vector<Handle> m_FreeHandles;
+
+		std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_Pending;
+		std::vector<Retired> m_Retired;
+
+	};
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <DirectXMath.h>
+
+#include <string>
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Ground queries for placement and terrain. The batch calls take SoA (x, z) arrays, run 8 points
+	// per iteration under AVX2 (4 with DirectXMath otherwise) and split large batches over the JobSystem.
+	class HeightField {
+	public:
+		HeightField() = default;
+		HeightField(const HeightField&) = delete;
+		HeightField& operator=(const HeightField&) = delete;
+		virtual ~HeightField() = default;
+
+		virtual float GetHeight(float x, float z) const = 0;
+		virtual DirectX::XMFLOAT3 GetNormal(float x, float z) const = 0;
+
+		void GetHeights(const float* xs, const float* zs, size_t count, float* outHeights) const;
+		void GetNormals(const float* xs, const float* zs, size_t count, DirectX::XMFLOAT3* outNormals) const;
+
+	protected:
+		// One contiguous range on the calling thread; the defaults fall back to the scalar queries.
+		virtual void GetHeightsRange(const float* xs, const float* zs, size_t count, float* outHeights) const;
+		virtual void GetNormalsRange(const float* xs, const float* zs, size_t count, DirectX::XMFLOAT3* outNormals) const;
+
+	};
+
+	// y = 0.3 * (z * sin(0.1x) + x * cos(0.1z)), the LandAndWaves hills.
+	class HillsHeightField : public HeightField {
+	public:
+		float GetHeight(float x, float z) const override;
+		DirectX::XMFLOAT3 GetNormal(float x, float z) const override;
+
+	protected:
+		void GetHeightsRange(const float* xs, const float* zs, size_t count, float* outHeights) const override;
+		void GetNormalsRange(const float* xs, const float* zs, size_t count, DirectX::XMFLOAT3* outNormals) const override;
+
+	};
+
+	// Regular grid of height samples with bilinear filtering and a normal map cached at load time.
+	class HeightMap : public HeightField {
+	public:
+		HeightMap();
+
+		// heights: width * depth samples, row major along +x, rows along +z.
+		void Initialize(UINT width, UINT depth, float cellSpacing, const DirectX::XMFLOAT2& origin,
+			std::vector<float> heights);
+
+		// 16-bit little-endian RAW; height = sample / 65535 * heightScale + heightOffset.
+		bool LoadRaw16(const std::string& filename, UINT width, UINT depth, float cellSpacing,
+			const DirectX::XMFLOAT2& origin, float heightScale, float heightOffset);
+
+		float GetHeight(float x, float z) const override;
+		DirectX::XMFLOAT3 GetNormal(float x, float z) const override;
+
+		UINT GetWidth() const;
+		UINT GetDepth() const;
+		float GetCellSpacing() const;
+
+	protected:
+		void GetHeightsRange(const float* xs, const float* zs, size_t count, float* outHeights) const override;
+		void GetNormalsRange(const float* xs, const float* zs, size_t count, DirectX::XMFLOAT3* outNormals) const override;
+
+	private:
+		void BuildNormalMap();
+
+		// Grid cell (clamped to the map) and the fractional position inside it.
+		void GetCell(float x, float z, UINT& ix, UINT& iz, float& fx, float& fz) const;
+
+	private:
+		std::vector<float> m_Heights;
+		std::vector<DirectX::XMFLOAT3> m_Normals;
+
+		UINT m_Width = 0;
+		UINT m_Depth = 0;
+		float m_CellSpacing = 1.0f;
+		float m_InvCellSpacing = 1.0f;
+		DirectX::XMFLOAT2 m_Origin = { 0.0f, 0.0f };
+
+	};
+}
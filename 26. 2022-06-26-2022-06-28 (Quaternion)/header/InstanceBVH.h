@@ -0,0 +1,97 @@
+#pragma once
+
+#include "TriangleBVH.h"
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include <cfloat>
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Top level of a two level acceleration structure: a BVH over the world bounds of mesh instances,
+	// each leaf one instance that points at its mesh's shared TriangleBVH. Nodes use the TriangleBVH
+	// layout; a leaf's Offset is the instance it holds. Moving instances refits the path above them,
+	// the topology only changes on Build.
+	class InstanceBVH {
+	public:
+		static const UINT NullInstance = 0xffffffff;
+
+		// T, U, V and Triangle as in TriangleBVH::Hit; Item and Instance are what the instance was added with.
+		struct Hit {
+			float T = FLT_MAX;
+			float U = 0.0f;
+			float V = 0.0f;
+			UINT Item = NullInstance;
+			UINT Instance = 0;
+			UINT Triangle = TriangleBVH::NullTriangle;
+		};
+
+		InstanceBVH();
+		InstanceBVH(const InstanceBVH&) = delete;
+		InstanceBVH& operator=(const InstanceBVH&) = delete;
+		~InstanceBVH();
+
+		void Clear();
+
+		// mesh has to outlive the tree. Returns the id SetWorld takes; instances added after Build are
+		// only found once Build runs again.
+		UINT AddInstance(const TriangleBVH* mesh, DirectX::CXMMATRIX world, UINT item, UINT instance);
+		void SetWorld(UINT id, DirectX::CXMMATRIX world);
+
+		// Top-down binned SAH over the current world bounds.
+		void Build();
+
+		// Brings the boxes above every instance moved since the last Build or Refit up to date.
+		void Refit();
+
+		// World space rays; only hits with T in [0, tMax) count.
+		bool ClosestHit(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMax, Hit& outHit) const;
+		bool AnyHit(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMax) const;
+
+		// A sphere swept from origin along direction. Instance boxes are grown by radius; the leaves sweep
+		// it against their triangles, so the Hit is the first contact with the mesh itself.
+		bool SweepSphere(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float radius, float tMax,
+			Hit& outHit) const;
+
+		// Appends the id of every instance whose world bounds intersect box.
+		void Overlap(const DirectX::BoundingBox& box, std::vector<UINT>& outIds) const;
+
+		UINT GetItem(UINT id) const;
+		UINT GetInstanceIndex(UINT id) const;
+
+		DirectX::BoundingBox GetBounds() const;
+		size_t GetNodeCount() const;
+		UINT GetInstanceCount() const;
+
+	private:
+		void Place(UINT id, DirectX::CXMMATRIX world);
+		void BuildRange(std::vector<UINT>& ids, const std::vector<DirectX::XMFLOAT3>& centroids, UINT node,
+			size_t first, size_t last, int depth);
+
+		// Sweep grows every box by radius and sweeps the sphere through the mesh at the leaves.
+		template <bool AnyHitOnly, bool Sweep>
+		bool Traverse(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float radius, float tMax,
+			Hit& outHit) const;
+
+	private:
+		std::vector<TriangleBVH::Node> m_Nodes;
+		std::vector<UINT> m_Parents;
+
+		// Per instance.
+		std::vector<const TriangleBVH*> m_Meshes;
+		std::vector<DirectX::XMFLOAT4X3> m_World;
+		std::vector<DirectX::XMFLOAT4X3> m_InvWorld;
+		std::vector<DirectX::XMFLOAT3> m_Min;
+		std::vector<DirectX::XMFLOAT3> m_Max;
+		std::vector<UINT> m_Items;
+		std::vector<UINT> m_Instances;
+		std::vector<UINT> m_Leaves;			// NullInstance until Build places the instance
+		std::vector<UINT8> m_Moved;
+
+		std::vector<UINT> m_MovedInstances;
+
+	};
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "FrameResource.h"
+
+#include <DirectXMath.h>
+
+namespace Mawi1e {
+	class InstancePacker {
+	public:
+		InstancePacker() = delete;
+
+		// Packs the items listed in items[0, count) into outInstances, in list order. worlds, texTransforms
+		// and materials are dense per-item arrays; 2 instances per iteration under AVX2.
+		static void Pack(const DirectX::XMFLOAT4X4* worlds, const DirectX::XMFLOAT4X4* texTransforms,
+			const UINT* materials, const UINT* items, size_t count, PackedInstance* outInstances);
+
+		static void Pack(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& texTransform,
+			UINT material, PackedInstance& outInstance);
+
+	};
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	class JobSystem {
+	public:
+		// (first, last) range of a chunk and the index of the chunk itself.
+		using RangeJob = std::function<void(size_t, size_t, size_t)>;
+
+		JobSystem();
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		~JobSystem();
+
+		static JobSystem* Get();
+
+		void Initialize(UINT workerCount = 0);
+		void Shutdown();
+
+		UINT GetWorkerCount() const;
+		size_t GetChunkCount(size_t count, size_t minChunkSize) const;
+
+		// Splits [0, count) into GetChunkCount() contiguous chunks and blocks until all of them ran.
+		// The calling thread takes part in the work. Calls from several threads at once are queued and
+		// share the workers in the order they came; nested calls (from inside a job) run inline.
+		void ParallelFor(size_t count, size_t minChunkSize, const RangeJob& job);
+
+	private:
+		// One ParallelFor call, on its caller's stack. Guarded by m_Mutex.
+		struct Dispatch {
+			const RangeJob* Job = nullptr;
+			size_t Count = 0;
+			size_t ChunkCount = 0;
+			size_t NextChunk = 0;
+			size_t DoneChunks = 0;
+		};
+
+		void WorkerLoop();
+
+		// Runs chunk c of dispatch and reports it done; dispatch may be gone once this returns.
+		void RunChunk(Dispatch& dispatch, size_t c);
+
+	private:
+		std::vector<std::thread> m_Workers;
+		std::mutex m_Mutex;
+		std::condition_variable m_WakeUp;
+		std::condition_variable m_Finished;
+
+		// Dispatches with chunks not yet handed out, oldest first.
+		std::vector<Dispatch*> m_Queue;
+		bool m_Quit = false;
+
+	};
+}
\ No newline at end of file
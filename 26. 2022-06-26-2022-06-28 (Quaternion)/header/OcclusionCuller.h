@@ -0,0 +1,91 @@
+#pragma once
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Masked software occlusion culling. Occluders are rasterized into a low resolution depth buffer of
+	// 8x4 pixel tiles; each tile keeps a 32-bit coverage mask of a working layer and two depths, so no
+	// per-pixel depth is stored. The reference depth of a tile is a conservative farthest depth for the
+	// whole tile and is what occludees are tested against. Depth is post-projection z/w, 0 = near.
+	class OcclusionCuller {
+	public:
+		static const UINT TileWidth = 8;
+		static const UINT TileHeight = 4;
+
+		struct Mesh {
+			std::vector<DirectX::XMFLOAT3> Positions;
+			std::vector<UINT> Indices;
+		};
+
+		OcclusionCuller();
+		OcclusionCuller(const OcclusionCuller&) = delete;
+		OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+		~OcclusionCuller();
+
+		// Rounded up to whole tiles.
+		void Initialize(UINT width, UINT height);
+
+		// Twelve triangles of a box; a box flat along one axis is its quad.
+		static Mesh BuildBoxMesh(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents);
+
+		void BeginFrame(DirectX::FXMMATRIX viewProj);
+		void AddOccluder(const Mesh& mesh, DirectX::FXMMATRIX world);
+
+		// Bins the occluder triangles into bands of tile rows and rasterizes the bands in parallel.
+		void Rasterize();
+
+		bool IsVisible(const DirectX::BoundingBox& worldBox) const;
+
+		UINT GetWidth() const;
+		UINT GetHeight() const;
+		UINT GetTriangleCount() const;
+
+	private:
+		struct Triangle {
+			// Edge functions A*x + B*y + C, >= 0 inside, in pixel units.
+			float EdgeA[3];
+			float EdgeB[3];
+			float EdgeC[3];
+
+			// Depth plane z = ZX*x + ZY*y + Z0, and the nearest and farthest vertex depths.
+			float ZX;
+			float ZY;
+			float Z0;
+			float MinZ;
+			float MaxZ;
+
+			int MinTileX;
+			int MaxTileX;
+			int MinTileY;
+			int MaxTileY;
+		};
+
+		void SetupTriangle(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b, const DirectX::XMFLOAT4& c);
+		void RasterizeBand(UINT band);
+		void RasterizeTriangle(const Triangle& tri, int firstTileRow, int lastTileRow);
+		UINT CoverageMask(const Triangle& tri, int tileX, int tileY) const;
+		void UpdateTile(UINT tile, UINT coverage, float depth);
+
+	private:
+		UINT m_Width = 0;
+		UINT m_Height = 0;
+		UINT m_TilesX = 0;
+		UINT m_TilesY = 0;
+		UINT m_BandCount = 0;
+
+		DirectX::XMFLOAT4X4 m_ViewProj;
+
+		std::vector<Triangle> m_Triangles;
+		std::vector<std::vector<UINT>> m_Bins;
+
+		std::vector<UINT> m_Mask;
+		std::vector<float> m_WorkingZ;
+		std::vector<float> m_ReferenceZ;
+
+	};
+}
@@ -13,14 +13,61 @@ struct Keyframe
 	DirectX::XMFLOAT3 Scale;
 };
 
+// Remembers the key span an instance sampled last, so the next sample usually finds its span
+// without a search.
+struct AnimationCursor
+{
+	AnimationCursor() : Key(0) {}
+
+	size_t Key;
+};
+
 struct BoneAnimation
 {
 	float GetStartTime() const;
 	float GetEndTime() const;
 
+	// Packs the key times into timePos, which every search below reads. Call it again after
+	// keyFrames change.
+	void BuildTimeTable();
+
+	// Wraps dt into the clip so looping and reverse playback never run off either end.
+	float WrapTime(float dt) const;
+
+	// Clamped to the first and last key outside the clip. Without a cursor the span is found by
+	// binary search; with one it is checked against the last span and its neighbours first.
+	// BuildTimeTable has to have run since keyFrames last changed; debug builds assert it.
 	void Interpolate(float dt, DirectX::XMFLOAT4X4& M) const;
+	void Interpolate(float dt, DirectX::XMFLOAT4X4& M, AnimationCursor& cursor) const;
+
+	// The same sample as scale, rotation and translation instead of a matrix.
+	void Interpolate(float dt, DirectX::XMFLOAT3& S, DirectX::XMFLOAT4& Q, DirectX::XMFLOAT3& T) const;
 
 	std::vector<Keyframe> keyFrames;
+	std::vector<float> timePos;
+
+private:
+	size_t FindKey(float dt) const;
+	size_t FindKey(float dt, AnimationCursor& cursor) const;
+
+	void Pose(const Keyframe& key, DirectX::XMFLOAT4X4& M) const;
+	void Blend(size_t key, float dt, DirectX::XMFLOAT4X4& M) const;
+};
+
+// One BoneAnimation per skeleton bone, in the skeleton's bone order. Bones whose keys end early
+// hold their last key for the rest of the clip.
+struct AnimationClip
+{
+	float GetClipStartTime() const;
+	float GetClipEndTime() const;
+
+	void BuildTimeTables();
+	float WrapTime(float dt) const;
+
+	// Writes every bone's to-parent transform; cursors holds one per bone.
+	void Interpolate(float dt, DirectX::XMFLOAT4X4* boneTransforms, AnimationCursor* cursors) const;
+
+	std::vector<BoneAnimation> boneAnimations;
 };
 
 class QuaternionManager
@@ -34,8 +81,13 @@ public:
 	void Initailize();
 	void Update(float dt, DirectX::XMFLOAT4X4& M);
 
+	// Negative rates play the clip backwards.
+	void SetPlaybackRate(float rate);
+
 private:
 	BoneAnimation m_BoneAnimator;
+	AnimationCursor m_Cursor;
 	float m_AnimateFrame;
+	float m_PlaybackRate;
 
 };
\ No newline at end of file
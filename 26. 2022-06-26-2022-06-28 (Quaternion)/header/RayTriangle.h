@@ -0,0 +1,46 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Eight triangles laid out structure of arrays, one per lane. Unused lanes are zeroed; a
+	// triangle with all three vertices equal never reports a hit.
+	struct alignas(32) TrianglePacket {
+		float V[3][3][8];		// [vertex][axis][lane]
+	};
+
+	// Watertight ray/triangle tests (Woop, Benthin and Wald) over whole packets: 8 lanes per iteration
+	// under AVX2, two 4 lane halves through XMVECTOR otherwise. Both faces count.
+	class RayTriangle {
+	public:
+		static const UINT PacketWidth = 8;
+
+		// Per ray state shared by every packet it is tested against; see PrepareRay.
+		struct Ray {
+			DirectX::XMFLOAT3 Origin;
+			int Kx, Ky, Kz;
+			float Sx, Sy, Sz;
+		};
+
+		RayTriangle() = delete;
+
+		static Ray PrepareRay(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction);
+
+		static void ClearPacket(TrianglePacket& packet);
+		static void SetTriangle(TrianglePacket& packet, UINT lane, const DirectX::XMFLOAT3& v0,
+			const DirectX::XMFLOAT3& v1, const DirectX::XMFLOAT3& v2);
+
+		// Closest lane with T in [0, tMax), or -1. T is in lengths of the direction given to PrepareRay,
+		// the hit point is (1 - U - V) * v0 + U * v1 + V * v2.
+		static int Intersect(const Ray& ray, const TrianglePacket& packet, float tMax,
+			float& outT, float& outU, float& outV);
+		static bool IntersectAny(const Ray& ray, const TrianglePacket& packet, float tMax);
+
+		// Every packet in turn; outTriangle is packet * PacketWidth + lane.
+		static bool Intersect(const Ray& ray, const TrianglePacket* packets, size_t packetCount, float tMax,
+			float& outT, float& outU, float& outV, UINT& outTriangle);
+
+	};
+}
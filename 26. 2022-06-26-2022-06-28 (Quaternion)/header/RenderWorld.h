@@ -0,0 +1,146 @@
+#pragma once
+
+#include "VertexBuffer.h"
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Index names a sparse slot that outlives compaction of the dense arrays; Generation tells the
+	// item apart from a later one that reused the slot.
+	struct RenderHandle {
+		UINT Index = 0xffffffff;
+		UINT Generation = 0;
+	};
+
+	// Render items as dense SoA arrays. Items are addressed by handle from the outside and by dense
+	// index inside per-frame loops; destroying an item moves the last one into its place, so the
+	// arrays stay packed and dense indices of other items may change.
+	class RenderWorld {
+	public:
+		static const UINT NullIndex = 0xffffffff;
+
+		enum ItemFlags : UINT {
+			ItemVisible = 0x1,
+			ItemOccluder = 0x2,
+		};
+
+		// A draw range of a MeshGeometry, shared by every item that refers to it.
+		struct Mesh {
+			MeshGeometry* Geo = nullptr;
+			D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+			UINT IndexCount = 0;
+			UINT StartIndexLocation = 0;
+			INT BaseVertexLocation = 0;
+			DirectX::BoundingBox Bounds;
+			DirectX::BoundingSphere SphereBounds;
+		};
+
+		struct ItemDesc {
+			DirectX::XMFLOAT4X4 World = VertexBuffer::GetMatrixIdentity4x4();
+			DirectX::XMFLOAT4X4 TexTransform = VertexBuffer::GetMatrixIdentity4x4();
+			UINT Mesh = NullIndex;
+			UINT Material = 0;
+			UINT Layer = 0;
+			UINT Flags = ItemVisible;
+		};
+
+		// frameResourceCount: frames an item stays dirty after it changed.
+		explicit RenderWorld(int frameResourceCount);
+		RenderWorld(const RenderWorld&) = delete;
+		RenderWorld& operator=(const RenderWorld&) = delete;
+		~RenderWorld();
+
+		UINT AddMesh(const Mesh& mesh);
+		Mesh& GetMesh(UINT mesh);
+		const Mesh& GetMesh(UINT mesh) const;
+		UINT GetMeshCount() const;
+
+		// Bounds are taken from the mesh.
+		RenderHandle Create(const ItemDesc& desc);
+		void Destroy(RenderHandle handle);
+
+		bool IsAlive(RenderHandle handle) const;
+		UINT GetIndex(RenderHandle handle) const;
+		RenderHandle GetHandle(UINT index) const;
+		UINT GetCount() const;
+
+		// The sparse slot of an item; stable for the item's lifetime, so it doubles as its instance slot.
+		UINT GetInstanceSlot(UINT index) const;
+		UINT GetSlotCapacity() const;
+
+		const DirectX::XMFLOAT4X4& GetWorld(UINT index) const;
+		void SetWorld(UINT index, const DirectX::XMFLOAT4X4& world);
+		const DirectX::XMFLOAT4X4& GetTexTransform(UINT index) const;
+		const DirectX::BoundingBox& GetBounds(UINT index) const;
+		const DirectX::BoundingSphere& GetSphereBounds(UINT index) const;
+		// For items whose mesh changed its range after Create; the culling structures refit next frame.
+		void SetBounds(UINT index, const DirectX::BoundingBox& bounds, const DirectX::BoundingSphere& sphereBounds);
+		UINT GetMeshIndex(UINT index) const;
+		UINT GetMaterial(UINT index) const;
+		void SetMaterial(UINT index, UINT material);
+		UINT GetLayer(UINT index) const;
+
+		// The dense arrays themselves, for batch loops over many items.
+		const DirectX::XMFLOAT4X4* GetWorldData() const;
+		const DirectX::BoundingBox* GetBoundsData() const;
+		const DirectX::XMFLOAT4X4* GetTexTransformData() const;
+		const UINT* GetMaterialData() const;
+
+		UINT GetFlags(UINT index) const;
+		void SetFlags(UINT index, UINT flags);
+
+		// Frames left until every frame resource saw the latest world matrix.
+		int GetDirtyFrames(UINT index) const;
+		void MarkDirty(UINT index);
+		void ConsumeDirtyFrame(UINT index);
+
+		// Set when the world matrix, texture transform or material changed since the instance slot was written.
+		bool IsInstanceDirty(UINT index) const;
+		void ClearInstanceDirty(UINT index);
+
+		// Set when the world matrix changed since the culling structures were refit; one refit clears it.
+		bool IsBoundsDirty(UINT index) const;
+		void ClearBoundsDirty(UINT index);
+
+		int GetCullProxy(UINT index) const;
+		void SetCullProxy(UINT index, int proxy);
+		UINT GetSceneNode(UINT index) const;
+		void SetSceneNode(UINT index, UINT node);
+
+	private:
+		struct Slot {
+			UINT Dense = NullIndex;		// next free slot while free
+			UINT Generation = 0;
+		};
+
+	private:
+		int m_FrameResourceCount;
+
+		std::vector<Mesh> m_Meshes;
+
+		std::vector<Slot> m_Slots;
+		UINT m_FreeSlot = NullIndex;
+
+		// Dense, one entry per live item.
+		std::vector<UINT> m_SlotOfItem;
+		std::vector<DirectX::XMFLOAT4X4> m_World;
+		std::vector<DirectX::XMFLOAT4X4> m_TexTransform;
+		std::vector<DirectX::BoundingBox> m_Bounds;
+		std::vector<DirectX::BoundingSphere> m_SphereBounds;
+		std::vector<UINT> m_Mesh;
+		std::vector<UINT> m_Material;
+		std::vector<UINT> m_Layer;
+		std::vector<UINT> m_Flags;
+		std::vector<int> m_DirtyFrames;
+		std::vector<UINT8> m_InstanceDirty;
+		std::vector<UINT8> m_BoundsDirty;
+		std::vector<int> m_CullProxy;
+		std::vector<UINT> m_SceneNode;
+
+	};
+}
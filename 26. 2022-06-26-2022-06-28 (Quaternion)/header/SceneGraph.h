@@ -0,0 +1,82 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <utility>
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Transform hierarchy kept as SoA arrays of local TRS sorted so that every root is followed by its
+	// whole subtree: a parent always precedes its children and each root owns a contiguous range. World
+	// matrices are recomputed in one linear pass over the roots that had a local change, one job per
+	// group of roots.
+	class SceneGraph {
+	public:
+		static const UINT NullNode = 0xffffffff;
+
+		SceneGraph();
+		SceneGraph(const SceneGraph&) = delete;
+		SceneGraph& operator=(const SceneGraph&) = delete;
+		~SceneGraph();
+
+		void Clear();
+
+		// Node handles stay valid when the arrays are re-sorted. The parent has to exist already.
+		UINT CreateNode(UINT parent, UINT userData);
+
+		// Removes the node and its whole subtree; their handles are reused by later CreateNode calls and
+		// their slots leave the arrays at the next Update.
+		void RemoveNode(UINT node);
+
+		void SetLocal(UINT node, const DirectX::XMFLOAT3& scale, const DirectX::XMFLOAT4& rotation,
+			const DirectX::XMFLOAT3& translation);
+
+		// Decomposed into TRS; local has to be an affine scale-rotation-translation.
+		void SetLocal(UINT node, DirectX::FXMMATRIX local);
+
+		// Sorts after structural changes and recomputes the world matrices of dirty subtrees.
+		void Update();
+
+		const DirectX::XMFLOAT4X4& GetWorld(UINT node) const;
+		UINT GetParent(UINT node) const;
+		UINT GetUserData(UINT node) const;
+		void SetUserData(UINT node, UINT userData);
+		UINT GetNodeCount() const;
+
+		// Nodes whose world matrix changed in the last Update, in update order.
+		const std::vector<UINT>& GetChangedNodes() const;
+
+	private:
+		void Sort();
+		void UpdateRange(UINT first, UINT last);
+
+	private:
+		// Per handle.
+		std::vector<UINT> m_SlotOfNode;
+		std::vector<UINT> m_ParentNode;
+
+		// Per slot, in hierarchy order.
+		std::vector<UINT> m_NodeOfSlot;
+		std::vector<UINT> m_ParentSlot;
+		std::vector<UINT> m_RangeOfSlot;
+		std::vector<UINT> m_UserData;
+		std::vector<DirectX::XMFLOAT3> m_Scale;
+		std::vector<DirectX::XMFLOAT4> m_Rotation;
+		std::vector<DirectX::XMFLOAT3> m_Translation;
+		std::vector<DirectX::XMFLOAT4X4> m_World;
+		std::vector<UINT8> m_LocalDirty;
+		std::vector<UINT8> m_WorldDirty;
+
+		// Per root: its [first, last) slots and whether anything below it changed.
+		std::vector<std::pair<UINT, UINT>> m_RootRanges;
+		std::vector<UINT8> m_RangeDirty;
+		std::vector<UINT> m_DirtyRanges;
+
+		std::vector<UINT> m_ChangedNodes;
+		std::vector<UINT> m_FreeNodes;
+		bool m_OrderDirty = false;
+
+	};
+}
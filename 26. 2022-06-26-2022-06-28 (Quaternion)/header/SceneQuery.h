@@ -0,0 +1,98 @@
+#pragma once
+
+#include "InstanceBVH.h"
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include <cfloat>
+#include <cstdint>
+#include <future>
+#include <utility>
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Batched scene queries. Everything submitted during a frame goes out together on Kick and runs
+	// on another thread, spread over the JobSystem workers; the next Collect makes the results
+	// readable by the tickets the submissions returned. Tickets count per kind: casts (rays, sweeps,
+	// line of sight) and overlaps.
+	class SceneQuery {
+	public:
+		static const UINT NullTicket = 0xffffffff;
+
+		struct OverlapHit {
+			UINT Item;
+			UINT Instance;
+		};
+
+		SceneQuery();
+		SceneQuery(const SceneQuery&) = delete;
+		SceneQuery& operator=(const SceneQuery&) = delete;
+		~SceneQuery();
+
+		UINT Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMax = FLT_MAX);
+		UINT SweepSphere(DirectX::FXMVECTOR center, DirectX::FXMVECTOR direction, float radius, float tMax = FLT_MAX);
+
+		// Blocked when anything lies between the two points; stops at the first hit found.
+		UINT LineOfSight(DirectX::FXMVECTOR from, DirectX::FXMVECTOR to);
+
+		UINT Overlap(const DirectX::BoundingBox& box);
+
+		// Starts everything submitted since the last Kick against scene, which must not change until the
+		// next Collect. The future is ready once the batch ran; its results still need Collect.
+		std::shared_future<void> Kick(const InstanceBVH& scene);
+
+		// Waits for the batch in flight, if any, and makes its results current.
+		void Collect();
+
+		// Results of the batch the last Collect made current. Item and instance indices are the ones
+		// the scene held when the batch ran.
+		bool IsHit(UINT cast) const;
+		const InstanceBVH::Hit& GetHit(UINT cast) const;
+		UINT GetOverlaps(UINT overlap, const OverlapHit*& outHits) const;
+
+		UINT GetCastCount() const;
+		UINT GetOverlapCount() const;
+
+	private:
+		enum CastKind : UINT {
+			CastRay,
+			CastSweep,
+			CastLineOfSight,
+		};
+
+		struct Cast {
+			DirectX::XMFLOAT3 Origin;
+			float TMax;
+			DirectX::XMFLOAT3 Direction;
+			float Radius;
+			UINT Kind;
+		};
+
+		struct Batch {
+			std::vector<Cast> Casts;
+			std::vector<DirectX::BoundingBox> Overlaps;
+
+			std::vector<std::pair<std::uint64_t, UINT>> Order;
+			std::vector<InstanceBVH::Hit> Hits;
+			std::vector<UINT8> Found;
+			std::vector<std::vector<OverlapHit>> OverlapHits;
+
+			void Clear();
+		};
+
+		UINT AddCast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMax, float radius, UINT kind);
+
+		static void Execute(Batch& batch, const InstanceBVH& scene);
+
+	private:
+		Batch m_Pending;
+		Batch m_Running;
+		Batch m_Done;
+
+		std::shared_future<void> m_InFlight;
+
+	};
+}
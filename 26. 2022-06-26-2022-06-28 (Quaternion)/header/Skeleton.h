@@ -0,0 +1,46 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Bone hierarchy as a parent index per bone, stored so that every parent comes before its
+	// children. That order lets a whole pose go from local to model space in one forward pass.
+	class Skeleton {
+	public:
+		static const UINT NullBone = 0xffffffff;
+
+		Skeleton();
+		Skeleton(const Skeleton&) = delete;
+		Skeleton& operator=(const Skeleton&) = delete;
+		~Skeleton();
+
+		void Clear();
+
+		// parent is NullBone for a root and has to be added already. boneOffset takes bind pose
+		// model space into the bone's own space. Returns the new bone's index.
+		UINT AddBone(UINT parent, DirectX::CXMMATRIX boneOffset);
+
+		UINT GetBoneCount() const;
+		UINT GetParent(UINT bone) const;
+		const DirectX::XMFLOAT4X4& GetBoneOffset(UINT bone) const;
+
+		// local holds each bone's to-parent transform; model gets its to-root transform.
+		void ToModel(const DirectX::XMFLOAT4X4* local, DirectX::XMFLOAT4X4* model) const;
+
+		// palette[i] = offset[i] * model[i], the matrix a vertex bound to bone i is skinned by.
+		void BuildPalette(const DirectX::XMFLOAT4X4* model, DirectX::XMFLOAT4X4* palette) const;
+
+		// ToModel and BuildPalette together; model is scratch for GetBoneCount() matrices.
+		void BuildPalette(const DirectX::XMFLOAT4X4* local, DirectX::XMFLOAT4X4* model,
+			DirectX::XMFLOAT4X4* palette) const;
+
+	private:
+		std::vector<UINT> m_Parents;
+		std::vector<DirectX::XMFLOAT4X4> m_BoneOffsets;
+
+	};
+}
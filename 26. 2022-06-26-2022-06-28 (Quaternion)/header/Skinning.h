@@ -0,0 +1,36 @@
+#pragma once
+
+#include "FrameResource.h"
+
+#include <DirectXMath.h>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Up to four bones per vertex. Weights sum to one; unused slots have weight zero and any bone
+	// index that exists in the palette, 0 being the usual choice.
+	struct SkinInfluence {
+		float Weights[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+		UINT8 Bones[4] = { 0, 0, 0, 0 };
+	};
+
+	// Linear blend skinning on the CPU: each vertex is moved by the weighted sum of its bones'
+	// palette matrices (Skeleton::BuildPalette). Normals and tangents go through the same matrix, so
+	// bones should not carry non-uniform scale; the blended normal is left unnormalized, as the
+	// shaders normalize it anyway.
+	class Skinning {
+	public:
+		Skinning() = delete;
+
+		// One vertex per iteration under AVX2, its blended matrix held in two 8 lane registers;
+		// SkinReference otherwise. out may be mapped upload heap memory (UploadBuffer::MappedData):
+		// each vertex is written once, front to back, in whole 16 byte stores, and out is never read.
+		static void Skin(const DirectX::XMFLOAT4X4* palette, const Vertex* bindVertices,
+			const SkinInfluence* influences, size_t count, Vertex* out);
+
+		// Scalar version of the same sums, the reference Skin is checked against.
+		static void SkinReference(const DirectX::XMFLOAT4X4* palette, const Vertex* bindVertices,
+			const SkinInfluence* influences, size_t count, Vertex* out);
+
+	};
+}
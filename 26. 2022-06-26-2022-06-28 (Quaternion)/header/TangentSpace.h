@@ -0,0 +1,47 @@
+#pragma once
+
+#include "FrameResource.h"
+#include "JobSystem.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Mawi1e {
+	class TangentSpace {
+	public:
+		struct Options {
+			Options() : RecomputeNormals(true), SplitMirroredVertices(true) {}
+
+			// false keeps the incoming normals (e.g. skull.txt ships its own).
+			bool RecomputeNormals;
+			// Vertices shared by triangles with opposite UV winding get one copy per handedness.
+			bool SplitMirroredVertices;
+		};
+
+		// OBJ style input: every triangle corner references its own position/uv/normal stream.
+		struct CornerIndex {
+			std::uint32_t Position = 0;
+			std::uint32_t TexC = UINT32_MAX;
+			std::uint32_t Normal = UINT32_MAX;
+		};
+
+		TangentSpace() = delete;
+
+		// Rewrites Normal/Tangent of an indexed triangle list in place. Tangent.w holds the
+		// bitangent sign (B = w * cross(N, T)). May append vertices and remap indices.
+		static void Generate(std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices,
+			const Options& options = Options());
+
+		// Welds corners into vertices, splitting only where the uv (or a given normal) differs,
+		// then runs Generate() on the result.
+		static void BuildFromCorners(
+			const std::vector<DirectX::XMFLOAT3>& positions,
+			const std::vector<DirectX::XMFLOAT2>& texCoords,
+			const std::vector<DirectX::XMFLOAT3>& normals,
+			const std::vector<CornerIndex>& corners,
+			std::vector<Vertex>& outVertices,
+			std::vector<std::uint32_t>& outIndices,
+			const Options& options = Options());
+
+	};
+}
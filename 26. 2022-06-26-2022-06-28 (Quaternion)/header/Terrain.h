@@ -0,0 +1,99 @@
+#pragma once
+
+#include "FrameResource.h"
+#include "HeightField.h"
+#include "JobSystem.h"
+
+#include <DirectXCollision.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Mawi1e {
+	// CDLOD (Strugar, 2010): a quadtree over the heightfield, one shared GridDim x GridDim patch mesh
+	// drawn instanced, every selected node is one TerrainPatch and vertices morph toward the next lod.
+	class Terrain {
+	public:
+		// Quads per patch side. Must match TERRAIN_GRID_DIM in Terrain.hlsl (passed as a shader macro).
+		static const UINT GridDim = 32;
+
+		struct Settings {
+			Settings() :
+				Size(1024.0f), Origin(-512.0f, -512.0f), LodCount(6),
+				FinestRange(96.0f), MorphStartRatio(0.66f), BaseHeight(0.0f),
+				MaxPatches(1024), MaterialIndex(0) {}
+
+			float Size;					// root node side length
+			DirectX::XMFLOAT2 Origin;	// world xz of the root's min corner
+			UINT LodCount;				// leaf side = Size / 2^(LodCount - 1)
+			float FinestRange;			// visibility range of lod 0, doubled per lod
+			float MorphStartRatio;		// morph over [ratio, 1] of each lod's range band
+			float BaseHeight;
+			UINT MaxPatches;
+			UINT MaterialIndex;
+		};
+
+		Terrain();
+		Terrain(const Terrain&) = delete;
+		Terrain& operator=(const Terrain&) = delete;
+		~Terrain();
+
+		// Samples heightField once into the height grid; the heightField is not kept.
+		void Initialize(const Settings& settings, const HeightField* heightField);
+
+		// Records the copy of the height grid into an R32_FLOAT texture on cmdList and writes its SRV
+		// to srvHandle, for gTerrainHeights in Terrain.hlsl. Culling bounds, lod selection, GetHeight
+		// and the displaced vertices then all read the same samples. The upload buffer is held until
+		// ReleaseUploader, once the GPU is past cmdList.
+		void UploadHeights(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+			D3D12_CPU_DESCRIPTOR_HANDLE srvHandle);
+		void ReleaseUploader();
+
+		// Rebuilds the patch list for this frame. frustumW is in world space.
+		void Select(const DirectX::XMFLOAT3& eyePosW, const DirectX::BoundingFrustum& frustumW);
+
+		const std::vector<TerrainPatch>& GetPatches() const;
+		const Settings& GetSettings() const;
+
+		// Bilinear in the height grid, as the vertex shader samples it.
+		float GetHeight(float x, float z) const;
+		float GetLodRange(UINT lod) const;
+
+		// Height grid: one sample per vertex of the finest patches, GetSampleCount() per side.
+		UINT GetSampleCount() const;
+		float GetSampleSpacing() const;
+
+		// Unit patch in [0, 1] on xz; the vertex shader places, morphs and displaces it.
+		void BuildGridMesh(std::vector<Vertex>& vertices, std::vector<std::uint16_t>& indices) const;
+
+	private:
+		void BuildHeights(const HeightField* heightField);
+		void BuildMinMaxHeights();
+
+		float GetNodeSize(UINT lod) const;
+		UINT GetNodeCount(UINT lod) const;
+		DirectX::BoundingBox GetNodeBox(UINT lod, UINT x, UINT z) const;
+
+		bool SelectNode(UINT lod, UINT x, UINT z, bool insideFrustum);
+		void AddPatch(UINT lod, UINT x, UINT z);
+
+	private:
+		Settings m_Settings;
+
+		std::vector<float> m_Heights;		// [z * m_SampleCount + x], without BaseHeight
+		UINT m_SampleCount = 0;
+		float m_SampleSpacing = 1.0f;
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_HeightTexture = nullptr;
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_HeightUploader = nullptr;
+
+		std::vector<float> m_LodRanges;
+		std::vector<std::vector<DirectX::XMFLOAT2>> m_MinMaxHeights;	// [lod][z * count + x]
+
+		std::vector<TerrainPatch> m_Patches;
+
+		DirectX::XMFLOAT3 m_EyePosW;
+		DirectX::BoundingFrustum m_FrustumW;
+
+	};
+}
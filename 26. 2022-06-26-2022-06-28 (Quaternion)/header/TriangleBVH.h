@@ -0,0 +1,92 @@
+#pragma once
+
+#include "RayTriangle.h"
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+#include <Windows.h>
+
+namespace Mawi1e {
+	// Static BVH over the triangles of one mesh, built once with binned SAH. Nodes are 32 bytes and
+	// stored depth first: the left child of an inner node follows it, the right one is at Offset. A
+	// leaf holds Count triangles, pre-swizzled into the packet at Offset so one kernel call tests them all.
+	class TriangleBVH {
+	public:
+		static const UINT NullTriangle = 0xffffffff;
+		static const UINT MaxLeafTriangles = RayTriangle::PacketWidth;
+
+		struct Node {
+			DirectX::XMFLOAT3 Min;
+			UINT Offset;
+			DirectX::XMFLOAT3 Max;
+			UINT Count;				// 0 for inner nodes
+		};
+
+		// T is measured in lengths of the ray direction as given. The hit point is
+		// (1 - U - V) * v0 + U * v1 + V * v2; Triangle is the index into the build input.
+		struct Hit {
+			float T = FLT_MAX;
+			float U = 0.0f;
+			float V = 0.0f;
+			UINT Triangle = NullTriangle;
+		};
+
+		TriangleBVH();
+		TriangleBVH(const TriangleBVH&) = delete;
+		TriangleBVH& operator=(const TriangleBVH&) = delete;
+		~TriangleBVH();
+
+		void Clear();
+
+		// positions/stride follow BoundingBox::CreateFromPoints; indices hold three vertices per triangle.
+		void Build(const DirectX::XMFLOAT3* positions, size_t stride, const std::uint32_t* indices, size_t triangleCount);
+		void Build(const DirectX::XMFLOAT3* positions, size_t stride, const std::uint16_t* indices, size_t triangleCount);
+
+		// Rays in the mesh's own space; only hits with T in [0, tMax) count.
+		bool ClosestHit(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMax, Hit& outHit) const;
+		bool AnyHit(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMax) const;
+
+		// World space rays against an instance of the mesh placed by world. The direction is not
+		// renormalized in mesh space, so T stays comparable across instances.
+		bool ClosestHit(DirectX::FXMVECTOR originW, DirectX::FXMVECTOR directionW, DirectX::CXMMATRIX world,
+			float tMax, Hit& outHit) const;
+		bool AnyHit(DirectX::FXMVECTOR originW, DirectX::FXMVECTOR directionW, DirectX::CXMMATRIX world, float tMax) const;
+
+		// A world space sphere swept from originW along directionW against the triangles of an instance
+		// placed by world, with invWorld its inverse. T is the first contact, 0 if the sphere starts
+		// touching; U and V locate the touched point on the triangle as for rays.
+		bool SweepSphere(DirectX::FXMVECTOR originW, DirectX::FXMVECTOR directionW, float radius,
+			DirectX::CXMMATRIX world, DirectX::CXMMATRIX invWorld, float tMax, Hit& outHit) const;
+
+		DirectX::BoundingBox GetBounds() const;
+		size_t GetNodeCount() const;
+		size_t GetTriangleCount() const;
+
+	private:
+		// Per input triangle, only while building.
+		struct BuildInput {
+			std::vector<DirectX::XMFLOAT3> Min;
+			std::vector<DirectX::XMFLOAT3> Max;
+			std::vector<DirectX::XMFLOAT3> Centroid;
+		};
+
+		template <class Index>
+		void BuildIndexed(const DirectX::XMFLOAT3* positions, size_t stride, const Index* indices, size_t triangleCount);
+		void BuildRange(const BuildInput& input, UINT node, size_t first, size_t last, int depth);
+
+		template <bool AnyHitOnly>
+		bool Traverse(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMax, Hit& outHit) const;
+
+	private:
+		std::vector<Node> m_Nodes;
+		std::vector<TrianglePacket> m_Packets;
+		std::vector<UINT> m_TriangleIds;		// while building per triangle, after it per packet lane
+		size_t m_TriangleCount = 0;
+
+	};
+}
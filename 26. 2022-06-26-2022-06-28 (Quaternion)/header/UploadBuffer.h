@@ -36,10 +36,26 @@ public:
 		return m_UploadBuffer.Get();
 	}
 
+	// For writers that fill a tightly strided (non constant) buffer in place instead of through CopyData.
+	T* MappedData(UINT firstElement = 0) const {
+		return reinterpret_cast<T*>(m_MappedData) + firstElement;
+	}
+
 	void CopyData(UINT elementIndex, const T& data) {
 		memcpy(&m_MappedData[m_ElementByteSize * elementIndex], &data, sizeof(T));
 	}
 
+	void CopyData(UINT firstElement, const T* data, UINT count) {
+		if (m_IsConstantBuffer) {
+			for (UINT i = 0; i < count; ++i) {
+				CopyData(firstElement + i, data[i]);
+			}
+			return;
+		}
+
+		memcpy(&m_MappedData[m_ElementByteSize * firstElement], data, sizeof(T) * count);
+	}
+
 private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_UploadBuffer = nullptr;
 
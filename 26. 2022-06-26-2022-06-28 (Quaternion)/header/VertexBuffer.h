@@ -44,6 +44,8 @@ namespace Mawi1e {
 		INT BaseVertexLocation = 0;
 
 		DirectX::BoundingBox Bounds;
+		DirectX::BoundingSphere SphereBounds;
+		DirectX::BoundingOrientedBox OrientedBounds;
 	};
 
 	struct MeshGeometry {
@@ -66,6 +68,9 @@ namespace Mawi1e {
 
 		std::unordered_map<std::string, SubMeshGeometry> DrawArgs;
 
+		// GeometryPool allocation holding the GPU copy; DrawArgs stay relative to it.
+		UINT PoolHandle = 0xffffffff;
+
 		D3D12_VERTEX_BUFFER_VIEW VertexBufferView() const {
 			D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
 			vertexBufferView.BufferLocation = GPUVertexBuffer->GetGPUVirtualAddress();
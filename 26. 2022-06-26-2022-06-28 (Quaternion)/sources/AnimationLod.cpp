@@ -0,0 +1,74 @@
+#include "AnimationLod.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		inline float ScreenSize(float distance, float radius, float invTanHalfFov) {
+			return (distance > radius) ? radius * invTanHalfFov / distance : 1.0f;
+		}
+	}
+
+	void AnimationLod::Apply(const Camera& camera, const Settings& settings, const XMFLOAT3* centers,
+		const float* radii, const UINT8* visible, CrowdAnimator& animator) {
+		const XMFLOAT3 position = camera.GetPosition();
+		const XMVECTOR eye = XMLoadFloat3(&position);
+		const float invTanHalfFov = 1.0f / std::tan(0.5f * camera.GetFovY());
+		const UINT count = animator.GetInstanceCount();
+
+		for (UINT i = 0; i < count; ++i) {
+			const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&centers[i]), eye)));
+			const float screenSize = ScreenSize(distance, radii[i], invTanHalfFov);
+
+			UINT interval = 1;
+			for (float threshold : settings.RateScreenSizes) {
+				if (screenSize < threshold) interval <<= 1;
+			}
+
+			UINT boneLod = 0;
+			for (float threshold : settings.BoneLodDistances) {
+				if (distance > threshold) ++boneLod;
+			}
+
+			animator.SetLod(i, interval, boneLod, visible == nullptr || visible[i] != 0);
+		}
+	}
+
+	float AnimationLod::GetScreenSize(const Camera& camera, const XMFLOAT3& center, float radius) {
+		const XMFLOAT3 eye = camera.GetPosition();
+		const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&center), XMLoadFloat3(&eye))));
+
+		return ScreenSize(distance, radius, 1.0f / std::tan(0.5f * camera.GetFovY()));
+	}
+
+	void AnimationLod::BuildBoneLod(const Skeleton& skeleton, float minExtent, std::vector<UINT8>& outAnimated) {
+		const UINT boneCount = skeleton.GetBoneCount();
+
+		std::vector<XMFLOAT3> origins(boneCount);
+		for (UINT i = 0; i < boneCount; ++i) {
+			XMMATRIX bind = XMMatrixInverse(nullptr, XMLoadFloat4x4(&skeleton.GetBoneOffset(i)));
+			XMStoreFloat3(&origins[i], bind.r[3]);
+		}
+
+		// Children come after their parents, so one backward pass hands every reach up the chain.
+		std::vector<float> reach(boneCount, 0.0f);
+		std::vector<float> length(boneCount, 0.0f);
+		for (UINT i = boneCount; i-- > 0;) {
+			const UINT parent = skeleton.GetParent(i);
+			if (parent == Skeleton::NullBone) continue;
+
+			length[i] = XMVectorGetX(XMVector3Length(
+				XMVectorSubtract(XMLoadFloat3(&origins[i]), XMLoadFloat3(&origins[parent]))));
+			reach[parent] = (std::max)(reach[parent], length[i] + reach[i]);
+		}
+
+		outAnimated.resize(boneCount);
+		for (UINT i = 0; i < boneCount; ++i) {
+			const bool root = (skeleton.GetParent(i) == Skeleton::NullBone);
+			outAnimated[i] = (root || length[i] + reach[i] >= minExtent) ? 1 : 0;
+		}
+	}
+}
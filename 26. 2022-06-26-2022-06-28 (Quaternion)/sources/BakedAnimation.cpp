@@ -0,0 +1,190 @@
+#include "BakedAnimation.h"
+
+#include <DirectXPackedVector.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <stdexcept>
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		// Floats of a palette matrix as stored: its first three columns.
+		const UINT gAffine = 12;
+	}
+
+	BakedAnimation::BakedAnimation() {
+	}
+
+	BakedAnimation::~BakedAnimation() {
+	}
+
+	void BakedAnimation::Initialize(const Skeleton* skeleton, Format format) {
+		m_Skeleton = skeleton;
+		m_BoneCount = skeleton->GetBoneCount();
+		m_Format = format;
+
+		m_Clips.clear();
+		m_Palettes.clear();
+		m_HalfPalettes.clear();
+
+		m_PaletteBuffer = nullptr;
+		m_ClipBuffer = nullptr;
+		ReleaseUploaders();
+	}
+
+	UINT BakedAnimation::AddClip(const AnimationClip& clip, float sampleRate) {
+		if ((UINT)clip.boneAnimations.size() != m_BoneCount) {
+			throw std::runtime_error("@@@ Error: BakedAnimation clip bone count");
+		}
+
+		const float startTime = clip.GetClipStartTime();
+
+		ClipInfo info;
+		info.BoneCount = m_BoneCount;
+		info.Duration = clip.GetClipEndTime() - startTime;
+		info.FrameCount = (std::max)((UINT)std::ceil(info.Duration * sampleRate) + 1, 2u);
+		info.FrameRate = (info.Duration > 0.0f) ? (float)(info.FrameCount - 1) / info.Duration : 0.0f;
+		info.FirstPalette = (m_Clips.empty()) ? 0 : m_Clips.back().FirstPalette + m_Clips.back().FrameCount * m_BoneCount;
+
+		if ((size_t)info.FirstPalette + (size_t)info.FrameCount * m_BoneCount > (size_t)UINT_MAX / gAffine) {
+			throw std::runtime_error("@@@ Error: BakedAnimation palette storage");
+		}
+
+		std::vector<XMFLOAT4X4> local(m_BoneCount);
+		std::vector<XMFLOAT4X4> model(m_BoneCount);
+		std::vector<XMFLOAT4X4> palette(m_BoneCount);
+
+		// Frames go forward, so every cursor only ever steps to the next key.
+		std::vector<AnimationCursor> cursors(m_BoneCount);
+
+		const size_t first = info.FirstPalette;
+		if (m_Format == FormatFloat) {
+			m_Palettes.resize(first + (size_t)info.FrameCount * m_BoneCount);
+		}
+		else {
+			m_HalfPalettes.resize((first + (size_t)info.FrameCount * m_BoneCount) * gAffine);
+		}
+
+		for (UINT frame = 0; frame < info.FrameCount; ++frame) {
+			const float t = startTime + info.Duration * (float)frame / (float)(info.FrameCount - 1);
+
+			clip.Interpolate(t, local.data(), cursors.data());
+			m_Skeleton->BuildPalette(local.data(), model.data(), palette.data());
+
+			for (UINT bone = 0; bone < m_BoneCount; ++bone) {
+				const size_t index = first + (size_t)frame * m_BoneCount + bone;
+
+				XMFLOAT3X4 columns;
+				XMStoreFloat3x4(&columns, XMLoadFloat4x4(&palette[bone]));
+
+				if (m_Format == FormatFloat) {
+					m_Palettes[index] = columns;
+				}
+				else {
+					const float* source = &columns._11;
+					UINT16* halves = &m_HalfPalettes[index * gAffine];
+					for (UINT i = 0; i < gAffine; ++i) {
+						halves[i] = PackedVector::XMConvertFloatToHalf(source[i]);
+					}
+				}
+			}
+		}
+
+		m_Clips.push_back(info);
+		return (UINT)m_Clips.size() - 1;
+	}
+
+	void BakedAnimation::LoadBone(UINT palette, float* out) const {
+		if (m_Format == FormatFloat) {
+			const float* source = &m_Palettes[palette]._11;
+			std::copy(source, source + gAffine, out);
+		}
+		else {
+			const UINT16* halves = &m_HalfPalettes[(size_t)palette * gAffine];
+			for (UINT i = 0; i < gAffine; ++i) {
+				out[i] = PackedVector::XMConvertHalfToFloat(halves[i]);
+			}
+		}
+	}
+
+	void BakedAnimation::Sample(UINT clip, float time, XMFLOAT4X4* palette) const {
+		const ClipInfo& info = m_Clips[clip];
+
+		// The same steps as BakedSkinMatrix in the shaders.
+		float t = (info.Duration > 0.0f) ? time - info.Duration * std::floor(time / info.Duration) : 0.0f;
+		float frame = t * info.FrameRate;
+
+		const UINT frame0 = (std::min)((UINT)frame, info.FrameCount - 1);
+		const UINT frame1 = (std::min)(frame0 + 1, info.FrameCount - 1);
+		const float weight = frame - (float)frame0;
+
+		const UINT first0 = info.FirstPalette + frame0 * m_BoneCount;
+		const UINT first1 = info.FirstPalette + frame1 * m_BoneCount;
+
+		for (UINT bone = 0; bone < m_BoneCount; ++bone) {
+			XMFLOAT3X4 a, b;
+			LoadBone(first0 + bone, &a._11);
+			LoadBone(first1 + bone, &b._11);
+
+			XMMATRIX A = XMLoadFloat3x4(&a);
+			XMMATRIX B = XMLoadFloat3x4(&b);
+
+			XMMATRIX M;
+			M.r[0] = XMVectorLerp(A.r[0], B.r[0], weight);
+			M.r[1] = XMVectorLerp(A.r[1], B.r[1], weight);
+			M.r[2] = XMVectorLerp(A.r[2], B.r[2], weight);
+			M.r[3] = XMVectorLerp(A.r[3], B.r[3], weight);
+
+			XMStoreFloat4x4(&palette[bone], M);
+		}
+	}
+
+	void BakedAnimation::Upload(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList) {
+		if (m_Clips.empty()) {
+			throw std::runtime_error("@@@ Error: BakedAnimation uploaded without clips");
+		}
+
+		const void* table = (m_Format == FormatFloat) ? (const void*)m_Palettes.data() : (const void*)m_HalfPalettes.data();
+
+		m_PaletteBuffer = VertexBuffer::CreateDefaultBuffer(device, cmdList, table, (UINT64)GetByteSize(),
+			m_PaletteUploader);
+		m_ClipBuffer = VertexBuffer::CreateDefaultBuffer(device, cmdList, m_Clips.data(),
+			(UINT64)m_Clips.size() * sizeof(ClipInfo), m_ClipUploader);
+	}
+
+	void BakedAnimation::ReleaseUploaders() {
+		m_PaletteUploader = nullptr;
+		m_ClipUploader = nullptr;
+	}
+
+	ID3D12Resource* BakedAnimation::GetPaletteBuffer() const {
+		return m_PaletteBuffer.Get();
+	}
+
+	ID3D12Resource* BakedAnimation::GetClipBuffer() const {
+		return m_ClipBuffer.Get();
+	}
+
+	BakedAnimation::Format BakedAnimation::GetFormat() const {
+		return m_Format;
+	}
+
+	UINT BakedAnimation::GetBoneCount() const {
+		return m_BoneCount;
+	}
+
+	UINT BakedAnimation::GetClipCount() const {
+		return (UINT)m_Clips.size();
+	}
+
+	const BakedAnimation::ClipInfo& BakedAnimation::GetClip(UINT clip) const {
+		return m_Clips[clip];
+	}
+
+	size_t BakedAnimation::GetByteSize() const {
+		return (m_Format == FormatFloat) ? m_Palettes.size() * sizeof(XMFLOAT3X4) : m_HalfPalettes.size() * sizeof(UINT16);
+	}
+}
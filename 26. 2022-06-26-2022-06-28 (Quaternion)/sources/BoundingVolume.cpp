@@ -0,0 +1,356 @@
+#include "BoundingVolume.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		const int gGrowIterations = 64;
+		const float gRefineShrink[] = { 0.98f, 0.95f, 0.9f, 0.85f, 0.8f };
+
+		inline const XMFLOAT3* PointAt(const XMFLOAT3* pPoints, size_t stride, size_t i) {
+			return reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const BYTE*>(pPoints) + i * stride);
+		}
+
+#if defined(__AVX2__)
+		inline __m256i GatherOffsets(size_t stride) {
+			return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+				_mm256_set1_epi32((int)(stride / sizeof(float))));
+		}
+
+		// World AABBs of the 8 items in items, written to outBoxes[0..7].
+		inline void TransformBoxes8(const BoundingBox* localBoxes, const XMFLOAT4X4* worlds, __m256i items, BoundingBox* outBoxes) {
+			const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+			const __m256i boxOffsets = _mm256_mullo_epi32(items, _mm256_set1_epi32((int)(sizeof(BoundingBox) / sizeof(float))));
+			const __m256i worldOffsets = _mm256_slli_epi32(items, 4);
+
+			const float* box = &localBoxes[0].Center.x;
+			const float* world = &worlds[0]._11;
+
+			__m256 c[3], e[3];
+			for (int k = 0; k < 3; ++k) {
+				c[k] = _mm256_i32gather_ps(box + k, boxOffsets, 4);
+				e[k] = _mm256_i32gather_ps(box + 3 + k, boxOffsets, 4);
+			}
+
+			alignas(32) float lanes[6][8];
+			for (int column = 0; column < 3; ++column) {
+				__m256 m0 = _mm256_i32gather_ps(world + column, worldOffsets, 4);
+				__m256 m1 = _mm256_i32gather_ps(world + 4 + column, worldOffsets, 4);
+				__m256 m2 = _mm256_i32gather_ps(world + 8 + column, worldOffsets, 4);
+				__m256 m3 = _mm256_i32gather_ps(world + 12 + column, worldOffsets, 4);
+
+				__m256 center = _mm256_fmadd_ps(c[0], m0, _mm256_fmadd_ps(c[1], m1, _mm256_fmadd_ps(c[2], m2, m3)));
+				__m256 extent = _mm256_fmadd_ps(e[0], _mm256_and_ps(m0, absMask),
+					_mm256_fmadd_ps(e[1], _mm256_and_ps(m1, absMask), _mm256_mul_ps(e[2], _mm256_and_ps(m2, absMask))));
+
+				_mm256_store_ps(lanes[column], center);
+				_mm256_store_ps(lanes[3 + column], extent);
+			}
+
+			for (int lane = 0; lane < 8; ++lane) {
+				outBoxes[lane].Center = XMFLOAT3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+				outBoxes[lane].Extents = XMFLOAT3(lanes[3][lane], lanes[4][lane], lanes[5][lane]);
+			}
+		}
+#endif
+
+		inline void TransformBox(const BoundingBox& localBox, const XMFLOAT4X4& world, BoundingBox& outBox) {
+			XMMATRIX W = XMLoadFloat4x4(&world);
+
+			XMVECTOR c = XMLoadFloat3(&localBox.Center);
+			XMVECTOR e = XMLoadFloat3(&localBox.Extents);
+
+			XMVECTOR center = XMVector3Transform(c, W);
+			XMVECTOR extents = XMVectorMultiply(XMVectorAbs(W.r[0]), XMVectorSplatX(e));
+			extents = XMVectorMultiplyAdd(XMVectorAbs(W.r[1]), XMVectorSplatY(e), extents);
+			extents = XMVectorMultiplyAdd(XMVectorAbs(W.r[2]), XMVectorSplatZ(e), extents);
+
+			XMStoreFloat3(&outBox.Center, center);
+			XMStoreFloat3(&outBox.Extents, extents);
+		}
+
+		// Index of the point farthest from center and its squared distance.
+		size_t FarthestPoint(const XMFLOAT3* pPoints, size_t count, size_t stride, const XMFLOAT3& center, float& outDistSq) {
+			size_t best = 0;
+			float bestDistSq = -1.0f;
+			size_t i = 0;
+
+#if defined(__AVX2__)
+			if (count >= 8) {
+				const __m256i offsets = GatherOffsets(stride);
+				const __m256 cx = _mm256_set1_ps(center.x);
+				const __m256 cy = _mm256_set1_ps(center.y);
+				const __m256 cz = _mm256_set1_ps(center.z);
+
+				__m256 maxDist = _mm256_set1_ps(-1.0f);
+				__m256i maxIndex = _mm256_setzero_si256();
+				__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+				const __m256i step = _mm256_set1_epi32(8);
+
+				for (; i + 8 <= count; i += 8) {
+					const float* base = &PointAt(pPoints, stride, i)->x;
+
+					__m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(base + 0, offsets, 4), cx);
+					__m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(base + 1, offsets, 4), cy);
+					__m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(base + 2, offsets, 4), cz);
+
+					__m256 distSq = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+					__m256 greater = _mm256_cmp_ps(distSq, maxDist, _CMP_GT_OQ);
+
+					maxDist = _mm256_blendv_ps(maxDist, distSq, greater);
+					maxIndex = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(maxIndex), _mm256_castsi256_ps(index), greater));
+					index = _mm256_add_epi32(index, step);
+				}
+
+				alignas(32) float lanesDist[8];
+				alignas(32) int lanesIndex[8];
+				_mm256_store_ps(lanesDist, maxDist);
+				_mm256_store_si256(reinterpret_cast<__m256i*>(lanesIndex), maxIndex);
+
+				for (int lane = 0; lane < 8; ++lane) {
+					if (lanesDist[lane] > bestDistSq) {
+						bestDistSq = lanesDist[lane];
+						best = (size_t)lanesIndex[lane];
+					}
+				}
+			}
+#endif
+
+			XMVECTOR c = XMLoadFloat3(&center);
+			for (; i < count; ++i) {
+				float distSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(PointAt(pPoints, stride, i)), c)));
+				if (distSq > bestDistSq) {
+					bestDistSq = distSq;
+					best = i;
+				}
+			}
+
+			outDistSq = bestDistSq;
+			return best;
+		}
+
+		// Ritter growth, driven by the farthest outside point instead of input order.
+		void GrowSphere(const XMFLOAT3* pPoints, size_t count, size_t stride, XMFLOAT3& center, float& radius) {
+			for (int iter = 0; iter < gGrowIterations; ++iter) {
+				float distSq = 0.0f;
+				size_t far = FarthestPoint(pPoints, count, stride, center, distSq);
+
+				if (distSq <= radius * radius) {
+					return;
+				}
+
+				float dist = sqrtf(distSq);
+				float newRadius = 0.5f * (radius + dist);
+
+				XMVECTOR c = XMLoadFloat3(&center);
+				XMVECTOR p = XMLoadFloat3(PointAt(pPoints, stride, far));
+				c = XMVectorAdd(c, XMVectorScale(XMVectorSubtract(p, c), (newRadius - radius) / dist));
+
+				XMStoreFloat3(&center, c);
+				radius = newRadius;
+			}
+
+			// Didn't settle: one classic sequential Ritter sweep is always enclosing.
+			XMVECTOR c = XMLoadFloat3(&center);
+			for (size_t i = 0; i < count; ++i) {
+				XMVECTOR p = XMLoadFloat3(PointAt(pPoints, stride, i));
+				float dist = XMVectorGetX(XMVector3Length(XMVectorSubtract(p, c)));
+
+				if (dist > radius) {
+					float newRadius = 0.5f * (radius + dist);
+					c = XMVectorAdd(c, XMVectorScale(XMVectorSubtract(p, c), (newRadius - radius) / dist));
+					radius = newRadius;
+				}
+			}
+			XMStoreFloat3(&center, c);
+		}
+	}
+
+	void BoundingVolume::ComputeMinMax(const XMFLOAT3* pPoints, size_t count, size_t stride, XMFLOAT3& outMin, XMFLOAT3& outMax) {
+		XMVECTOR vMin = XMVectorReplicate(+FLT_MAX);
+		XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		if (count >= 8) {
+			const __m256i offsets = GatherOffsets(stride);
+
+			__m256 minX = _mm256_set1_ps(+FLT_MAX), minY = minX, minZ = minX;
+			__m256 maxX = _mm256_set1_ps(-FLT_MAX), maxY = maxX, maxZ = maxX;
+
+			for (; i + 8 <= count; i += 8) {
+				const float* base = &PointAt(pPoints, stride, i)->x;
+
+				__m256 x = _mm256_i32gather_ps(base + 0, offsets, 4);
+				__m256 y = _mm256_i32gather_ps(base + 1, offsets, 4);
+				__m256 z = _mm256_i32gather_ps(base + 2, offsets, 4);
+
+				minX = _mm256_min_ps(minX, x); maxX = _mm256_max_ps(maxX, x);
+				minY = _mm256_min_ps(minY, y); maxY = _mm256_max_ps(maxY, y);
+				minZ = _mm256_min_ps(minZ, z); maxZ = _mm256_max_ps(maxZ, z);
+			}
+
+			alignas(32) float lanes[6][8];
+			_mm256_store_ps(lanes[0], minX); _mm256_store_ps(lanes[1], minY); _mm256_store_ps(lanes[2], minZ);
+			_mm256_store_ps(lanes[3], maxX); _mm256_store_ps(lanes[4], maxY); _mm256_store_ps(lanes[5], maxZ);
+
+			for (int lane = 0; lane < 8; ++lane) {
+				vMin = XMVectorMin(vMin, XMVectorSet(lanes[0][lane], lanes[1][lane], lanes[2][lane], 0.0f));
+				vMax = XMVectorMax(vMax, XMVectorSet(lanes[3][lane], lanes[4][lane], lanes[5][lane], 0.0f));
+			}
+		}
+#endif
+
+		for (; i < count; ++i) {
+			XMVECTOR p = XMLoadFloat3(PointAt(pPoints, stride, i));
+			vMin = XMVectorMin(vMin, p);
+			vMax = XMVectorMax(vMax, p);
+		}
+
+		XMStoreFloat3(&outMin, vMin);
+		XMStoreFloat3(&outMax, vMax);
+	}
+
+	BoundingBox BoundingVolume::CreateBox(const XMFLOAT3* pPoints, size_t count, size_t stride) {
+		BoundingBox bBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+		if (count == 0) {
+			return bBox;
+		}
+
+		XMFLOAT3 fMin, fMax;
+		ComputeMinMax(pPoints, count, stride, fMin, fMax);
+
+		XMVECTOR vMin = XMLoadFloat3(&fMin);
+		XMVECTOR vMax = XMLoadFloat3(&fMax);
+
+		XMStoreFloat3(&bBox.Center, XMVectorScale(XMVectorAdd(vMax, vMin), 0.5f));
+		XMStoreFloat3(&bBox.Extents, XMVectorScale(XMVectorSubtract(vMax, vMin), 0.5f));
+
+		return bBox;
+	}
+
+	BoundingBox BoundingVolume::CreateBox(const std::vector<Vertex>& vertices) {
+		return CreateBox(&vertices.data()->Pos, vertices.size(), sizeof(Vertex));
+	}
+
+	BoundingSphere BoundingVolume::CreateSphere(const XMFLOAT3* pPoints, size_t count, size_t stride) {
+		BoundingSphere bSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 0.0f);
+		if (count == 0) {
+			return bSphere;
+		}
+
+		// Ritter: x -> farthest y -> farthest z, start with the (y, z) diameter.
+		float distSq = 0.0f;
+		size_t a = FarthestPoint(pPoints, count, stride, *PointAt(pPoints, stride, 0), distSq);
+		size_t b = FarthestPoint(pPoints, count, stride, *PointAt(pPoints, stride, a), distSq);
+
+		XMVECTOR pa = XMLoadFloat3(PointAt(pPoints, stride, a));
+		XMVECTOR pb = XMLoadFloat3(PointAt(pPoints, stride, b));
+
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, XMVectorScale(XMVectorAdd(pa, pb), 0.5f));
+		float radius = 0.5f * sqrtf(distSq);
+
+		GrowSphere(pPoints, count, stride, center, radius);
+
+		// Refinement: shrink, regrow toward the points that fall out, keep the smallest enclosing one.
+		for (float shrink : gRefineShrink) {
+			XMFLOAT3 trialCenter = center;
+			float trialRadius = radius * shrink;
+
+			GrowSphere(pPoints, count, stride, trialCenter, trialRadius);
+
+			if (trialRadius < radius) {
+				center = trialCenter;
+				radius = trialRadius;
+			}
+		}
+
+		// Box centered sphere wins for axis aligned, box like meshes (e.g. grids).
+		BoundingBox bBox = CreateBox(pPoints, count, stride);
+		float boxDistSq = 0.0f;
+		FarthestPoint(pPoints, count, stride, bBox.Center, boxDistSq);
+
+		if (boxDistSq < radius * radius) {
+			center = bBox.Center;
+			radius = sqrtf(boxDistSq);
+		}
+
+		bSphere.Center = center;
+		bSphere.Radius = radius * (1.0f + 1e-5f);
+
+		return bSphere;
+	}
+
+	BoundingOrientedBox BoundingVolume::CreateOrientedBox(const XMFLOAT3* pPoints, size_t count, size_t stride) {
+		BoundingBox bBox = CreateBox(pPoints, count, stride);
+
+		BoundingOrientedBox obb;
+		obb.Center = bBox.Center;
+		obb.Extents = bBox.Extents;
+		obb.Orientation = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		if (count < 3) {
+			return obb;
+		}
+
+		BoundingOrientedBox pca;
+		BoundingOrientedBox::CreateFromPoints(pca, count, pPoints, stride);
+
+		float aabbVolume = bBox.Extents.x * bBox.Extents.y * bBox.Extents.z;
+		float pcaVolume = pca.Extents.x * pca.Extents.y * pca.Extents.z;
+
+		return (pcaVolume < aabbVolume) ? pca : obb;
+	}
+
+	void BoundingVolume::Compute(SubMeshGeometry& subMesh, const Vertex* vertices, size_t vertexCount, bool orientedBox) {
+		const XMFLOAT3* pPoints = &vertices->Pos;
+
+		subMesh.Bounds = CreateBox(pPoints, vertexCount, sizeof(Vertex));
+		subMesh.SphereBounds = CreateSphere(pPoints, vertexCount, sizeof(Vertex));
+
+		if (orientedBox) {
+			subMesh.OrientedBounds = CreateOrientedBox(pPoints, vertexCount, sizeof(Vertex));
+		}
+		else {
+			subMesh.OrientedBounds.Center = subMesh.Bounds.Center;
+			subMesh.OrientedBounds.Extents = subMesh.Bounds.Extents;
+			subMesh.OrientedBounds.Orientation = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+	}
+
+	void BoundingVolume::TransformBoxes(const BoundingBox* localBoxes, const XMFLOAT4X4* worlds, size_t count, BoundingBox* outBoxes) {
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		for (; i + 8 <= count; i += 8) {
+			__m256i items = _mm256_add_epi32(_mm256_set1_epi32((int)i), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+			TransformBoxes8(localBoxes, worlds, items, outBoxes + i);
+		}
+#endif
+
+		for (; i < count; ++i) {
+			TransformBox(localBoxes[i], worlds[i], outBoxes[i]);
+		}
+	}
+
+	void BoundingVolume::TransformBoxes(const BoundingBox* localBoxes, const XMFLOAT4X4* worlds,
+		const UINT* indices, size_t count, BoundingBox* outBoxes) {
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		for (; i + 8 <= count; i += 8) {
+			__m256i items = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + i));
+			TransformBoxes8(localBoxes, worlds, items, outBoxes + i);
+		}
+#endif
+
+		for (; i < count; ++i) {
+			TransformBox(localBoxes[indices[i]], worlds[indices[i]], outBoxes[i]);
+		}
+	}
+}
@@ -20,6 +20,18 @@ XMFLOAT3 Camera::GetPosition() const {
 	return m_Position;
 }
 
+float Camera::GetFovY() const {
+	return m_FovY;
+}
+
+float Camera::GetNearZ() const {
+	return m_NearZ;
+}
+
+float Camera::GetNearWindowHeight() const {
+	return m_NearWindowHeight;
+}
+
 void Camera::SetPosition(float x, float y, float z) {
 	m_Position = XMFLOAT3(x, y, z);
 
@@ -0,0 +1,518 @@
+#include "CompressedClip.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		// The three smallest components of a unit quaternion lie in [-1/sqrt(2), 1/sqrt(2)].
+		const float gQuatRange = 0.70710678f;
+		const float gQuatSteps = 32767.0f;
+		const float gVectorSteps = 65535.0f;
+
+		// The error is checked at every key time of the clip and, between them, at least this often.
+		const float gSampleRate = 60.0f;
+
+		// Largest component dropped and made positive, the other three at 15 bits each; the 2 bit index
+		// of the dropped one sits on top of the 48.
+		void PackQuaternion(FXMVECTOR q, UINT16* out) {
+			XMFLOAT4 v;
+			XMStoreFloat4(&v, XMQuaternionNormalize(q));
+			const float c[4] = { v.x, v.y, v.z, v.w };
+
+			UINT largest = 0;
+			for (UINT i = 1; i < 4; ++i) {
+				if (std::fabs(c[i]) > std::fabs(c[largest])) largest = i;
+			}
+			const float sign = (c[largest] < 0.0f) ? -1.0f : 1.0f;
+
+			UINT64 bits = (UINT64)largest << 45;
+			UINT shift = 30;
+			for (UINT i = 0; i < 4; ++i) {
+				if (i == largest) continue;
+
+				float unit = (c[i] * sign / gQuatRange) * 0.5f + 0.5f;
+				unit = (std::min)((std::max)(unit, 0.0f), 1.0f);
+				bits |= (UINT64)(unit * gQuatSteps + 0.5f) << shift;
+				shift -= 15;
+			}
+
+			out[0] = (UINT16)(bits & 0xffff);
+			out[1] = (UINT16)((bits >> 16) & 0xffff);
+			out[2] = (UINT16)((bits >> 32) & 0xffff);
+		}
+
+		XMVECTOR UnpackQuaternion(const UINT16* in) {
+			const UINT64 bits = (UINT64)in[0] | ((UINT64)in[1] << 16) | ((UINT64)in[2] << 32);
+			const UINT largest = (UINT)(bits >> 45) & 3;
+
+			float c[4];
+			float sumSq = 0.0f;
+			UINT shift = 30;
+			for (UINT i = 0; i < 4; ++i) {
+				if (i == largest) continue;
+
+				float unit = (float)((bits >> shift) & 0x7fff) / gQuatSteps;
+				c[i] = (unit * 2.0f - 1.0f) * gQuatRange;
+				sumSq += c[i] * c[i];
+				shift -= 15;
+			}
+			c[largest] = std::sqrt((std::max)(1.0f - sumSq, 0.0f));
+
+			return XMVectorSet(c[0], c[1], c[2], c[3]);
+		}
+
+		void PackVector(const XMFLOAT3& v, const XMFLOAT3& minimum, const XMFLOAT3& extent, UINT16* out) {
+			const float value[3] = { v.x, v.y, v.z };
+			const float lo[3] = { minimum.x, minimum.y, minimum.z };
+			const float size[3] = { extent.x, extent.y, extent.z };
+
+			for (UINT i = 0; i < 3; ++i) {
+				float unit = (size[i] > 0.0f) ? (value[i] - lo[i]) / size[i] : 0.0f;
+				unit = (std::min)((std::max)(unit, 0.0f), 1.0f);
+				out[i] = (UINT16)(unit * gVectorSteps + 0.5f);
+			}
+		}
+
+		XMVECTOR UnpackVector(const UINT16* in, const XMFLOAT3& minimum, const XMFLOAT3& extent) {
+			XMVECTOR unit = XMVectorSet((float)in[0], (float)in[1], (float)in[2], 0.0f);
+			unit = XMVectorScale(unit, 1.0f / gVectorSteps);
+			return XMVectorMultiplyAdd(unit, XMLoadFloat3(&extent), XMLoadFloat3(&minimum));
+		}
+
+		// Slerp for rotations, lerp for the rest; the sampler and the compressor have to agree exactly.
+		XMVECTOR BlendKeys(bool rotation, FXMVECTOR a, FXMVECTOR b, float t) {
+			return rotation ? XMQuaternionSlerp(a, b, t) : XMVectorLerp(a, b, t);
+		}
+
+		XMMATRIX Compose(FXMVECTOR rotation, FXMVECTOR translation, FXMVECTOR scale) {
+			XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+			return XMMatrixAffineTransformation(scale, zero, rotation, translation);
+		}
+
+		// Bound on how far any point within reach of the bone's origin lands from itself under the two
+		// to-root transforms: the origin's own offset plus reach times the (Frobenius) norm of the
+		// difference of the 3x3 parts. Covers the bone's position and everything it carries that far out.
+		float ShellError(CXMMATRIX reference, CXMMATRIX candidate, float reach) {
+			XMVECTOR axes = XMVectorZero();
+			for (UINT axis = 0; axis < 3; ++axis) {
+				XMVECTOR d = XMVectorSubtract(reference.r[axis], candidate.r[axis]);
+				axes = XMVectorAdd(axes, XMVector3Dot(d, d));
+			}
+
+			XMVECTOR origin = XMVector3Length(XMVectorSubtract(reference.r[3], candidate.r[3]));
+			return XMVectorGetX(origin) + reach * std::sqrt(XMVectorGetX(axes));
+		}
+
+		// One track of one bone while it is being reduced.
+		struct WorkTrack {
+			std::vector<UINT16> Times;
+			std::vector<UINT16> Packed;				// three per key
+			std::vector<XMFLOAT4> Keys;				// Packed, decoded again
+			std::vector<UINT8> Kept;
+			std::vector<XMFLOAT4> Samples;			// the track as it stands, at every sample time
+
+			XMFLOAT3 Min = { 0.0f, 0.0f, 0.0f };
+			XMFLOAT3 Extent = { 0.0f, 0.0f, 0.0f };
+
+			bool Constant = false;
+			XMFLOAT4 ConstantValue = { 0.0f, 0.0f, 0.0f, 0.0f };
+		};
+	}
+
+	CompressedClip::CompressedClip() {
+	}
+
+	CompressedClip::~CompressedClip() {
+	}
+
+	void CompressedClip::Clear() {
+		m_Times.clear();
+		m_Tracks.clear();
+		m_Constants.clear();
+		m_Ranges.clear();
+		m_RotationTimes.clear();
+		m_Rotations.clear();
+		m_VectorTimes.clear();
+		m_Vectors.clear();
+
+		m_StartTime = 0.0f;
+		m_EndTime = 0.0f;
+	}
+
+	void CompressedClip::Compress(const Skeleton& skeleton, const AnimationClip& clip, float tolerance,
+		float shellDistance) {
+		Clear();
+
+		const UINT boneCount = skeleton.GetBoneCount();
+		if ((UINT)clip.boneAnimations.size() != boneCount) {
+			throw std::runtime_error("@@@ Error: CompressedClip bone count");
+		}
+		if (boneCount == 0) return;
+
+		m_StartTime = clip.GetClipStartTime();
+		m_EndTime = clip.GetClipEndTime();
+
+		for (const BoneAnimation& bone : clip.boneAnimations) {
+			m_Times.insert(m_Times.end(), bone.timePos.begin(), bone.timePos.end());
+		}
+		std::sort(m_Times.begin(), m_Times.end());
+		m_Times.erase(std::unique(m_Times.begin(), m_Times.end()), m_Times.end());
+
+		if (m_Times.size() > 0x10000) {
+			throw std::runtime_error("@@@ Error: CompressedClip has too many distinct key times");
+		}
+
+		std::vector<float> sampleTimes;
+		for (size_t i = 0; i < m_Times.size(); ++i) {
+			sampleTimes.push_back(m_Times[i]);
+			if (i + 1 == m_Times.size()) break;
+
+			const float gap = m_Times[i + 1] - m_Times[i];
+			const int steps = (int)std::ceil(gap * gSampleRate);
+			for (int s = 1; s < steps; ++s) {
+				sampleTimes.push_back(m_Times[i] + gap * (float)s / (float)steps);
+			}
+		}
+		const size_t sampleCount = sampleTimes.size();
+
+		// Where the uncompressed clip puts every bone, and where the bones reduced so far end up.
+		std::vector<XMFLOAT4X4> local(boneCount);
+		std::vector<AnimationCursor> cursors(boneCount);
+		std::vector<XMFLOAT4X4> reference(sampleCount * boneCount);
+		std::vector<XMFLOAT4X4> reduced(sampleCount * boneCount);
+
+		for (size_t s = 0; s < sampleCount; ++s) {
+			clip.Interpolate(sampleTimes[s], local.data(), cursors.data());
+			skeleton.ToModel(local.data(), &reference[s * boneCount]);
+		}
+
+		// A bone's error matters as far out as its farthest descendant in the bind pose. Children come
+		// after their parents, so one backward pass hands every reach up the chain.
+		std::vector<XMFLOAT3> origins(boneCount);
+		std::vector<float> reach(boneCount, shellDistance);
+		for (UINT i = 0; i < boneCount; ++i) {
+			XMMATRIX bind = XMMatrixInverse(nullptr, XMLoadFloat4x4(&skeleton.GetBoneOffset(i)));
+			XMStoreFloat3(&origins[i], bind.r[3]);
+		}
+		for (UINT i = boneCount; i-- > 0;) {
+			const UINT parent = skeleton.GetParent(i);
+			if (parent == Skeleton::NullBone) continue;
+
+			float distance = XMVectorGetX(XMVector3Length(
+				XMVectorSubtract(XMLoadFloat3(&origins[i]), XMLoadFloat3(&origins[parent]))));
+			reach[parent] = (std::max)(reach[parent], distance + reach[i]);
+		}
+
+		WorkTrack tracks[TracksPerBone];
+
+		for (UINT bone = 0; bone < boneCount; ++bone) {
+			const std::vector<Keyframe>& keyFrames = clip.boneAnimations[bone].keyFrames;
+			const std::vector<float>& timePos = clip.boneAnimations[bone].timePos;
+			const size_t keyCount = keyFrames.size();
+			const UINT parent = skeleton.GetParent(bone);
+
+			if (keyCount > 0xffff) {
+				throw std::runtime_error("@@@ Error: CompressedClip track has too many keys");
+			}
+
+			for (UINT kind = 0; kind < TracksPerBone; ++kind) {
+				WorkTrack& track = tracks[kind];
+				track.Times.resize(keyCount);
+				track.Packed.resize(keyCount * 3);
+				track.Keys.resize(keyCount);
+				track.Kept.assign(keyCount, 1);
+				track.Samples.resize(sampleCount);
+				track.Constant = false;
+
+				for (size_t k = 0; k < keyCount; ++k) {
+					track.Times[k] = (UINT16)(std::lower_bound(m_Times.begin(), m_Times.end(), timePos[k]) - m_Times.begin());
+				}
+
+				if (kind == TrackRotation) {
+					for (size_t k = 0; k < keyCount; ++k) {
+						PackQuaternion(XMLoadFloat4(&keyFrames[k].RotationQuat), &track.Packed[k * 3]);
+						XMStoreFloat4(&track.Keys[k], UnpackQuaternion(&track.Packed[k * 3]));
+					}
+					continue;
+				}
+
+				XMVECTOR lo = XMVectorReplicate(FLT_MAX);
+				XMVECTOR hi = XMVectorReplicate(-FLT_MAX);
+				for (size_t k = 0; k < keyCount; ++k) {
+					XMVECTOR v = XMLoadFloat3((kind == TrackTranslation) ? &keyFrames[k].Translation : &keyFrames[k].Scale);
+					lo = XMVectorMin(lo, v);
+					hi = XMVectorMax(hi, v);
+				}
+				XMStoreFloat3(&track.Min, lo);
+				XMStoreFloat3(&track.Extent, XMVectorSubtract(hi, lo));
+
+				for (size_t k = 0; k < keyCount; ++k) {
+					const XMFLOAT3& v = (kind == TrackTranslation) ? keyFrames[k].Translation : keyFrames[k].Scale;
+					PackVector(v, track.Min, track.Extent, &track.Packed[k * 3]);
+					XMStoreFloat4(&track.Keys[k], UnpackVector(&track.Packed[k * 3], track.Min, track.Extent));
+				}
+			}
+
+			// Every track as the sampler would play it back with all of its keys.
+			for (UINT kind = 0; kind < TracksPerBone; ++kind) {
+				WorkTrack& track = tracks[kind];
+				AnimationCursor cursor;
+
+				for (size_t s = 0; s < sampleCount; ++s) {
+					const float t = sampleTimes[s];
+					XMVECTOR value;
+
+					if (t <= timePos.front()) {
+						value = XMLoadFloat4(&track.Keys.front());
+					}
+					else if (t >= timePos.back()) {
+						value = XMLoadFloat4(&track.Keys.back());
+					}
+					else {
+						while (timePos[cursor.Key + 1] <= t) ++cursor.Key;
+						const size_t k = cursor.Key;
+						const float u = (t - timePos[k]) / (timePos[k + 1] - timePos[k]);
+						value = BlendKeys(kind == TrackRotation, XMLoadFloat4(&track.Keys[k]), XMLoadFloat4(&track.Keys[k + 1]), u);
+					}
+
+					XMStoreFloat4(&track.Samples[s], value);
+				}
+			}
+
+			// Whether the bone, with one track replaced by candidate over samples [first, last), still
+			// lands within tolerance everywhere.
+			auto withinTolerance = [&](UINT kind, const XMFLOAT4* candidate, size_t first, size_t last) {
+				for (size_t s = first; s < last; ++s) {
+					XMVECTOR value[TracksPerBone];
+					for (UINT other = 0; other < TracksPerBone; ++other) {
+						value[other] = XMLoadFloat4((other == kind) ? &candidate[s - first] : &tracks[other].Samples[s]);
+					}
+
+					XMMATRIX model = Compose(value[TrackRotation], value[TrackTranslation], value[TrackScale]);
+					if (parent != Skeleton::NullBone) {
+						model = XMMatrixMultiply(model, XMLoadFloat4x4(&reduced[s * boneCount + parent]));
+					}
+
+					if (ShellError(XMLoadFloat4x4(&reference[s * boneCount + bone]), model, reach[bone]) > tolerance) {
+						return false;
+					}
+				}
+
+				return true;
+			};
+
+			std::vector<XMFLOAT4> candidate;
+
+			for (UINT kind = 0; kind < TracksPerBone; ++kind) {
+				WorkTrack& track = tracks[kind];
+				const bool rotation = (kind == TrackRotation);
+
+				// A track that holds still closely enough keeps only its first key.
+				XMFLOAT4 first;
+				if (rotation) {
+					first = keyFrames.front().RotationQuat;
+				}
+				else {
+					const XMFLOAT3& v = (kind == TrackTranslation) ? keyFrames.front().Translation : keyFrames.front().Scale;
+					first = XMFLOAT4(v.x, v.y, v.z, 0.0f);
+				}
+
+				candidate.assign(sampleCount, first);
+				if (keyCount == 1 || withinTolerance(kind, candidate.data(), 0, sampleCount)) {
+					track.Constant = true;
+					track.ConstantValue = first;
+					track.Samples = candidate;
+					continue;
+				}
+
+				// Greedy, front to back: every key between the last one kept and the next is tried.
+				size_t previous = 0;
+				for (size_t k = 1; k + 1 < keyCount; ++k) {
+					const float t0 = timePos[previous];
+					const float t1 = timePos[k + 1];
+					const size_t firstSample = std::upper_bound(sampleTimes.begin(), sampleTimes.end(), t0) - sampleTimes.begin();
+					const size_t lastSample = std::lower_bound(sampleTimes.begin(), sampleTimes.end(), t1) - sampleTimes.begin();
+
+					XMVECTOR a = XMLoadFloat4(&track.Keys[previous]);
+					XMVECTOR b = XMLoadFloat4(&track.Keys[k + 1]);
+
+					candidate.resize(lastSample - firstSample);
+					for (size_t s = firstSample; s < lastSample; ++s) {
+						const float u = (sampleTimes[s] - t0) / (t1 - t0);
+						XMStoreFloat4(&candidate[s - firstSample], BlendKeys(rotation, a, b, u));
+					}
+
+					if (withinTolerance(kind, candidate.data(), firstSample, lastSample)) {
+						track.Kept[k] = 0;
+						std::copy(candidate.begin(), candidate.end(), track.Samples.begin() + firstSample);
+					}
+					else {
+						previous = k;
+					}
+				}
+			}
+
+			for (size_t s = 0; s < sampleCount; ++s) {
+				XMMATRIX model = Compose(XMLoadFloat4(&tracks[TrackRotation].Samples[s]),
+					XMLoadFloat4(&tracks[TrackTranslation].Samples[s]), XMLoadFloat4(&tracks[TrackScale].Samples[s]));
+				if (parent != Skeleton::NullBone) {
+					model = XMMatrixMultiply(model, XMLoadFloat4x4(&reduced[s * boneCount + parent]));
+				}
+				XMStoreFloat4x4(&reduced[s * boneCount + bone], model);
+			}
+
+			for (UINT kind = 0; kind < TracksPerBone; ++kind) {
+				const WorkTrack& work = tracks[kind];
+				Track track;
+
+				if (work.Constant) {
+					track.First = (UINT)m_Constants.size();
+					track.KeyCount = 1;
+					m_Constants.push_back(work.ConstantValue);
+					m_Tracks.push_back(track);
+					continue;
+				}
+
+				std::vector<UINT16>& times = (kind == TrackRotation) ? m_RotationTimes : m_VectorTimes;
+				std::vector<UINT16>& values = (kind == TrackRotation) ? m_Rotations : m_Vectors;
+
+				track.First = (UINT)times.size();
+				for (size_t k = 0; k < keyCount; ++k) {
+					if (!work.Kept[k]) continue;
+
+					times.push_back(work.Times[k]);
+					values.insert(values.end(), work.Packed.begin() + k * 3, work.Packed.begin() + k * 3 + 3);
+					++track.KeyCount;
+				}
+
+				if (kind != TrackRotation) {
+					if (m_Ranges.size() > 0xffff) {
+						throw std::runtime_error("@@@ Error: CompressedClip has too many vector tracks");
+					}
+
+					track.Range = (UINT16)m_Ranges.size();
+					m_Ranges.push_back({ work.Min, work.Extent });
+				}
+
+				m_Tracks.push_back(track);
+			}
+		}
+	}
+
+	float CompressedClip::GetClipStartTime() const {
+		return m_StartTime;
+	}
+
+	float CompressedClip::GetClipEndTime() const {
+		return m_EndTime;
+	}
+
+	float CompressedClip::WrapTime(float dt) const {
+		float duration = m_EndTime - m_StartTime;
+
+		if (duration <= 0.0f) {
+			return m_StartTime;
+		}
+
+		float t = std::fmod(dt - m_StartTime, duration);
+		if (t < 0.0f) {
+			t += duration;
+		}
+
+		return m_StartTime + t;
+	}
+
+	UINT CompressedClip::GetBoneCount() const {
+		return (UINT)m_Tracks.size() / TracksPerBone;
+	}
+
+	void CompressedClip::Interpolate(float dt, XMFLOAT4X4* boneTransforms, AnimationCursor* cursors) const {
+		const UINT boneCount = GetBoneCount();
+
+		for (UINT bone = 0; bone < boneCount; ++bone) {
+			const Track* tracks = &m_Tracks[bone * TracksPerBone];
+			AnimationCursor* boneCursors = &cursors[bone * TracksPerBone];
+
+			XMVECTOR rotation = SampleTrack(tracks[TrackRotation], TrackRotation, dt, boneCursors[TrackRotation]);
+			XMVECTOR translation = SampleTrack(tracks[TrackTranslation], TrackTranslation, dt, boneCursors[TrackTranslation]);
+			XMVECTOR scale = SampleTrack(tracks[TrackScale], TrackScale, dt, boneCursors[TrackScale]);
+
+			XMStoreFloat4x4(&boneTransforms[bone], Compose(rotation, translation, scale));
+		}
+	}
+
+	XMVECTOR CompressedClip::SampleTrack(const Track& track, UINT kind, float dt, AnimationCursor& cursor) const {
+		if (track.KeyCount == 1) {
+			return XMLoadFloat4(&m_Constants[track.First]);
+		}
+
+		const bool rotation = (kind == TrackRotation);
+		const UINT16* times = rotation ? &m_RotationTimes[track.First] : &m_VectorTimes[track.First];
+		const UINT16* values = rotation ? &m_Rotations[track.First * 3] : &m_Vectors[track.First * 3];
+		const size_t count = track.KeyCount;
+
+		auto decode = [&](size_t key) {
+			if (rotation) {
+				return UnpackQuaternion(&values[key * 3]);
+			}
+
+			const VectorRange& range = m_Ranges[track.Range];
+			return UnpackVector(&values[key * 3], range.Min, range.Extent);
+		};
+
+		if (dt <= m_Times[times[0]]) {
+			cursor.Key = 0;
+			return decode(0);
+		}
+		if (dt >= m_Times[times[count - 1]]) {
+			cursor.Key = count - 2;
+			return decode(count - 1);
+		}
+
+		const size_t key = FindKey(times, count, dt, cursor);
+		const float t0 = m_Times[times[key]];
+		const float t1 = m_Times[times[key + 1]];
+
+		return BlendKeys(rotation, decode(key), decode(key + 1), (dt - t0) / (t1 - t0));
+	}
+
+	// As BoneAnimation::FindKey, over a track's time indices.
+	size_t CompressedClip::FindKey(const UINT16* times, size_t count, float dt, AnimationCursor& cursor) const {
+		const size_t last = count - 2;
+		const size_t key = (cursor.Key < last) ? cursor.Key : last;
+
+		if (dt >= m_Times[times[key]]) {
+			if (dt < m_Times[times[key + 1]]) {
+				cursor.Key = key;
+				return key;
+			}
+
+			if (key < last && dt < m_Times[times[key + 2]]) {
+				cursor.Key = key + 1;
+				return key + 1;
+			}
+		}
+		else if (key > 0 && dt >= m_Times[times[key - 1]]) {
+			cursor.Key = key - 1;
+			return key - 1;
+		}
+
+		const UINT16* upper = std::upper_bound(times, times + count, dt,
+			[this](float value, UINT16 index) { return value < m_Times[index]; });
+		cursor.Key = (upper - times) - 1;
+		return cursor.Key;
+	}
+
+	size_t CompressedClip::GetByteSize() const {
+		return m_Times.size() * sizeof(float) +
+			m_Tracks.size() * sizeof(Track) +
+			m_Constants.size() * sizeof(XMFLOAT4) +
+			m_Ranges.size() * sizeof(VectorRange) +
+			(m_RotationTimes.size() + m_Rotations.size() + m_VectorTimes.size() + m_Vectors.size()) * sizeof(UINT16);
+	}
+}
@@ -0,0 +1,574 @@
+#include "CrowdAnimator.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		// Rotation xyzw, translation xyz, scale xyz.
+		const UINT gComponents = 10;
+
+		// Affine matrices are kept as their first three columns, row after row.
+		const UINT gAffine = 12;
+
+		// ParallelFor counts in chunks of LaneCount instances.
+		const size_t gChunksPerJob = 4;
+
+#if defined(__AVX2__)
+		typedef __m256 Lanes;
+
+		inline Lanes Splat(float v) { return _mm256_set1_ps(v); }
+		inline Lanes Load(const float* p) { return _mm256_loadu_ps(p); }
+		inline void Store(float* p, Lanes v) { _mm256_storeu_ps(p, v); }
+		inline Lanes Add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+		inline Lanes Sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+		inline Lanes Mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+		inline Lanes MulAdd(Lanes a, Lanes b, Lanes c) { return _mm256_fmadd_ps(a, b, c); }
+		inline Lanes Abs(Lanes a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+		inline Lanes InvSqrt(Lanes a) { return _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(a)); }
+
+		// a, negated in the lanes where s is negative.
+		inline Lanes FlipSign(Lanes a, Lanes s) { return _mm256_xor_ps(a, _mm256_and_ps(s, _mm256_set1_ps(-0.0f))); }
+
+		inline Lanes Gather(const float* base, const int* indices) {
+			return _mm256_i32gather_ps(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)), 4);
+		}
+#else
+		struct Lanes {
+			float v[CrowdAnimator::LaneCount];
+		};
+
+#define CROWD_LANES(expr) Lanes r; for (UINT l = 0; l < CrowdAnimator::LaneCount; ++l) { r.v[l] = (expr); } return r
+
+		inline Lanes Splat(float v) { CROWD_LANES(v); }
+		inline Lanes Load(const float* p) { CROWD_LANES(p[l]); }
+		inline void Store(float* p, Lanes a) { for (UINT l = 0; l < CrowdAnimator::LaneCount; ++l) p[l] = a.v[l]; }
+		inline Lanes Add(Lanes a, Lanes b) { CROWD_LANES(a.v[l] + b.v[l]); }
+		inline Lanes Sub(Lanes a, Lanes b) { CROWD_LANES(a.v[l] - b.v[l]); }
+		inline Lanes Mul(Lanes a, Lanes b) { CROWD_LANES(a.v[l] * b.v[l]); }
+		inline Lanes MulAdd(Lanes a, Lanes b, Lanes c) { CROWD_LANES(a.v[l] * b.v[l] + c.v[l]); }
+		inline Lanes Abs(Lanes a) { CROWD_LANES(std::fabs(a.v[l])); }
+		inline Lanes InvSqrt(Lanes a) { CROWD_LANES(1.0f / std::sqrt(a.v[l])); }
+		inline Lanes FlipSign(Lanes a, Lanes s) { CROWD_LANES(std::signbit(s.v[l]) ? -a.v[l] : a.v[l]); }
+		inline Lanes Gather(const float* base, const int* indices) { CROWD_LANES(base[indices[l]]); }
+
+#undef CROWD_LANES
+#endif
+
+		struct QuatLanes {
+			Lanes X, Y, Z, W;
+		};
+
+		struct Float3Lanes {
+			Lanes X, Y, Z;
+		};
+
+		inline Lanes Lerp(Lanes a, Lanes b, Lanes t) {
+			return MulAdd(Sub(b, a), t, a);
+		}
+
+		inline Float3Lanes Lerp(const Float3Lanes& a, const Float3Lanes& b, Lanes t) {
+			return { Lerp(a.X, b.X, t), Lerp(a.Y, b.Y, t), Lerp(a.Z, b.Z, t) };
+		}
+
+		// Normalized lerp along the shorter arc. With slerp set, t is first bent by Kapoulkine's fit so the
+		// result follows slerp's constant angular speed; cheaper than slerp and close enough for keys a
+		// frame apart.
+		QuatLanes Nlerp(const QuatLanes& a, QuatLanes b, Lanes t, bool slerp) {
+			Lanes dot = MulAdd(a.X, b.X, MulAdd(a.Y, b.Y, MulAdd(a.Z, b.Z, Mul(a.W, b.W))));
+			b = { FlipSign(b.X, dot), FlipSign(b.Y, dot), FlipSign(b.Z, dot), FlipSign(b.W, dot) };
+
+			if (slerp) {
+				Lanes d = Abs(dot);
+				Lanes A = MulAdd(d, MulAdd(d, MulAdd(d, Splat(-1.43519f), Splat(3.55645f)), Splat(-3.2452f)), Splat(1.0904f));
+				Lanes B = MulAdd(d, MulAdd(d, Splat(0.215638f), Splat(-1.06021f)), Splat(0.848013f));
+				Lanes h = Sub(t, Splat(0.5f));
+				Lanes k = MulAdd(Mul(A, h), h, B);
+				t = MulAdd(Mul(Mul(t, h), Sub(t, Splat(1.0f))), k, t);
+			}
+
+			QuatLanes q = { Lerp(a.X, b.X, t), Lerp(a.Y, b.Y, t), Lerp(a.Z, b.Z, t), Lerp(a.W, b.W, t) };
+			Lanes invLength = InvSqrt(MulAdd(q.X, q.X, MulAdd(q.Y, q.Y, MulAdd(q.Z, q.Z, Mul(q.W, q.W)))));
+			return { Mul(q.X, invLength), Mul(q.Y, invLength), Mul(q.Z, invLength), Mul(q.W, invLength) };
+		}
+
+		// Scale, then rotation, then translation, as XMMatrixAffineTransformation builds it.
+		void Compose(const QuatLanes& q, const Float3Lanes& t, const Float3Lanes& s, Lanes* m) {
+			Lanes x2 = Add(q.X, q.X), y2 = Add(q.Y, q.Y), z2 = Add(q.Z, q.Z);
+			Lanes xx = Mul(q.X, x2), yy = Mul(q.Y, y2), zz = Mul(q.Z, z2);
+			Lanes xy = Mul(q.X, y2), xz = Mul(q.X, z2), yz = Mul(q.Y, z2);
+			Lanes wx = Mul(q.W, x2), wy = Mul(q.W, y2), wz = Mul(q.W, z2);
+			Lanes one = Splat(1.0f);
+
+			m[0] = Mul(s.X, Sub(one, Add(yy, zz)));
+			m[1] = Mul(s.X, Add(xy, wz));
+			m[2] = Mul(s.X, Sub(xz, wy));
+			m[3] = Mul(s.Y, Sub(xy, wz));
+			m[4] = Mul(s.Y, Sub(one, Add(xx, zz)));
+			m[5] = Mul(s.Y, Add(yz, wx));
+			m[6] = Mul(s.Z, Add(xz, wy));
+			m[7] = Mul(s.Z, Sub(yz, wx));
+			m[8] = Mul(s.Z, Sub(one, Add(xx, yy)));
+			m[9] = t.X;
+			m[10] = t.Y;
+			m[11] = t.Z;
+		}
+
+		// c = a * b for affine row vector matrices.
+		void MultiplyAffine(const Lanes* a, const Lanes* b, Lanes* c) {
+			for (UINT row = 0; row < 4; ++row) {
+				for (UINT col = 0; col < 3; ++col) {
+					Lanes sum = (row == 3) ? b[9 + col] : Splat(0.0f);
+					sum = MulAdd(a[row * 3 + 0], b[col], sum);
+					sum = MulAdd(a[row * 3 + 1], b[3 + col], sum);
+					sum = MulAdd(a[row * 3 + 2], b[6 + col], sum);
+					c[row * 3 + col] = sum;
+				}
+			}
+		}
+
+		// Writes the first count lanes of an affine SoA matrix as XMFLOAT4X4s, out[l][bone] for lane l.
+		void StorePalettes(const Lanes* m, XMFLOAT4X4* const* out, UINT bone, UINT count) {
+#if defined(__AVX2__)
+			// Each group of three columns plus the constant fourth is transposed as four 4x4 blocks in the
+			// two halves; block row l % 4 of half l / 4 is lane l's matrix row.
+			const Lanes zero = _mm256_setzero_ps();
+			const Lanes one = _mm256_set1_ps(1.0f);
+
+			for (UINT row = 0; row < 4; ++row) {
+				Lanes a = m[row * 3 + 0];
+				Lanes b = m[row * 3 + 1];
+				Lanes c = m[row * 3 + 2];
+				Lanes d = (row == 3) ? one : zero;
+
+				Lanes ab0 = _mm256_unpacklo_ps(a, b);
+				Lanes ab1 = _mm256_unpackhi_ps(a, b);
+				Lanes cd0 = _mm256_unpacklo_ps(c, d);
+				Lanes cd1 = _mm256_unpackhi_ps(c, d);
+
+				Lanes rows[4] = {
+					_mm256_shuffle_ps(ab0, cd0, _MM_SHUFFLE(1, 0, 1, 0)),
+					_mm256_shuffle_ps(ab0, cd0, _MM_SHUFFLE(3, 2, 3, 2)),
+					_mm256_shuffle_ps(ab1, cd1, _MM_SHUFFLE(1, 0, 1, 0)),
+					_mm256_shuffle_ps(ab1, cd1, _MM_SHUFFLE(3, 2, 3, 2)),
+				};
+
+				for (UINT l = 0; l < count; ++l) {
+					__m128 half = (l < 4) ? _mm256_castps256_ps128(rows[l]) : _mm256_extractf128_ps(rows[l - 4], 1);
+					_mm_storeu_ps(out[l][bone].m[row], half);
+				}
+			}
+#else
+			for (UINT l = 0; l < count; ++l) {
+				out[l][bone] = XMFLOAT4X4(
+					m[0].v[l], m[1].v[l], m[2].v[l], 0.0f,
+					m[3].v[l], m[4].v[l], m[5].v[l], 0.0f,
+					m[6].v[l], m[7].v[l], m[8].v[l], 0.0f,
+					m[9].v[l], m[10].v[l], m[11].v[l], 1.0f);
+			}
+#endif
+		}
+
+		// One clip's key pair and blend factor per lane.
+		struct LaneKeys {
+			int Key0[CrowdAnimator::LaneCount];
+			int Key1[CrowdAnimator::LaneCount];
+			float Fraction[CrowdAnimator::LaneCount];
+		};
+
+		void SampleBone(const float* keys, const LaneKeys& lanes, QuatLanes& q, Float3Lanes& t, Float3Lanes& s) {
+			Lanes fraction = Load(lanes.Fraction);
+
+			QuatLanes q0 = { Gather(keys, lanes.Key0), Gather(keys + 1, lanes.Key0), Gather(keys + 2, lanes.Key0), Gather(keys + 3, lanes.Key0) };
+			QuatLanes q1 = { Gather(keys, lanes.Key1), Gather(keys + 1, lanes.Key1), Gather(keys + 2, lanes.Key1), Gather(keys + 3, lanes.Key1) };
+			q = Nlerp(q0, q1, fraction, true);
+
+			Float3Lanes t0 = { Gather(keys + 4, lanes.Key0), Gather(keys + 5, lanes.Key0), Gather(keys + 6, lanes.Key0) };
+			Float3Lanes t1 = { Gather(keys + 4, lanes.Key1), Gather(keys + 5, lanes.Key1), Gather(keys + 6, lanes.Key1) };
+			t = Lerp(t0, t1, fraction);
+
+			Float3Lanes s0 = { Gather(keys + 7, lanes.Key0), Gather(keys + 8, lanes.Key0), Gather(keys + 9, lanes.Key0) };
+			Float3Lanes s1 = { Gather(keys + 7, lanes.Key1), Gather(keys + 8, lanes.Key1), Gather(keys + 9, lanes.Key1) };
+			s = Lerp(s0, s1, fraction);
+		}
+	}
+
+	CrowdAnimator::CrowdAnimator() {
+	}
+
+	CrowdAnimator::~CrowdAnimator() {
+	}
+
+	void CrowdAnimator::Initialize(const Skeleton* skeleton) {
+		m_Skeleton = skeleton;
+		m_BoneCount = skeleton->GetBoneCount();
+
+		m_BoneOffsets.resize(m_BoneCount * gAffine);
+		m_BindLocals.resize(m_BoneCount * gAffine);
+		for (UINT bone = 0; bone < m_BoneCount; ++bone) {
+			const XMFLOAT4X4& offset = skeleton->GetBoneOffset(bone);
+			const UINT parent = skeleton->GetParent(bone);
+
+			// The offset takes bind pose model space into the bone, so the bind pose relative to the
+			// parent is the bone's inverse offset times its parent's offset.
+			XMMATRIX bindLocal = XMMatrixInverse(nullptr, XMLoadFloat4x4(&offset));
+			if (parent != Skeleton::NullBone) {
+				bindLocal = XMMatrixMultiply(bindLocal, XMLoadFloat4x4(&skeleton->GetBoneOffset(parent)));
+			}
+			XMFLOAT4X4 local;
+			XMStoreFloat4x4(&local, bindLocal);
+
+			for (UINT row = 0; row < 4; ++row) {
+				for (UINT col = 0; col < 3; ++col) {
+					m_BoneOffsets[bone * gAffine + row * 3 + col] = offset.m[row][col];
+					m_BindLocals[bone * gAffine + row * 3 + col] = local.m[row][col];
+				}
+			}
+		}
+
+		m_BoneLods.assign(MaxBoneLods * m_BoneCount, 1);
+
+		m_Clips.clear();
+		m_Keys.clear();
+
+		m_ClipA.clear();
+		m_TimeA.clear();
+		m_ClipB.clear();
+		m_TimeB.clear();
+		m_Weight.clear();
+		m_Rate.clear();
+		m_Active.clear();
+		m_Pending.clear();
+		m_Interval.clear();
+		m_BoneLod.clear();
+		m_Visible.clear();
+		m_Stale.clear();
+
+		m_Frame = 0;
+		m_DueInstances.clear();
+		m_Chunks.clear();
+		m_Palettes.clear();
+	}
+
+	UINT CrowdAnimator::AddClip(const AnimationClip& clip, float sampleRate) {
+		if ((UINT)clip.boneAnimations.size() != m_BoneCount) {
+			throw std::runtime_error("@@@ Error: CrowdAnimator clip bone count");
+		}
+
+		Clip entry;
+		entry.StartTime = clip.GetClipStartTime();
+		entry.Duration = clip.GetClipEndTime() - entry.StartTime;
+		entry.FrameCount = (std::max)((UINT)std::ceil(entry.Duration * sampleRate) + 1, 2u);
+		entry.FrameRate = (entry.Duration > 0.0f) ? (float)(entry.FrameCount - 1) / entry.Duration : 0.0f;
+		entry.Offset = (UINT)m_Keys.size();
+
+		// Key indices are gathered as 32 bit signed integers.
+		const size_t frameSize = (size_t)m_BoneCount * gComponents;
+		if (m_Keys.size() + entry.FrameCount * frameSize > (size_t)INT_MAX) {
+			throw std::runtime_error("@@@ Error: CrowdAnimator key storage");
+		}
+
+		m_Keys.resize(m_Keys.size() + entry.FrameCount * frameSize);
+
+		for (UINT frame = 0; frame < entry.FrameCount; ++frame) {
+			const float t = entry.StartTime + entry.Duration * (float)frame / (float)(entry.FrameCount - 1);
+			float* keys = &m_Keys[entry.Offset + frame * frameSize];
+
+			for (UINT bone = 0; bone < m_BoneCount; ++bone) {
+				XMFLOAT3 S, T;
+				XMFLOAT4 Q;
+				clip.boneAnimations[bone].Interpolate(t, S, Q, T);
+
+				float* key = &keys[bone * gComponents];
+				key[0] = Q.x; key[1] = Q.y; key[2] = Q.z; key[3] = Q.w;
+				key[4] = T.x; key[5] = T.y; key[6] = T.z;
+				key[7] = S.x; key[8] = S.y; key[9] = S.z;
+			}
+		}
+
+		m_Clips.push_back(entry);
+		return (UINT)m_Clips.size() - 1;
+	}
+
+	UINT CrowdAnimator::AddInstance(UINT clip, float time, float rate) {
+		m_ClipA.push_back(clip);
+		m_TimeA.push_back(WrapTime(clip, time));
+		m_ClipB.push_back((UINT)NullClip);
+		m_TimeB.push_back(0.0f);
+		m_Weight.push_back(0.0f);
+		m_Rate.push_back(rate);
+		m_Active.push_back(1);
+		m_Pending.push_back(0.0f);
+		m_Interval.push_back(1);
+		m_BoneLod.push_back(0);
+		m_Visible.push_back(1);
+		m_Stale.push_back(1);
+
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		m_Palettes.resize(m_Palettes.size() + m_BoneCount, identity);
+
+		return (UINT)m_ClipA.size() - 1;
+	}
+
+	void CrowdAnimator::SetClip(UINT instance, UINT clip, float time) {
+		m_ClipA[instance] = clip;
+		m_TimeA[instance] = WrapTime(clip, time);
+
+		// Rebuilt on the next Update, whatever the instance's update interval.
+		m_Stale[instance] = 1;
+	}
+
+	void CrowdAnimator::SetRate(UINT instance, float rate) {
+		m_Rate[instance] = rate;
+	}
+
+	void CrowdAnimator::SetBlend(UINT instance, UINT clip, float time, float weight) {
+		m_Stale[instance] = 1;
+
+		if (clip == NullClip || weight <= 0.0f) {
+			m_ClipB[instance] = NullClip;
+			m_Weight[instance] = 0.0f;
+			return;
+		}
+
+		m_ClipB[instance] = clip;
+		m_TimeB[instance] = WrapTime(clip, time);
+		m_Weight[instance] = (std::min)(weight, 1.0f);
+	}
+
+	void CrowdAnimator::SetActive(UINT instance, bool active) {
+		m_Active[instance] = active ? 1 : 0;
+	}
+
+	void CrowdAnimator::SetBoneLod(UINT lod, const std::vector<UINT8>& animated) {
+		if (lod == 0 || lod >= MaxBoneLods || (UINT)animated.size() != m_BoneCount) {
+			throw std::runtime_error("@@@ Error: CrowdAnimator bone level");
+		}
+
+		std::copy(animated.begin(), animated.end(), m_BoneLods.begin() + lod * m_BoneCount);
+	}
+
+	void CrowdAnimator::SetLod(UINT instance, UINT interval, UINT boneLod, bool visible) {
+		UINT clamped = 1;
+		while (clamped < interval && clamped < MaxUpdateInterval) clamped <<= 1;
+
+		m_Interval[instance] = (UINT8)clamped;
+		m_BoneLod[instance] = (UINT8)(std::min)(boneLod, MaxBoneLods - 1);
+		m_Visible[instance] = visible ? 1 : 0;
+	}
+
+	void CrowdAnimator::Update(float dt) {
+		++m_Frame;
+
+		for (UINT lod = 0; lod < MaxBoneLods; ++lod) {
+			m_LodInstances[lod].clear();
+		}
+
+		for (UINT i = 0; i < (UINT)m_Active.size(); ++i) {
+			if (!m_Active[i]) continue;
+
+			m_Pending[i] += dt;
+
+			if (!m_Visible[i]) {
+				AdvanceTime(i);
+				m_Stale[i] = 1;
+				continue;
+			}
+
+			const UINT phase = i & (MaxUpdateInterval - 1);
+			if (!m_Stale[i] && ((m_Frame + phase) & (m_Interval[i] - 1u)) != 0) continue;
+
+			m_LodInstances[m_BoneLod[i]].push_back(i);
+		}
+
+		// Instances due this frame, grouped by bone level so that a chunk never mixes levels.
+		m_DueInstances.clear();
+		m_Chunks.clear();
+		for (UINT lod = 0; lod < MaxBoneLods; ++lod) {
+			const std::vector<UINT>& instances = m_LodInstances[lod];
+
+			for (size_t begin = 0; begin < instances.size(); begin += LaneCount) {
+				Chunk chunk;
+				chunk.First = (UINT)(m_DueInstances.size() + begin);
+				chunk.Count = (UINT)(std::min)((size_t)LaneCount, instances.size() - begin);
+				chunk.BoneLod = lod;
+				m_Chunks.push_back(chunk);
+			}
+
+			m_DueInstances.insert(m_DueInstances.end(), instances.begin(), instances.end());
+		}
+
+		JobSystem::Get()->ParallelFor(m_Chunks.size(), gChunksPerJob, [&](size_t first, size_t last, size_t) {
+			// Model space transforms of every bone of the chunk, for the children to read.
+			std::vector<float> modelScratch((size_t)m_BoneCount * gAffine * LaneCount);
+
+			for (size_t c = first; c < last; ++c) {
+				const Chunk& chunk = m_Chunks[c];
+				AnimateChunk(&m_DueInstances[chunk.First], chunk.Count, chunk.BoneLod, modelScratch.data());
+			}
+		});
+	}
+
+	void CrowdAnimator::AdvanceTime(UINT instance) {
+		const float step = m_Pending[instance] * m_Rate[instance];
+		m_Pending[instance] = 0.0f;
+
+		m_TimeA[instance] = WrapTime(m_ClipA[instance], m_TimeA[instance] + step);
+		if (m_ClipB[instance] != NullClip) {
+			m_TimeB[instance] = WrapTime(m_ClipB[instance], m_TimeB[instance] + step);
+		}
+	}
+
+	void CrowdAnimator::AnimateChunk(const UINT* instances, UINT count, UINT boneLod, float* modelScratch) {
+		const int frameSize = (int)(m_BoneCount * gComponents);
+
+		LaneKeys keysA;
+		LaneKeys keysB;
+		float weight[LaneCount];
+		XMFLOAT4X4* palettes[LaneCount];
+		bool blend = false;
+
+		// Lanes past count repeat the last instance and are never written back.
+		for (UINT l = 0; l < LaneCount; ++l) {
+			const UINT instance = instances[(std::min)(l, count - 1)];
+
+			if (l < count) {
+				AdvanceTime(instance);
+				m_Stale[instance] = 0;
+			}
+
+			auto locate = [&](UINT clip, float time, LaneKeys& keys) {
+				const Clip& entry = m_Clips[clip];
+				const float position = (std::min)((std::max)((time - entry.StartTime) * entry.FrameRate, 0.0f),
+					(float)(entry.FrameCount - 1));
+				const UINT frame = (std::min)((UINT)position, entry.FrameCount - 2);
+
+				keys.Key0[l] = (int)entry.Offset + (int)frame * frameSize;
+				keys.Key1[l] = keys.Key0[l] + frameSize;
+				keys.Fraction[l] = position - (float)frame;
+			};
+
+			locate(m_ClipA[instance], m_TimeA[instance], keysA);
+
+			if (m_ClipB[instance] != NullClip) {
+				locate(m_ClipB[instance], m_TimeB[instance], keysB);
+				weight[l] = m_Weight[instance];
+				blend = true;
+			}
+			else {
+				keysB.Key0[l] = keysA.Key0[l];
+				keysB.Key1[l] = keysA.Key1[l];
+				keysB.Fraction[l] = keysA.Fraction[l];
+				weight[l] = 0.0f;
+			}
+
+			palettes[l] = &m_Palettes[(size_t)instance * m_BoneCount];
+		}
+
+		const Lanes blendWeight = Load(weight);
+		const UINT8* animated = &m_BoneLods[boneLod * m_BoneCount];
+
+		for (UINT bone = 0; bone < m_BoneCount; ++bone) {
+			Lanes local[gAffine];
+
+			if (animated[bone]) {
+				const float* keys = &m_Keys[bone * gComponents];
+
+				QuatLanes q;
+				Float3Lanes t, s;
+				SampleBone(keys, keysA, q, t, s);
+
+				if (blend) {
+					QuatLanes qB;
+					Float3Lanes tB, sB;
+					SampleBone(keys, keysB, qB, tB, sB);
+
+					q = Nlerp(q, qB, blendWeight, false);
+					t = Lerp(t, tB, blendWeight);
+					s = Lerp(s, sB, blendWeight);
+				}
+
+				Compose(q, t, s, local);
+			}
+			else {
+				for (UINT i = 0; i < gAffine; ++i) {
+					local[i] = Splat(m_BindLocals[bone * gAffine + i]);
+				}
+			}
+
+			// Parents come first, so the parent's model transform is already in the scratch.
+			Lanes model[gAffine];
+			const UINT parent = m_Skeleton->GetParent(bone);
+			if (parent == Skeleton::NullBone) {
+				std::copy(local, local + gAffine, model);
+			}
+			else {
+				Lanes parentModel[gAffine];
+				for (UINT i = 0; i < gAffine; ++i) {
+					parentModel[i] = Load(&modelScratch[((size_t)parent * gAffine + i) * LaneCount]);
+				}
+				MultiplyAffine(local, parentModel, model);
+			}
+
+			for (UINT i = 0; i < gAffine; ++i) {
+				Store(&modelScratch[((size_t)bone * gAffine + i) * LaneCount], model[i]);
+			}
+
+			Lanes offset[gAffine];
+			for (UINT i = 0; i < gAffine; ++i) {
+				offset[i] = Splat(m_BoneOffsets[bone * gAffine + i]);
+			}
+
+			Lanes palette[gAffine];
+			MultiplyAffine(offset, model, palette);
+
+			StorePalettes(palette, palettes, bone, count);
+		}
+	}
+
+	float CrowdAnimator::WrapTime(UINT clip, float dt) const {
+		const Clip& entry = m_Clips[clip];
+
+		if (entry.Duration <= 0.0f) {
+			return entry.StartTime;
+		}
+
+		float t = std::fmod(dt - entry.StartTime, entry.Duration);
+		if (t < 0.0f) {
+			t += entry.Duration;
+		}
+
+		return entry.StartTime + t;
+	}
+
+	const XMFLOAT4X4* CrowdAnimator::GetPalette(UINT instance) const {
+		return &m_Palettes[(size_t)instance * m_BoneCount];
+	}
+
+	const XMFLOAT4X4* CrowdAnimator::GetPalettes() const {
+		return m_Palettes.data();
+	}
+
+	float CrowdAnimator::GetTime(UINT instance) const {
+		return m_TimeA[instance];
+	}
+
+	UINT CrowdAnimator::GetBoneCount() const {
+		return m_BoneCount;
+	}
+
+	UINT CrowdAnimator::GetInstanceCount() const {
+		return (UINT)m_ClipA.size();
+	}
+}
@@ -26,6 +26,8 @@ namespace Mawi1e {
 	void D3DApp::Initialize(const D3DSettings& d3dSettings) {
 		m_d3dSettings = d3dSettings;
 
+		JobSystem::Get()->Initialize();
+
 #if defined(DEBUG) || defined(_DEBUG)
 		EnableDebugLayer();
 #endif
@@ -69,13 +71,25 @@ namespace Mawi1e {
 		BuildRootSignature();
 		BuildDescriptorHeaps();
 		BuildShadersAndInputlayout();
+
+		m_GeometryPool = std::make_unique<GeometryPool>();
+		m_GeometryPool->Initialize(m_Device.Get(), sizeof(Vertex));
+
 		BuildInstancesTheSkull();
 		BuildShapeGeometry();
 		BuildPlaneGeometry();
 		BuildQuadGeometry();
 		BuildMaterials();
+		BuildTerrain();
 		BuildRenderItems();
+		BuildCrowd();
+		BuildSceneGraph();
+		BuildSceneBVH();
+		BuildOccluders();
+		BuildMeshBVHs();
+		BuildInstanceBVH();
 		BuildFrameResources();
+		BuildInstanceBuffer();
 		BuildPSO();
 
 
@@ -84,12 +98,26 @@ namespace Mawi1e {
 		m_CommandQueue->ExecuteCommandLists(_countof(cmdList), cmdList);
 
 		FlushCommandQueue();
+
+		m_Terrain->ReleaseUploader();
+
+		m_CrowdAnimation.ReleaseUploaders();
+		m_DrawArgs["crowdGeo"]->GPUVertexUploader = nullptr;
+		m_DrawArgs["crowdGeo"]->GPUIndexUploader = nullptr;
+		m_CrowdInfluenceUploader = nullptr;
+		m_BakedInstanceUploader = nullptr;
+
+		m_GeometryPool->OnSubmitted(m_FenceCount);
+		m_GeometryPool->ReleaseCompleted(m_Fence->GetCompletedValue());
 	}
 
 	void D3DApp::Shutdown() {
 		if (m_SwapChain != nullptr) {
 			FlushCommandQueue();
 		}
+
+		m_SceneQuery.Collect();
+		JobSystem::Get()->Shutdown();
 	}
 
 	float D3DApp::AspectRatio() const {
@@ -123,12 +151,20 @@ namespace Mawi1e {
 	}
 
 	void D3DApp::Update(const GameTimer* gameTimer) {
+		// Last frame's batch has to finish before anything below moves the instances it reads.
+		m_SceneQuery.Collect();
+
 		OnKeyboardInput(gameTimer);
 		UpdateWindowTitle(gameTimer);
 
-		m_QuatManager->Update(gameTimer->DeltaTime(), m_SkullRitem->World);
-		m_SkullRitem->NumFramesDirty = gNumFrameResources;
+		XMFLOAT4X4 skullLocal;
+		m_QuatManager->Update(gameTimer->DeltaTime(), skullLocal);
+		if (m_RenderWorld->IsAlive(m_SkullRitem)) {
+			m_SceneGraph.SetLocal(m_RenderWorld->GetSceneNode(m_RenderWorld->GetIndex(m_SkullRitem)), XMLoadFloat4x4(&skullLocal));
+		}
 		// UpdateSkullPosition(gameTimer->TotalTime());
+
+		UpdateSceneGraph();
 		
 		m_CurrFrameResourceIndex = (m_CurrFrameResourceIndex + 1) % gNumFrameResources;
 		m_CurrFrameResource = m_FrameResources[m_CurrFrameResourceIndex].get();
@@ -140,6 +176,8 @@ namespace Mawi1e {
 			CloseHandle(hEvent);
 		}
 
+		m_GeometryPool->ReleaseCompleted(m_Fence->GetCompletedValue());
+
 		mLightRotationAngle += 0.6f * gameTimer->DeltaTime();
 		XMMATRIX R = XMMatrixRotationY(mLightRotationAngle);
 
@@ -149,9 +187,11 @@ namespace Mawi1e {
 			XMStoreFloat3(&mRotatedLightDirections[i], RotLightDir);
 		}
 
+		UpdateShadowTransform(gameTimer);
 		UpdateObjectCB(gameTimer);
+		m_SceneQuery.Kick(m_InstanceBVH);
+		UpdateTerrainPatches();
 		UpdateMatetialCBs(gameTimer);
-		UpdateShadowTransform(gameTimer);
 		UpdatePassCB();
 		UpdateShadowPassCB();
 	}
@@ -162,10 +202,22 @@ namespace Mawi1e {
 
 		m_CommandList->Reset(cmdListAlloc.Get(), m_PSOs["opaque"].Get());
 
+		// Despawns leave holes in the pool; once they are most of its free space, repack it.
+		if (m_GeometryPool->GetFragmentation() > gMaxGeometryFragmentation) {
+			m_GeometryPool->Defragment(m_CommandList.Get());
+		}
+
 		ID3D12DescriptorHeap* descriptorHeaps[] = { m_SrvDescriptorHeap.Get() };
 		m_CommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
 		m_CommandList->SetGraphicsRootSignature(m_RootSignature.Get());
+
+		CopyInstanceUpdates();
+		m_CommandList->SetGraphicsRootShaderResourceView(6, m_InstanceBuffer->GetGPUVirtualAddress());
+
+		m_CommandList->SetGraphicsRootShaderResourceView(8, m_CrowdAnimation.GetPaletteBuffer()->GetGPUVirtualAddress());
+		m_CommandList->SetGraphicsRootShaderResourceView(9, m_CrowdAnimation.GetClipBuffer()->GetGPUVirtualAddress());
+		m_CommandList->SetGraphicsRootShaderResourceView(10, m_BakedInstanceBuffer->GetGPUVirtualAddress());
 		
 		UINT passCBByteSize = VertexBuffer::CalcConstantBufferSize(sizeof(PassConstants));
 		CD3DX12_GPU_DESCRIPTOR_HANDLE skyHandle(m_SrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
@@ -204,7 +256,7 @@ namespace Mawi1e {
 
 		m_CommandList->SetGraphicsRootDescriptorTable(3, cubemapHandle);
 		// dynamic cube
-		DrawRenderItems(m_CommandList.Get(), mRitemLayer[(int)RenderLayer::DynamicCubemapOpaque]);
+		DrawRenderItems(m_CommandList.Get(), gMainCullView, RenderLayer::DynamicCubemapOpaque);
 
 		m_CommandList->SetGraphicsRootDescriptorTable(3, skyHandle);
 		// opaque
@@ -214,22 +266,34 @@ namespace Mawi1e {
 		else {
 			m_CommandList->SetPipelineState(m_PSOs["opaque"].Get());
 		}
-		DrawRenderItems(m_CommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+		DrawRenderItems(m_CommandList.Get(), gMainCullView, RenderLayer::Opaque);
 
 		// skull
-		DrawRenderItems(m_CommandList.Get(), mRitemLayer[(int)RenderLayer::Skull]);
+		DrawRenderItems(m_CommandList.Get(), gMainCullView, RenderLayer::Skull);
+
+		// crowd
+		if (m_IsWireFrames) {
+			m_CommandList->SetPipelineState(m_PSOs["skinned_wireframe"].Get());
+		}
+		else {
+			m_CommandList->SetPipelineState(m_PSOs["skinned"].Get());
+		}
+		DrawCrowd(m_CommandList.Get(), gMainCullView);
+
+		// terrain
+		DrawTerrain(m_CommandList.Get());
 
 		// highlight
 		m_CommandList->SetPipelineState(m_PSOs["highlight"].Get());
-		DrawRenderItems(m_CommandList.Get(), mRitemLayer[(int)RenderLayer::Highlight]);
+		DrawRenderItems(m_CommandList.Get(), gMainCullView, RenderLayer::Highlight);
 
 		// ui + image
 		m_CommandList->SetPipelineState(m_PSOs["debug"].Get());
-		DrawRenderItems(m_CommandList.Get(), mRitemLayer[(int)RenderLayer::Debug]);
+		DrawRenderItems(m_CommandList.Get(), gMainCullView, RenderLayer::Debug);
 
 		// sky
 		m_CommandList->SetPipelineState(m_PSOs["sky"].Get());
-		DrawRenderItems(m_CommandList.Get(), mRitemLayer[(int)RenderLayer::Sky]);
+		DrawRenderItems(m_CommandList.Get(), gMainCullView, RenderLayer::Sky);
 		
 		D3D12_RESOURCE_BARRIER resourceBarrier_2 =
 			CD3DX12_RESOURCE_BARRIER::Transition(m_RtvDescriptor[m_CurrBackBufferIdx].Get(),
@@ -247,6 +311,8 @@ namespace Mawi1e {
 
 		m_CurrFrameResource->m_Fence = ++m_FenceCount;
 		m_CommandQueue->Signal(m_Fence.Get(), m_FenceCount);
+
+		m_GeometryPool->OnSubmitted(m_FenceCount);
 	}
 
 	void D3DApp::ResizeBuffer() {
@@ -686,14 +752,23 @@ namespace Mawi1e {
 		// 3 - shadowMap
 		dRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 8, 2, 0);
 
-		const size_t size = 5;
+		CD3DX12_DESCRIPTOR_RANGE terrainHeightRange;
+		terrainHeightRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 10, 0);
+
+		const size_t size = 11;
 
 		CD3DX12_ROOT_PARAMETER cbvParameter[size];
-		cbvParameter[0].InitAsConstantBufferView(0);		// Object
+		cbvParameter[0].InitAsShaderResourceView(3, 1);		// Visible slots of the draw
 		cbvParameter[1].InitAsConstantBufferView(1);		// Pass
 		cbvParameter[2].InitAsShaderResourceView(0, 1);		// Material
 		cbvParameter[3].InitAsDescriptorTable(1, &cubeMapRange, D3D12_SHADER_VISIBILITY_PIXEL); // CubeMap
 		cbvParameter[4].InitAsDescriptorTable(1, &dRange, D3D12_SHADER_VISIBILITY_PIXEL); // Textures
+		cbvParameter[5].InitAsShaderResourceView(1, 1);		// Terrain patches
+		cbvParameter[6].InitAsShaderResourceView(2, 1);		// Instance slots
+		cbvParameter[7].InitAsDescriptorTable(1, &terrainHeightRange, D3D12_SHADER_VISIBILITY_VERTEX); // Terrain heights
+		cbvParameter[8].InitAsShaderResourceView(4, 1);		// Baked palettes
+		cbvParameter[9].InitAsShaderResourceView(5, 1);		// Baked clips
+		cbvParameter[10].InitAsShaderResourceView(6, 1);	// Baked instances, one per slot
 
 		auto sSamplers = GetStaticSamplers();
 		
@@ -742,13 +817,40 @@ namespace Mawi1e {
 		m_Shaders["skyVS"] = VertexBuffer::CompileShader(SOURCE_SHADER_FILE_CUBEMAP_VS, nullptr, "VS", "vs_5_1");
 		m_Shaders["skyPS"] = VertexBuffer::CompileShader(SOURCE_SHADER_FILE_CUBEMAP_PS, &opaque[0], "PS", "ps_5_1");
 
+		const std::string terrainGridDim = std::to_string(Terrain::GridDim);
+		const D3D_SHADER_MACRO terrain[] = {
+			"FOG", "1",
+			"TERRAIN_GRID_DIM", terrainGridDim.c_str(),
+			NULL, NULL,
+		};
+
+		m_Shaders["terrainVS"] = VertexBuffer::CompileShader(SOURCE_SHADER_FILE_TERRAIN_VS, &terrain[0], "VS", "vs_5_1");
+		m_Shaders["terrainPS"] = VertexBuffer::CompileShader(SOURCE_SHADER_FILE_TERRAIN_PS, &terrain[0], "PS", "ps_5_1");
+
+		// BAKED_HALF matches the FormatHalf table BuildCrowd bakes.
+		const D3D_SHADER_MACRO skinned[] = {
+			"SKINNED", "1",
+			"BAKED_HALF", "1",
+			NULL, NULL,
+		};
+
+		m_Shaders["skinnedVS"] = VertexBuffer::CompileShader(SOURCE_SHADER_FILE_VS, &skinned[0], "VS", "vs_5_1");
+		m_Shaders["shadowSkinnedVS"] = VertexBuffer::CompileShader(SOURCE_SHADER_FILE_SHADOWMAP_VS, &skinned[0], "VS", "vs_5_1");
+
 		m_InputElementDesc =
 		{
 			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		};
+
+		// SkinInfluence, from the second vertex buffer.
+		m_SkinnedInputElementDesc = m_InputElementDesc;
+		m_SkinnedInputElementDesc.push_back(
+			{ "WEIGHTS", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+		m_SkinnedInputElementDesc.push_back(
+			{ "BONEINDICES", 0, DXGI_FORMAT_R8G8B8A8_UINT, 1, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
 	}
 
 	void D3DApp::BuildInstancesTheSkull() {
@@ -768,12 +870,6 @@ namespace Mawi1e {
 		fin >> ignore >> tcount;
 		fin >> ignore >> ignore >> ignore >> ignore;
 
-		XMFLOAT3 vMinf3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
-		XMFLOAT3 vMaxf3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
-
-		XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-		XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
 		std::vector<Vertex> vertices(vcount);
 		for (UINT i = 0; i < vcount; ++i)
 		{
@@ -797,20 +893,13 @@ namespace Mawi1e {
 			float v = phi / XM_PI;
 
 			vertices[i].TexC = { u, v };
-
-			vMin = XMVectorMin(vMin, P);
-			vMax = XMVectorMax(vMax, P);
 		}
 
-		BoundingBox bounds;
-		XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-		XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-
 		fin >> ignore;
 		fin >> ignore;
 		fin >> ignore;
 
-		std::vector<std::int32_t> indices(3 * tcount);
+		std::vector<std::uint32_t> indices(3 * tcount);
 		for (UINT i = 0; i < tcount; ++i)
 		{
 			fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
@@ -818,10 +907,15 @@ namespace Mawi1e {
 
 		fin.close();
 
+		// skull.txt has normals but no tangents; keep the normals, derive the tangent frame.
+		TangentSpace::Options tangentOptions;
+		tangentOptions.RecomputeNormals = false;
+		TangentSpace::Generate(vertices, indices, tangentOptions);
+
 		
 		const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 
-		const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
+		const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
 
 		auto geo = std::make_unique<MeshGeometry>();
 		geo->Name = "lskullGeo";
@@ -832,11 +926,8 @@ namespace Mawi1e {
 		THROWFAILEDIF("@@@ Error: D3DCreateBlob", D3DCreateBlob(ibByteSize, &geo->CPUIndexBuffer));
 		CopyMemory(geo->CPUIndexBuffer->GetBufferPointer(), indices.data(), ibByteSize);
 
-		geo->GPUVertexBuffer = VertexBuffer::CreateDefaultBuffer(m_Device.Get(),
-			m_CommandList.Get(), vertices.data(), vbByteSize, geo->GPUVertexUploader);
-
-		geo->GPUIndexBuffer = VertexBuffer::CreateDefaultBuffer(m_Device.Get(),
-			m_CommandList.Get(), indices.data(), ibByteSize, geo->GPUIndexUploader);
+		geo->PoolHandle = m_GeometryPool->Upload(m_CommandList.Get(),
+			vertices.data(), (UINT)vertices.size(), indices.data(), (UINT)indices.size());
 
 		geo->VertexByteStride = sizeof(Vertex);
 		geo->VertexBufferByteSize = vbByteSize;
@@ -847,7 +938,7 @@ namespace Mawi1e {
 		submesh.IndexCount = (UINT)indices.size();
 		submesh.StartIndexLocation = 0;
 		submesh.BaseVertexLocation = 0;
-		submesh.Bounds = bounds;
+		BoundingVolume::Compute(submesh, vertices.data(), vertices.size(), true);
 
 		geo->DrawArgs["lskull"] = submesh;
 
@@ -943,6 +1034,16 @@ namespace Mawi1e {
 		THROWFAILEDIF("@@@Error: ID3D12Device::CreateGraphicsPipelineState",
 			m_Device->CreateGraphicsPipelineState(&ShdowMapPSODesc, IID_PPV_ARGS(m_PSOs["shadow_opaque"].GetAddressOf())));
 
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC ShadowSkinnedPSODesc = ShdowMapPSODesc;
+		ShadowSkinnedPSODesc.InputLayout = { m_SkinnedInputElementDesc.data(), (UINT)m_SkinnedInputElementDesc.size() };
+		ShadowSkinnedPSODesc.VS = {
+			reinterpret_cast<BYTE*>(m_Shaders["shadowSkinnedVS"]->GetBufferPointer()),
+			m_Shaders["shadowSkinnedVS"]->GetBufferSize(),
+		};
+
+		THROWFAILEDIF("@@@Error: ID3D12Device::CreateGraphicsPipelineState",
+			m_Device->CreateGraphicsPipelineState(&ShadowSkinnedPSODesc, IID_PPV_ARGS(m_PSOs["shadow_skinned"].GetAddressOf())));
+
 
 		D3D12_GRAPHICS_PIPELINE_STATE_DESC ShdowMapDebugPSODesc = GrphicsPSODesc;
 		ShdowMapDebugPSODesc.VS = {
@@ -956,48 +1057,247 @@ namespace Mawi1e {
 
 		THROWFAILEDIF("@@@Error: ID3D12Device::CreateGraphicsPipelineState",
 			m_Device->CreateGraphicsPipelineState(&ShdowMapDebugPSODesc, IID_PPV_ARGS(m_PSOs["debug"].GetAddressOf())));
+
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC TerrainPSODesc = GrphicsPSODesc;
+		TerrainPSODesc.VS = {
+			reinterpret_cast<BYTE*>(m_Shaders["terrainVS"]->GetBufferPointer()),
+			m_Shaders["terrainVS"]->GetBufferSize(),
+		};
+		TerrainPSODesc.PS = {
+			reinterpret_cast<BYTE*>(m_Shaders["terrainPS"]->GetBufferPointer()),
+			m_Shaders["terrainPS"]->GetBufferSize(),
+		};
+
+		THROWFAILEDIF("@@@Error: ID3D12Device::CreateGraphicsPipelineState",
+			m_Device->CreateGraphicsPipelineState(&TerrainPSODesc, IID_PPV_ARGS(m_PSOs["terrain"].GetAddressOf())));
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC TerrainWireframePSODesc = TerrainPSODesc;
+		TerrainWireframePSODesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+		THROWFAILEDIF("@@@Error: ID3D12Device::CreateGraphicsPipelineState",
+			m_Device->CreateGraphicsPipelineState(&TerrainWireframePSODesc, IID_PPV_ARGS(m_PSOs["terrain_wireframe"].GetAddressOf())));
+
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC SkinnedPSODesc = GrphicsPSODesc;
+		SkinnedPSODesc.InputLayout = { m_SkinnedInputElementDesc.data(), (UINT)m_SkinnedInputElementDesc.size() };
+		SkinnedPSODesc.VS = {
+			reinterpret_cast<BYTE*>(m_Shaders["skinnedVS"]->GetBufferPointer()),
+			m_Shaders["skinnedVS"]->GetBufferSize(),
+		};
+
+		THROWFAILEDIF("@@@Error: ID3D12Device::CreateGraphicsPipelineState",
+			m_Device->CreateGraphicsPipelineState(&SkinnedPSODesc, IID_PPV_ARGS(m_PSOs["skinned"].GetAddressOf())));
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC SkinnedWireframePSODesc = SkinnedPSODesc;
+		SkinnedWireframePSODesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+		THROWFAILEDIF("@@@Error: ID3D12Device::CreateGraphicsPipelineState",
+			m_Device->CreateGraphicsPipelineState(&SkinnedWireframePSODesc, IID_PPV_ARGS(m_PSOs["skinned_wireframe"].GetAddressOf())));
 	}
 
 
 	void D3DApp::BuildFrameResources() {
 		for (int i = 0; i < gNumFrameResources; ++i) {
 			m_FrameResources.push_back(std::make_unique<FrameResource>(m_Device.Get(),
-				8, (UINT)m_AllRItems.size(), (UINT)m_Materials.size()));
+				8, m_RenderWorld->GetCount(), (UINT)m_Materials.size(), m_Terrain->GetSettings().MaxPatches,
+				m_RenderWorld->GetCount() * gCullViewCount));
 		}
 	}
 
+	void D3DApp::BuildInstanceBuffer() {
+		CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(
+			(UINT64)(std::max)(m_RenderWorld->GetSlotCapacity(), 1u) * sizeof(PackedInstance));
+
+		THROWFAILEDIF("@@@ Error: ID3D12Device::CreateCommittedResource",
+			m_Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+				D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(m_InstanceBuffer.GetAddressOf())));
+	}
+
 	void D3DApp::UpdateObjectCB(const GameTimer* gameTimer) {
-		auto currInstanceBuffer = m_CurrFrameResource->m_InstCB.get();
+		auto currInstanceUploads = m_CurrFrameResource->m_InstanceUploads.get();
+		auto currVisibleSlots = m_CurrFrameResource->m_VisibleSlots.get();
 
-		XMMATRIX invView = XMMatrixInverse(
-			&My_unmove(XMMatrixDeterminant(My_unmove(XMLoadFloat4x4(&My_unmove(m_Camera.GetViewMatrix()))))),
-			My_unmove(XMLoadFloat4x4(&My_unmove(m_Camera.GetViewMatrix()))));
+		const UINT itemCount = m_RenderWorld->GetCount();
 
-		size_t ObjectCounts = 0;
+		// Items that moved since the last frame refit their leaf before the query, once per move.
+		m_RefitItems.clear();
+		for (UINT i = 0; i < itemCount; ++i) {
+			if (m_RenderWorld->IsBoundsDirty(i)) {
+				m_RefitItems.push_back(i);
+			}
+		}
 
-		for (auto& e : m_AllRItems) {
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
-			XMMATRIX tex = XMLoadFloat4x4(&e->TexTransform);
+		m_RefitBounds.resize(m_RefitItems.size());
+		BoundingVolume::TransformBoxes(m_RenderWorld->GetBoundsData(), m_RenderWorld->GetWorldData(),
+			m_RefitItems.data(), m_RefitItems.size(), m_RefitBounds.data());
 
-			XMMATRIX invWorld = XMMatrixInverse(&My_unmove(XMMatrixDeterminant(world)), world);
+		for (size_t k = 0; k < m_RefitItems.size(); ++k) {
+			const UINT i = m_RefitItems[k];
 
-			XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+			BoundingSphere worldSphere;
+			m_RenderWorld->GetSphereBounds(i).Transform(worldSphere, XMLoadFloat4x4(&m_RenderWorld->GetWorld(i)));
 
-			BoundingFrustum bFrustum;
-			m_LocalProjFrustum.Transform(bFrustum, toLocal);
+			m_SceneBVH->MoveProxy(m_RenderWorld->GetCullProxy(i), m_RefitBounds[k]);
+			m_Culler.SetBounds(i, m_RefitBounds[k]);
+			m_Culler.SetSphere(i, worldSphere);
 
-			if ((bFrustum.Contains(e->Bounds) != DirectX::DISJOINT) || m_isFrustumCulling) {
-				InstanceConstants instanceConstants;
-				XMStoreFloat4x4(&instanceConstants.World, XMMatrixTranspose(world));
-				XMStoreFloat4x4(&instanceConstants.TexTransform, XMMatrixTranspose(tex));
-				instanceConstants.MaterialIndex = e->Mat->MatCBIndex;
+			m_RenderWorld->ClearBoundsDirty(i);
+		}
 
-				currInstanceBuffer->CopyData(e->InstanceCount, instanceConstants);
-				ObjectCounts++;
+		// Only changed items are staged, in slot order so that neighbouring slots share one copy.
+		m_DirtyInstances.clear();
+		for (UINT i = 0; i < itemCount; ++i) {
+			if (!m_RenderWorld->IsInstanceDirty(i)) continue;
+
+			m_DirtyInstances.push_back(std::make_pair(m_RenderWorld->GetInstanceSlot(i), i));
+			m_RenderWorld->ClearInstanceDirty(i);
+		}
+		std::sort(m_DirtyInstances.begin(), m_DirtyInstances.end());
+
+		m_DirtyItems.clear();
+		m_InstanceCopies.clear();
+		for (const auto& dirty : m_DirtyInstances) {
+			const UINT slot = dirty.first;
+			m_DirtyItems.push_back(dirty.second);
+
+			if (!m_InstanceCopies.empty() && m_InstanceCopies.back().first + m_InstanceCopies.back().second == slot) {
+				++m_InstanceCopies.back().second;
+			}
+			else {
+				m_InstanceCopies.push_back(std::make_pair(slot, 1u));
+			}
+		}
+
+		// Pick instances follow their items; the top level refits once for all of them.
+		for (UINT item : m_DirtyItems) {
+			if (m_PickInstances[item] != InstanceBVH::NullInstance) {
+				m_InstanceBVH.SetWorld(m_PickInstances[item], XMLoadFloat4x4(&m_RenderWorld->GetWorld(item)));
+			}
+		}
+		m_InstanceBVH.Refit();
+
+		if (!m_DirtyItems.empty()) {
+			m_PackedInstances.resize(m_DirtyItems.size());
+			InstancePacker::Pack(m_RenderWorld->GetWorldData(), m_RenderWorld->GetTexTransformData(),
+				m_RenderWorld->GetMaterialData(), m_DirtyItems.data(), m_DirtyItems.size(), m_PackedInstances.data());
+			currInstanceUploads->CopyData(0, m_PackedInstances.data(), (UINT)m_PackedInstances.size());
+		}
+
+		if (m_isFrustumCulling) {
+			std::fill(m_ViewMasks.begin(), m_ViewMasks.end(), (1u << gCullViewCount) - 1);
+		}
+		else {
+			std::fill(m_ViewMasks.begin(), m_ViewMasks.end(), 0u);
+			UpdateCullViews();
+
+			// One sweep for every view: the tree settles whole subtrees, and the leaves it leaves open
+			// are tested against their tight bounds 8 at a time.
+			m_SceneBVH->QueryViews(m_CullViews, gCullViewCount, m_ViewMasks.data(), m_CullCandidates, m_CullCandidateMasks);
+			m_Culler.CullViews(m_CullViews, gCullViewCount, m_CullCandidates.data(), m_CullCandidateMasks.data(),
+				m_CullCandidates.size(), m_ViewMasks.data());
+			m_Culler.CullContribution(m_CullViews, gCullViewCount, m_ViewMasks.data());
+
+			CullOccludedItems();
+		}
+
+		for (int layer = 0; layer < (int)RenderLayer::Count; ++layer) {
+			for (UINT view = 0; view < gCullViewCount; ++view) {
+				m_ViewLayers[view][layer].clear();
 			}
 		}
 
-		m_SkullCounts = (UINT)ObjectCounts;
+		m_SkullCounts = 0;
+
+		for (UINT i = 0; i < itemCount; ++i) {
+			const UINT layer = m_RenderWorld->GetLayer(i);
+
+			// The debug quad is already in clip space.
+			if (layer == (UINT)RenderLayer::Debug) {
+				m_ViewMasks[i] |= 1u << gMainCullView;
+			}
+
+			const UINT mask = m_ViewMasks[i];
+			if (mask == 0) continue;
+
+			for (UINT view = 0; view < gCullViewCount; ++view) {
+				if (mask & (1u << view)) {
+					m_ViewLayers[view][layer].push_back(i);
+				}
+			}
+
+			if (mask & (1u << gMainCullView)) {
+				++m_SkullCounts;
+			}
+		}
+
+		// Every draw list goes out as the slots of its items, one list after another.
+		UINT visibleCount = 0;
+		for (UINT view = 0; view < gCullViewCount; ++view) {
+			for (int layer = 0; layer < (int)RenderLayer::Count; ++layer) {
+				m_ViewLayerOffsets[view][layer] = visibleCount;
+
+				for (UINT index : m_ViewLayers[view][layer]) {
+					currVisibleSlots->CopyData(visibleCount++, m_RenderWorld->GetInstanceSlot(index));
+				}
+			}
+		}
+	}
+
+	void D3DApp::UpdateCullViews() {
+		XMMATRIX view = XMLoadFloat4x4(&My_unmove(m_Camera.GetViewMatrix()));
+		XMMATRIX invView = XMMatrixInverse(&My_unmove(XMMatrixDeterminant(view)), view);
+
+		BoundingFrustum frustumW;
+		m_LocalProjFrustum.Transform(frustumW, invView);
+
+		XMFLOAT4 mainPlanes[6];
+		FrustumCuller::ExtractPlanes(frustumW, mainPlanes);
+		FrustumCuller::BuildView(mainPlanes, m_CullViews[gMainCullView]);
+		FrustumCuller::SetPerspectiveContribution(m_CullViews[gMainCullView], m_Camera.GetPosition(),
+			(float)m_d3dSettings.screenHeight, m_Camera.GetNearZ(), m_Camera.GetNearWindowHeight(), gMainMinPixels);
+
+		// Casters only matter if their shadow can land inside the main view.
+		XMFLOAT4 lightPlanes[6];
+		FrustumCuller::ExtractPlanes(XMMatrixMultiply(XMLoadFloat4x4(&mLightView), XMLoadFloat4x4(&mLightProj)), lightPlanes);
+		FrustumCuller::BuildShadowCasterView(mainPlanes, XMLoadFloat3(&mRotatedLightDirections[0]), lightPlanes,
+			m_CullViews[gShadowCullView]);
+		FrustumCuller::SetOrthographicContribution(m_CullViews[gShadowCullView], (float)gShadowMapSize,
+			2.0f * m_SceneBounds.Radius, gShadowMinPixels);
+
+		for (int i = 0; i < 6; ++i) {
+			XMMATRIX V = XMLoadFloat4x4(&My_unmove(m_DynamicCubemapCamera[i].GetViewMatrix()));
+			XMMATRIX P = XMLoadFloat4x4(&My_unmove(m_DynamicCubemapCamera[i].GetProjectionMatrix()));
+
+			XMFLOAT4 facePlanes[6];
+			FrustumCuller::ExtractPlanes(XMMatrixMultiply(V, P), facePlanes);
+			FrustumCuller::BuildView(facePlanes, m_CullViews[gCubeFaceCullView + i]);
+			FrustumCuller::SetPerspectiveContribution(m_CullViews[gCubeFaceCullView + i], m_DynamicCubemapCamera[i].GetPosition(),
+				(float)gCubemapSize, m_DynamicCubemapCamera[i].GetNearZ(), m_DynamicCubemapCamera[i].GetNearWindowHeight(), gCubeFaceMinPixels);
+		}
+	}
+
+	void D3DApp::CullOccludedItems() {
+		XMMATRIX view = XMLoadFloat4x4(&My_unmove(m_Camera.GetViewMatrix()));
+		XMMATRIX proj = XMLoadFloat4x4(&My_unmove(m_Camera.GetProjectionMatrix()));
+
+		m_OcclusionCuller.BeginFrame(XMMatrixMultiply(view, proj));
+
+		for (auto& occluder : m_Occluders) {
+			UINT index = m_RenderWorld->GetIndex(occluder.first);
+			if ((m_ViewMasks[index] & (1u << gMainCullView)) == 0) continue;
+
+			m_OcclusionCuller.AddOccluder(occluder.second, XMLoadFloat4x4(&m_RenderWorld->GetWorld(index)));
+		}
+
+		m_OcclusionCuller.Rasterize();
+
+		for (UINT i = 0; i < m_RenderWorld->GetCount(); ++i) {
+			if ((m_ViewMasks[i] & (1u << gMainCullView)) == 0) continue;
+
+			if (!m_OcclusionCuller.IsVisible(m_Culler.GetBounds(i))) {
+				m_ViewMasks[i] &= ~(1u << gMainCullView);
+			}
+		}
 	}
 
 	void D3DApp::UpdateMatetialCBs(const GameTimer* gameTimer) {
@@ -1143,8 +1443,19 @@ namespace Mawi1e {
 
 		XMFLOAT4 xmfloat4;
 		XMStoreFloat4(&xmfloat4, m_SkullCenter);
-		XMStoreFloat4x4(&m_SkullRitem->World, XMMatrixTranslation(xmfloat4.x + radius * cosf(angle), 0.0f, xmfloat4.z + radius * sinf(angle)));
-		m_SkullRitem->NumFramesDirty = gNumFrameResources;
+		m_SceneGraph.SetLocal(m_RenderWorld->GetSceneNode(m_RenderWorld->GetIndex(m_SkullRitem)),
+			XMMatrixTranslation(xmfloat4.x + radius * cosf(angle), 0.0f, xmfloat4.z + radius * sinf(angle)));
+	}
+
+	void D3DApp::UpdateSceneGraph() {
+		m_SceneGraph.Update();
+
+		for (UINT node : m_SceneGraph.GetChangedNodes()) {
+			UINT index = m_SceneGraph.GetUserData(node);
+			if (index == SceneGraph::NullNode) continue;
+
+			m_RenderWorld->SetWorld(index, m_SceneGraph.GetWorld(node));
+		}
 	}
 
 	void D3DApp::UpdatePassCB() {
@@ -1301,142 +1612,307 @@ namespace Mawi1e {
 	}
 
 	void D3DApp::BuildRenderItems() {
-		auto lSkullRitems = std::make_unique<RenderItem>();
-		lSkullRitems->World = VertexBuffer::GetMatrixIdentity4x4();
-		lSkullRitems->TexTransform = VertexBuffer::GetMatrixIdentity4x4();
-		lSkullRitems->InstanceCount = 0;
-		lSkullRitems->Mat = m_Materials["white1x1"].get();
-		lSkullRitems->Geo = m_DrawArgs["lskullGeo"].get();
-		lSkullRitems->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		lSkullRitems->IndexCount = lSkullRitems->Geo->DrawArgs["lskull"].IndexCount;
-		lSkullRitems->StartIndexLocation = lSkullRitems->Geo->DrawArgs["lskull"].StartIndexLocation;
-		lSkullRitems->BaseVertexLocation = lSkullRitems->Geo->DrawArgs["lskull"].BaseVertexLocation;
-		lSkullRitems->Bounds = lSkullRitems->Geo->DrawArgs["lskull"].Bounds;
-		lSkullRitems->Visible = true;
-
-		m_SkullRitem = lSkullRitems.get();
-		mRitemLayer[(int)RenderLayer::Skull].push_back(lSkullRitems.get());
-		m_AllRItems.push_back(std::move(lSkullRitems));
-
-
-		auto HighlightRitem = std::make_unique<RenderItem>();
-		HighlightRitem->World = VertexBuffer::GetMatrixIdentity4x4();
-		HighlightRitem->TexTransform = VertexBuffer::GetMatrixIdentity4x4();
-		HighlightRitem->InstanceCount = 1;
-		HighlightRitem->Mat = m_Materials["yell"].get();
-		HighlightRitem->Geo = m_DrawArgs["lskullGeo"].get();
-		HighlightRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		HighlightRitem->Visible = false;
-
-		HighlightRitem->IndexCount = 0;
-		HighlightRitem->StartIndexLocation = 0;
-		HighlightRitem->BaseVertexLocation = 0;
-
-		m_PickedItem = HighlightRitem.get();
-		mRitemLayer[(int)RenderLayer::Highlight].push_back(HighlightRitem.get());
-		m_AllRItems.push_back(std::move(HighlightRitem));
-
-		auto SkySphereRitem = std::make_unique<RenderItem>();
-		XMStoreFloat4x4(&SkySphereRitem->World, XMMatrixScaling(5000.0f, 5000.0f, 5000.0f));
-		SkySphereRitem->TexTransform = VertexBuffer::GetMatrixIdentity4x4();
-		SkySphereRitem->InstanceCount = 2;
-		SkySphereRitem->Mat = m_Materials["ice"].get();
-		SkySphereRitem->Geo = m_DrawArgs["shapeGeo"].get();
-		SkySphereRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		SkySphereRitem->IndexCount = SkySphereRitem->Geo->DrawArgs["sphere"].IndexCount;
-		SkySphereRitem->StartIndexLocation = SkySphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
-		SkySphereRitem->BaseVertexLocation = SkySphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
-		SkySphereRitem->Visible = true;
-
-		mRitemLayer[(int)RenderLayer::Sky].push_back(SkySphereRitem.get());
-		m_AllRItems.push_back(std::move(SkySphereRitem));
-
-
-		UINT Count = 3;
+		m_RenderWorld = std::make_unique<RenderWorld>(gNumFrameResources);
+
+		auto addMesh = [this](const std::string& geoName, const std::string& drawArgName) {
+			RenderWorld::Mesh mesh;
+			mesh.Geo = m_DrawArgs[geoName].get();
+			mesh.PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+			mesh.IndexCount = mesh.Geo->DrawArgs[drawArgName].IndexCount;
+			mesh.StartIndexLocation = mesh.Geo->DrawArgs[drawArgName].StartIndexLocation;
+			mesh.BaseVertexLocation = mesh.Geo->DrawArgs[drawArgName].BaseVertexLocation;
+			mesh.Bounds = mesh.Geo->DrawArgs[drawArgName].Bounds;
+			mesh.SphereBounds = mesh.Geo->DrawArgs[drawArgName].SphereBounds;
+
+			return m_RenderWorld->AddMesh(mesh);
+		};
+
+		UINT skullMesh = addMesh("lskullGeo", "lskull");
+		UINT sphereMesh = addMesh("shapeGeo", "sphere");
+		UINT gridMesh = addMesh("planeGeo", "grid");
+		UINT quadMesh = addMesh("quadGeo", "quad");
+
+		// The highlight draws whatever range of the skull Pick chose, so it owns its mesh.
+		RenderWorld::Mesh highlightMesh = m_RenderWorld->GetMesh(skullMesh);
+		highlightMesh.IndexCount = 0;
+		highlightMesh.StartIndexLocation = 0;
+		highlightMesh.BaseVertexLocation = 0;
+		m_PickedMesh = m_RenderWorld->AddMesh(highlightMesh);
+
+		RenderWorld::ItemDesc lSkullDesc;
+		lSkullDesc.Mesh = skullMesh;
+		lSkullDesc.Material = m_Materials["white1x1"]->MatCBIndex;
+		lSkullDesc.Layer = (UINT)RenderLayer::Skull;
+
+		m_SkullRitem = m_RenderWorld->Create(lSkullDesc);
+
+
+		RenderWorld::ItemDesc HighlightDesc;
+		HighlightDesc.Mesh = m_PickedMesh;
+		HighlightDesc.Material = m_Materials["yell"]->MatCBIndex;
+		HighlightDesc.Layer = (UINT)RenderLayer::Highlight;
+		HighlightDesc.Flags = 0;
+
+		m_PickedItem = m_RenderWorld->Create(HighlightDesc);
+
+		RenderWorld::ItemDesc SkySphereDesc;
+		XMStoreFloat4x4(&SkySphereDesc.World, XMMatrixScaling(5000.0f, 5000.0f, 5000.0f));
+		SkySphereDesc.Mesh = sphereMesh;
+		SkySphereDesc.Material = m_Materials["ice"]->MatCBIndex;
+		SkySphereDesc.Layer = (UINT)RenderLayer::Sky;
+
+		m_RenderWorld->Create(SkySphereDesc);
+
+
+		// The spheres hang off one row node; their World is filled in by the scene graph.
+		m_SphereRowNode = m_SceneGraph.CreateNode(SceneGraph::NullNode, SceneGraph::NullNode);
+		m_SceneGraph.SetLocal(m_SphereRowNode, XMMatrixTranslation(10.0f, 0.0f, 0.0f));
+
 		for (int i = 0; i < 9; ++i) {
-			auto SphereRitem = std::make_unique<RenderItem>();
-			XMStoreFloat4x4(&SphereRitem->World, XMMatrixScaling(10.0f, 10.0f, 10.0f) * XMMatrixTranslation(10.0f + (i * 13), 0.0f, 0.0f));
-			SphereRitem->TexTransform = VertexBuffer::GetMatrixIdentity4x4();
-			SphereRitem->InstanceCount = Count++;
+			RenderWorld::ItemDesc SphereDesc;
+			SphereDesc.Mesh = sphereMesh;
 			std::string MaterialString = "mirror" + std::to_string(i);
-			SphereRitem->Mat = m_Materials[MaterialString].get();
-			SphereRitem->Geo = m_DrawArgs["shapeGeo"].get();
-			SphereRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-			SphereRitem->IndexCount = SphereRitem->Geo->DrawArgs["sphere"].IndexCount;
-			SphereRitem->StartIndexLocation = SphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
-			SphereRitem->BaseVertexLocation = SphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
-			SphereRitem->Bounds = SphereRitem->Geo->DrawArgs["sphere"].Bounds;
-			SphereRitem->Visible = true;
-
-			mRitemLayer[(int)RenderLayer::Opaque].push_back(SphereRitem.get());
-			m_AllRItems.push_back(std::move(SphereRitem));
+			SphereDesc.Material = m_Materials[MaterialString]->MatCBIndex;
+			SphereDesc.Layer = (UINT)RenderLayer::Opaque;
+			SphereDesc.Flags = RenderWorld::ItemVisible | RenderWorld::ItemOccluder;
+
+			UINT index = m_RenderWorld->GetIndex(m_RenderWorld->Create(SphereDesc));
+			UINT node = m_SceneGraph.CreateNode(m_SphereRowNode, index);
+			m_SceneGraph.SetLocal(node, XMMatrixScaling(10.0f, 10.0f, 10.0f) * XMMatrixTranslation((float)(i * 13), 0.0f, 0.0f));
+			m_RenderWorld->SetSceneNode(index, node);
 		}
 
 		// 12 ->
-		auto PlaneGridRitem = std::make_unique<RenderItem>();
-		XMStoreFloat4x4(&PlaneGridRitem->World, XMMatrixScaling(1.0f, 1.0f, 1.0f) * XMMatrixTranslation(0.0f, -15.0f, 0.0f));
-		PlaneGridRitem->TexTransform = VertexBuffer::GetMatrixIdentity4x4();
-		PlaneGridRitem->InstanceCount = 12;
-		PlaneGridRitem->Mat = m_Materials["planeWall1"].get();
-		PlaneGridRitem->Geo = m_DrawArgs["planeGeo"].get();
-		PlaneGridRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		PlaneGridRitem->IndexCount = PlaneGridRitem->Geo->DrawArgs["grid"].IndexCount;
-		PlaneGridRitem->StartIndexLocation = PlaneGridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-		PlaneGridRitem->BaseVertexLocation = PlaneGridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
-		PlaneGridRitem->Visible = true;
-
-		auto PlaneGridRitem2 = std::make_unique<RenderItem>();
-		XMStoreFloat4x4(&PlaneGridRitem2->World, XMMatrixScaling(1.0f, 1.0f, 1.0f) * XMMatrixTranslation(-30.0f, -15.0f, 0.0f));
-		PlaneGridRitem2->TexTransform = VertexBuffer::GetMatrixIdentity4x4();
-		PlaneGridRitem2->InstanceCount = 13;
-		PlaneGridRitem2->Mat = m_Materials["planeWall2"].get();
-		PlaneGridRitem2->Geo = m_DrawArgs["planeGeo"].get();
-		PlaneGridRitem2->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		PlaneGridRitem2->IndexCount = PlaneGridRitem2->Geo->DrawArgs["grid"].IndexCount;
-		PlaneGridRitem2->StartIndexLocation = PlaneGridRitem2->Geo->DrawArgs["grid"].StartIndexLocation;
-		PlaneGridRitem2->BaseVertexLocation = PlaneGridRitem2->Geo->DrawArgs["grid"].BaseVertexLocation;
-		PlaneGridRitem2->Visible = true;
-
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(PlaneGridRitem.get());
-		m_AllRItems.push_back(std::move(PlaneGridRitem));
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(PlaneGridRitem2.get());
-		m_AllRItems.push_back(std::move(PlaneGridRitem2));
-
-		auto QuadRitem = std::make_unique<RenderItem>();
-		QuadRitem->World = VertexBuffer::GetMatrixIdentity4x4();
-		QuadRitem->TexTransform = VertexBuffer::GetMatrixIdentity4x4();
-		QuadRitem->InstanceCount = 14;
-		QuadRitem->Mat = m_Materials["bricks0"].get();
-		QuadRitem->Geo = m_DrawArgs["quadGeo"].get();
-		QuadRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		QuadRitem->IndexCount = QuadRitem->Geo->DrawArgs["quad"].IndexCount;
-		QuadRitem->StartIndexLocation = QuadRitem->Geo->DrawArgs["quad"].StartIndexLocation;
-		QuadRitem->BaseVertexLocation = QuadRitem->Geo->DrawArgs["quad"].BaseVertexLocation;
-		QuadRitem->Visible = true;
-
-		mRitemLayer[(int)RenderLayer::Debug].push_back(QuadRitem.get());
-		m_AllRItems.push_back(std::move(QuadRitem));
-
-		auto PlaneGridRitem3 = std::make_unique<RenderItem>();
-		XMStoreFloat4x4(&PlaneGridRitem3->World, XMMatrixScaling(10.0f, 1.0f, 10.0f) * XMMatrixTranslation(0.0f, -30.0f, 0.0f));
-		PlaneGridRitem3->TexTransform = VertexBuffer::GetMatrixIdentity4x4();
-		PlaneGridRitem3->InstanceCount = 15;
-		PlaneGridRitem3->Mat = m_Materials["planeWall2"].get();
-		PlaneGridRitem3->Geo = m_DrawArgs["planeGeo"].get();
-		PlaneGridRitem3->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		PlaneGridRitem3->IndexCount = PlaneGridRitem3->Geo->DrawArgs["grid"].IndexCount;
-		PlaneGridRitem3->StartIndexLocation = PlaneGridRitem3->Geo->DrawArgs["grid"].StartIndexLocation;
-		PlaneGridRitem3->BaseVertexLocation = PlaneGridRitem3->Geo->DrawArgs["grid"].BaseVertexLocation;
-		PlaneGridRitem3->Visible = true;
-
-		mRitemLayer[(int)RenderLayer::Opaque].push_back(PlaneGridRitem3.get());
-		m_AllRItems.push_back(std::move(PlaneGridRitem3));
+		RenderWorld::ItemDesc PlaneGridDesc;
+		XMStoreFloat4x4(&PlaneGridDesc.World, XMMatrixScaling(1.0f, 1.0f, 1.0f) * XMMatrixTranslation(0.0f, -15.0f, 0.0f));
+		PlaneGridDesc.Mesh = gridMesh;
+		PlaneGridDesc.Material = m_Materials["planeWall1"]->MatCBIndex;
+		PlaneGridDesc.Layer = (UINT)RenderLayer::Opaque;
+		PlaneGridDesc.Flags = RenderWorld::ItemVisible | RenderWorld::ItemOccluder;
+
+		RenderWorld::ItemDesc PlaneGridDesc2;
+		XMStoreFloat4x4(&PlaneGridDesc2.World, XMMatrixScaling(1.0f, 1.0f, 1.0f) * XMMatrixTranslation(-30.0f, -15.0f, 0.0f));
+		PlaneGridDesc2.Mesh = gridMesh;
+		PlaneGridDesc2.Material = m_Materials["planeWall2"]->MatCBIndex;
+		PlaneGridDesc2.Layer = (UINT)RenderLayer::Opaque;
+		PlaneGridDesc2.Flags = RenderWorld::ItemVisible | RenderWorld::ItemOccluder;
+
+		m_RenderWorld->Create(PlaneGridDesc);
+		m_RenderWorld->Create(PlaneGridDesc2);
+
+		RenderWorld::ItemDesc QuadDesc;
+		QuadDesc.Mesh = quadMesh;
+		QuadDesc.Material = m_Materials["bricks0"]->MatCBIndex;
+		QuadDesc.Layer = (UINT)RenderLayer::Debug;
+
+		m_RenderWorld->Create(QuadDesc);
+
+		RenderWorld::ItemDesc PlaneGridDesc3;
+		XMStoreFloat4x4(&PlaneGridDesc3.World, XMMatrixScaling(10.0f, 1.0f, 10.0f) * XMMatrixTranslation(0.0f, -30.0f, 0.0f));
+		PlaneGridDesc3.Mesh = gridMesh;
+		PlaneGridDesc3.Material = m_Materials["planeWall2"]->MatCBIndex;
+		PlaneGridDesc3.Layer = (UINT)RenderLayer::Opaque;
+		PlaneGridDesc3.Flags = RenderWorld::ItemVisible | RenderWorld::ItemOccluder;
+
+		m_RenderWorld->Create(PlaneGridDesc3);
+	}
+
+	void D3DApp::DestroyRenderItem(RenderHandle handle) {
+		const UINT index = m_RenderWorld->GetIndex(handle);
+		if (index == RenderWorld::NullIndex) return;
+
+		// A batch still in flight walks m_InstanceBVH into the mesh BVHs freed below; let it finish before
+		// anything it could read changes.
+		m_SceneQuery.Collect();
+
+		const UINT last = m_RenderWorld->GetCount() - 1;
+
+		m_SceneBVH->DestroyProxy(m_RenderWorld->GetCullProxy(index));
+
+		// Items own leaf nodes, so removing the node takes nothing else out of the graph.
+		if (m_RenderWorld->GetSceneNode(index) != SceneGraph::NullNode) {
+			m_SceneGraph.RemoveNode(m_RenderWorld->GetSceneNode(index));
+		}
+
+		m_Occluders.erase(std::remove_if(m_Occluders.begin(), m_Occluders.end(),
+			[&handle](const std::pair<RenderHandle, OcclusionCuller::Mesh>& occluder) {
+				return occluder.first.Index == handle.Index && occluder.first.Generation == handle.Generation;
+			}), m_Occluders.end());
+
+		// The last item moves into the hole; everything keyed by dense index follows it.
+		if (index != last) {
+			m_SceneBVH->SetUserData(m_RenderWorld->GetCullProxy(last), index);
+			if (m_RenderWorld->GetSceneNode(last) != SceneGraph::NullNode) {
+				m_SceneGraph.SetUserData(m_RenderWorld->GetSceneNode(last), index);
+			}
+			m_Culler.SetBounds(index, m_Culler.GetBounds(last));
+			m_Culler.SetSphere(index, m_Culler.GetSphere(last));
+			m_ViewMasks[index] = m_ViewMasks[last];
+		}
+
+		MeshGeometry* geo = m_RenderWorld->GetMesh(m_RenderWorld->GetMeshIndex(index)).Geo;
+
+		m_RenderWorld->Destroy(handle);
+		m_Culler.Resize(last);
+		m_ViewMasks.resize(last);
+
+		ReleaseUnusedGeometry(geo);
+
+		// Pick instances name items by dense index; destroying is rare enough to rebuild the top level.
+		BuildInstanceBVH();
+	}
+
+	void D3DApp::ReleaseUnusedGeometry(MeshGeometry* geo) {
+		if (geo->PoolHandle == GeometryPool::InvalidHandle) return;
+
+		// The highlight only borrows the geometry of whatever was picked last.
+		const UINT highlight = m_RenderWorld->GetIndex(m_PickedItem);
+		for (UINT i = 0; i < m_RenderWorld->GetCount(); ++i) {
+			if (i != highlight && m_RenderWorld->GetMesh(m_RenderWorld->GetMeshIndex(i)).Geo == geo) return;
+		}
+
+		if (highlight != RenderWorld::NullIndex && m_RenderWorld->GetMesh(m_PickedMesh).Geo == geo) {
+			m_RenderWorld->SetFlags(highlight, 0);
+		}
+
+		for (UINT i = 0; i < m_RenderWorld->GetMeshCount(); ++i) {
+			if (m_RenderWorld->GetMesh(i).Geo == geo) {
+				m_MeshBVHs[i] = nullptr;
+			}
+		}
+
+		// The pool keeps a page the GPU may still read until the frame that last drew from it is done.
+		m_GeometryPool->Free(geo->PoolHandle);
+		geo->PoolHandle = GeometryPool::InvalidHandle;
+	}
+
+	void D3DApp::BuildSceneGraph() {
+		// Every other item is a root placed where BuildRenderItems put it. The highlight copies the
+		// World of whatever is picked and stays out of the graph.
+		const UINT highlight = m_RenderWorld->GetIndex(m_PickedItem);
+
+		for (UINT i = 0; i < m_RenderWorld->GetCount(); ++i) {
+			if (m_RenderWorld->GetSceneNode(i) != SceneGraph::NullNode || i == highlight) continue;
+
+			UINT node = m_SceneGraph.CreateNode(SceneGraph::NullNode, i);
+			m_SceneGraph.SetLocal(node, XMLoadFloat4x4(&m_RenderWorld->GetWorld(i)));
+			m_RenderWorld->SetSceneNode(i, node);
+		}
+
+		UpdateSceneGraph();
+	}
+
+	void D3DApp::BuildSceneBVH() {
+		const UINT itemCount = m_RenderWorld->GetCount();
+
+		std::vector<BoundingBox> worldBounds(itemCount);
+		std::vector<UINT> itemIndices(itemCount);
+		std::vector<int> proxies(itemCount);
+
+		BoundingVolume::TransformBoxes(m_RenderWorld->GetBoundsData(), m_RenderWorld->GetWorldData(),
+			itemCount, worldBounds.data());
+		for (UINT i = 0; i < itemCount; ++i) {
+			itemIndices[i] = i;
+		}
+
+		m_SceneBVH = std::make_unique<DynamicBVH>();
+		m_SceneBVH->Build(worldBounds.data(), itemIndices.data(), worldBounds.size(), proxies.data());
+
+		m_Culler.Resize(itemCount);
+		m_ViewMasks.resize(itemCount, 0u);
+		for (UINT i = 0; i < itemCount; ++i) {
+			BoundingSphere worldSphere;
+			m_RenderWorld->GetSphereBounds(i).Transform(worldSphere, XMLoadFloat4x4(&m_RenderWorld->GetWorld(i)));
+
+			m_Culler.SetBounds(i, worldBounds[i]);
+			m_Culler.SetSphere(i, worldSphere);
+		}
+
+		for (UINT i = 0; i < itemCount; ++i) {
+			m_RenderWorld->SetCullProxy(i, proxies[i]);
+		}
+	}
+
+	void D3DApp::BuildOccluders() {
+		m_OcclusionCuller.Initialize(gOcclusionWidth, gOcclusionHeight);
+		m_Occluders.clear();
+
+		for (UINT i = 0; i < m_RenderWorld->GetCount(); ++i) {
+			if ((m_RenderWorld->GetFlags(i) & RenderWorld::ItemOccluder) == 0) continue;
+
+			const BoundingBox& bounds = m_RenderWorld->GetBounds(i);
+
+			// Flat meshes stand in as their bounds quad. Solid ones as a box of half their extents: its
+			// corners reach sqrt(3) / 2 of the way to the bounds, well inside the faces of a tessellated
+			// sphere, where the inscribed 1/sqrt(3) box would poke out between the vertices.
+			XMFLOAT3 extents = bounds.Extents;
+			float minExtent = std::min({ extents.x, extents.y, extents.z });
+
+			if (minExtent > 1e-3f) {
+				extents = XMFLOAT3(extents.x * gOccluderShrink, extents.y * gOccluderShrink, extents.z * gOccluderShrink);
+			}
+
+			m_Occluders.emplace_back(m_RenderWorld->GetHandle(i), OcclusionCuller::BuildBoxMesh(bounds.Center, extents));
+		}
+	}
+
+	void D3DApp::BuildMeshBVHs() {
+		m_MeshBVHs.clear();
+		m_MeshBVHs.resize(m_RenderWorld->GetMeshCount());
+
+		for (UINT i = 0; i < m_RenderWorld->GetMeshCount(); ++i) {
+			const RenderWorld::Mesh& mesh = m_RenderWorld->GetMesh(i);
+
+			// The highlight's range changes with every pick.
+			if (i == m_PickedMesh) continue;
+			if (mesh.PrimitiveType != D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST) continue;
+			if (mesh.Geo->CPUVertexBuffer == nullptr || mesh.Geo->CPUIndexBuffer == nullptr) continue;
+
+			// Every vertex layout starts with its position.
+			const BYTE* vertices = (const BYTE*)mesh.Geo->CPUVertexBuffer->GetBufferPointer() +
+				(size_t)mesh.BaseVertexLocation * mesh.Geo->VertexByteStride;
+			const XMFLOAT3* positions = reinterpret_cast<const XMFLOAT3*>(vertices);
+			const void* indices = mesh.Geo->CPUIndexBuffer->GetBufferPointer();
+
+			auto bvh = std::make_unique<TriangleBVH>();
+			if (mesh.Geo->IndexFormat == DXGI_FORMAT_R32_UINT) {
+				bvh->Build(positions, mesh.Geo->VertexByteStride,
+					(const std::uint32_t*)indices + mesh.StartIndexLocation, mesh.IndexCount / 3);
+			}
+			else {
+				bvh->Build(positions, mesh.Geo->VertexByteStride,
+					(const std::uint16_t*)indices + mesh.StartIndexLocation, mesh.IndexCount / 3);
+			}
+
+			m_MeshBVHs[i] = std::move(bvh);
+		}
+	}
+
+	void D3DApp::BuildInstanceBVH() {
+		const UINT highlight = m_RenderWorld->GetIndex(m_PickedItem);
+
+		m_InstanceBVH.Clear();
+		m_PickInstances.assign(m_RenderWorld->GetCount(), (UINT)InstanceBVH::NullInstance);
+
+		// Every item draws a single instance of its mesh. The sky sphere surrounds the whole scene and the
+		// debug quad sits in screen space, so neither is something a ray or a query can meet.
+		for (UINT i = 0; i < m_RenderWorld->GetCount(); ++i) {
+			const TriangleBVH* bvh = m_MeshBVHs[m_RenderWorld->GetMeshIndex(i)].get();
+			if (bvh == nullptr || i == highlight) continue;
+
+			const UINT layer = m_RenderWorld->GetLayer(i);
+			if (layer == (UINT)RenderLayer::Sky || layer == (UINT)RenderLayer::Debug) continue;
+
+			m_PickInstances[i] = m_InstanceBVH.AddInstance(bvh, XMLoadFloat4x4(&m_RenderWorld->GetWorld(i)), i, 0);
+		}
+
+		m_InstanceBVH.Build();
 	}
 
 	void D3DApp::BuildDescriptorHeaps() {
 		D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
 		srvHeapDesc.NodeMask = 0;
-		srvHeapDesc.NumDescriptors = 8;
+		srvHeapDesc.NumDescriptors = 9;
 		srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 		srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 
@@ -1477,6 +1953,7 @@ namespace Mawi1e {
 		m_ShadowMapIndex = m_SnowCubeMapTextureIndex + 1;
 		mNullCubeSrvIndex = m_ShadowMapIndex + 1;
 		mNullTexSrvIndex = mNullCubeSrvIndex + 1;
+		m_TerrainHeightSrvIndex = mNullTexSrvIndex + 1;
 
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
 		srvDesc.TextureCube.MostDetailedMip = 0;
@@ -1609,6 +2086,17 @@ namespace Mawi1e {
 		m_Materials["planeWall1"] = std::move(planeW);
 		m_Materials["planeWall2"] = std::move(planeW2);
 		m_Materials["bricks0"] = std::move(bricks0);
+
+		auto terrain = std::make_unique<Material>();
+		terrain->Name = "terrain";
+		terrain->DiffuseAlbedo = XMFLOAT4(0.45f, 0.6f, 0.3f, 1.0f);
+		terrain->FresnelR0 = XMFLOAT3(0.01f, 0.01f, 0.01f);
+		terrain->Roughness = 0.9f;
+		terrain->MatCBIndex = CBIndex++;
+		terrain->DiffuseSrvHeapIndex = 0;
+		terrain->NormalSrvHeapIndex = -1;
+
+		m_Materials["terrain"] = std::move(terrain);
 	}
 
 	void D3DApp::BuildShapeGeometry() {
@@ -1618,32 +2106,25 @@ namespace Mawi1e {
 		std::vector<Vertex> vertices(grid.Vertices.size());
 		std::vector<std::uint16_t> indices = grid.GetIndices16();
 
-		XMFLOAT3 _maxVec(-FLT_MAX, -FLT_MAX, -FLT_MAX);
-		XMFLOAT3 _minVec(FLT_MAX, FLT_MAX, FLT_MAX);
-
-		XMVECTOR maxVec = XMLoadFloat3(&_maxVec);
-		XMVECTOR minVec = XMLoadFloat3(&_minVec);
-
 		for (size_t i = 0; i < grid.Vertices.size(); ++i) {
 			vertices[i].Pos = grid.Vertices[i].Position;
 			vertices[i].Normal = grid.Vertices[i].Normal;
 			vertices[i].TexC = grid.Vertices[i].TexC;
-			vertices[i].Tangent = grid.Vertices[i].TangentU;
-
-			maxVec = XMVectorMax(XMLoadFloat3(&vertices[i].Pos), maxVec);
-			minVec = XMVectorMax(XMLoadFloat3(&vertices[i].Pos), minVec);
+			vertices[i].Tangent = XMFLOAT4(grid.Vertices[i].TangentU.x, grid.Vertices[i].TangentU.y, grid.Vertices[i].TangentU.z, 1.0f);
 		}
 
 		UINT verticesSize = sizeof(Vertex) * (UINT)vertices.size();
 		UINT indicesSize = sizeof(std::uint16_t) * (UINT)indices.size();
 
 		auto meshGeo = std::make_unique<MeshGeometry>();
-		D3DCreateBlob(verticesSize, &meshGeo->CPUVertexBuffer);
-		D3DCreateBlob(indicesSize, &meshGeo->CPUIndexBuffer);
-		meshGeo->GPUVertexBuffer = VertexBuffer::CreateDefaultBuffer(m_Device.Get(), m_CommandList.Get(),
-			vertices.data(), verticesSize, meshGeo->GPUVertexUploader);
-		meshGeo->GPUIndexBuffer = VertexBuffer::CreateDefaultBuffer(m_Device.Get(), m_CommandList.Get(),
-			indices.data(), indicesSize, meshGeo->GPUIndexUploader);
+		THROWFAILEDIF("@@@ Error: D3DCreateBlob", D3DCreateBlob(verticesSize, &meshGeo->CPUVertexBuffer));
+		CopyMemory(meshGeo->CPUVertexBuffer->GetBufferPointer(), vertices.data(), verticesSize);
+
+		THROWFAILEDIF("@@@ Error: D3DCreateBlob", D3DCreateBlob(indicesSize, &meshGeo->CPUIndexBuffer));
+		CopyMemory(meshGeo->CPUIndexBuffer->GetBufferPointer(), indices.data(), indicesSize);
+
+		meshGeo->PoolHandle = m_GeometryPool->Upload(m_CommandList.Get(),
+			vertices.data(), (UINT)vertices.size(), indices.data(), (UINT)indices.size());
 
 		meshGeo->IndexBufferByteSize = indicesSize;
 		meshGeo->IndexFormat = DXGI_FORMAT_R16_UINT;
@@ -1655,10 +2136,7 @@ namespace Mawi1e {
 		subMeshGeo.IndexCount = (UINT)indices.size();
 		subMeshGeo.BaseVertexLocation = 0;
 		subMeshGeo.StartIndexLocation = 0;
-
-		BoundingBox bBox;
-		XMStoreFloat3(&bBox.Extents, 0.5f * (maxVec - minVec));
-		XMStoreFloat3(&bBox.Center, 0.5f * (maxVec + minVec));
+		BoundingVolume::Compute(subMeshGeo, vertices.data(), vertices.size());
 
 		meshGeo->DrawArgs["grid"] = subMeshGeo;
 		m_DrawArgs[meshGeo->Name] = std::move(meshGeo);
@@ -1671,31 +2149,24 @@ namespace Mawi1e {
 		std::vector<Vertex> vertices(sphere.Vertices.size());
 		std::vector<std::uint16_t> indices = sphere.GetIndices16();
 
-		XMFLOAT3 _maxVec(-FLT_MAX, -FLT_MAX, -FLT_MAX);
-		XMFLOAT3 _minVec(FLT_MAX, FLT_MAX, FLT_MAX);
-
-		XMVECTOR maxVec = XMLoadFloat3(&_maxVec);
-		XMVECTOR minVec = XMLoadFloat3(&_minVec);
-
 		for (size_t i = 0; i < sphere.Vertices.size(); ++i) {
 			vertices[i].Pos = sphere.Vertices[i].Position;
 			vertices[i].Normal = sphere.Vertices[i].Normal;
 			vertices[i].TexC = sphere.Vertices[i].TexC;
-
-			maxVec = XMVectorMax(XMLoadFloat3(&vertices[i].Pos), maxVec);
-			minVec = XMVectorMax(XMLoadFloat3(&vertices[i].Pos), minVec);
 		}
 
 		UINT verticesSize = sizeof(Vertex) * (UINT)vertices.size();
 		UINT indicesSize = sizeof(std::uint16_t) * (UINT)indices.size();
 
 		auto meshGeo = std::make_unique<MeshGeometry>();
-		D3DCreateBlob(verticesSize, &meshGeo->CPUVertexBuffer);
-		D3DCreateBlob(indicesSize, &meshGeo->CPUIndexBuffer);
-		meshGeo->GPUVertexBuffer = VertexBuffer::CreateDefaultBuffer(m_Device.Get(), m_CommandList.Get(),
-			vertices.data(), verticesSize, meshGeo->GPUVertexUploader);
-		meshGeo->GPUIndexBuffer = VertexBuffer::CreateDefaultBuffer(m_Device.Get(), m_CommandList.Get(),
-			indices.data(), indicesSize, meshGeo->GPUIndexUploader);
+		THROWFAILEDIF("@@@ Error: D3DCreateBlob", D3DCreateBlob(verticesSize, &meshGeo->CPUVertexBuffer));
+		CopyMemory(meshGeo->CPUVertexBuffer->GetBufferPointer(), vertices.data(), verticesSize);
+
+		THROWFAILEDIF("@@@ Error: D3DCreateBlob", D3DCreateBlob(indicesSize, &meshGeo->CPUIndexBuffer));
+		CopyMemory(meshGeo->CPUIndexBuffer->GetBufferPointer(), indices.data(), indicesSize);
+
+		meshGeo->PoolHandle = m_GeometryPool->Upload(m_CommandList.Get(),
+			vertices.data(), (UINT)vertices.size(), indices.data(), (UINT)indices.size());
 
 		meshGeo->IndexBufferByteSize = indicesSize;
 		meshGeo->IndexFormat = DXGI_FORMAT_R16_UINT;
@@ -1707,10 +2178,7 @@ namespace Mawi1e {
 		subMeshGeo.IndexCount = (UINT)indices.size();
 		subMeshGeo.BaseVertexLocation = 0;
 		subMeshGeo.StartIndexLocation = 0;
-
-		BoundingBox bBox;
-		XMStoreFloat3(&bBox.Extents, 0.5f * (maxVec - minVec));
-		XMStoreFloat3(&bBox.Center, 0.5f * (maxVec + minVec));
+		BoundingVolume::Compute(subMeshGeo, vertices.data(), vertices.size());
 
 		meshGeo->DrawArgs["sphere"] = subMeshGeo;
 		m_DrawArgs[meshGeo->Name] = std::move(meshGeo);
@@ -1733,12 +2201,14 @@ namespace Mawi1e {
 		UINT indicesSize = sizeof(std::uint16_t) * (UINT)indices.size();
 
 		auto meshGeo = std::make_unique<MeshGeometry>();
-		D3DCreateBlob(verticesSize, &meshGeo->CPUVertexBuffer);
-		D3DCreateBlob(indicesSize, &meshGeo->CPUIndexBuffer);
-		meshGeo->GPUVertexBuffer = VertexBuffer::CreateDefaultBuffer(m_Device.Get(), m_CommandList.Get(),
-			vertices.data(), verticesSize, meshGeo->GPUVertexUploader);
-		meshGeo->GPUIndexBuffer = VertexBuffer::CreateDefaultBuffer(m_Device.Get(), m_CommandList.Get(),
-			indices.data(), indicesSize, meshGeo->GPUIndexUploader);
+		THROWFAILEDIF("@@@ Error: D3DCreateBlob", D3DCreateBlob(verticesSize, &meshGeo->CPUVertexBuffer));
+		CopyMemory(meshGeo->CPUVertexBuffer->GetBufferPointer(), vertices.data(), verticesSize);
+
+		THROWFAILEDIF("@@@ Error: D3DCreateBlob", D3DCreateBlob(indicesSize, &meshGeo->CPUIndexBuffer));
+		CopyMemory(meshGeo->CPUIndexBuffer->GetBufferPointer(), indices.data(), indicesSize);
+
+		meshGeo->PoolHandle = m_GeometryPool->Upload(m_CommandList.Get(),
+			vertices.data(), (UINT)vertices.size(), indices.data(), (UINT)indices.size());
 
 		meshGeo->IndexBufferByteSize = indicesSize;
 		meshGeo->IndexFormat = DXGI_FORMAT_R16_UINT;
@@ -1750,28 +2220,224 @@ namespace Mawi1e {
 		subMeshGeo.IndexCount = (UINT)indices.size();
 		subMeshGeo.BaseVertexLocation = 0;
 		subMeshGeo.StartIndexLocation = 0;
+		BoundingVolume::Compute(subMeshGeo, vertices.data(), vertices.size());
 
 		meshGeo->DrawArgs["quad"] = subMeshGeo;
 		m_DrawArgs[meshGeo->Name] = std::move(meshGeo);
 	}
 
-	void D3DApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& rItem) {
-		auto currInstanceBuf = m_CurrFrameResource->m_InstCB->Resource();
-		UINT objSize = VertexBuffer::CalcConstantBufferSize(sizeof(InstanceConstants));
+	void D3DApp::BuildCrowd() {
+		const float height = 4.0f;
+		const float segment = height / (float)(gCrowdBoneCount - 1);
+
+		// A chain up the middle of a tapered cylinder, rooted at its base. The cylinder is centred on
+		// its origin, so in the bind pose bone b sits at y = -height / 2 + b * segment.
+		m_CrowdSkeleton.Clear();
+		for (UINT bone = 0; bone < gCrowdBoneCount; ++bone) {
+			const float y = -0.5f * height + (float)bone * segment;
+			m_CrowdSkeleton.AddBone((bone == 0) ? Skeleton::NullBone : bone - 1, XMMatrixTranslation(0.0f, -y, 0.0f));
+		}
+
+		// Two loops, a sway and a slower nod. Each joint lags the one below it, so a wave runs up
+		// the chain.
+		const XMVECTOR axes[] = { XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) };
+		const float periods[] = { 2.0f, 3.0f };
+		const UINT keyCount = 17;
+
+		m_CrowdAnimation.Initialize(&m_CrowdSkeleton, BakedAnimation::FormatHalf);
+
+		for (UINT c = 0; c < _countof(periods); ++c) {
+			AnimationClip clip;
+			clip.boneAnimations.resize(gCrowdBoneCount);
+
+			for (UINT bone = 0; bone < gCrowdBoneCount; ++bone) {
+				BoneAnimation& boneAnimation = clip.boneAnimations[bone];
+				boneAnimation.keyFrames.resize(keyCount);
+
+				for (UINT key = 0; key < keyCount; ++key) {
+					const float phase = XM_2PI * (float)key / (float)(keyCount - 1);
+
+					Keyframe& keyFrame = boneAnimation.keyFrames[key];
+					keyFrame.TimePos = periods[c] * (float)key / (float)(keyCount - 1);
+					keyFrame.Translation = (bone == 0) ? XMFLOAT3(0.0f, -0.5f * height, 0.0f) : XMFLOAT3(0.0f, segment, 0.0f);
+					XMStoreFloat4(&keyFrame.RotationQuat, XMQuaternionRotationAxis(axes[c], 0.3f * sinf(phase - 0.8f * (float)bone)));
+				}
+			}
+
+			clip.BuildTimeTables();
+			m_CrowdAnimation.AddClip(clip);
+		}
+
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.4f, 0.1f, height, 12, 16);
+
+		std::vector<Vertex> vertices(cylinder.Vertices.size());
+		std::vector<SkinInfluence> influences(cylinder.Vertices.size());
+		std::vector<std::uint16_t> indices = cylinder.GetIndices16();
+
+		for (size_t i = 0; i < cylinder.Vertices.size(); ++i) {
+			vertices[i].Pos = cylinder.Vertices[i].Position;
+			vertices[i].Normal = cylinder.Vertices[i].Normal;
+			vertices[i].TexC = cylinder.Vertices[i].TexC;
+			vertices[i].Tangent = XMFLOAT4(cylinder.Vertices[i].TangentU.x, cylinder.Vertices[i].TangentU.y, cylinder.Vertices[i].TangentU.z, 1.0f);
+
+			// Each vertex follows the two bones either side of it.
+			const float t = Clamp((vertices[i].Pos.y + 0.5f * height) / segment, 0.0f, (float)(gCrowdBoneCount - 1));
+			const UINT bone = (std::min)((UINT)t, gCrowdBoneCount - 2);
+
+			influences[i].Weights[0] = 1.0f - (t - (float)bone);
+			influences[i].Weights[1] = t - (float)bone;
+			influences[i].Bones[0] = (UINT8)bone;
+			influences[i].Bones[1] = (UINT8)(bone + 1);
+		}
+
+		const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+		const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+
+		// The pose only exists on the GPU, so there is no CPU copy to pick against.
+		auto geo = std::make_unique<MeshGeometry>();
+		geo->Name = "crowdGeo";
+		geo->GPUVertexBuffer = VertexBuffer::CreateDefaultBuffer(m_Device.Get(), m_CommandList.Get(),
+			vertices.data(), vbByteSize, geo->GPUVertexUploader);
+		geo->GPUIndexBuffer = VertexBuffer::CreateDefaultBuffer(m_Device.Get(), m_CommandList.Get(),
+			indices.data(), ibByteSize, geo->GPUIndexUploader);
+		geo->VertexByteStride = sizeof(Vertex);
+		geo->VertexBufferByteSize = vbByteSize;
+		geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+		geo->IndexBufferByteSize = ibByteSize;
+
+		m_CrowdInfluences = VertexBuffer::CreateDefaultBuffer(m_Device.Get(), m_CommandList.Get(),
+			influences.data(), (UINT64)influences.size() * sizeof(SkinInfluence), m_CrowdInfluenceUploader);
+
+		SubMeshGeometry submesh;
+		submesh.IndexCount = (UINT)indices.size();
+		submesh.StartIndexLocation = 0;
+		submesh.BaseVertexLocation = 0;
+		BoundingVolume::Compute(submesh, vertices.data(), vertices.size());
+
+		// Culling sees the mesh bounds only, so they have to hold every baked frame. Between two frames
+		// the shader blends matrices linearly, which keeps every vertex between its two posed positions.
+		std::vector<XMFLOAT4X4> palette(gCrowdBoneCount);
+		std::vector<Vertex> posed(vertices.size());
+
+		XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+		XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+
+		for (UINT c = 0; c < m_CrowdAnimation.GetClipCount(); ++c) {
+			const BakedAnimation::ClipInfo& info = m_CrowdAnimation.GetClip(c);
+
+			for (UINT frame = 0; frame < info.FrameCount; ++frame) {
+				m_CrowdAnimation.Sample(c, info.Duration * (float)frame / (float)(info.FrameCount - 1), palette.data());
+				Skinning::Skin(palette.data(), vertices.data(), influences.data(), vertices.size(), posed.data());
+
+				for (const Vertex& vertex : posed) {
+					XMVECTOR P = XMLoadFloat3(&vertex.Pos);
+					boundsMin = XMVectorMin(boundsMin, P);
+					boundsMax = XMVectorMax(boundsMax, P);
+				}
+			}
+		}
+
+		BoundingBox::CreateFromPoints(submesh.Bounds, boundsMin, boundsMax);
+		BoundingSphere::CreateFromBoundingBox(submesh.SphereBounds, submesh.Bounds);
+
+		geo->DrawArgs["tentacle"] = submesh;
+
+		RenderWorld::Mesh mesh;
+		mesh.Geo = geo.get();
+		mesh.PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mesh.IndexCount = submesh.IndexCount;
+		mesh.StartIndexLocation = submesh.StartIndexLocation;
+		mesh.BaseVertexLocation = submesh.BaseVertexLocation;
+		mesh.Bounds = submesh.Bounds;
+		mesh.SphereBounds = submesh.SphereBounds;
+		m_CrowdMesh = m_RenderWorld->AddMesh(mesh);
+
+		m_DrawArgs[geo->Name] = std::move(geo);
+
+		// A field of them on the first wall grid, each with its own clip and its own place in it.
+		std::vector<RenderHandle> members;
+		for (UINT row = 0; row < gCrowdSide; ++row) {
+			for (UINT column = 0; column < gCrowdSide; ++column) {
+				const float x = ((float)column - 0.5f * (float)(gCrowdSide - 1)) * gCrowdSpacing;
+				const float z = ((float)row - 0.5f * (float)(gCrowdSide - 1)) * gCrowdSpacing;
+
+				RenderWorld::ItemDesc MemberDesc;
+				XMStoreFloat4x4(&MemberDesc.World, XMMatrixTranslation(x, -15.0f + 0.5f * height, z));
+				MemberDesc.Mesh = m_CrowdMesh;
+				MemberDesc.Material = m_Materials["bricks0"]->MatCBIndex;
+				MemberDesc.Layer = (UINT)RenderLayer::Crowd;
+
+				members.push_back(m_RenderWorld->Create(MemberDesc));
+			}
+		}
+
+		std::vector<BakedInstance> bakedInstances(m_RenderWorld->GetSlotCapacity());
+		for (size_t i = 0; i < members.size(); ++i) {
+			BakedInstance& bakedInstance = bakedInstances[m_RenderWorld->GetInstanceSlot(m_RenderWorld->GetIndex(members[i]))];
+			bakedInstance.Clip = (UINT)i % m_CrowdAnimation.GetClipCount();
+			bakedInstance.TimeOffset = RandF(0.0f, m_CrowdAnimation.GetClip(bakedInstance.Clip).Duration);
+		}
+
+		m_CrowdAnimation.Upload(m_Device.Get(), m_CommandList.Get());
+		m_BakedInstanceBuffer = VertexBuffer::CreateDefaultBuffer(m_Device.Get(), m_CommandList.Get(),
+			bakedInstances.data(), (UINT64)bakedInstances.size() * sizeof(BakedInstance), m_BakedInstanceUploader);
+	}
+
+	void D3DApp::CopyInstanceUpdates() {
+		if (m_InstanceCopies.empty()) return;
+
+		auto uploads = m_CurrFrameResource->m_InstanceUploads->Resource();
+		const UINT64 stride = sizeof(PackedInstance);
+
+		// The buffer decays to COMMON after every frame; the first copy promotes it to COPY_DEST, and
+		// frames without copies promote it straight to a shader resource.
+		UINT64 uploadOffset = 0;
+		for (const auto& copy : m_InstanceCopies) {
+			m_CommandList->CopyBufferRegion(m_InstanceBuffer.Get(), copy.first * stride,
+				uploads, uploadOffset, copy.second * stride);
+			uploadOffset += copy.second * stride;
+		}
+
+		m_CommandList->ResourceBarrier(1, &My_unmove(CD3DX12_RESOURCE_BARRIER::Transition(
+			m_InstanceBuffer.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+		)));
+	}
+
+	void D3DApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, UINT view, RenderLayer layer) {
+		const std::vector<UINT>& rItem = m_ViewLayers[view][(int)layer];
+		const D3D12_GPU_VIRTUAL_ADDRESS visibleSlots = m_CurrFrameResource->m_VisibleSlots->Resource()->GetGPUVirtualAddress() +
+			(UINT64)m_ViewLayerOffsets[view][(int)layer] * sizeof(UINT);
+
+		// Items sharing a pool page (all static meshes, usually) keep the IA bindings of the previous draw.
+		UINT boundPage = UINT_MAX;
+		D3D12_PRIMITIVE_TOPOLOGY boundTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
 
 		for (size_t i = 0; i < rItem.size(); ++i) {
-			auto ri = rItem[i];
+			UINT index = rItem[i];
 
-			if (ri->Visible == false) continue;
+			if ((m_RenderWorld->GetFlags(index) & RenderWorld::ItemVisible) == 0) continue;
 
-			cmdList->IASetVertexBuffers(0, 1, &My_unmove(ri->Geo->VertexBufferView()));
-			cmdList->IASetIndexBuffer(&My_unmove(ri->Geo->IndexBufferView()));
-			cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+			const RenderWorld::Mesh& mesh = m_RenderWorld->GetMesh(m_RenderWorld->GetMeshIndex(index));
+			const GeometryPool::Range& range = m_GeometryPool->GetRange(mesh.Geo->PoolHandle);
 
-			cmdList->SetGraphicsRootShaderResourceView(0, currInstanceBuf->GetGPUVirtualAddress() + objSize * ri->InstanceCount);
+			if (range.Page != boundPage) {
+				cmdList->IASetVertexBuffers(0, 1, &My_unmove(m_GeometryPool->GetVertexBufferView(range.Page)));
+				cmdList->IASetIndexBuffer(&My_unmove(m_GeometryPool->GetIndexBufferView(range.Page)));
+				boundPage = range.Page;
+			}
+
+			if (mesh.PrimitiveType != boundTopology) {
+				cmdList->IASetPrimitiveTopology(mesh.PrimitiveType);
+				boundTopology = mesh.PrimitiveType;
+			}
 
-			cmdList->DrawIndexedInstanced(ri->IndexCount, 1,
-				ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+			cmdList->SetGraphicsRootShaderResourceView(0, visibleSlots + i * sizeof(UINT));
+
+			cmdList->DrawIndexedInstanced(mesh.IndexCount, 1,
+				range.StartIndexLocation + mesh.StartIndexLocation, range.BaseVertexLocation + mesh.BaseVertexLocation, 0);
 		}
 	}
 
@@ -1801,12 +2467,12 @@ namespace Mawi1e {
 			D3D12_GPU_VIRTUAL_ADDRESS passGpuVirtualAddress = pass->GetGPUVirtualAddress() + (i + 1) * passCstSize;
 			m_CommandList->SetGraphicsRootConstantBufferView(1, passGpuVirtualAddress);
 
-			DrawRenderItems(m_CommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+			DrawRenderItems(m_CommandList.Get(), gCubeFaceCullView + i, RenderLayer::Opaque);
 
-			DrawRenderItems(m_CommandList.Get(), mRitemLayer[(int)RenderLayer::Skull]);
+			DrawRenderItems(m_CommandList.Get(), gCubeFaceCullView + i, RenderLayer::Skull);
 			
 			m_CommandList->SetPipelineState(m_PSOs["sky"].Get());
-			DrawRenderItems(m_CommandList.Get(), mRitemLayer[(int)RenderLayer::Sky]);
+			DrawRenderItems(m_CommandList.Get(), gCubeFaceCullView + i, RenderLayer::Sky);
 
 			m_CommandList->SetPipelineState(m_PSOs["opaque"].Get());
 		}
@@ -1838,8 +2504,11 @@ namespace Mawi1e {
 		m_CommandList->SetGraphicsRootConstantBufferView(1, passGpuVirtualAddress);
 
 		m_CommandList->SetPipelineState(m_PSOs["shadow_opaque"].Get());
-		DrawRenderItems(m_CommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
-		DrawRenderItems(m_CommandList.Get(), mRitemLayer[(int)RenderLayer::Skull]);
+		DrawRenderItems(m_CommandList.Get(), gShadowCullView, RenderLayer::Opaque);
+		DrawRenderItems(m_CommandList.Get(), gShadowCullView, RenderLayer::Skull);
+
+		m_CommandList->SetPipelineState(m_PSOs["shadow_skinned"].Get());
+		DrawCrowd(m_CommandList.Get(), gShadowCullView);
 
 		m_CommandList->ResourceBarrier(1, &My_unmove(CD3DX12_RESOURCE_BARRIER::Transition(
 			m_ShadowMap->Resource(),
@@ -1848,21 +2517,129 @@ namespace Mawi1e {
 		)));
 	}
 
+	void D3DApp::DrawCrowd(ID3D12GraphicsCommandList* cmdList, UINT view) {
+		const std::vector<UINT>& rItem = m_ViewLayers[view][(int)RenderLayer::Crowd];
+		if (rItem.empty()) return;
+
+		const D3D12_GPU_VIRTUAL_ADDRESS visibleSlots = m_CurrFrameResource->m_VisibleSlots->Resource()->GetGPUVirtualAddress() +
+			(UINT64)m_ViewLayerOffsets[view][(int)RenderLayer::Crowd] * sizeof(UINT);
+
+		const RenderWorld::Mesh& mesh = m_RenderWorld->GetMesh(m_CrowdMesh);
+
+		D3D12_VERTEX_BUFFER_VIEW vertexBufferViews[2] = { mesh.Geo->VertexBufferView(), {} };
+		vertexBufferViews[1].BufferLocation = m_CrowdInfluences->GetGPUVirtualAddress();
+		vertexBufferViews[1].SizeInBytes = mesh.Geo->VertexBufferByteSize / mesh.Geo->VertexByteStride * sizeof(SkinInfluence);
+		vertexBufferViews[1].StrideInBytes = sizeof(SkinInfluence);
+
+		cmdList->IASetVertexBuffers(0, 2, vertexBufferViews);
+		cmdList->IASetIndexBuffer(&My_unmove(mesh.Geo->IndexBufferView()));
+		cmdList->IASetPrimitiveTopology(mesh.PrimitiveType);
+
+		// Every member draws the same mesh, so each run of visible members is one instanced draw.
+		size_t first = 0;
+		while (first < rItem.size()) {
+			if ((m_RenderWorld->GetFlags(rItem[first]) & RenderWorld::ItemVisible) == 0) {
+				++first;
+				continue;
+			}
+
+			size_t last = first + 1;
+			while (last < rItem.size() && (m_RenderWorld->GetFlags(rItem[last]) & RenderWorld::ItemVisible) != 0) {
+				++last;
+			}
+
+			cmdList->SetGraphicsRootShaderResourceView(0, visibleSlots + first * sizeof(UINT));
+			cmdList->DrawIndexedInstanced(mesh.IndexCount, (UINT)(last - first),
+				mesh.StartIndexLocation, mesh.BaseVertexLocation, 0);
+
+			first = last;
+		}
+	}
+
 	float D3DApp::GetHillsHeight(float x, float z) const {
-		return 0.3f * (z * sinf(0.1f * x) + x * cosf(0.1f * z));
+		return m_Hills.GetHeight(x, z);
 	}
 
 	XMFLOAT3 D3DApp::GetHillsNormal(float x, float z) const {
-		// n = (-df/dx, 1, -df/dz)
-		XMFLOAT3 n(
-			-0.03f * z * cosf(0.1f * x) - 0.3f * cosf(0.1f * z),
-			1.0f,
-			-0.3f * sinf(0.1f * x) + 0.03f * x * sinf(0.1f * z));
+		return m_Hills.GetNormal(x, z);
+	}
+
+	void D3DApp::BuildTerrain() {
+		Terrain::Settings settings;
+		settings.BaseHeight = -60.0f;
+		settings.MaterialIndex = m_Materials["terrain"]->MatCBIndex;
+
+		m_Terrain = std::make_unique<Terrain>();
+		m_Terrain->Initialize(settings, &m_Hills);
+		m_Terrain->UploadHeights(m_Device.Get(), m_CommandList.Get(), CD3DX12_CPU_DESCRIPTOR_HANDLE(
+			m_SrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), m_TerrainHeightSrvIndex, m_CbvSize));
+
+		std::vector<Vertex> vertices;
+		std::vector<std::uint16_t> indices;
+		m_Terrain->BuildGridMesh(vertices, indices);
+
+		UINT verticesSize = sizeof(Vertex) * (UINT)vertices.size();
+		UINT indicesSize = sizeof(std::uint16_t) * (UINT)indices.size();
 
-		XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
-		XMStoreFloat3(&n, unitNormal);
+		// The patch grid is flat until the VS displaces it, so it keeps no CPU copy to pick against.
+		auto meshGeo = std::make_unique<MeshGeometry>();
+		meshGeo->PoolHandle = m_GeometryPool->Upload(m_CommandList.Get(),
+			vertices.data(), (UINT)vertices.size(), indices.data(), (UINT)indices.size());
+
+		meshGeo->IndexBufferByteSize = indicesSize;
+		meshGeo->IndexFormat = DXGI_FORMAT_R16_UINT;
+		meshGeo->VertexByteStride = sizeof(Vertex);
+		meshGeo->VertexBufferByteSize = verticesSize;
+		meshGeo->Name = "terrainGeo";
 
-		return n;
+		SubMeshGeometry subMeshGeo;
+		subMeshGeo.IndexCount = (UINT)indices.size();
+		subMeshGeo.BaseVertexLocation = 0;
+		subMeshGeo.StartIndexLocation = 0;
+		BoundingVolume::Compute(subMeshGeo, vertices.data(), vertices.size());
+
+		meshGeo->DrawArgs["patch"] = subMeshGeo;
+		m_DrawArgs[meshGeo->Name] = std::move(meshGeo);
+	}
+
+	void D3DApp::UpdateTerrainPatches() {
+		XMMATRIX view = XMLoadFloat4x4(&My_unmove(m_Camera.GetViewMatrix()));
+		XMMATRIX invView = XMMatrixInverse(&My_unmove(XMMatrixDeterminant(view)), view);
+
+		BoundingFrustum frustumW;
+		m_LocalProjFrustum.Transform(frustumW, invView);
+
+		m_Terrain->Select(m_Camera.GetPosition(), frustumW);
+
+		auto currTerrainVB = m_CurrFrameResource->m_TerrainVB.get();
+		const auto& patches = m_Terrain->GetPatches();
+
+		for (size_t i = 0; i < patches.size(); ++i) {
+			currTerrainVB->CopyData((UINT)i, patches[i]);
+		}
+	}
+
+	void D3DApp::DrawTerrain(ID3D12GraphicsCommandList* cmdList) {
+		const auto& patches = m_Terrain->GetPatches();
+		if (patches.empty()) return;
+
+		auto geo = m_DrawArgs["terrainGeo"].get();
+		const SubMeshGeometry& patch = geo->DrawArgs["patch"];
+
+		cmdList->SetPipelineState(m_IsWireFrames ? m_PSOs["terrain_wireframe"].Get() : m_PSOs["terrain"].Get());
+
+		const GeometryPool::Range& range = m_GeometryPool->GetRange(geo->PoolHandle);
+
+		cmdList->IASetVertexBuffers(0, 1, &My_unmove(m_GeometryPool->GetVertexBufferView(range.Page)));
+		cmdList->IASetIndexBuffer(&My_unmove(m_GeometryPool->GetIndexBufferView(range.Page)));
+		cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+		cmdList->SetGraphicsRootShaderResourceView(5, m_CurrFrameResource->m_TerrainVB->Resource()->GetGPUVirtualAddress());
+		cmdList->SetGraphicsRootDescriptorTable(7, CD3DX12_GPU_DESCRIPTOR_HANDLE(
+			m_SrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), m_TerrainHeightSrvIndex, m_CbvSize));
+
+		cmdList->DrawIndexedInstanced(patch.IndexCount, (UINT)patches.size(),
+			range.StartIndexLocation + patch.StartIndexLocation, range.BaseVertexLocation + patch.BaseVertexLocation, 0);
 	}
 
 	LRESULT D3DApp::MessageHandler(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp) {
@@ -1953,6 +2730,12 @@ namespace Mawi1e {
 			if (wp == VK_ESCAPE) {
 				PostQuitMessage(0);
 			}
+			else if (wp == VK_DELETE && m_RenderWorld != nullptr && m_RenderWorld->IsAlive(m_PickTarget)) {
+				// The highlight goes with the item it sits on.
+				m_RenderWorld->SetFlags(m_RenderWorld->GetIndex(m_PickedItem), 0);
+				DestroyRenderItem(m_PickTarget);
+				m_PickTarget = RenderHandle();
+			}
 			return 0;
 		case WM_DESTROY:
 			PostQuitMessage(0);
@@ -1969,6 +2752,10 @@ namespace Mawi1e {
 		return m_D3DApp;
 	}
 
+	SceneQuery& D3DApp::GetSceneQuery() {
+		return m_SceneQuery;
+	}
+
 	void D3DApp::Pick(int sx, int sy) {
 		XMFLOAT4X4 P = m_Camera.GetProjectionMatrix();
 		XMMATRIX V = XMLoadFloat4x4(&My_unmove(m_Camera.GetViewMatrix()));
@@ -1977,76 +2764,64 @@ namespace Mawi1e {
 		float cx = ((2.0f * sx) / m_d3dSettings.screenWidth - 1.0f) / P(0, 0);
 		float cy = ((-2.0f * sy) / m_d3dSettings.screenHeight + 1.0f) / P(1, 1);
 
-		XMVECTOR rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMVECTOR rayDir = XMVectorSet(cx, cy, 1.0f, 0.0f);
-
-		m_PickedItem->Visible = false;
-
-		for (auto& e : mRitemLayer[(int)RenderLayer::Skull]) {
-			XMMATRIX W = XMLoadFloat4x4(&My_unmove(e->World));
-			XMMATRIX invWorld = XMMatrixInverse(&My_unmove(XMMatrixDeterminant(W)), W);
-			XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
-
-			rayOrigin = XMVector3TransformCoord(rayOrigin, toLocal);
-			rayDir = XMVector3TransformNormal(rayDir, toLocal);
-			rayDir = XMVector3Normalize(rayDir);
+		// The view space ray goes to world space once; every item takes it on to its own space.
+		XMVECTOR rayOrigin = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), invView);
+		XMVECTOR rayDir = XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(cx, cy, 1.0f, 0.0f), invView));
 
-			float fMax = 0.0f;
-			if (e->Bounds.Intersects(rayOrigin, rayDir, fMax)) {
-				auto vertices = (Vertex*)e->Geo->CPUVertexBuffer->GetBufferPointer();
-				auto indices = (uint32_t*)e->Geo->CPUIndexBuffer->GetBufferPointer();
+		const UINT picked = m_RenderWorld->GetIndex(m_PickedItem);
+		RenderWorld::Mesh& pickedMesh = m_RenderWorld->GetMesh(m_PickedMesh);
 
-				UINT triangleCount = e->IndexCount / 3;
+		m_RenderWorld->SetFlags(picked, 0);
 
-				fMax = FLT_MAX;
-				for (UINT i = 0; i < triangleCount; ++i) {
-					UINT i1 = indices[i * 3 + 0];
-					UINT i2 = indices[i * 3 + 1];
-					UINT i3 = indices[i * 3 + 2];
+		m_PickTarget = RenderHandle();
 
-					XMVECTOR v1 = XMLoadFloat3(&vertices[i1].Pos);
-					XMVECTOR v2 = XMLoadFloat3(&vertices[i2].Pos);
-					XMVECTOR v3 = XMLoadFloat3(&vertices[i3].Pos);
+		InstanceBVH::Hit closest;
+		if (!m_InstanceBVH.ClosestHit(rayOrigin, rayDir, FLT_MAX, closest)) return;
 
-					float fm = 0.0f;
-					if (DirectX::TriangleTests::Intersects(rayOrigin, rayDir, v1, v2, v3, fm)) {
-						if (fm < fMax) {
-							fMax = fm;
+		const UINT closestItem = closest.Item;
+		m_PickTarget = m_RenderWorld->GetHandle(closestItem);
+		const RenderWorld::Mesh& mesh = m_RenderWorld->GetMesh(m_RenderWorld->GetMeshIndex(closestItem));
 
-							UINT pickedTriangle = i;
+		pickedMesh.Geo = mesh.Geo;
+		pickedMesh.BaseVertexLocation = mesh.BaseVertexLocation;
 
-							m_PickedItem->IndexCount = 3;
-							m_PickedItem->Visible = true;
-							m_PickedItem->BaseVertexLocation = 0;
-							m_PickedItem->NumFramesDirty = gNumFrameResources;
-							m_PickedItem->StartIndexLocation = pickedTriangle * 3;
-							m_PickedItem->World = e->World;
-
-							if (m_PickingFromAll) {
-								m_PickedItem->IndexCount = e->IndexCount;
-								m_PickedItem->StartIndexLocation = 0;
-							}
-						}
-					}
-				}
+		if (m_PickingFromAll) {
+			pickedMesh.IndexCount = mesh.IndexCount;
+			pickedMesh.StartIndexLocation = mesh.StartIndexLocation;
+			pickedMesh.Bounds = mesh.Bounds;
+			pickedMesh.SphereBounds = mesh.SphereBounds;
+		}
+		else {
+			pickedMesh.IndexCount = 3;
+			pickedMesh.StartIndexLocation = mesh.StartIndexLocation + closest.Triangle * 3;
+
+			// Only the triangle is drawn, so only it is culled. Anything with a mesh BVH has its CPU copy.
+			const BYTE* vertices = (const BYTE*)mesh.Geo->CPUVertexBuffer->GetBufferPointer() +
+				(size_t)mesh.BaseVertexLocation * mesh.Geo->VertexByteStride;
+			const void* indices = mesh.Geo->CPUIndexBuffer->GetBufferPointer();
+
+			XMVECTOR corners[3];
+			for (UINT k = 0; k < 3; ++k) {
+				const UINT location = pickedMesh.StartIndexLocation + k;
+				const UINT vertex = (mesh.Geo->IndexFormat == DXGI_FORMAT_R32_UINT) ?
+					((const std::uint32_t*)indices)[location] : ((const std::uint16_t*)indices)[location];
+				corners[k] = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertices + (size_t)vertex * mesh.Geo->VertexByteStride));
 			}
+
+			BoundingBox::CreateFromPoints(pickedMesh.Bounds,
+				XMVectorMin(corners[0], XMVectorMin(corners[1], corners[2])),
+				XMVectorMax(corners[0], XMVectorMax(corners[1], corners[2])));
+			BoundingSphere::CreateFromBoundingBox(pickedMesh.SphereBounds, pickedMesh.Bounds);
 		}
+
+		// The item keeps its own copy of the mesh bounds; the refit moves its proxy and culler box.
+		m_RenderWorld->SetBounds(picked, pickedMesh.Bounds, pickedMesh.SphereBounds);
+		m_RenderWorld->SetFlags(picked, RenderWorld::ItemVisible);
+		m_RenderWorld->SetWorld(picked, m_RenderWorld->GetWorld(closestItem));
 	}
 
 	void D3DApp::GetBoundingBoxFromVertex(BoundingBox& bBox, const std::vector<Vertex>& vertices) {
-		DirectX::XMFLOAT3 fvecMin(FLT_MAX, FLT_MAX, FLT_MAX);
-		DirectX::XMFLOAT3 fvecMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
-
-		DirectX::XMVECTOR vecMin = DirectX::XMLoadFloat3(&fvecMin);
-		DirectX::XMVECTOR vecMax = DirectX::XMLoadFloat3(&fvecMin);
-
-		for (size_t i = 0; i < vertices.size(); ++i) {
-			DirectX::XMVectorMin(DirectX::XMLoadFloat3(&vertices[i].Pos), vecMin);
-			DirectX::XMVectorMax(DirectX::XMLoadFloat3(&vertices[i].Pos), vecMax);
-		}
-
-		DirectX::XMStoreFloat3(&bBox.Center, 0.5f * (vecMax + vecMin));
-		DirectX::XMStoreFloat3(&bBox.Extents, 0.5f * (vecMax - vecMin));
+		bBox = BoundingVolume::CreateBox(vertices);
 	}
 
 	void D3DApp::MouseDown(WPARAM btnState, int x, int y) {
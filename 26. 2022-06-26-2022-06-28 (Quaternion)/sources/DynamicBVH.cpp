@@ -0,0 +1,648 @@
+#include "DynamicBVH.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		const int gSahBins = 12;
+
+		// Past this depth the build splits at the median so degenerate inputs stay O(log n) deep.
+		const int gMaxSahDepth = 48;
+
+		inline XMFLOAT3 Min3(const XMFLOAT3& a, const XMFLOAT3& b) {
+			return XMFLOAT3((std::min)(a.x, b.x), (std::min)(a.y, b.y), (std::min)(a.z, b.z));
+		}
+
+		inline XMFLOAT3 Max3(const XMFLOAT3& a, const XMFLOAT3& b) {
+			return XMFLOAT3((std::max)(a.x, b.x), (std::max)(a.y, b.y), (std::max)(a.z, b.z));
+		}
+
+		inline float Area(const XMFLOAT3& mn, const XMFLOAT3& mx) {
+			float dx = mx.x - mn.x;
+			float dy = mx.y - mn.y;
+			float dz = mx.z - mn.z;
+			return 2.0f * (dx * dy + dy * dz + dz * dx);
+		}
+
+		inline float UnionArea(const XMFLOAT3& min1, const XMFLOAT3& max1, const XMFLOAT3& min2, const XMFLOAT3& max2) {
+			return Area(Min3(min1, min2), Max3(max1, max2));
+		}
+
+		inline float Axis(const XMFLOAT3& v, int axis) {
+			return (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
+		}
+
+		inline void ToMinMax(const BoundingBox& box, float margin, XMFLOAT3& outMin, XMFLOAT3& outMax) {
+			outMin = XMFLOAT3(box.Center.x - box.Extents.x - margin, box.Center.y - box.Extents.y - margin, box.Center.z - box.Extents.z - margin);
+			outMax = XMFLOAT3(box.Center.x + box.Extents.x + margin, box.Center.y + box.Extents.y + margin, box.Center.z + box.Extents.z + margin);
+		}
+	}
+
+	DynamicBVH::DynamicBVH(float margin) : m_Margin(margin) {
+	}
+
+	DynamicBVH::~DynamicBVH() {
+	}
+
+	void DynamicBVH::Clear() {
+		m_Nodes.clear();
+		m_Root = NullNode;
+		m_FreeList = NullNode;
+		m_ProxyCount = 0;
+	}
+
+	int DynamicBVH::AllocateNode() {
+		if (m_FreeList == NullNode) {
+			m_Nodes.emplace_back();
+			return (int)m_Nodes.size() - 1;
+		}
+
+		int node = m_FreeList;
+		m_FreeList = m_Nodes[node].Parent;
+		m_Nodes[node] = Node();
+
+		return node;
+	}
+
+	void DynamicBVH::FreeNode(int node) {
+		m_Nodes[node].Parent = m_FreeList;
+		m_Nodes[node].Height = -1;
+		m_FreeList = node;
+	}
+
+	int DynamicBVH::CreateProxy(const BoundingBox& box, UINT userData) {
+		int proxy = AllocateNode();
+		Node& leaf = m_Nodes[proxy];
+
+		ToMinMax(box, m_Margin, leaf.Min, leaf.Max);
+		leaf.UserData = userData;
+		leaf.Height = 0;
+
+		InsertLeaf(proxy);
+		++m_ProxyCount;
+
+		return proxy;
+	}
+
+	void DynamicBVH::DestroyProxy(int proxy) {
+		RemoveLeaf(proxy);
+		FreeNode(proxy);
+		--m_ProxyCount;
+	}
+
+	bool DynamicBVH::MoveProxy(int proxy, const BoundingBox& box) {
+		Node& leaf = m_Nodes[proxy];
+
+		XMFLOAT3 tightMin, tightMax;
+		ToMinMax(box, 0.0f, tightMin, tightMax);
+
+		if (leaf.Min.x <= tightMin.x && leaf.Min.y <= tightMin.y && leaf.Min.z <= tightMin.z &&
+			leaf.Max.x >= tightMax.x && leaf.Max.y >= tightMax.y && leaf.Max.z >= tightMax.z) {
+			return false;
+		}
+
+		XMFLOAT3 fatMin, fatMax;
+		ToMinMax(box, m_Margin, fatMin, fatMax);
+
+		bool overlaps =
+			fatMin.x <= leaf.Max.x && fatMax.x >= leaf.Min.x &&
+			fatMin.y <= leaf.Max.y && fatMax.y >= leaf.Min.y &&
+			fatMin.z <= leaf.Max.z && fatMax.z >= leaf.Min.z;
+
+		if (overlaps) {
+			// Still near its old place: refit the path up instead of searching a new sibling.
+			leaf.Min = fatMin;
+			leaf.Max = fatMax;
+			RefitAncestors(leaf.Parent);
+		}
+		else {
+			RemoveLeaf(proxy);
+			m_Nodes[proxy].Min = fatMin;
+			m_Nodes[proxy].Max = fatMax;
+			InsertLeaf(proxy);
+		}
+
+		return true;
+	}
+
+	void DynamicBVH::InsertLeaf(int leaf) {
+		if (m_Root == NullNode) {
+			m_Root = leaf;
+			m_Nodes[leaf].Parent = NullNode;
+			return;
+		}
+
+		const XMFLOAT3 leafMin = m_Nodes[leaf].Min;
+		const XMFLOAT3 leafMax = m_Nodes[leaf].Max;
+
+		// Descend toward the sibling with the lowest SAH cost; inheritance is the growth forced on ancestors.
+		int index = m_Root;
+		while (!m_Nodes[index].IsLeaf()) {
+			const Node& node = m_Nodes[index];
+
+			float area = Area(node.Min, node.Max);
+			float combinedArea = UnionArea(node.Min, node.Max, leafMin, leafMax);
+
+			float cost = 2.0f * combinedArea;
+			float inheritance = 2.0f * (combinedArea - area);
+
+			auto descendCost = [&](int child) {
+				const Node& c = m_Nodes[child];
+				float unionArea = UnionArea(c.Min, c.Max, leafMin, leafMax);
+				return (c.IsLeaf() ? unionArea : unionArea - Area(c.Min, c.Max)) + inheritance;
+			};
+
+			float cost1 = descendCost(node.Child1);
+			float cost2 = descendCost(node.Child2);
+
+			if (cost < cost1 && cost < cost2) break;
+
+			index = (cost1 < cost2) ? node.Child1 : node.Child2;
+		}
+
+		int sibling = index;
+		int oldParent = m_Nodes[sibling].Parent;
+		int newParent = AllocateNode();
+
+		Node& parent = m_Nodes[newParent];
+		parent.Parent = oldParent;
+		parent.Min = Min3(leafMin, m_Nodes[sibling].Min);
+		parent.Max = Max3(leafMax, m_Nodes[sibling].Max);
+		parent.Height = m_Nodes[sibling].Height + 1;
+		parent.Child1 = sibling;
+		parent.Child2 = leaf;
+
+		if (oldParent != NullNode) {
+			if (m_Nodes[oldParent].Child1 == sibling) m_Nodes[oldParent].Child1 = newParent;
+			else m_Nodes[oldParent].Child2 = newParent;
+		}
+		else {
+			m_Root = newParent;
+		}
+
+		m_Nodes[sibling].Parent = newParent;
+		m_Nodes[leaf].Parent = newParent;
+
+		RefitAncestors(newParent);
+	}
+
+	void DynamicBVH::RemoveLeaf(int leaf) {
+		if (leaf == m_Root) {
+			m_Root = NullNode;
+			return;
+		}
+
+		int parent = m_Nodes[leaf].Parent;
+		int grandParent = m_Nodes[parent].Parent;
+		int sibling = (m_Nodes[parent].Child1 == leaf) ? m_Nodes[parent].Child2 : m_Nodes[parent].Child1;
+
+		if (grandParent != NullNode) {
+			if (m_Nodes[grandParent].Child1 == parent) m_Nodes[grandParent].Child1 = sibling;
+			else m_Nodes[grandParent].Child2 = sibling;
+
+			m_Nodes[sibling].Parent = grandParent;
+			FreeNode(parent);
+
+			RefitAncestors(grandParent);
+		}
+		else {
+			m_Root = sibling;
+			m_Nodes[sibling].Parent = NullNode;
+			FreeNode(parent);
+		}
+
+		m_Nodes[leaf].Parent = NullNode;
+	}
+
+	void DynamicBVH::RefitAncestors(int node) {
+		while (node != NullNode) {
+			Refit(node);
+			Rotate(node);
+			node = m_Nodes[node].Parent;
+		}
+	}
+
+	void DynamicBVH::Refit(int node) {
+		Node& n = m_Nodes[node];
+		const Node& c1 = m_Nodes[n.Child1];
+		const Node& c2 = m_Nodes[n.Child2];
+
+		n.Min = Min3(c1.Min, c2.Min);
+		n.Max = Max3(c1.Max, c2.Max);
+		n.Height = 1 + (std::max)(c1.Height, c2.Height);
+	}
+
+	void DynamicBVH::Rotate(int a) {
+		// Kensler-style rotations: swap a child of A with a grandchild when that shrinks the children's area.
+		Node& nodeA = m_Nodes[a];
+		if (nodeA.Height < 2) return;
+
+		int b = nodeA.Child1;
+		int c = nodeA.Child2;
+		const Node& nodeB = m_Nodes[b];
+		const Node& nodeC = m_Nodes[c];
+
+		const float areaB = Area(nodeB.Min, nodeB.Max);
+		const float areaC = Area(nodeC.Min, nodeC.Max);
+
+		// Leaves keep their area wherever they hang, so only the change of B's and C's areas counts.
+		int bestP1 = NullNode, bestX = NullNode, bestP2 = NullNode, bestY = NullNode;
+		float bestDelta = 0.0f;
+
+		// Swapping x (child of p1) with y (child of p2).
+		auto consider = [&](int p1, int x, int p2, int y, float delta) {
+			if (delta < bestDelta) {
+				bestDelta = delta;
+				bestP1 = p1; bestX = x; bestP2 = p2; bestY = y;
+			}
+		};
+
+		if (!nodeC.IsLeaf()) {
+			const Node& f = m_Nodes[nodeC.Child1];
+			const Node& g = m_Nodes[nodeC.Child2];
+
+			// B <-> F: C = (B, G). B <-> G: C = (F, B).
+			consider(a, b, c, nodeC.Child1, UnionArea(nodeB.Min, nodeB.Max, g.Min, g.Max) - areaC);
+			consider(a, b, c, nodeC.Child2, UnionArea(nodeB.Min, nodeB.Max, f.Min, f.Max) - areaC);
+		}
+
+		if (!nodeB.IsLeaf()) {
+			const Node& d = m_Nodes[nodeB.Child1];
+			const Node& e = m_Nodes[nodeB.Child2];
+
+			// C <-> D: B = (C, E). C <-> E: B = (D, C).
+			consider(a, c, b, nodeB.Child1, UnionArea(nodeC.Min, nodeC.Max, e.Min, e.Max) - areaB);
+			consider(a, c, b, nodeB.Child2, UnionArea(nodeC.Min, nodeC.Max, d.Min, d.Max) - areaB);
+		}
+
+		if (!nodeB.IsLeaf() && !nodeC.IsLeaf()) {
+			const Node& d = m_Nodes[nodeB.Child1];
+			const Node& e = m_Nodes[nodeB.Child2];
+			const Node& f = m_Nodes[nodeC.Child1];
+			const Node& g = m_Nodes[nodeC.Child2];
+
+			// D <-> F: B = (F, E), C = (D, G). D <-> G: B = (G, E), C = (F, D).
+			consider(b, nodeB.Child1, c, nodeC.Child1,
+				UnionArea(f.Min, f.Max, e.Min, e.Max) + UnionArea(d.Min, d.Max, g.Min, g.Max) - areaB - areaC);
+			consider(b, nodeB.Child1, c, nodeC.Child2,
+				UnionArea(g.Min, g.Max, e.Min, e.Max) + UnionArea(f.Min, f.Max, d.Min, d.Max) - areaB - areaC);
+		}
+
+		if (bestX == NullNode) return;
+
+		Node& p1 = m_Nodes[bestP1];
+		Node& p2 = m_Nodes[bestP2];
+
+		if (p1.Child1 == bestX) p1.Child1 = bestY;
+		else p1.Child2 = bestY;
+
+		if (p2.Child1 == bestY) p2.Child1 = bestX;
+		else p2.Child2 = bestX;
+
+		m_Nodes[bestY].Parent = bestP1;
+		m_Nodes[bestX].Parent = bestP2;
+
+		if (bestP1 != a) Refit(bestP1);
+		Refit(bestP2);
+		Refit(a);
+	}
+
+	void DynamicBVH::Build(const BoundingBox* boxes, const UINT* userData, size_t count, int* outProxies) {
+		Clear();
+
+		if (count == 0) return;
+
+		m_Nodes.reserve(count * 2);
+
+		std::vector<int> leaves(count);
+		for (size_t i = 0; i < count; ++i) {
+			int proxy = AllocateNode();
+			Node& leaf = m_Nodes[proxy];
+
+			ToMinMax(boxes[i], m_Margin, leaf.Min, leaf.Max);
+			leaf.UserData = userData[i];
+			leaf.Height = 0;
+
+			leaves[i] = proxy;
+			outProxies[i] = proxy;
+		}
+
+		m_ProxyCount = (UINT)count;
+		m_Root = BuildRange(leaves, 0, count, 0);
+		m_Nodes[m_Root].Parent = NullNode;
+	}
+
+	int DynamicBVH::BuildRange(std::vector<int>& leaves, size_t first, size_t last, int depth) {
+		const size_t count = last - first;
+		if (count == 1) return leaves[first];
+
+		auto centroid = [this](int node, int axis) {
+			const Node& n = m_Nodes[node];
+			return 0.5f * (Axis(n.Min, axis) + Axis(n.Max, axis));
+		};
+
+		XMFLOAT3 cMin(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+		XMFLOAT3 cMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (size_t i = first; i < last; ++i) {
+			const Node& n = m_Nodes[leaves[i]];
+			XMFLOAT3 c(0.5f * (n.Min.x + n.Max.x), 0.5f * (n.Min.y + n.Max.y), 0.5f * (n.Min.z + n.Max.z));
+			cMin = Min3(cMin, c);
+			cMax = Max3(cMax, c);
+		}
+
+		XMFLOAT3 extent(cMax.x - cMin.x, cMax.y - cMin.y, cMax.z - cMin.z);
+		int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : ((extent.y > extent.z) ? 1 : 2);
+		const float axisMin = Axis(cMin, axis);
+		const float axisExtent = Axis(extent, axis);
+
+		size_t mid = first + count / 2;
+		bool sahSplit = false;
+
+		if (axisExtent > 0.0f && depth < gMaxSahDepth) {
+			struct Bin {
+				XMFLOAT3 Min = XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+				XMFLOAT3 Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				size_t Count = 0;
+			};
+
+			Bin bins[gSahBins];
+			const float binScale = gSahBins / axisExtent;
+
+			auto binOf = [&](int node) {
+				int b = (int)((centroid(node, axis) - axisMin) * binScale);
+				return (std::min)((std::max)(b, 0), gSahBins - 1);
+			};
+
+			for (size_t i = first; i < last; ++i) {
+				const Node& n = m_Nodes[leaves[i]];
+				Bin& bin = bins[binOf(leaves[i])];
+				bin.Min = Min3(bin.Min, n.Min);
+				bin.Max = Max3(bin.Max, n.Max);
+				++bin.Count;
+			}
+
+			// Sweep from the right for suffix areas, then from the left for the cost of each split plane.
+			float rightArea[gSahBins];
+			size_t rightCount[gSahBins];
+			XMFLOAT3 accMin(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+			XMFLOAT3 accMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			size_t accCount = 0;
+
+			for (int b = gSahBins - 1; b > 0; --b) {
+				accMin = Min3(accMin, bins[b].Min);
+				accMax = Max3(accMax, bins[b].Max);
+				accCount += bins[b].Count;
+				rightArea[b] = (accCount > 0) ? Area(accMin, accMax) : 0.0f;
+				rightCount[b] = accCount;
+			}
+
+			int bestSplit = -1;
+			float bestCost = FLT_MAX;
+			accMin = XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+			accMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			accCount = 0;
+
+			for (int b = 0; b < gSahBins - 1; ++b) {
+				accMin = Min3(accMin, bins[b].Min);
+				accMax = Max3(accMax, bins[b].Max);
+				accCount += bins[b].Count;
+
+				if (accCount == 0 || rightCount[b + 1] == 0) continue;
+
+				float cost = accCount * Area(accMin, accMax) + rightCount[b + 1] * rightArea[b + 1];
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestSplit = b;
+				}
+			}
+
+			if (bestSplit >= 0) {
+				auto it = std::partition(leaves.begin() + first, leaves.begin() + last,
+					[&](int node) { return binOf(node) <= bestSplit; });
+				mid = (size_t)(it - leaves.begin());
+				sahSplit = (mid != first && mid != last);
+			}
+		}
+
+		if (!sahSplit) {
+			mid = first + count / 2;
+			std::nth_element(leaves.begin() + first, leaves.begin() + mid, leaves.begin() + last,
+				[&](int lhs, int rhs) { return centroid(lhs, axis) < centroid(rhs, axis); });
+		}
+
+		int left = BuildRange(leaves, first, mid, depth + 1);
+		int right = BuildRange(leaves, mid, last, depth + 1);
+
+		int node = AllocateNode();
+		Node& n = m_Nodes[node];
+		n.Child1 = left;
+		n.Child2 = right;
+		m_Nodes[left].Parent = node;
+		m_Nodes[right].Parent = node;
+		Refit(node);
+
+		return node;
+	}
+
+	void DynamicBVH::QueryFrustum(const BoundingFrustum& frustum, std::vector<UINT>& outUserData, std::vector<UINT>* outUntested) const {
+		outUserData.clear();
+		if (outUntested) outUntested->clear();
+		if (m_Root == NullNode) return;
+
+		// Outward facing planes: a box is outside when its center is farther than its projected radius.
+		XMVECTOR planeVectors[6];
+		frustum.GetPlanes(&planeVectors[0], &planeVectors[1], &planeVectors[2],
+			&planeVectors[3], &planeVectors[4], &planeVectors[5]);
+
+		XMFLOAT4 planes[6];
+		for (int i = 0; i < 6; ++i) {
+			XMStoreFloat4(&planes[i], planeVectors[i]);
+		}
+
+		const UINT allPlanes = (1u << 6) - 1;
+
+		std::vector<std::pair<int, UINT>> stack;
+		stack.reserve(64);
+		stack.emplace_back(m_Root, allPlanes);
+
+		while (!stack.empty()) {
+			int index = stack.back().first;
+			UINT mask = stack.back().second;
+			stack.pop_back();
+
+			const Node& node = m_Nodes[index];
+
+			// The caller tests these against tight bounds, the fat leaf box adds nothing.
+			if (outUntested && node.IsLeaf()) {
+				outUntested->push_back(node.UserData);
+				continue;
+			}
+
+			XMFLOAT3 center(0.5f * (node.Min.x + node.Max.x), 0.5f * (node.Min.y + node.Max.y), 0.5f * (node.Min.z + node.Max.z));
+			XMFLOAT3 extents(0.5f * (node.Max.x - node.Min.x), 0.5f * (node.Max.y - node.Min.y), 0.5f * (node.Max.z - node.Min.z));
+
+			bool outside = false;
+			for (int i = 0; i < 6; ++i) {
+				if ((mask & (1u << i)) == 0) continue;
+
+				const XMFLOAT4& p = planes[i];
+				float distance = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+				float radius = fabsf(p.x) * extents.x + fabsf(p.y) * extents.y + fabsf(p.z) * extents.z;
+
+				if (distance > radius) {
+					outside = true;
+					break;
+				}
+				if (distance < -radius) {
+					mask &= ~(1u << i);
+				}
+			}
+
+			if (outside) continue;
+
+			if (mask == 0) {
+				CollectLeaves(index, outUserData);
+			}
+			else if (node.IsLeaf()) {
+				outUserData.push_back(node.UserData);
+			}
+			else {
+				stack.emplace_back(node.Child1, mask);
+				stack.emplace_back(node.Child2, mask);
+			}
+		}
+	}
+
+	void DynamicBVH::QueryViews(const FrustumCuller::View* views, UINT viewCount, UINT* inOutMasks,
+		std::vector<UINT>& outUntested, std::vector<UINT>& outUntestedMasks) const {
+		outUntested.clear();
+		outUntestedMasks.clear();
+		if (m_Root == NullNode || viewCount == 0) return;
+
+		const UINT allViews = (viewCount >= 32) ? ~0u : (1u << viewCount) - 1;
+
+		std::vector<std::pair<int, UINT>> stack;
+		stack.reserve(64);
+		stack.emplace_back(m_Root, allViews);
+
+		std::vector<UINT> leaves;
+
+		while (!stack.empty()) {
+			int index = stack.back().first;
+			UINT open = stack.back().second;
+			stack.pop_back();
+
+			const Node& node = m_Nodes[index];
+
+			if (node.IsLeaf()) {
+				outUntested.push_back(node.UserData);
+				outUntestedMasks.push_back(open);
+				continue;
+			}
+
+			XMFLOAT3 center(0.5f * (node.Min.x + node.Max.x), 0.5f * (node.Min.y + node.Max.y), 0.5f * (node.Min.z + node.Max.z));
+			XMFLOAT3 extents(0.5f * (node.Max.x - node.Min.x), 0.5f * (node.Max.y - node.Min.y), 0.5f * (node.Max.z - node.Min.z));
+
+			UINT inside = 0;
+
+			for (UINT v = 0; v < viewCount; ++v) {
+				const UINT viewBit = 1u << v;
+				if ((open & viewBit) == 0) continue;
+
+				bool outside = false;
+				bool straddles = false;
+
+				for (UINT i = 0; i < views[v].PlaneCount; ++i) {
+					const XMFLOAT4& p = views[v].Planes[i];
+					float distance = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+					float radius = fabsf(p.x) * extents.x + fabsf(p.y) * extents.y + fabsf(p.z) * extents.z;
+
+					if (distance > radius) {
+						outside = true;
+						break;
+					}
+					if (distance >= -radius) {
+						straddles = true;
+					}
+				}
+
+				if (outside) {
+					open &= ~viewBit;
+				}
+				else if (!straddles) {
+					open &= ~viewBit;
+					inside |= viewBit;
+				}
+			}
+
+			if (inside != 0) {
+				leaves.clear();
+				CollectLeaves(index, leaves);
+
+				for (UINT userData : leaves) {
+					inOutMasks[userData] |= inside;
+				}
+			}
+
+			if (open != 0) {
+				stack.emplace_back(node.Child1, open);
+				stack.emplace_back(node.Child2, open);
+			}
+		}
+	}
+
+	void DynamicBVH::CollectLeaves(int root, std::vector<UINT>& outUserData) const {
+		int stack[64];
+		int top = 0;
+		stack[top++] = root;
+
+		while (top > 0) {
+			const Node& node = m_Nodes[stack[--top]];
+
+			if (node.IsLeaf()) {
+				outUserData.push_back(node.UserData);
+			}
+			else if (top + 2 <= 64) {
+				stack[top++] = node.Child1;
+				stack[top++] = node.Child2;
+			}
+			else {
+				CollectLeaves(node.Child1, outUserData);
+				CollectLeaves(node.Child2, outUserData);
+			}
+		}
+	}
+
+	UINT DynamicBVH::GetUserData(int proxy) const {
+		return m_Nodes[proxy].UserData;
+	}
+
+	void DynamicBVH::SetUserData(int proxy, UINT userData) {
+		m_Nodes[proxy].UserData = userData;
+	}
+
+	int DynamicBVH::GetHeight() const {
+		return (m_Root == NullNode) ? 0 : m_Nodes[m_Root].Height;
+	}
+
+	UINT DynamicBVH::GetProxyCount() const {
+		return m_ProxyCount;
+	}
+
+	float DynamicBVH::GetAreaRatio() const {
+		if (m_Root == NullNode) return 0.0f;
+
+		float total = 0.0f;
+		for (const Node& node : m_Nodes) {
+			if (node.Height <= 0) continue;
+			total += Area(node.Min, node.Max);
+		}
+
+		float rootArea = Area(m_Nodes[m_Root].Min, m_Nodes[m_Root].Max);
+		return (rootArea > 0.0f) ? total / rootArea : 0.0f;
+	}
+}
@@ -1,13 +1,16 @@
 #include "FrameResource.h"
 
 namespace Mawi1e {
-	FrameResource::FrameResource(ID3D12Device* Device, UINT passCount, UINT objCount, UINT matCount) {
+	FrameResource::FrameResource(ID3D12Device* Device, UINT passCount, UINT objCount, UINT matCount, UINT terrainPatchCount,
+		UINT visibleSlotCount) {
 		Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
 			IID_PPV_ARGS(m_CommandAllocator.GetAddressOf()));
 
-		m_InstCB = std::make_unique<UploadBuffer<InstanceConstants>>(Device, objCount, true);
+		m_InstanceUploads = std::make_unique<UploadBuffer<PackedInstance>>(Device, objCount, false);
+		m_VisibleSlots = std::make_unique<UploadBuffer<UINT>>(Device, visibleSlotCount, false);
 		m_PassCB = std::make_unique<UploadBuffer<PassConstants>>(Device, passCount, true);
 		m_MatVB = std::make_unique<UploadBuffer<MaterialConstants>>(Device, matCount, false);
+		m_TerrainVB = std::make_unique<UploadBuffer<TerrainPatch>>(Device, terrainPatchCount, false);
 	}
 
 	FrameResource::~FrameResource() {
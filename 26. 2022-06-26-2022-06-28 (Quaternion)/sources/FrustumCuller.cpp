@@ -0,0 +1,400 @@
+#include "FrustumCuller.h"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+#if defined(__AVX2__)
+		struct Boxes8 {
+			__m256 CX, CY, CZ;
+			__m256 EX, EY, EZ;
+		};
+
+		struct Spheres8 {
+			__m256 CX, CY, CZ;
+			__m256 R;
+		};
+
+		// Bit i set when box i is outside some plane.
+		inline int OutsideMask(const XMFLOAT4* planes, UINT planeCount, const Boxes8& b) {
+			const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+			__m256 outside = _mm256_setzero_ps();
+
+			for (UINT i = 0; i < planeCount; ++i) {
+				__m256 px = _mm256_broadcast_ss(&planes[i].x);
+				__m256 py = _mm256_broadcast_ss(&planes[i].y);
+				__m256 pz = _mm256_broadcast_ss(&planes[i].z);
+				__m256 pw = _mm256_broadcast_ss(&planes[i].w);
+
+				__m256 distance = _mm256_fmadd_ps(px, b.CX, _mm256_fmadd_ps(py, b.CY, _mm256_fmadd_ps(pz, b.CZ, pw)));
+				__m256 radius = _mm256_fmadd_ps(_mm256_and_ps(px, absMask), b.EX,
+					_mm256_fmadd_ps(_mm256_and_ps(py, absMask), b.EY, _mm256_mul_ps(_mm256_and_ps(pz, absMask), b.EZ)));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, radius, _CMP_GT_OQ));
+			}
+
+			return _mm256_movemask_ps(outside);
+		}
+
+		// Bit i set when sphere i projects below the view's threshold:
+		// r * scale < minPixels * distance, compared squared; distance is 1 for orthographic views.
+		inline int SmallMask(const FrustumCuller::View& view, const Spheres8& b) {
+			__m256 radiusSq = _mm256_mul_ps(b.R, b.R);
+
+			__m256 dx = _mm256_sub_ps(b.CX, _mm256_set1_ps(view.Eye.x));
+			__m256 dy = _mm256_sub_ps(b.CY, _mm256_set1_ps(view.Eye.y));
+			__m256 dz = _mm256_sub_ps(b.CZ, _mm256_set1_ps(view.Eye.z));
+			__m256 distanceSq = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+			distanceSq = _mm256_fmadd_ps(_mm256_set1_ps(view.Perspective), _mm256_sub_ps(distanceSq, _mm256_set1_ps(1.0f)),
+				_mm256_set1_ps(1.0f));
+
+			__m256 projected = _mm256_mul_ps(radiusSq, _mm256_set1_ps(view.PixelScale * view.PixelScale));
+			__m256 threshold = _mm256_mul_ps(distanceSq, _mm256_set1_ps(view.MinPixels * view.MinPixels));
+
+			return _mm256_movemask_ps(_mm256_cmp_ps(projected, threshold, _CMP_LT_OQ));
+		}
+
+		inline Boxes8 LoadBoxes(const float* cx, const float* cy, const float* cz,
+			const float* ex, const float* ey, const float* ez, size_t first) {
+			Boxes8 b;
+			b.CX = _mm256_loadu_ps(cx + first);
+			b.CY = _mm256_loadu_ps(cy + first);
+			b.CZ = _mm256_loadu_ps(cz + first);
+			b.EX = _mm256_loadu_ps(ex + first);
+			b.EY = _mm256_loadu_ps(ey + first);
+			b.EZ = _mm256_loadu_ps(ez + first);
+			return b;
+		}
+
+		inline Spheres8 LoadSpheres(const float* cx, const float* cy, const float* cz, const float* r, size_t first) {
+			Spheres8 b;
+			b.CX = _mm256_loadu_ps(cx + first);
+			b.CY = _mm256_loadu_ps(cy + first);
+			b.CZ = _mm256_loadu_ps(cz + first);
+			b.R = _mm256_loadu_ps(r + first);
+			return b;
+		}
+
+		inline Boxes8 GatherBoxes(const float* cx, const float* cy, const float* cz,
+			const float* ex, const float* ey, const float* ez, const UINT* indices) {
+			__m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices));
+
+			Boxes8 b;
+			b.CX = _mm256_i32gather_ps(cx, index, 4);
+			b.CY = _mm256_i32gather_ps(cy, index, 4);
+			b.CZ = _mm256_i32gather_ps(cz, index, 4);
+			b.EX = _mm256_i32gather_ps(ex, index, 4);
+			b.EY = _mm256_i32gather_ps(ey, index, 4);
+			b.EZ = _mm256_i32gather_ps(ez, index, 4);
+			return b;
+		}
+
+		// Branchless compaction: every lane is written, only survivors advance the cursor.
+		template <class IndexOf>
+		inline void AppendVisible(int outside, IndexOf indexOf, std::vector<UINT>& outVisible) {
+			size_t cursor = outVisible.size();
+			outVisible.resize(cursor + 8);
+			for (int lane = 0; lane < 8; ++lane) {
+				outVisible[cursor] = indexOf(lane);
+				cursor += ((outside >> lane) & 1) ^ 1;
+			}
+			outVisible.resize(cursor);
+		}
+#endif
+
+		inline XMFLOAT4 NormalizePlane(float x, float y, float z, float w) {
+			float invLength = 1.0f / sqrtf(x * x + y * y + z * z);
+			return XMFLOAT4(x * invLength, y * invLength, z * invLength, w * invLength);
+		}
+	}
+
+	FrustumCuller::FrustumCuller() {
+	}
+
+	FrustumCuller::~FrustumCuller() {
+	}
+
+	void FrustumCuller::Resize(size_t count) {
+		m_CenterX.resize(count, 0.0f);
+		m_CenterY.resize(count, 0.0f);
+		m_CenterZ.resize(count, 0.0f);
+		m_ExtentX.resize(count, 0.0f);
+		m_ExtentY.resize(count, 0.0f);
+		m_ExtentZ.resize(count, 0.0f);
+		m_SphereX.resize(count, 0.0f);
+		m_SphereY.resize(count, 0.0f);
+		m_SphereZ.resize(count, 0.0f);
+		m_Radius.resize(count, 0.0f);
+	}
+
+	size_t FrustumCuller::GetCount() const {
+		return m_CenterX.size();
+	}
+
+	void FrustumCuller::SetBounds(size_t index, const BoundingBox& worldBox) {
+		m_CenterX[index] = worldBox.Center.x;
+		m_CenterY[index] = worldBox.Center.y;
+		m_CenterZ[index] = worldBox.Center.z;
+		m_ExtentX[index] = worldBox.Extents.x;
+		m_ExtentY[index] = worldBox.Extents.y;
+		m_ExtentZ[index] = worldBox.Extents.z;
+
+		BoundingSphere sphere;
+		BoundingSphere::CreateFromBoundingBox(sphere, worldBox);
+		SetSphere(index, sphere);
+	}
+
+	BoundingBox FrustumCuller::GetBounds(size_t index) const {
+		return BoundingBox(
+			XMFLOAT3(m_CenterX[index], m_CenterY[index], m_CenterZ[index]),
+			XMFLOAT3(m_ExtentX[index], m_ExtentY[index], m_ExtentZ[index]));
+	}
+
+	void FrustumCuller::SetSphere(size_t index, const BoundingSphere& worldSphere) {
+		m_SphereX[index] = worldSphere.Center.x;
+		m_SphereY[index] = worldSphere.Center.y;
+		m_SphereZ[index] = worldSphere.Center.z;
+		m_Radius[index] = worldSphere.Radius;
+	}
+
+	BoundingSphere FrustumCuller::GetSphere(size_t index) const {
+		return BoundingSphere(XMFLOAT3(m_SphereX[index], m_SphereY[index], m_SphereZ[index]), m_Radius[index]);
+	}
+
+	void FrustumCuller::ExtractPlanes(const BoundingFrustum& frustumW, XMFLOAT4 outPlanes[6]) {
+		XMVECTOR planes[6];
+		frustumW.GetPlanes(&planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+
+		for (int i = 0; i < 6; ++i) {
+			XMStoreFloat4(&outPlanes[i], planes[i]);
+		}
+	}
+
+	void FrustumCuller::ExtractPlanes(FXMMATRIX viewProj, XMFLOAT4 outPlanes[6]) {
+		// Row vectors, D3D clip space: -w <= x, y <= w and 0 <= z <= w. Negated for outward normals.
+		XMFLOAT4X4 m;
+		XMStoreFloat4x4(&m, viewProj);
+
+		auto column = [&m](int j) {
+			return XMFLOAT4(m.m[0][j], m.m[1][j], m.m[2][j], m.m[3][j]);
+		};
+
+		XMFLOAT4 cx = column(0), cy = column(1), cz = column(2), cw = column(3);
+
+		outPlanes[0] = NormalizePlane(-cz.x, -cz.y, -cz.z, -cz.w);
+		outPlanes[1] = NormalizePlane(cz.x - cw.x, cz.y - cw.y, cz.z - cw.z, cz.w - cw.w);
+		outPlanes[2] = NormalizePlane(cx.x - cw.x, cx.y - cw.y, cx.z - cw.z, cx.w - cw.w);
+		outPlanes[3] = NormalizePlane(-cx.x - cw.x, -cx.y - cw.y, -cx.z - cw.z, -cx.w - cw.w);
+		outPlanes[4] = NormalizePlane(cy.x - cw.x, cy.y - cw.y, cy.z - cw.z, cy.w - cw.w);
+		outPlanes[5] = NormalizePlane(-cy.x - cw.x, -cy.y - cw.y, -cy.z - cw.z, -cy.w - cw.w);
+	}
+
+	void FrustumCuller::BuildView(const XMFLOAT4 planes[6], View& outView) {
+		for (int i = 0; i < 6; ++i) {
+			outView.Planes[i] = planes[i];
+		}
+		outView.PlaneCount = 6;
+	}
+
+	void FrustumCuller::BuildShadowCasterView(const XMFLOAT4 receiverPlanes[6], FXMVECTOR lightDir,
+		const XMFLOAT4 lightPlanes[6], View& outView) {
+		outView.PlaneCount = 0;
+
+		// Moving along the light only takes a point further out of a plane whose normal does not face
+		// the light; planes that do face it are dropped. Conservative: silhouette planes are omitted.
+		for (int i = 0; i < 6; ++i) {
+			XMVECTOR normal = XMLoadFloat4(&receiverPlanes[i]);
+			if (XMVectorGetX(XMVector3Dot(normal, lightDir)) >= 0.0f) {
+				outView.Planes[outView.PlaneCount++] = receiverPlanes[i];
+			}
+		}
+
+		for (int i = 0; i < 6; ++i) {
+			outView.Planes[outView.PlaneCount++] = lightPlanes[i];
+		}
+	}
+
+	void FrustumCuller::SetPerspectiveContribution(View& view, const XMFLOAT3& eye, float viewportHeight,
+		float nearZ, float nearWindowHeight, float minPixels) {
+		view.Eye = eye;
+		view.Perspective = 1.0f;
+		view.PixelScale = viewportHeight * nearZ / nearWindowHeight;
+		view.MinPixels = minPixels;
+	}
+
+	void FrustumCuller::SetOrthographicContribution(View& view, float viewportHeight, float volumeHeight, float minPixels) {
+		view.Eye = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		view.Perspective = 0.0f;
+		view.PixelScale = viewportHeight / volumeHeight;
+		view.MinPixels = minPixels;
+	}
+
+	bool FrustumCuller::IsVisible(const XMFLOAT4* planes, UINT planeCount, size_t index) const {
+		for (UINT i = 0; i < planeCount; ++i) {
+			const XMFLOAT4& p = planes[i];
+			float distance = p.x * m_CenterX[index] + p.y * m_CenterY[index] + p.z * m_CenterZ[index] + p.w;
+			float radius = fabsf(p.x) * m_ExtentX[index] + fabsf(p.y) * m_ExtentY[index] + fabsf(p.z) * m_ExtentZ[index];
+
+			if (distance > radius) return false;
+		}
+
+		return true;
+	}
+
+	bool FrustumCuller::IsLargeEnough(const View& view, size_t index) const {
+		float radiusSq = m_Radius[index] * m_Radius[index];
+
+		float dx = m_SphereX[index] - view.Eye.x;
+		float dy = m_SphereY[index] - view.Eye.y;
+		float dz = m_SphereZ[index] - view.Eye.z;
+		float distanceSq = view.Perspective * (dx * dx + dy * dy + dz * dz - 1.0f) + 1.0f;
+
+		return radiusSq * view.PixelScale * view.PixelScale >= distanceSq * view.MinPixels * view.MinPixels;
+	}
+
+	void FrustumCuller::Cull(const XMFLOAT4 planes[6], std::vector<UINT>& outVisible) const {
+		const size_t count = GetCount();
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		for (; i + 8 <= count; i += 8) {
+			Boxes8 b = LoadBoxes(m_CenterX.data(), m_CenterY.data(), m_CenterZ.data(),
+				m_ExtentX.data(), m_ExtentY.data(), m_ExtentZ.data(), i);
+
+			AppendVisible(OutsideMask(planes, 6, b), [i](int lane) { return (UINT)(i + lane); }, outVisible);
+		}
+#endif
+
+		for (; i < count; ++i) {
+			if (IsVisible(planes, 6, i)) {
+				outVisible.push_back((UINT)i);
+			}
+		}
+	}
+
+	void FrustumCuller::Cull(const XMFLOAT4 planes[6], const UINT* indices, size_t count, std::vector<UINT>& outVisible) const {
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		for (; i + 8 <= count; i += 8) {
+			const UINT* batch = indices + i;
+			Boxes8 b = GatherBoxes(m_CenterX.data(), m_CenterY.data(), m_CenterZ.data(),
+				m_ExtentX.data(), m_ExtentY.data(), m_ExtentZ.data(), batch);
+
+			AppendVisible(OutsideMask(planes, 6, b), [batch](int lane) { return batch[lane]; }, outVisible);
+		}
+#endif
+
+		for (; i < count; ++i) {
+			if (IsVisible(planes, 6, indices[i])) {
+				outVisible.push_back(indices[i]);
+			}
+		}
+	}
+
+	void FrustumCuller::CullViews(const View* views, UINT viewCount, const UINT* indices, const UINT* testMasks,
+		size_t count, UINT* inOutMasks) const {
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		for (; i + 8 <= count; i += 8) {
+			Boxes8 b = GatherBoxes(m_CenterX.data(), m_CenterY.data(), m_CenterZ.data(),
+				m_ExtentX.data(), m_ExtentY.data(), m_ExtentZ.data(), indices + i);
+
+			UINT batchViews = 0;
+			for (int lane = 0; lane < 8; ++lane) {
+				batchViews |= testMasks[i + lane];
+			}
+
+			UINT visible[8] = {};
+
+			for (UINT v = 0; v < viewCount; ++v) {
+				const UINT viewBit = 1u << v;
+				if ((batchViews & viewBit) == 0) continue;
+
+				int outside = OutsideMask(views[v].Planes, views[v].PlaneCount, b);
+				for (int lane = 0; lane < 8; ++lane) {
+					visible[lane] |= viewBit & ((UINT)((outside >> lane) & 1) - 1u);
+				}
+			}
+
+			for (int lane = 0; lane < 8; ++lane) {
+				inOutMasks[indices[i + lane]] |= visible[lane] & testMasks[i + lane];
+			}
+		}
+#endif
+
+		for (; i < count; ++i) {
+			UINT visible = 0;
+
+			for (UINT v = 0; v < viewCount; ++v) {
+				const UINT viewBit = 1u << v;
+				if ((testMasks[i] & viewBit) != 0 && IsVisible(views[v].Planes, views[v].PlaneCount, indices[i])) {
+					visible |= viewBit;
+				}
+			}
+
+			inOutMasks[indices[i]] |= visible;
+		}
+	}
+
+	void FrustumCuller::CullContribution(const View* views, UINT viewCount, UINT* inOutMasks) const {
+		UINT testedViews = 0;
+		for (UINT v = 0; v < viewCount; ++v) {
+			if (views[v].MinPixels > 0.0f) {
+				testedViews |= 1u << v;
+			}
+		}
+
+		if (testedViews == 0) return;
+
+		const size_t count = GetCount();
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		for (; i + 8 <= count; i += 8) {
+			UINT batchViews = 0;
+			for (int lane = 0; lane < 8; ++lane) {
+				batchViews |= inOutMasks[i + lane];
+			}
+
+			batchViews &= testedViews;
+			if (batchViews == 0) continue;
+
+			Spheres8 b = LoadSpheres(m_SphereX.data(), m_SphereY.data(), m_SphereZ.data(), m_Radius.data(), i);
+
+			UINT small[8] = {};
+
+			for (UINT v = 0; v < viewCount; ++v) {
+				const UINT viewBit = 1u << v;
+				if ((batchViews & viewBit) == 0) continue;
+
+				int smallMask = SmallMask(views[v], b);
+				for (int lane = 0; lane < 8; ++lane) {
+					small[lane] |= viewBit & (0u - (UINT)((smallMask >> lane) & 1));
+				}
+			}
+
+			for (int lane = 0; lane < 8; ++lane) {
+				inOutMasks[i + lane] &= ~small[lane];
+			}
+		}
+#endif
+
+		for (; i < count; ++i) {
+			UINT tested = inOutMasks[i] & testedViews;
+
+			for (UINT v = 0; v < viewCount; ++v) {
+				const UINT viewBit = 1u << v;
+				if ((tested & viewBit) != 0 && !IsLargeEnough(views[v], i)) {
+					inOutMasks[i] &= ~viewBit;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,393 @@
+#include "GeometryPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Mawi1e {
+	void GeometryPool::FreeList::Reset(UINT capacity) {
+		Capacity = capacity;
+		Used = 0;
+		Blocks.clear();
+		Blocks.push_back({ 0, capacity });
+	}
+
+	bool GeometryPool::FreeList::Allocate(UINT size, UINT& outOffset) {
+		if (size == 0) {
+			outOffset = 0;
+			return true;
+		}
+
+		for (size_t i = 0; i < Blocks.size(); ++i) {
+			Block& block = Blocks[i];
+			if (block.Size < size) continue;
+
+			outOffset = block.Offset;
+			block.Offset += size;
+			block.Size -= size;
+
+			if (block.Size == 0) {
+				Blocks.erase(Blocks.begin() + i);
+			}
+
+			Used += size;
+			return true;
+		}
+
+		return false;
+	}
+
+	void GeometryPool::FreeList::Free(UINT offset, UINT size) {
+		if (size == 0) return;
+
+		auto next = std::lower_bound(Blocks.begin(), Blocks.end(), offset,
+			[](const Block& block, UINT value) { return block.Offset < value; });
+		auto it = Blocks.insert(next, { offset, size });
+
+		if (it + 1 != Blocks.end() && it->Offset + it->Size == (it + 1)->Offset) {
+			it->Size += (it + 1)->Size;
+			Blocks.erase(it + 1);
+		}
+
+		if (it != Blocks.begin() && (it - 1)->Offset + (it - 1)->Size == it->Offset) {
+			(it - 1)->Size += it->Size;
+			Blocks.erase(it);
+		}
+
+		Used -= size;
+	}
+
+	GeometryPool::GeometryPool() {
+	}
+
+	GeometryPool::~GeometryPool() {
+	}
+
+	void GeometryPool::Initialize(ID3D12Device* device, UINT vertexStride,
+		UINT pageVertexCapacity, UINT pageIndexCapacity) {
+		m_Device = device;
+		m_VertexStride = vertexStride;
+		m_PageVertexCapacity = pageVertexCapacity;
+		m_PageIndexCapacity = pageIndexCapacity;
+	}
+
+	GeometryPool::Handle GeometryPool::Upload(ID3D12GraphicsCommandList* cmdList, const void* vertices, UINT vertexCount,
+		const std::uint16_t* indices, UINT indexCount) {
+		return Upload(cmdList, vertices, vertexCount, indices, indexCount, true);
+	}
+
+	GeometryPool::Handle GeometryPool::Upload(ID3D12GraphicsCommandList* cmdList, const void* vertices, UINT vertexCount,
+		const std::uint32_t* indices, UINT indexCount) {
+		return Upload(cmdList, vertices, vertexCount, indices, indexCount, false);
+	}
+
+	GeometryPool::Handle GeometryPool::Upload(ID3D12GraphicsCommandList* cmdList, const void* vertices, UINT vertexCount,
+		const void* indices, UINT indexCount, bool indices16) {
+		UINT baseVertex = 0;
+		UINT startIndex = 0;
+		UINT pageIndex = AllocateRange(vertexCount, indexCount, baseVertex, startIndex);
+		Page& page = *m_Pages[pageIndex];
+
+		const UINT64 vertexBytes = (UINT64)vertexCount * m_VertexStride;
+		const UINT64 indexBytes = (UINT64)indexCount * sizeof(std::uint32_t);
+		const UINT64 indexOffset = (vertexBytes + 3) & ~(UINT64)3;
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> staging;
+		D3D12_HEAP_PROPERTIES heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer((std::max)(indexOffset + indexBytes, (UINT64)4));
+
+		if (FAILED(m_Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(staging.GetAddressOf())))) {
+			throw std::runtime_error("@@@ Error: GeometryPool staging buffer");
+		}
+
+		BYTE* mapped = nullptr;
+		staging->Map(0, nullptr, reinterpret_cast<void**>(&mapped));
+
+		std::memcpy(mapped, vertices, (size_t)vertexBytes);
+
+		std::uint32_t* mappedIndices = reinterpret_cast<std::uint32_t*>(mapped + indexOffset);
+		if (indices16) {
+			const std::uint16_t* source = static_cast<const std::uint16_t*>(indices);
+			for (UINT i = 0; i < indexCount; ++i) {
+				mappedIndices[i] = source[i];
+			}
+		}
+		else {
+			std::memcpy(mappedIndices, indices, (size_t)indexBytes);
+		}
+
+		staging->Unmap(0, nullptr);
+
+		Transition(cmdList, page.VertexBuffer.Get(), page.State, D3D12_RESOURCE_STATE_COPY_DEST);
+		Transition(cmdList, page.IndexBuffer.Get(), page.State, D3D12_RESOURCE_STATE_COPY_DEST);
+
+		if (vertexBytes != 0) {
+			cmdList->CopyBufferRegion(page.VertexBuffer.Get(), (UINT64)baseVertex * m_VertexStride,
+				staging.Get(), 0, vertexBytes);
+		}
+		if (indexBytes != 0) {
+			cmdList->CopyBufferRegion(page.IndexBuffer.Get(), (UINT64)startIndex * sizeof(std::uint32_t),
+				staging.Get(), indexOffset, indexBytes);
+		}
+
+		Transition(cmdList, page.VertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+		Transition(cmdList, page.IndexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+		page.State = D3D12_RESOURCE_STATE_GENERIC_READ;
+
+		Retire(staging);
+
+		Range range;
+		range.Page = pageIndex;
+		range.BaseVertexLocation = (INT)baseVertex;
+		range.StartIndexLocation = startIndex;
+		range.VertexCount = vertexCount;
+		range.IndexCount = indexCount;
+
+		return NewHandle(range);
+	}
+
+	void GeometryPool::Free(Handle handle) {
+		if (handle >= m_Ranges.size() || !m_Live[handle]) return;
+
+		const Range& range = m_Ranges[handle];
+		Page& page = *m_Pages[range.Page];
+
+		page.Vertices.Free((UINT)range.BaseVertexLocation, range.VertexCount);
+		page.Indices.Free(range.StartIndexLocation, range.IndexCount);
+
+		if (--page.RangeCount == 0) {
+			ReleasePage(range.Page);
+		}
+
+		m_Live[handle] = false;
+		m_FreeHandles.push_back(handle);
+	}
+
+	void GeometryPool::Defragment(ID3D12GraphicsCommandList* cmdList) {
+		std::vector<Handle> live;
+		for (Handle h = 0; h < (Handle)m_Ranges.size(); ++h) {
+			if (m_Live[h]) live.push_back(h);
+		}
+
+		// Keep the previous order so meshes uploaded together stay together.
+		std::sort(live.begin(), live.end(), [this](Handle a, Handle b) {
+			const Range& ra = m_Ranges[a];
+			const Range& rb = m_Ranges[b];
+			return (ra.Page != rb.Page) ? (ra.Page < rb.Page) : (ra.StartIndexLocation < rb.StartIndexLocation);
+		});
+
+		std::vector<std::unique_ptr<Page>> oldPages = std::move(m_Pages);
+		m_Pages.clear();
+
+		for (auto& page : oldPages) {
+			if (page == nullptr) continue;
+
+			Transition(cmdList, page->VertexBuffer.Get(), page->State, D3D12_RESOURCE_STATE_COPY_SOURCE);
+			Transition(cmdList, page->IndexBuffer.Get(), page->State, D3D12_RESOURCE_STATE_COPY_SOURCE);
+		}
+
+		for (Handle h : live) {
+			Range& range = m_Ranges[h];
+			const Page& source = *oldPages[range.Page];
+
+			UINT baseVertex = 0;
+			UINT startIndex = 0;
+			UINT pageIndex = AllocateRange(range.VertexCount, range.IndexCount, baseVertex, startIndex);
+			Page& target = *m_Pages[pageIndex];
+
+			Transition(cmdList, target.VertexBuffer.Get(), target.State, D3D12_RESOURCE_STATE_COPY_DEST);
+			Transition(cmdList, target.IndexBuffer.Get(), target.State, D3D12_RESOURCE_STATE_COPY_DEST);
+			target.State = D3D12_RESOURCE_STATE_COPY_DEST;
+
+			if (range.VertexCount != 0) {
+				cmdList->CopyBufferRegion(target.VertexBuffer.Get(), (UINT64)baseVertex * m_VertexStride,
+					source.VertexBuffer.Get(), (UINT64)range.BaseVertexLocation * m_VertexStride,
+					(UINT64)range.VertexCount * m_VertexStride);
+			}
+			if (range.IndexCount != 0) {
+				cmdList->CopyBufferRegion(target.IndexBuffer.Get(), (UINT64)startIndex * sizeof(std::uint32_t),
+					source.IndexBuffer.Get(), (UINT64)range.StartIndexLocation * sizeof(std::uint32_t),
+					(UINT64)range.IndexCount * sizeof(std::uint32_t));
+			}
+
+			range.Page = pageIndex;
+			range.BaseVertexLocation = (INT)baseVertex;
+			range.StartIndexLocation = startIndex;
+		}
+
+		for (auto& page : m_Pages) {
+			Transition(cmdList, page->VertexBuffer.Get(), page->State, D3D12_RESOURCE_STATE_GENERIC_READ);
+			Transition(cmdList, page->IndexBuffer.Get(), page->State, D3D12_RESOURCE_STATE_GENERIC_READ);
+			page->State = D3D12_RESOURCE_STATE_GENERIC_READ;
+		}
+
+		for (auto& page : oldPages) {
+			if (page == nullptr) continue;
+
+			Retire(page->VertexBuffer);
+			Retire(page->IndexBuffer);
+		}
+	}
+
+	float GeometryPool::GetFragmentation() const {
+		UINT64 freeTotal = 0;
+		UINT64 holes = 0;
+
+		auto accumulate = [&](const FreeList& list) {
+			UINT free = list.Capacity - list.Used;
+			UINT tail = 0;
+
+			if (!list.Blocks.empty() && list.Blocks.back().Offset + list.Blocks.back().Size == list.Capacity) {
+				tail = list.Blocks.back().Size;
+			}
+
+			freeTotal += free;
+			holes += free - tail;
+		};
+
+		for (const auto& page : m_Pages) {
+			if (page == nullptr) continue;
+
+			accumulate(page->Vertices);
+			accumulate(page->Indices);
+		}
+
+		return (freeTotal == 0) ? 0.0f : (float)((double)holes / (double)freeTotal);
+	}
+
+	const GeometryPool::Range& GeometryPool::GetRange(Handle handle) const {
+		return m_Ranges[handle];
+	}
+
+	UINT GeometryPool::GetPageCount() const {
+		return (UINT)m_Pages.size();
+	}
+
+	D3D12_VERTEX_BUFFER_VIEW GeometryPool::GetVertexBufferView(UINT page) const {
+		const Page& p = *m_Pages[page];
+
+		D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
+		vertexBufferView.BufferLocation = p.VertexBuffer->GetGPUVirtualAddress();
+		vertexBufferView.SizeInBytes = p.Vertices.Capacity * m_VertexStride;
+		vertexBufferView.StrideInBytes = m_VertexStride;
+
+		return vertexBufferView;
+	}
+
+	D3D12_INDEX_BUFFER_VIEW GeometryPool::GetIndexBufferView(UINT page) const {
+		const Page& p = *m_Pages[page];
+
+		D3D12_INDEX_BUFFER_VIEW indexBufferView;
+		indexBufferView.BufferLocation = p.IndexBuffer->GetGPUVirtualAddress();
+		indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+		indexBufferView.SizeInBytes = p.Indices.Capacity * sizeof(std::uint32_t);
+
+		return indexBufferView;
+	}
+
+	void GeometryPool::OnSubmitted(UINT64 fenceValue) {
+		for (auto& resource : m_Pending) {
+			m_Retired.push_back({ std::move(resource), fenceValue });
+		}
+		m_Pending.clear();
+	}
+
+	void GeometryPool::ReleaseCompleted(UINT64 completedFenceValue) {
+		m_Retired.erase(std::remove_if(m_Retired.begin(), m_Retired.end(),
+			[completedFenceValue](const Retired& retired) { return retired.FenceValue <= completedFenceValue; }),
+			m_Retired.end());
+	}
+
+	std::unique_ptr<GeometryPool::Page> GeometryPool::CreatePage(UINT vertexCapacity, UINT indexCapacity) {
+		auto page = std::make_unique<Page>();
+
+		D3D12_HEAP_PROPERTIES heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		auto vertexDesc = CD3DX12_RESOURCE_DESC::Buffer((UINT64)vertexCapacity * m_VertexStride);
+		auto indexDesc = CD3DX12_RESOURCE_DESC::Buffer((UINT64)indexCapacity * sizeof(std::uint32_t));
+
+		if (FAILED(m_Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &vertexDesc,
+			D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(page->VertexBuffer.GetAddressOf())))) {
+			throw std::runtime_error("@@@ Error: GeometryPool vertex page");
+		}
+
+		if (FAILED(m_Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &indexDesc,
+			D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(page->IndexBuffer.GetAddressOf())))) {
+			throw std::runtime_error("@@@ Error: GeometryPool index page");
+		}
+
+		page->Vertices.Reset(vertexCapacity);
+		page->Indices.Reset(indexCapacity);
+
+		return page;
+	}
+
+	UINT GeometryPool::AllocateRange(UINT vertexCount, UINT indexCount, UINT& outBaseVertex, UINT& outStartIndex) {
+		for (UINT i = 0; i < (UINT)m_Pages.size(); ++i) {
+			Page* page = m_Pages[i].get();
+			if (page == nullptr) continue;
+
+			if (!page->Vertices.Allocate(vertexCount, outBaseVertex)) continue;
+
+			if (!page->Indices.Allocate(indexCount, outStartIndex)) {
+				page->Vertices.Free(outBaseVertex, vertexCount);
+				continue;
+			}
+
+			++page->RangeCount;
+			return i;
+		}
+
+		// Meshes larger than a page get a page of their own size.
+		auto page = CreatePage((std::max)(vertexCount, m_PageVertexCapacity), (std::max)(indexCount, m_PageIndexCapacity));
+		page->Vertices.Allocate(vertexCount, outBaseVertex);
+		page->Indices.Allocate(indexCount, outStartIndex);
+		page->RangeCount = 1;
+
+		auto slot = std::find(m_Pages.begin(), m_Pages.end(), nullptr);
+		if (slot != m_Pages.end()) {
+			*slot = std::move(page);
+			return (UINT)(slot - m_Pages.begin());
+		}
+
+		m_Pages.push_back(std::move(page));
+		return (UINT)m_Pages.size() - 1;
+	}
+
+	void GeometryPool::ReleasePage(UINT page) {
+		Retire(m_Pages[page]->VertexBuffer);
+		Retire(m_Pages[page]->IndexBuffer);
+		m_Pages[page].reset();
+	}
+
+	GeometryPool::Handle GeometryPool::NewHandle(const Range& range) {
+		Handle handle;
+
+		if (!m_FreeHandles.empty()) {
+			handle = m_FreeHandles.back();
+			m_FreeHandles.pop_back();
+		}
+		else {
+			handle = (Handle)m_Ranges.size();
+			m_Ranges.emplace_back();
+			m_Live.push_back(false);
+		}
+
+		m_Ranges[handle] = range;
+		m_Live[handle] = true;
+
+		return handle;
+	}
+
+	void GeometryPool::Transition(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* resource,
+		D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after) {
+		if (before == after) return;
+
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(resource, before, after);
+		cmdList->ResourceBarrier(1, &barrier);
+	}
+
+	void GeometryPool::Retire(const Microsoft::WRL::ComPtr<ID3D12Resource>& resource) {
+		m_Pending.push_back(resource);
+	}
+}
@@ -0,0 +1,476 @@
+#include "HeightField.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		// Below this a batch stays on the calling thread.
+		const size_t gMinBatchChunk = 4096;
+
+		const float gHillsAmplitude = 0.3f;
+		const float gHillsFrequency = 0.1f;
+
+#if defined(__AVX2__)
+		// sin/cos of 8 lanes. Range reduction to [-pi, pi], reflection into [-pi/2, pi/2] and the same
+		// degree 11/10 minimax polynomials as XMVectorSinCos (~1e-6 absolute error).
+		inline void SinCos8(__m256 x, __m256& outSin, __m256& outCos) {
+			const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+			__m256 quotient = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(XM_1DIV2PI)),
+				_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+			x = _mm256_fnmadd_ps(quotient, _mm256_set1_ps(XM_2PI), x);
+
+			// x in (pi/2, pi]: sin(x) = sin(pi - x), cos(x) = -cos(pi - x).
+			__m256 sign = _mm256_and_ps(x, signMask);
+			__m256 reflected = _mm256_sub_ps(_mm256_or_ps(_mm256_set1_ps(XM_PI), sign), x);
+			__m256 absX = _mm256_andnot_ps(signMask, x);
+			__m256 inside = _mm256_cmp_ps(absX, _mm256_set1_ps(XM_PIDIV2), _CMP_LE_OQ);
+
+			x = _mm256_blendv_ps(reflected, x, inside);
+			__m256 cosSign = _mm256_blendv_ps(_mm256_set1_ps(-1.0f), _mm256_set1_ps(1.0f), inside);
+
+			__m256 x2 = _mm256_mul_ps(x, x);
+
+			__m256 s = _mm256_set1_ps(-2.3889859e-08f);
+			s = _mm256_fmadd_ps(s, x2, _mm256_set1_ps(+2.7525562e-06f));
+			s = _mm256_fmadd_ps(s, x2, _mm256_set1_ps(-0.00019840874f));
+			s = _mm256_fmadd_ps(s, x2, _mm256_set1_ps(+0.0083333310f));
+			s = _mm256_fmadd_ps(s, x2, _mm256_set1_ps(-0.16666667f));
+			s = _mm256_fmadd_ps(s, x2, _mm256_set1_ps(1.0f));
+			outSin = _mm256_mul_ps(s, x);
+
+			__m256 c = _mm256_set1_ps(-2.6051615e-07f);
+			c = _mm256_fmadd_ps(c, x2, _mm256_set1_ps(+2.4760495e-05f));
+			c = _mm256_fmadd_ps(c, x2, _mm256_set1_ps(-0.0013888378f));
+			c = _mm256_fmadd_ps(c, x2, _mm256_set1_ps(+0.041666638f));
+			c = _mm256_fmadd_ps(c, x2, _mm256_set1_ps(-0.5f));
+			c = _mm256_fmadd_ps(c, x2, _mm256_set1_ps(1.0f));
+			outCos = _mm256_mul_ps(c, cosSign);
+		}
+
+		// rsqrt estimate refined by one Newton-Raphson step.
+		inline __m256 ReciprocalSqrt8(__m256 v) {
+			__m256 r = _mm256_rsqrt_ps(v);
+			__m256 halfVrr = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), v), _mm256_mul_ps(r, r));
+			return _mm256_mul_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.5f), halfVrr));
+		}
+
+		inline void StoreNormals8(__m256 nx, __m256 ny, __m256 nz, XMFLOAT3* outNormals) {
+			alignas(32) float x[8];
+			alignas(32) float y[8];
+			alignas(32) float z[8];
+			_mm256_store_ps(x, nx);
+			_mm256_store_ps(y, ny);
+			_mm256_store_ps(z, nz);
+
+			for (int lane = 0; lane < 8; ++lane) {
+				outNormals[lane] = XMFLOAT3(x[lane], y[lane], z[lane]);
+			}
+		}
+
+		inline __m256 Lerp8(__m256 a, __m256 b, __m256 t) {
+			return _mm256_fmadd_ps(_mm256_sub_ps(b, a), t, a);
+		}
+#endif
+	}
+
+	void HeightField::GetHeights(const float* xs, const float* zs, size_t count, float* outHeights) const {
+		if (count < gMinBatchChunk * 2) {
+			GetHeightsRange(xs, zs, count, outHeights);
+			return;
+		}
+
+		JobSystem::Get()->ParallelFor(count, gMinBatchChunk, [&](size_t first, size_t last, size_t) {
+			GetHeightsRange(xs + first, zs + first, last - first, outHeights + first);
+		});
+	}
+
+	void HeightField::GetNormals(const float* xs, const float* zs, size_t count, XMFLOAT3* outNormals) const {
+		if (count < gMinBatchChunk * 2) {
+			GetNormalsRange(xs, zs, count, outNormals);
+			return;
+		}
+
+		JobSystem::Get()->ParallelFor(count, gMinBatchChunk, [&](size_t first, size_t last, size_t) {
+			GetNormalsRange(xs + first, zs + first, last - first, outNormals + first);
+		});
+	}
+
+	void HeightField::GetHeightsRange(const float* xs, const float* zs, size_t count, float* outHeights) const {
+		for (size_t i = 0; i < count; ++i) {
+			outHeights[i] = GetHeight(xs[i], zs[i]);
+		}
+	}
+
+	void HeightField::GetNormalsRange(const float* xs, const float* zs, size_t count, XMFLOAT3* outNormals) const {
+		for (size_t i = 0; i < count; ++i) {
+			outNormals[i] = GetNormal(xs[i], zs[i]);
+		}
+	}
+
+	float HillsHeightField::GetHeight(float x, float z) const {
+		return gHillsAmplitude * (z * sinf(gHillsFrequency * x) + x * cosf(gHillsFrequency * z));
+	}
+
+	XMFLOAT3 HillsHeightField::GetNormal(float x, float z) const {
+		// n = (-df/dx, 1, -df/dz)
+		XMFLOAT3 n(
+			-gHillsAmplitude * (gHillsFrequency * z * cosf(gHillsFrequency * x) + cosf(gHillsFrequency * z)),
+			1.0f,
+			-gHillsAmplitude * (sinf(gHillsFrequency * x) - gHillsFrequency * x * sinf(gHillsFrequency * z)));
+
+		XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
+		XMStoreFloat3(&n, unitNormal);
+
+		return n;
+	}
+
+	void HillsHeightField::GetHeightsRange(const float* xs, const float* zs, size_t count, float* outHeights) const {
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		const __m256 amplitude = _mm256_set1_ps(gHillsAmplitude);
+		const __m256 frequency = _mm256_set1_ps(gHillsFrequency);
+
+		for (; i + 8 <= count; i += 8) {
+			__m256 x = _mm256_loadu_ps(xs + i);
+			__m256 z = _mm256_loadu_ps(zs + i);
+
+			__m256 sinX, cosX, sinZ, cosZ;
+			SinCos8(_mm256_mul_ps(frequency, x), sinX, cosX);
+			SinCos8(_mm256_mul_ps(frequency, z), sinZ, cosZ);
+
+			__m256 h = _mm256_fmadd_ps(z, sinX, _mm256_mul_ps(x, cosZ));
+			_mm256_storeu_ps(outHeights + i, _mm256_mul_ps(amplitude, h));
+		}
+#else
+		const XMVECTOR amplitude = XMVectorReplicate(gHillsAmplitude);
+		const XMVECTOR frequency = XMVectorReplicate(gHillsFrequency);
+
+		for (; i + 4 <= count; i += 4) {
+			XMVECTOR x = XMVectorSet(xs[i], xs[i + 1], xs[i + 2], xs[i + 3]);
+			XMVECTOR z = XMVectorSet(zs[i], zs[i + 1], zs[i + 2], zs[i + 3]);
+
+			XMVECTOR sinX, cosX, sinZ, cosZ;
+			XMVectorSinCos(&sinX, &cosX, XMVectorMultiply(frequency, x));
+			XMVectorSinCos(&sinZ, &cosZ, XMVectorMultiply(frequency, z));
+
+			XMVECTOR h = XMVectorMultiplyAdd(z, sinX, XMVectorMultiply(x, cosZ));
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(outHeights + i), XMVectorMultiply(amplitude, h));
+		}
+#endif
+
+		for (; i < count; ++i) {
+			outHeights[i] = GetHeight(xs[i], zs[i]);
+		}
+	}
+
+	void HillsHeightField::GetNormalsRange(const float* xs, const float* zs, size_t count, XMFLOAT3* outNormals) const {
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		const __m256 amplitude = _mm256_set1_ps(gHillsAmplitude);
+		const __m256 frequency = _mm256_set1_ps(gHillsFrequency);
+		const __m256 one = _mm256_set1_ps(1.0f);
+
+		for (; i + 8 <= count; i += 8) {
+			__m256 x = _mm256_loadu_ps(xs + i);
+			__m256 z = _mm256_loadu_ps(zs + i);
+
+			__m256 sinX, cosX, sinZ, cosZ;
+			SinCos8(_mm256_mul_ps(frequency, x), sinX, cosX);
+			SinCos8(_mm256_mul_ps(frequency, z), sinZ, cosZ);
+
+			__m256 dx = _mm256_fmadd_ps(_mm256_mul_ps(frequency, z), cosX, cosZ);
+			__m256 dz = _mm256_fnmadd_ps(_mm256_mul_ps(frequency, x), sinZ, sinX);
+
+			__m256 nx = _mm256_mul_ps(amplitude, dx);
+			__m256 nz = _mm256_mul_ps(amplitude, dz);
+
+			// Sign flip folded into the scale: n = (-nx, 1, -nz) / |n|.
+			__m256 lengthSq = _mm256_fmadd_ps(nz, nz, _mm256_fmadd_ps(nx, nx, one));
+			__m256 invLength = ReciprocalSqrt8(lengthSq);
+			__m256 negInvLength = _mm256_sub_ps(_mm256_setzero_ps(), invLength);
+
+			StoreNormals8(_mm256_mul_ps(nx, negInvLength), invLength, _mm256_mul_ps(nz, negInvLength), outNormals + i);
+		}
+#else
+		const XMVECTOR amplitude = XMVectorReplicate(gHillsAmplitude);
+		const XMVECTOR frequency = XMVectorReplicate(gHillsFrequency);
+
+		for (; i + 4 <= count; i += 4) {
+			XMVECTOR x = XMVectorSet(xs[i], xs[i + 1], xs[i + 2], xs[i + 3]);
+			XMVECTOR z = XMVectorSet(zs[i], zs[i + 1], zs[i + 2], zs[i + 3]);
+
+			XMVECTOR sinX, cosX, sinZ, cosZ;
+			XMVectorSinCos(&sinX, &cosX, XMVectorMultiply(frequency, x));
+			XMVectorSinCos(&sinZ, &cosZ, XMVectorMultiply(frequency, z));
+
+			XMVECTOR nx = XMVectorMultiply(amplitude, XMVectorMultiplyAdd(XMVectorMultiply(frequency, z), cosX, cosZ));
+			XMVECTOR nz = XMVectorMultiply(amplitude, XMVectorNegativeMultiplySubtract(XMVectorMultiply(frequency, x), sinZ, sinX));
+
+			XMVECTOR lengthSq = XMVectorMultiplyAdd(nz, nz, XMVectorMultiplyAdd(nx, nx, XMVectorSplatOne()));
+			XMVECTOR invLength = XMVectorReciprocalSqrt(lengthSq);
+
+			XMFLOAT4 px, py, pz;
+			XMStoreFloat4(&px, XMVectorNegate(XMVectorMultiply(nx, invLength)));
+			XMStoreFloat4(&py, invLength);
+			XMStoreFloat4(&pz, XMVectorNegate(XMVectorMultiply(nz, invLength)));
+
+			outNormals[i + 0] = XMFLOAT3(px.x, py.x, pz.x);
+			outNormals[i + 1] = XMFLOAT3(px.y, py.y, pz.y);
+			outNormals[i + 2] = XMFLOAT3(px.z, py.z, pz.z);
+			outNormals[i + 3] = XMFLOAT3(px.w, py.w, pz.w);
+		}
+#endif
+
+		for (; i < count; ++i) {
+			outNormals[i] = GetNormal(xs[i], zs[i]);
+		}
+	}
+
+	HeightMap::HeightMap() {
+	}
+
+	void HeightMap::Initialize(UINT width, UINT depth, float cellSpacing, const XMFLOAT2& origin,
+		std::vector<float> heights) {
+		m_Width = (std::max)(width, 2u);
+		m_Depth = (std::max)(depth, 2u);
+		m_CellSpacing = cellSpacing;
+		m_InvCellSpacing = 1.0f / cellSpacing;
+		m_Origin = origin;
+
+		m_Heights = std::move(heights);
+		m_Heights.resize((size_t)m_Width * m_Depth, 0.0f);
+
+		BuildNormalMap();
+	}
+
+	bool HeightMap::LoadRaw16(const std::string& filename, UINT width, UINT depth, float cellSpacing,
+		const XMFLOAT2& origin, float heightScale, float heightOffset) {
+		std::ifstream fin(filename, std::ios::binary);
+
+		if (!fin) {
+			return false;
+		}
+
+		std::vector<BYTE> raw((size_t)width * depth * 2);
+		fin.read(reinterpret_cast<char*>(raw.data()), raw.size());
+
+		if ((size_t)fin.gcount() != raw.size()) {
+			return false;
+		}
+
+		const float scale = heightScale / 65535.0f;
+
+		std::vector<float> heights((size_t)width * depth);
+		for (size_t i = 0; i < heights.size(); ++i) {
+			UINT sample = (UINT)raw[i * 2] | ((UINT)raw[i * 2 + 1] << 8);
+			heights[i] = sample * scale + heightOffset;
+		}
+
+		Initialize(width, depth, cellSpacing, origin, std::move(heights));
+
+		return true;
+	}
+
+	void HeightMap::BuildNormalMap() {
+		m_Normals.resize(m_Heights.size());
+
+		JobSystem::Get()->ParallelFor(m_Depth, 16, [&](size_t first, size_t last, size_t) {
+			for (UINT z = (UINT)first; z < (UINT)last; ++z) {
+				UINT z0 = (z == 0) ? 0 : z - 1;
+				UINT z1 = (std::min)(z + 1, m_Depth - 1);
+
+				for (UINT x = 0; x < m_Width; ++x) {
+					UINT x0 = (x == 0) ? 0 : x - 1;
+					UINT x1 = (std::min)(x + 1, m_Width - 1);
+
+					// Central differences; one-sided at the border.
+					float dx = (m_Heights[(size_t)z * m_Width + x1] - m_Heights[(size_t)z * m_Width + x0])
+						/ ((float)(x1 - x0) * m_CellSpacing);
+					float dz = (m_Heights[(size_t)z1 * m_Width + x] - m_Heights[(size_t)z0 * m_Width + x])
+						/ ((float)(z1 - z0) * m_CellSpacing);
+
+					XMVECTOR n = XMVector3Normalize(XMVectorSet(-dx, 1.0f, -dz, 0.0f));
+					XMStoreFloat3(&m_Normals[(size_t)z * m_Width + x], n);
+				}
+			}
+		});
+	}
+
+	void HeightMap::GetCell(float x, float z, UINT& ix, UINT& iz, float& fx, float& fz) const {
+		float gx = (std::min)((std::max)((x - m_Origin.x) * m_InvCellSpacing, 0.0f), (float)(m_Width - 1));
+		float gz = (std::min)((std::max)((z - m_Origin.y) * m_InvCellSpacing, 0.0f), (float)(m_Depth - 1));
+
+		ix = (std::min)((UINT)gx, m_Width - 2);
+		iz = (std::min)((UINT)gz, m_Depth - 2);
+		fx = gx - (float)ix;
+		fz = gz - (float)iz;
+	}
+
+	float HeightMap::GetHeight(float x, float z) const {
+		if (m_Heights.empty()) {
+			return 0.0f;
+		}
+
+		UINT ix, iz;
+		float fx, fz;
+		GetCell(x, z, ix, iz, fx, fz);
+
+		const float* row0 = &m_Heights[(size_t)iz * m_Width + ix];
+		const float* row1 = row0 + m_Width;
+
+		float h0 = row0[0] + (row0[1] - row0[0]) * fx;
+		float h1 = row1[0] + (row1[1] - row1[0]) * fx;
+
+		return h0 + (h1 - h0) * fz;
+	}
+
+	XMFLOAT3 HeightMap::GetNormal(float x, float z) const {
+		if (m_Normals.empty()) {
+			return XMFLOAT3(0.0f, 1.0f, 0.0f);
+		}
+
+		UINT ix, iz;
+		float fx, fz;
+		GetCell(x, z, ix, iz, fx, fz);
+
+		const XMFLOAT3* row0 = &m_Normals[(size_t)iz * m_Width + ix];
+		const XMFLOAT3* row1 = row0 + m_Width;
+
+		XMVECTOR n0 = XMVectorLerp(XMLoadFloat3(&row0[0]), XMLoadFloat3(&row0[1]), fx);
+		XMVECTOR n1 = XMVectorLerp(XMLoadFloat3(&row1[0]), XMLoadFloat3(&row1[1]), fx);
+
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, XMVector3Normalize(XMVectorLerp(n0, n1, fz)));
+
+		return n;
+	}
+
+	void HeightMap::GetHeightsRange(const float* xs, const float* zs, size_t count, float* outHeights) const {
+		if (m_Heights.empty()) {
+			std::fill(outHeights, outHeights + count, 0.0f);
+			return;
+		}
+
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		const __m256 originX = _mm256_set1_ps(m_Origin.x);
+		const __m256 originZ = _mm256_set1_ps(m_Origin.y);
+		const __m256 invCell = _mm256_set1_ps(m_InvCellSpacing);
+		const __m256 maxX = _mm256_set1_ps((float)(m_Width - 1));
+		const __m256 maxZ = _mm256_set1_ps((float)(m_Depth - 1));
+		const __m256i maxCellX = _mm256_set1_epi32((int)m_Width - 2);
+		const __m256i maxCellZ = _mm256_set1_epi32((int)m_Depth - 2);
+		const __m256i width = _mm256_set1_epi32((int)m_Width);
+		const float* heights = m_Heights.data();
+
+		for (; i + 8 <= count; i += 8) {
+			__m256 gx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(xs + i), originX), invCell);
+			__m256 gz = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(zs + i), originZ), invCell);
+			gx = _mm256_min_ps(_mm256_max_ps(gx, _mm256_setzero_ps()), maxX);
+			gz = _mm256_min_ps(_mm256_max_ps(gz, _mm256_setzero_ps()), maxZ);
+
+			__m256i ix = _mm256_min_epi32(_mm256_cvttps_epi32(gx), maxCellX);
+			__m256i iz = _mm256_min_epi32(_mm256_cvttps_epi32(gz), maxCellZ);
+			__m256 fx = _mm256_sub_ps(gx, _mm256_cvtepi32_ps(ix));
+			__m256 fz = _mm256_sub_ps(gz, _mm256_cvtepi32_ps(iz));
+
+			__m256i i00 = _mm256_add_epi32(_mm256_mullo_epi32(iz, width), ix);
+			__m256i i10 = _mm256_add_epi32(i00, width);
+
+			__m256 h00 = _mm256_i32gather_ps(heights, i00, 4);
+			__m256 h01 = _mm256_i32gather_ps(heights + 1, i00, 4);
+			__m256 h10 = _mm256_i32gather_ps(heights, i10, 4);
+			__m256 h11 = _mm256_i32gather_ps(heights + 1, i10, 4);
+
+			__m256 h = Lerp8(Lerp8(h00, h01, fx), Lerp8(h10, h11, fx), fz);
+			_mm256_storeu_ps(outHeights + i, h);
+		}
+#endif
+
+		for (; i < count; ++i) {
+			outHeights[i] = GetHeight(xs[i], zs[i]);
+		}
+	}
+
+	void HeightMap::GetNormalsRange(const float* xs, const float* zs, size_t count, XMFLOAT3* outNormals) const {
+		if (m_Normals.empty()) {
+			std::fill(outNormals, outNormals + count, XMFLOAT3(0.0f, 1.0f, 0.0f));
+			return;
+		}
+
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		const __m256 originX = _mm256_set1_ps(m_Origin.x);
+		const __m256 originZ = _mm256_set1_ps(m_Origin.y);
+		const __m256 invCell = _mm256_set1_ps(m_InvCellSpacing);
+		const __m256 maxX = _mm256_set1_ps((float)(m_Width - 1));
+		const __m256 maxZ = _mm256_set1_ps((float)(m_Depth - 1));
+		const __m256i maxCellX = _mm256_set1_epi32((int)m_Width - 2);
+		const __m256i maxCellZ = _mm256_set1_epi32((int)m_Depth - 2);
+		const __m256i width = _mm256_set1_epi32((int)m_Width);
+		const __m256i three = _mm256_set1_epi32(3);
+		const float* normals = &m_Normals[0].x;
+
+		for (; i + 8 <= count; i += 8) {
+			__m256 gx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(xs + i), originX), invCell);
+			__m256 gz = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(zs + i), originZ), invCell);
+			gx = _mm256_min_ps(_mm256_max_ps(gx, _mm256_setzero_ps()), maxX);
+			gz = _mm256_min_ps(_mm256_max_ps(gz, _mm256_setzero_ps()), maxZ);
+
+			__m256i ix = _mm256_min_epi32(_mm256_cvttps_epi32(gx), maxCellX);
+			__m256i iz = _mm256_min_epi32(_mm256_cvttps_epi32(gz), maxCellZ);
+			__m256 fx = _mm256_sub_ps(gx, _mm256_cvtepi32_ps(ix));
+			__m256 fz = _mm256_sub_ps(gz, _mm256_cvtepi32_ps(iz));
+
+			// Float offsets of the four corners' XMFLOAT3.
+			__m256i o00 = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(iz, width), ix), three);
+			__m256i o10 = _mm256_add_epi32(o00, _mm256_mullo_epi32(width, three));
+
+			__m256 n[3];
+			for (int c = 0; c < 3; ++c) {
+				__m256 n00 = _mm256_i32gather_ps(normals + c, o00, 4);
+				__m256 n01 = _mm256_i32gather_ps(normals + 3 + c, o00, 4);
+				__m256 n10 = _mm256_i32gather_ps(normals + c, o10, 4);
+				__m256 n11 = _mm256_i32gather_ps(normals + 3 + c, o10, 4);
+
+				n[c] = Lerp8(Lerp8(n00, n01, fx), Lerp8(n10, n11, fx), fz);
+			}
+
+			__m256 lengthSq = _mm256_fmadd_ps(n[2], n[2], _mm256_fmadd_ps(n[1], n[1], _mm256_mul_ps(n[0], n[0])));
+			__m256 invLength = ReciprocalSqrt8(lengthSq);
+
+			StoreNormals8(_mm256_mul_ps(n[0], invLength), _mm256_mul_ps(n[1], invLength),
+				_mm256_mul_ps(n[2], invLength), outNormals + i);
+		}
+#endif
+
+		for (; i < count; ++i) {
+			outNormals[i] = GetNormal(xs[i], zs[i]);
+		}
+	}
+
+	UINT HeightMap::GetWidth() const {
+		return m_Width;
+	}
+
+	UINT HeightMap::GetDepth() const {
+		return m_Depth;
+	}
+
+	float HeightMap::GetCellSpacing() const {
+		return m_CellSpacing;
+	}
+}
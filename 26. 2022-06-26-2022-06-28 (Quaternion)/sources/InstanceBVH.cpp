@@ -0,0 +1,491 @@
+#include "InstanceBVH.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		const int gSahBins = 12;
+
+		// Past this depth the build splits at the median so degenerate inputs stay O(log n) deep.
+		const int gMaxSahDepth = 48;
+
+		// Deeper than any tree the build can produce.
+		const int gMaxTraversalStack = 128;
+
+		// Refit sweeps the whole tree once more than 1 in this many nodes have a moved instance below.
+		const size_t gFullRefitRatio = 32;
+
+		// Slab distances are off by up to three roundings; see TriangleBVH.
+		const float gBoxExitScale = 1.0f + 2.0f * 1.7881393e-7f;
+
+		inline XMFLOAT3 Min3(const XMFLOAT3& a, const XMFLOAT3& b) {
+			return XMFLOAT3((std::min)(a.x, b.x), (std::min)(a.y, b.y), (std::min)(a.z, b.z));
+		}
+
+		inline XMFLOAT3 Max3(const XMFLOAT3& a, const XMFLOAT3& b) {
+			return XMFLOAT3((std::max)(a.x, b.x), (std::max)(a.y, b.y), (std::max)(a.z, b.z));
+		}
+
+		inline bool Equal3(const XMFLOAT3& a, const XMFLOAT3& b) {
+			return a.x == b.x && a.y == b.y && a.z == b.z;
+		}
+
+		inline float Area(const XMFLOAT3& mn, const XMFLOAT3& mx) {
+			float dx = mx.x - mn.x;
+			float dy = mx.y - mn.y;
+			float dz = mx.z - mn.z;
+			return 2.0f * (dx * dy + dy * dz + dz * dx);
+		}
+
+		inline float Axis(const XMFLOAT3& v, int axis) {
+			return (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
+		}
+
+		// Slab test against the box grown by grow on every side; outEntry is where the ray enters it,
+		// clamped to 0.
+		inline bool IntersectBox(const TriangleBVH::Node& node, FXMVECTOR origin, FXMVECTOR invDirection, FXMVECTOR grow,
+			float tMax, float& outEntry) {
+			XMVECTOR boxMin = XMVectorSubtract(XMLoadFloat3(&node.Min), grow);
+			XMVECTOR boxMax = XMVectorAdd(XMLoadFloat3(&node.Max), grow);
+			XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(boxMin, origin), invDirection);
+			XMVECTOR t2 = XMVectorMultiply(XMVectorSubtract(boxMax, origin), invDirection);
+
+			XMFLOAT3 tNear, tFar;
+			XMStoreFloat3(&tNear, XMVectorMin(t1, t2));
+			XMStoreFloat3(&tFar, XMVectorMax(t1, t2));
+
+			float entry = (std::max)((std::max)(tNear.x, tNear.y), (std::max)(tNear.z, 0.0f));
+			float exit = (std::min)((std::min)(tFar.x, tFar.y), (std::min)(tFar.z, tMax));
+
+			outEntry = entry;
+			return entry <= exit * gBoxExitScale;
+		}
+	}
+
+	InstanceBVH::InstanceBVH() {
+	}
+
+	InstanceBVH::~InstanceBVH() {
+	}
+
+	void InstanceBVH::Clear() {
+		m_Nodes.clear();
+		m_Parents.clear();
+
+		m_Meshes.clear();
+		m_World.clear();
+		m_InvWorld.clear();
+		m_Min.clear();
+		m_Max.clear();
+		m_Items.clear();
+		m_Instances.clear();
+		m_Leaves.clear();
+		m_Moved.clear();
+
+		m_MovedInstances.clear();
+	}
+
+	UINT InstanceBVH::AddInstance(const TriangleBVH* mesh, CXMMATRIX world, UINT item, UINT instance) {
+		const UINT id = (UINT)m_Meshes.size();
+
+		m_Meshes.push_back(mesh);
+		m_World.emplace_back();
+		m_InvWorld.emplace_back();
+		m_Min.emplace_back();
+		m_Max.emplace_back();
+		m_Items.push_back(item);
+		m_Instances.push_back(instance);
+		m_Leaves.push_back((UINT)NullInstance);
+		m_Moved.push_back(0);
+
+		Place(id, world);
+		return id;
+	}
+
+	void InstanceBVH::SetWorld(UINT id, CXMMATRIX world) {
+		Place(id, world);
+
+		if (m_Leaves[id] != NullInstance && m_Moved[id] == 0) {
+			m_Moved[id] = 1;
+			m_MovedInstances.push_back(id);
+		}
+	}
+
+	void InstanceBVH::Place(UINT id, CXMMATRIX world) {
+		// Rays go to mesh space through the inverse, so it is paid for once per move rather than per query.
+		// Sweeps place triangles in world space and keep the forward transform too.
+		XMStoreFloat4x3(&m_World[id], world);
+		XMStoreFloat4x3(&m_InvWorld[id], XMMatrixInverse(nullptr, world));
+
+		BoundingBox worldBounds;
+		m_Meshes[id]->GetBounds().Transform(worldBounds, world);
+
+		XMVECTOR center = XMLoadFloat3(&worldBounds.Center);
+		XMVECTOR extents = XMLoadFloat3(&worldBounds.Extents);
+		XMStoreFloat3(&m_Min[id], XMVectorSubtract(center, extents));
+		XMStoreFloat3(&m_Max[id], XMVectorAdd(center, extents));
+	}
+
+	void InstanceBVH::Build() {
+		m_Nodes.clear();
+		m_Parents.clear();
+
+		for (UINT id : m_MovedInstances) {
+			m_Moved[id] = 0;
+		}
+		m_MovedInstances.clear();
+
+		const size_t count = m_Meshes.size();
+		if (count == 0) return;
+
+		std::vector<UINT> ids(count);
+		std::vector<XMFLOAT3> centroids(count);
+		for (size_t i = 0; i < count; ++i) {
+			ids[i] = (UINT)i;
+			centroids[i] = XMFLOAT3(0.5f * (m_Min[i].x + m_Max[i].x), 0.5f * (m_Min[i].y + m_Max[i].y),
+				0.5f * (m_Min[i].z + m_Max[i].z));
+		}
+
+		m_Nodes.reserve(2 * count - 1);
+		m_Parents.reserve(2 * count - 1);
+		m_Nodes.emplace_back();
+		m_Parents.push_back((UINT)NullInstance);
+		BuildRange(ids, centroids, 0, 0, count, 0);
+	}
+
+	void InstanceBVH::BuildRange(std::vector<UINT>& ids, const std::vector<XMFLOAT3>& centroids, UINT node,
+		size_t first, size_t last, int depth) {
+		const size_t count = last - first;
+
+		XMFLOAT3 bMin(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+		XMFLOAT3 bMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		XMFLOAT3 cMin(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+		XMFLOAT3 cMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (size_t i = first; i < last; ++i) {
+			const UINT id = ids[i];
+			bMin = Min3(bMin, m_Min[id]);
+			bMax = Max3(bMax, m_Max[id]);
+			cMin = Min3(cMin, centroids[id]);
+			cMax = Max3(cMax, centroids[id]);
+		}
+
+		m_Nodes[node].Min = bMin;
+		m_Nodes[node].Max = bMax;
+
+		// One instance per leaf; its own BVH takes over from there.
+		if (count == 1) {
+			m_Nodes[node].Offset = ids[first];
+			m_Nodes[node].Count = 1;
+			m_Leaves[ids[first]] = node;
+			return;
+		}
+
+		XMFLOAT3 extent(cMax.x - cMin.x, cMax.y - cMin.y, cMax.z - cMin.z);
+		int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : ((extent.y > extent.z) ? 1 : 2);
+		const float axisMin = Axis(cMin, axis);
+		const float axisExtent = Axis(extent, axis);
+
+		size_t mid = first + count / 2;
+		bool sahSplit = false;
+
+		if (axisExtent > 0.0f && depth < gMaxSahDepth) {
+			struct Bin {
+				XMFLOAT3 Min = XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+				XMFLOAT3 Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				size_t Count = 0;
+			};
+
+			Bin bins[gSahBins];
+			const float binScale = gSahBins / axisExtent;
+
+			auto binOf = [&](UINT id) {
+				int b = (int)((Axis(centroids[id], axis) - axisMin) * binScale);
+				return (std::min)((std::max)(b, 0), gSahBins - 1);
+			};
+
+			for (size_t i = first; i < last; ++i) {
+				const UINT id = ids[i];
+				Bin& bin = bins[binOf(id)];
+				bin.Min = Min3(bin.Min, m_Min[id]);
+				bin.Max = Max3(bin.Max, m_Max[id]);
+				++bin.Count;
+			}
+
+			float rightArea[gSahBins];
+			size_t rightCount[gSahBins];
+			XMFLOAT3 accMin(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+			XMFLOAT3 accMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			size_t accCount = 0;
+
+			for (int b = gSahBins - 1; b > 0; --b) {
+				accMin = Min3(accMin, bins[b].Min);
+				accMax = Max3(accMax, bins[b].Max);
+				accCount += bins[b].Count;
+				rightArea[b] = (accCount > 0) ? Area(accMin, accMax) : 0.0f;
+				rightCount[b] = accCount;
+			}
+
+			int bestSplit = -1;
+			float bestCost = FLT_MAX;
+			accMin = XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+			accMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			accCount = 0;
+
+			for (int b = 0; b < gSahBins - 1; ++b) {
+				accMin = Min3(accMin, bins[b].Min);
+				accMax = Max3(accMax, bins[b].Max);
+				accCount += bins[b].Count;
+
+				if (accCount == 0 || rightCount[b + 1] == 0) continue;
+
+				float cost = accCount * Area(accMin, accMax) + rightCount[b + 1] * rightArea[b + 1];
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestSplit = b;
+				}
+			}
+
+			if (bestSplit >= 0) {
+				auto it = std::partition(ids.begin() + first, ids.begin() + last,
+					[&](UINT id) { return binOf(id) <= bestSplit; });
+				mid = (size_t)(it - ids.begin());
+				sahSplit = (mid != first && mid != last);
+			}
+		}
+
+		if (!sahSplit) {
+			mid = first + count / 2;
+			std::nth_element(ids.begin() + first, ids.begin() + mid, ids.begin() + last,
+				[&](UINT lhs, UINT rhs) { return Axis(centroids[lhs], axis) < Axis(centroids[rhs], axis); });
+		}
+
+		m_Nodes[node].Count = 0;
+
+		const UINT left = (UINT)m_Nodes.size();
+		m_Nodes.emplace_back();
+		m_Parents.push_back(node);
+		BuildRange(ids, centroids, left, first, mid, depth + 1);
+
+		const UINT right = (UINT)m_Nodes.size();
+		m_Nodes.emplace_back();
+		m_Parents.push_back(node);
+		m_Nodes[node].Offset = right;
+		BuildRange(ids, centroids, right, mid, last, depth + 1);
+	}
+
+	void InstanceBVH::Refit() {
+		for (UINT id : m_MovedInstances) {
+			m_Moved[id] = 0;
+
+			const UINT leaf = m_Leaves[id];
+			m_Nodes[leaf].Min = m_Min[id];
+			m_Nodes[leaf].Max = m_Max[id];
+		}
+
+		// Walking up from each leaf touches a node once per moved instance below it; past a few percent
+		// of the tree one sweep is cheaper. Children always come after their parent.
+		if (m_MovedInstances.size() * gFullRefitRatio > m_Nodes.size()) {
+			for (size_t node = m_Nodes.size(); node-- > 0;) {
+				TriangleBVH::Node& n = m_Nodes[node];
+				if (n.Count > 0) continue;
+
+				n.Min = Min3(m_Nodes[node + 1].Min, m_Nodes[n.Offset].Min);
+				n.Max = Max3(m_Nodes[node + 1].Max, m_Nodes[n.Offset].Max);
+			}
+		}
+		else {
+			for (UINT id : m_MovedInstances) {
+				// Walk up until a box comes out the same; everything above it already holds.
+				for (UINT node = m_Parents[m_Leaves[id]]; node != NullInstance; node = m_Parents[node]) {
+					const TriangleBVH::Node& left = m_Nodes[node + 1];
+					const TriangleBVH::Node& right = m_Nodes[m_Nodes[node].Offset];
+
+					XMFLOAT3 mn = Min3(left.Min, right.Min);
+					XMFLOAT3 mx = Max3(left.Max, right.Max);
+					if (Equal3(mn, m_Nodes[node].Min) && Equal3(mx, m_Nodes[node].Max)) break;
+
+					m_Nodes[node].Min = mn;
+					m_Nodes[node].Max = mx;
+				}
+			}
+		}
+
+		m_MovedInstances.clear();
+	}
+
+	template <bool AnyHitOnly, bool Sweep>
+	bool InstanceBVH::Traverse(FXMVECTOR origin, FXMVECTOR direction, float radius, float tMax, Hit& outHit) const {
+		if (m_Nodes.empty()) return false;
+
+		const XMVECTOR invDirection = XMVectorReciprocal(direction);
+		const XMVECTOR grow = XMVectorReplicate(radius);
+
+		float entry = 0.0f;
+		if (!IntersectBox(m_Nodes[0], origin, invDirection, grow, tMax, entry)) return false;
+
+		UINT stackNode[gMaxTraversalStack];
+		float stackEntry[gMaxTraversalStack];
+		int top = 0;
+
+		bool hit = false;
+		float closest = tMax;
+		UINT node = 0;
+
+		for (;;) {
+			const TriangleBVH::Node& n = m_Nodes[node];
+
+			if (n.Count > 0 && Sweep) {
+				const UINT id = n.Offset;
+
+				TriangleBVH::Hit meshHit;
+				if (m_Meshes[id]->SweepSphere(origin, direction, radius, XMLoadFloat4x3(&m_World[id]),
+					XMLoadFloat4x3(&m_InvWorld[id]), closest, meshHit)) {
+					if (AnyHitOnly) return true;
+
+					hit = true;
+					closest = meshHit.T;
+
+					outHit.T = meshHit.T;
+					outHit.U = meshHit.U;
+					outHit.V = meshHit.V;
+					outHit.Item = m_Items[id];
+					outHit.Instance = m_Instances[id];
+					outHit.Triangle = meshHit.Triangle;
+				}
+			}
+			else if (n.Count > 0) {
+				const UINT id = n.Offset;
+
+				// The direction keeps its length in mesh space so T means the same in every instance.
+				XMMATRIX invWorld = XMLoadFloat4x3(&m_InvWorld[id]);
+				XMVECTOR localOrigin = XMVector3TransformCoord(origin, invWorld);
+				XMVECTOR localDirection = XMVector3TransformNormal(direction, invWorld);
+
+				if (AnyHitOnly) {
+					if (m_Meshes[id]->AnyHit(localOrigin, localDirection, closest)) return true;
+				}
+				else {
+					TriangleBVH::Hit meshHit;
+					if (m_Meshes[id]->ClosestHit(localOrigin, localDirection, closest, meshHit)) {
+						hit = true;
+						closest = meshHit.T;
+
+						outHit.T = meshHit.T;
+						outHit.U = meshHit.U;
+						outHit.V = meshHit.V;
+						outHit.Item = m_Items[id];
+						outHit.Instance = m_Instances[id];
+						outHit.Triangle = meshHit.Triangle;
+					}
+				}
+			}
+			else {
+				UINT nearNode = node + 1;
+				UINT farNode = n.Offset;
+
+				float nearEntry = 0.0f;
+				float farEntry = 0.0f;
+				bool nearHit = IntersectBox(m_Nodes[nearNode], origin, invDirection, grow, closest, nearEntry);
+				bool farHit = IntersectBox(m_Nodes[farNode], origin, invDirection, grow, closest, farEntry);
+
+				if (nearHit && farHit) {
+					if (farEntry < nearEntry) {
+						std::swap(nearNode, farNode);
+						std::swap(nearEntry, farEntry);
+					}
+
+					stackNode[top] = farNode;
+					stackEntry[top] = farEntry;
+					++top;
+
+					node = nearNode;
+					entry = nearEntry;
+					continue;
+				}
+
+				if (nearHit || farHit) {
+					node = nearHit ? nearNode : farNode;
+					entry = nearHit ? nearEntry : farEntry;
+					continue;
+				}
+			}
+
+			do {
+				if (top == 0) return hit;
+				--top;
+			} while (stackEntry[top] > closest);
+
+			node = stackNode[top];
+			entry = stackEntry[top];
+		}
+	}
+
+	bool InstanceBVH::ClosestHit(FXMVECTOR origin, FXMVECTOR direction, float tMax, Hit& outHit) const {
+		return Traverse<false, false>(origin, direction, 0.0f, tMax, outHit);
+	}
+
+	bool InstanceBVH::AnyHit(FXMVECTOR origin, FXMVECTOR direction, float tMax) const {
+		Hit hit;
+		return Traverse<true, false>(origin, direction, 0.0f, tMax, hit);
+	}
+
+	bool InstanceBVH::SweepSphere(FXMVECTOR origin, FXMVECTOR direction, float radius, float tMax, Hit& outHit) const {
+		return Traverse<false, true>(origin, direction, radius, tMax, outHit);
+	}
+
+	void InstanceBVH::Overlap(const BoundingBox& box, std::vector<UINT>& outIds) const {
+		if (m_Nodes.empty()) return;
+
+		const XMFLOAT3 boxMin(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+		const XMFLOAT3 boxMax(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+
+		UINT stack[gMaxTraversalStack];
+		int top = 0;
+		stack[top++] = 0;
+
+		while (top > 0) {
+			const UINT node = stack[--top];
+			const TriangleBVH::Node& n = m_Nodes[node];
+
+			if (n.Min.x > boxMax.x || n.Max.x < boxMin.x ||
+				n.Min.y > boxMax.y || n.Max.y < boxMin.y ||
+				n.Min.z > boxMax.z || n.Max.z < boxMin.z) continue;
+
+			if (n.Count > 0) {
+				outIds.push_back(n.Offset);
+			}
+			else {
+				stack[top++] = n.Offset;
+				stack[top++] = node + 1;
+			}
+		}
+	}
+
+	UINT InstanceBVH::GetItem(UINT id) const {
+		return m_Items[id];
+	}
+
+	UINT InstanceBVH::GetInstanceIndex(UINT id) const {
+		return m_Instances[id];
+	}
+
+	BoundingBox InstanceBVH::GetBounds() const {
+		BoundingBox box;
+		if (m_Nodes.empty()) return box;
+
+		const TriangleBVH::Node& root = m_Nodes[0];
+		box.Center = XMFLOAT3(0.5f * (root.Min.x + root.Max.x), 0.5f * (root.Min.y + root.Max.y), 0.5f * (root.Min.z + root.Max.z));
+		box.Extents = XMFLOAT3(0.5f * (root.Max.x - root.Min.x), 0.5f * (root.Max.y - root.Min.y), 0.5f * (root.Max.z - root.Min.z));
+		return box;
+	}
+
+	size_t InstanceBVH::GetNodeCount() const {
+		return m_Nodes.size();
+	}
+
+	UINT InstanceBVH::GetInstanceCount() const {
+		return (UINT)m_Meshes.size();
+	}
+}
@@ -0,0 +1,109 @@
+#include "InstancePacker.h"
+
+#include <DirectXPackedVector.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// The half conversion is F16C, not AVX2. GCC and Clang only expose it under -mf16c; MSVC has no
+// separate switch and allows it with /arch:AVX2.
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define INSTANCEPACKER_F16C 1
+#endif
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		inline UINT PackHalf2(float x, float y) {
+			return (UINT)PackedVector::XMConvertFloatToHalf(x) | ((UINT)PackedVector::XMConvertFloatToHalf(y) << 16);
+		}
+
+#if defined(__AVX2__)
+		// a in the low lane, b in the high one.
+		inline __m256 LoadPair(const float* a, const float* b) {
+			return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a)), _mm_loadu_ps(b), 1);
+		}
+#endif
+	}
+
+	void InstancePacker::Pack(const XMFLOAT4X4* worlds, const XMFLOAT4X4* texTransforms, const UINT* materials,
+		const UINT* items, size_t count, PackedInstance* outInstances) {
+		size_t i = 0;
+
+#if defined(__AVX2__)
+		for (; i + 2 <= count; i += 2) {
+			const XMFLOAT4X4& wa = worlds[items[i]];
+			const XMFLOAT4X4& wb = worlds[items[i + 1]];
+			const XMFLOAT4X4& ta = texTransforms[items[i]];
+			const XMFLOAT4X4& tb = texTransforms[items[i + 1]];
+
+			PackedInstance& a = outInstances[i];
+			PackedInstance& b = outInstances[i + 1];
+
+			// Both matrices transposed at once, one per lane; the fourth column of an affine world is dropped.
+			__m256 r0 = LoadPair(&wa._11, &wb._11);
+			__m256 r1 = LoadPair(&wa._21, &wb._21);
+			__m256 r2 = LoadPair(&wa._31, &wb._31);
+			__m256 r3 = LoadPair(&wa._41, &wb._41);
+
+			__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+			__m256 t1 = _mm256_unpackhi_ps(r0, r1);
+			__m256 t2 = _mm256_unpacklo_ps(r2, r3);
+			__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+
+			__m256 c0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+			__m256 c1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+			__m256 c2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+
+			_mm_storeu_ps(&a.World._11, _mm256_castps256_ps128(c0));
+			_mm_storeu_ps(&a.World._21, _mm256_castps256_ps128(c1));
+			_mm_storeu_ps(&a.World._31, _mm256_castps256_ps128(c2));
+			_mm_storeu_ps(&b.World._11, _mm256_extractf128_ps(c0, 1));
+			_mm_storeu_ps(&b.World._21, _mm256_extractf128_ps(c1, 1));
+			_mm_storeu_ps(&b.World._31, _mm256_extractf128_ps(c2, 1));
+
+#if defined(INSTANCEPACKER_F16C)
+			// (_11, _12, _21, _22) of both texture transforms to halves in one conversion.
+			__m256 linear = _mm256_insertf128_ps(
+				_mm256_castps128_ps256(_mm_movelh_ps(_mm_loadu_ps(&ta._11), _mm_loadu_ps(&ta._21))),
+				_mm_movelh_ps(_mm_loadu_ps(&tb._11), _mm_loadu_ps(&tb._21)), 1);
+			__m128i halves = _mm256_cvtps_ph(linear, _MM_FROUND_TO_NEAREST_INT);
+
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(a.TexScale), halves);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(b.TexScale), _mm_unpackhi_epi64(halves, halves));
+#else
+			a.TexScale[0] = PackHalf2(ta._11, ta._12);
+			a.TexScale[1] = PackHalf2(ta._21, ta._22);
+			b.TexScale[0] = PackHalf2(tb._11, tb._12);
+			b.TexScale[1] = PackHalf2(tb._21, tb._22);
+#endif
+
+			a.TexOffset = XMFLOAT2(ta._41, ta._42);
+			b.TexOffset = XMFLOAT2(tb._41, tb._42);
+
+			a.MaterialIndex = (UINT16)materials[items[i]];
+			a.Reserved = 0;
+			b.MaterialIndex = (UINT16)materials[items[i + 1]];
+			b.Reserved = 0;
+		}
+#endif
+
+		for (; i < count; ++i) {
+			Pack(worlds[items[i]], texTransforms[items[i]], materials[items[i]], outInstances[i]);
+		}
+	}
+
+	void InstancePacker::Pack(const XMFLOAT4X4& world, const XMFLOAT4X4& texTransform, UINT material,
+		PackedInstance& outInstance) {
+		XMStoreFloat3x4(&outInstance.World, XMLoadFloat4x4(&world));
+
+		outInstance.TexOffset = XMFLOAT2(texTransform._41, texTransform._42);
+		outInstance.TexScale[0] = PackHalf2(texTransform._11, texTransform._12);
+		outInstance.TexScale[1] = PackHalf2(texTransform._21, texTransform._22);
+
+		outInstance.MaterialIndex = (UINT16)material;
+		outInstance.Reserved = 0;
+	}
+}
@@ -0,0 +1,149 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace Mawi1e {
+	namespace {
+		// Set while the thread runs a chunk, so ParallelFor from inside a job runs inline.
+		thread_local bool gInJob = false;
+	}
+
+	JobSystem::JobSystem() {
+	}
+
+	JobSystem::~JobSystem() {
+		Shutdown();
+	}
+
+	JobSystem* JobSystem::Get() {
+		static JobSystem jobSystem;
+		return &jobSystem;
+	}
+
+	void JobSystem::Initialize(UINT workerCount) {
+		Shutdown();
+
+		if (workerCount == 0) {
+			UINT hardwareThreads = std::thread::hardware_concurrency();
+			workerCount = (hardwareThreads > 1) ? (hardwareThreads - 1) : 0;
+		}
+
+		m_Quit = false;
+		for (UINT i = 0; i < workerCount; ++i) {
+			m_Workers.emplace_back(&JobSystem::WorkerLoop, this);
+		}
+	}
+
+	void JobSystem::Shutdown() {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Quit = true;
+		}
+		m_WakeUp.notify_all();
+
+		for (auto& worker : m_Workers) {
+			if (worker.joinable()) {
+				worker.join();
+			}
+		}
+
+		m_Workers.clear();
+	}
+
+	UINT JobSystem::GetWorkerCount() const {
+		return (UINT)m_Workers.size();
+	}
+
+	size_t JobSystem::GetChunkCount(size_t count, size_t minChunkSize) const {
+		if (minChunkSize == 0) {
+			minChunkSize = 1;
+		}
+
+		// A few chunks per thread so that uneven chunks still balance out.
+		const size_t maxChunks = (m_Workers.size() + 1) * 4;
+		size_t chunks = (count + minChunkSize - 1) / minChunkSize;
+
+		return (chunks < maxChunks) ? chunks : maxChunks;
+	}
+
+	void JobSystem::ParallelFor(size_t count, size_t minChunkSize, const RangeJob& job) {
+		if (count == 0) {
+			return;
+		}
+
+		const size_t chunkCount = GetChunkCount(count, minChunkSize);
+
+		if (chunkCount <= 1 || m_Workers.empty() || gInJob) {
+			for (size_t c = 0; c < chunkCount; ++c) {
+				job((c * count) / chunkCount, ((c + 1) * count) / chunkCount, c);
+			}
+			return;
+		}
+
+		Dispatch dispatch;
+		dispatch.Job = &job;
+		dispatch.Count = count;
+		dispatch.ChunkCount = chunkCount;
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Queue.push_back(&dispatch);
+		}
+		m_WakeUp.notify_all();
+
+		// The caller works through its own chunks, so a call finishes even while every worker is busy
+		// with older ones.
+		for (;;) {
+			size_t c;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				if (dispatch.NextChunk == dispatch.ChunkCount) break;
+
+				c = dispatch.NextChunk++;
+				if (dispatch.NextChunk == dispatch.ChunkCount) {
+					m_Queue.erase(std::find(m_Queue.begin(), m_Queue.end(), &dispatch));
+				}
+			}
+
+			RunChunk(dispatch, c);
+		}
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Finished.wait(lock, [&dispatch]() { return dispatch.DoneChunks == dispatch.ChunkCount; });
+	}
+
+	void JobSystem::WorkerLoop() {
+		for (;;) {
+			Dispatch* dispatch;
+			size_t c;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_WakeUp.wait(lock, [this]() { return m_Quit || !m_Queue.empty(); });
+
+				if (m_Quit) {
+					return;
+				}
+
+				dispatch = m_Queue.front();
+				c = dispatch->NextChunk++;
+				if (dispatch->NextChunk == dispatch->ChunkCount) {
+					m_Queue.erase(m_Queue.begin());
+				}
+			}
+
+			RunChunk(*dispatch, c);
+		}
+	}
+
+	void JobSystem::RunChunk(Dispatch& dispatch, size_t c) {
+		gInJob = true;
+		(*dispatch.Job)((c * dispatch.Count) / dispatch.ChunkCount, ((c + 1) * dispatch.Count) / dispatch.ChunkCount, c);
+		gInJob = false;
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			++dispatch.DoneChunks;
+		}
+		m_Finished.notify_all();
+	}
+}
@@ -0,0 +1,342 @@
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		const UINT gBandTileRows = 4;
+		const UINT gFullCoverage = 0xffffffffu;
+
+		inline XMFLOAT4 LerpClip(const XMFLOAT4& a, const XMFLOAT4& b, float t) {
+			return XMFLOAT4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t);
+		}
+	}
+
+	OcclusionCuller::OcclusionCuller() {
+	}
+
+	OcclusionCuller::~OcclusionCuller() {
+	}
+
+	void OcclusionCuller::Initialize(UINT width, UINT height) {
+		m_TilesX = (width + TileWidth - 1) / TileWidth;
+		m_TilesY = (height + TileHeight - 1) / TileHeight;
+		m_Width = m_TilesX * TileWidth;
+		m_Height = m_TilesY * TileHeight;
+		m_BandCount = (m_TilesY + gBandTileRows - 1) / gBandTileRows;
+
+		m_Mask.assign(m_TilesX * m_TilesY, 0);
+		m_WorkingZ.assign(m_TilesX * m_TilesY, 1.0f);
+		m_ReferenceZ.assign(m_TilesX * m_TilesY, 1.0f);
+		m_Bins.resize(m_BandCount);
+	}
+
+	OcclusionCuller::Mesh OcclusionCuller::BuildBoxMesh(const XMFLOAT3& center, const XMFLOAT3& extents) {
+		Mesh mesh;
+
+		for (int i = 0; i < 8; ++i) {
+			mesh.Positions.push_back(XMFLOAT3(
+				center.x + ((i & 1) ? extents.x : -extents.x),
+				center.y + ((i & 2) ? extents.y : -extents.y),
+				center.z + ((i & 4) ? extents.z : -extents.z)));
+		}
+
+		// Winding does not matter, occluders are rasterized two-sided.
+		mesh.Indices = {
+			0, 1, 3, 0, 3, 2,	// -z
+			4, 5, 7, 4, 7, 6,	// +z
+			0, 1, 5, 0, 5, 4,	// -y
+			2, 3, 7, 2, 7, 6,	// +y
+			0, 2, 6, 0, 6, 4,	// -x
+			1, 3, 7, 1, 7, 5,	// +x
+		};
+
+		return mesh;
+	}
+
+	void OcclusionCuller::BeginFrame(FXMMATRIX viewProj) {
+		XMStoreFloat4x4(&m_ViewProj, viewProj);
+
+		m_Triangles.clear();
+		std::fill(m_Mask.begin(), m_Mask.end(), 0u);
+		std::fill(m_WorkingZ.begin(), m_WorkingZ.end(), 1.0f);
+		std::fill(m_ReferenceZ.begin(), m_ReferenceZ.end(), 1.0f);
+	}
+
+	void OcclusionCuller::AddOccluder(const Mesh& mesh, FXMMATRIX world) {
+		XMMATRIX toClip = XMMatrixMultiply(world, XMLoadFloat4x4(&m_ViewProj));
+
+		std::vector<XMFLOAT4> clip(mesh.Positions.size());
+		for (size_t i = 0; i < mesh.Positions.size(); ++i) {
+			XMStoreFloat4(&clip[i], XMVector3Transform(XMLoadFloat3(&mesh.Positions[i]), toClip));
+		}
+
+		for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3) {
+			const XMFLOAT4 in[3] = { clip[mesh.Indices[i]], clip[mesh.Indices[i + 1]], clip[mesh.Indices[i + 2]] };
+
+			// Clip against the near plane (z >= 0); the other planes are handled by the screen bounds.
+			XMFLOAT4 out[4];
+			int count = 0;
+
+			for (int v = 0; v < 3; ++v) {
+				const XMFLOAT4& curr = in[v];
+				const XMFLOAT4& next = in[(v + 1) % 3];
+
+				if (curr.z >= 0.0f) {
+					out[count++] = curr;
+				}
+				if ((curr.z >= 0.0f) != (next.z >= 0.0f)) {
+					out[count++] = LerpClip(curr, next, curr.z / (curr.z - next.z));
+				}
+			}
+
+			if (count >= 3) SetupTriangle(out[0], out[1], out[2]);
+			if (count == 4) SetupTriangle(out[0], out[2], out[3]);
+		}
+	}
+
+	void OcclusionCuller::SetupTriangle(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c) {
+		const XMFLOAT4* clip[3] = { &a, &b, &c };
+		float x[3], y[3], z[3];
+
+		for (int i = 0; i < 3; ++i) {
+			float invW = 1.0f / clip[i]->w;
+			x[i] = (clip[i]->x * invW * 0.5f + 0.5f) * m_Width;
+			y[i] = (0.5f - clip[i]->y * invW * 0.5f) * m_Height;
+			z[i] = clip[i]->z * invW;
+		}
+
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (fabsf(area) < 1e-6f) return;
+
+		float minX = std::min({ x[0], x[1], x[2] });
+		float maxX = std::max({ x[0], x[1], x[2] });
+		float minY = std::min({ y[0], y[1], y[2] });
+		float maxY = std::max({ y[0], y[1], y[2] });
+		float minZ = std::min({ z[0], z[1], z[2] });
+
+		if (maxX < 0.0f || maxY < 0.0f || minX >= (float)m_Width || minY >= (float)m_Height || minZ > 1.0f) return;
+
+		Triangle tri;
+		const float sign = (area > 0.0f) ? 1.0f : -1.0f;
+
+		for (int i = 0; i < 3; ++i) {
+			int j = (i + 1) % 3;
+			tri.EdgeA[i] = sign * (y[i] - y[j]);
+			tri.EdgeB[i] = sign * (x[j] - x[i]);
+			tri.EdgeC[i] = sign * (x[i] * y[j] - x[j] * y[i]);
+		}
+
+		float invArea = 1.0f / area;
+		tri.ZX = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * invArea;
+		tri.ZY = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * invArea;
+		tri.Z0 = z[0] - tri.ZX * x[0] - tri.ZY * y[0];
+		tri.MinZ = std::max(minZ, 0.0f);
+		tri.MaxZ = std::min(std::max({ z[0], z[1], z[2] }), 1.0f);
+
+		tri.MinTileX = (int)std::max(minX, 0.0f) / (int)TileWidth;
+		tri.MaxTileX = (int)std::min(maxX, (float)(m_Width - 1)) / (int)TileWidth;
+		tri.MinTileY = (int)std::max(minY, 0.0f) / (int)TileHeight;
+		tri.MaxTileY = (int)std::min(maxY, (float)(m_Height - 1)) / (int)TileHeight;
+
+		m_Triangles.push_back(tri);
+	}
+
+	void OcclusionCuller::Rasterize() {
+		for (auto& bin : m_Bins) {
+			bin.clear();
+		}
+
+		for (UINT i = 0; i < (UINT)m_Triangles.size(); ++i) {
+			UINT firstBand = m_Triangles[i].MinTileY / gBandTileRows;
+			UINT lastBand = m_Triangles[i].MaxTileY / gBandTileRows;
+
+			for (UINT band = firstBand; band <= lastBand; ++band) {
+				m_Bins[band].push_back(i);
+			}
+		}
+
+		// Bands own disjoint tile rows, so no two jobs touch the same tile.
+		JobSystem::Get()->ParallelFor(m_BandCount, 1, [this](size_t first, size_t last, size_t) {
+			for (size_t band = first; band < last; ++band) {
+				RasterizeBand((UINT)band);
+			}
+		});
+	}
+
+	void OcclusionCuller::RasterizeBand(UINT band) {
+		const int firstRow = (int)(band * gBandTileRows);
+		const int lastRow = std::min((int)((band + 1) * gBandTileRows), (int)m_TilesY) - 1;
+
+		for (UINT index : m_Bins[band]) {
+			const Triangle& tri = m_Triangles[index];
+			RasterizeTriangle(tri, std::max(tri.MinTileY, firstRow), std::min(tri.MaxTileY, lastRow));
+		}
+	}
+
+	void OcclusionCuller::RasterizeTriangle(const Triangle& tri, int firstTileRow, int lastTileRow) {
+		for (int ty = firstTileRow; ty <= lastTileRow; ++ty) {
+			for (int tx = tri.MinTileX; tx <= tri.MaxTileX; ++tx) {
+				if (tri.MinZ >= m_ReferenceZ[ty * m_TilesX + tx]) continue;
+
+				UINT coverage = CoverageMask(tri, tx, ty);
+				if (coverage == 0) continue;
+
+				// Farthest point of the depth plane over the tile, never past the farthest vertex.
+				float x0 = (float)(tx * TileWidth), x1 = x0 + TileWidth;
+				float y0 = (float)(ty * TileHeight), y1 = y0 + TileHeight;
+				float depth = std::max(tri.ZX * x0, tri.ZX * x1) + std::max(tri.ZY * y0, tri.ZY * y1) + tri.Z0;
+				depth = std::max(std::min(depth, tri.MaxZ), 0.0f);
+
+				UpdateTile(ty * m_TilesX + tx, coverage, depth);
+			}
+		}
+	}
+
+	UINT OcclusionCuller::CoverageMask(const Triangle& tri, int tileX, int tileY) const {
+		// Bit (row * 8 + column) for the pixel centers of the tile.
+		UINT mask = 0;
+
+#if defined(__AVX2__)
+		const __m256 laneX = _mm256_add_ps(
+			_mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f), _mm256_set1_ps((float)(tileX * TileWidth)));
+
+		__m256 edgeX[3];
+		for (int e = 0; e < 3; ++e) {
+			edgeX[e] = _mm256_mul_ps(_mm256_set1_ps(tri.EdgeA[e]), laneX);
+		}
+
+		for (UINT row = 0; row < TileHeight; ++row) {
+			const float py = (float)(tileY * TileHeight + row) + 0.5f;
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+			for (int e = 0; e < 3; ++e) {
+				__m256 value = _mm256_add_ps(edgeX[e], _mm256_set1_ps(tri.EdgeB[e] * py + tri.EdgeC[e]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(value, _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+
+			mask |= (UINT)_mm256_movemask_ps(inside) << (row * TileWidth);
+		}
+#else
+		for (UINT row = 0; row < TileHeight; ++row) {
+			const float py = (float)(tileY * TileHeight + row) + 0.5f;
+
+			for (UINT column = 0; column < TileWidth; ++column) {
+				const float px = (float)(tileX * TileWidth + column) + 0.5f;
+				bool inside = true;
+
+				for (int e = 0; e < 3; ++e) {
+					inside &= (tri.EdgeA[e] * px + tri.EdgeB[e] * py + tri.EdgeC[e]) >= 0.0f;
+				}
+
+				if (inside) mask |= 1u << (row * TileWidth + column);
+			}
+		}
+#endif
+
+		return mask;
+	}
+
+	void OcclusionCuller::UpdateTile(UINT tile, UINT coverage, float depth) {
+		// Behind everything the tile already guarantees.
+		if (depth >= m_ReferenceZ[tile]) return;
+
+		UINT& mask = m_Mask[tile];
+		float& workingZ = m_WorkingZ[tile];
+		const float referenceZ = m_ReferenceZ[tile];
+
+		// Start the working layer over when the new triangle is much closer than what it holds;
+		// dropping coverage only makes the tile less tight, never wrong.
+		if (mask == 0 || (workingZ - depth) > (referenceZ - workingZ)) {
+			mask = coverage;
+			workingZ = depth;
+		}
+		else {
+			mask |= coverage;
+			workingZ = std::max(workingZ, depth);
+		}
+
+		// A fully covered working layer becomes the new reference.
+		if (mask == gFullCoverage) {
+			m_ReferenceZ[tile] = std::min(referenceZ, workingZ);
+			mask = 0;
+			workingZ = 1.0f;
+		}
+	}
+
+	bool OcclusionCuller::IsVisible(const BoundingBox& worldBox) const {
+		XMMATRIX viewProj = XMLoadFloat4x4(&m_ViewProj);
+
+		float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+
+		for (int i = 0; i < 8; ++i) {
+			XMVECTOR corner = XMVectorSet(
+				worldBox.Center.x + ((i & 1) ? worldBox.Extents.x : -worldBox.Extents.x),
+				worldBox.Center.y + ((i & 2) ? worldBox.Extents.y : -worldBox.Extents.y),
+				worldBox.Center.z + ((i & 4) ? worldBox.Extents.z : -worldBox.Extents.z), 1.0f);
+
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector4Transform(corner, viewProj));
+
+			// Crosses the near plane: too close to bound on screen.
+			if (clip.z < 0.0f || clip.w <= 1e-6f) return true;
+
+			float invW = 1.0f / clip.w;
+			float sx = (clip.x * invW * 0.5f + 0.5f) * m_Width;
+			float sy = (0.5f - clip.y * invW * 0.5f) * m_Height;
+
+			minX = std::min(minX, sx);
+			maxX = std::max(maxX, sx);
+			minY = std::min(minY, sy);
+			maxY = std::max(maxY, sy);
+			minZ = std::min(minZ, clip.z * invW);
+		}
+
+		if (maxX < 0.0f || maxY < 0.0f || minX >= (float)m_Width || minY >= (float)m_Height) return false;
+
+		const int tx0 = (int)std::max(minX, 0.0f) / (int)TileWidth;
+		const int tx1 = (int)std::min(maxX, (float)(m_Width - 1)) / (int)TileWidth;
+		const int ty0 = (int)std::max(minY, 0.0f) / (int)TileHeight;
+		const int ty1 = (int)std::min(maxY, (float)(m_Height - 1)) / (int)TileHeight;
+
+		// Visible as soon as one tile may hold something farther than the box's nearest point.
+		for (int ty = ty0; ty <= ty1; ++ty) {
+			const float* row = &m_ReferenceZ[ty * m_TilesX];
+			int tx = tx0;
+
+#if defined(__AVX2__)
+			const __m256 boxZ = _mm256_set1_ps(minZ);
+			for (; tx + 8 <= tx1 + 1; tx += 8) {
+				if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(row + tx), boxZ, _CMP_GE_OQ)) != 0) return true;
+			}
+#endif
+
+			for (; tx <= tx1; ++tx) {
+				if (row[tx] >= minZ) return true;
+			}
+		}
+
+		return false;
+	}
+
+	UINT OcclusionCuller::GetWidth() const {
+		return m_Width;
+	}
+
+	UINT OcclusionCuller::GetHeight() const {
+		return m_Height;
+	}
+
+	UINT OcclusionCuller::GetTriangleCount() const {
+		return (UINT)m_Triangles.size();
+	}
+}
@@ -1,5 +1,10 @@
 #include "Quaternion.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
 float BoneAnimation::GetStartTime() const
 {
 	return keyFrames.front().TimePos;
@@ -11,55 +16,225 @@ float BoneAnimation::GetEndTime() const
 	return f;
 }
 
-void BoneAnimation::Interpolate(float dt, DirectX::XMFLOAT4X4& M) const
+void BoneAnimation::BuildTimeTable()
 {
-	if (dt <= keyFrames.front().TimePos)
+	timePos.resize(keyFrames.size());
+
+	for (size_t i = 0; i < keyFrames.size(); ++i)
 	{
-		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMVECTOR S = XMLoadFloat3(&keyFrames.front().Scale);
-		XMVECTOR P = XMLoadFloat3(&keyFrames.front().Translation);
-		XMVECTOR Q = XMLoadFloat4(&keyFrames.front().RotationQuat);
+		timePos[i] = keyFrames[i].TimePos;
+	}
+}
+
+float BoneAnimation::WrapTime(float dt) const
+{
+	float start = GetStartTime();
+	float duration = GetEndTime() - start;
 
-		XMMATRIX A = XMMatrixAffineTransformation(S, zero, Q, P);
-		XMStoreFloat4x4(&M, A);
+	if (duration <= 0.0f)
+	{
+		return start;
 	}
-	else if (dt >= keyFrames.back().TimePos)
+
+	float t = std::fmod(dt - start, duration);
+	if (t < 0.0f)
 	{
-		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-		XMVECTOR S = XMLoadFloat3(&keyFrames.back().Scale);
-		XMVECTOR P = XMLoadFloat3(&keyFrames.back().Translation);
-		XMVECTOR Q = XMLoadFloat4(&keyFrames.back().RotationQuat);
+		t += duration;
+	}
 
-		XMMATRIX A = XMMatrixAffineTransformation(S, zero, Q, P);
-		XMStoreFloat4x4(&M, A);
+	return start + t;
+}
+
+void BoneAnimation::Interpolate(float dt, DirectX::XMFLOAT4X4& M) const
+{
+	assert(!keyFrames.empty() && timePos.size() == keyFrames.size() && "BuildTimeTable has to run first");
+
+	if (dt <= timePos.front())
+	{
+		Pose(keyFrames.front(), M);
+	}
+	else if (dt >= timePos.back())
+	{
+		Pose(keyFrames.back(), M);
 	}
 	else
 	{
-		for (size_t i = 0; i < keyFrames.size() - 1; ++i)
-		{
-			if (dt >= keyFrames[i].TimePos && dt <= keyFrames[i + 1].TimePos)
-			{
-				float t = (dt - keyFrames[i].TimePos) / (keyFrames[i + 1].TimePos - keyFrames[i].TimePos);
+		Blend(FindKey(dt), dt, M);
+	}
+}
+
+void BoneAnimation::Interpolate(float dt, DirectX::XMFLOAT4X4& M, AnimationCursor& cursor) const
+{
+	assert(!keyFrames.empty() && timePos.size() == keyFrames.size() && "BuildTimeTable has to run first");
+
+	if (dt <= timePos.front())
+	{
+		cursor.Key = 0;
+		Pose(keyFrames.front(), M);
+	}
+	else if (dt >= timePos.back())
+	{
+		cursor.Key = timePos.size() - 2;
+		Pose(keyFrames.back(), M);
+	}
+	else
+	{
+		Blend(FindKey(dt, cursor), dt, M);
+	}
+}
 
-				XMVECTOR s0 = XMLoadFloat3(&keyFrames[i].Scale);
-				XMVECTOR p0 = XMLoadFloat3(&keyFrames[i].Translation);
-				XMVECTOR q0 = XMLoadFloat4(&keyFrames[i].RotationQuat);
+void BoneAnimation::Interpolate(float dt, DirectX::XMFLOAT3& S, DirectX::XMFLOAT4& Q, DirectX::XMFLOAT3& T) const
+{
+	assert(!keyFrames.empty() && timePos.size() == keyFrames.size() && "BuildTimeTable has to run first");
+
+	if (dt <= timePos.front() || dt >= timePos.back())
+	{
+		const Keyframe& k = (dt <= timePos.front()) ? keyFrames.front() : keyFrames.back();
+		S = k.Scale;
+		Q = k.RotationQuat;
+		T = k.Translation;
+		return;
+	}
 
-				XMVECTOR s1 = XMLoadFloat3(&keyFrames[i + 1].Scale);
-				XMVECTOR p1 = XMLoadFloat3(&keyFrames[i + 1].Translation);
-				XMVECTOR q1 = XMLoadFloat4(&keyFrames[i + 1].RotationQuat);
+	size_t key = FindKey(dt);
+	const Keyframe& k0 = keyFrames[key];
+	const Keyframe& k1 = keyFrames[key + 1];
 
-				XMVECTOR S = XMVectorLerp(s0, s1, t);
-				XMVECTOR P = XMVectorLerp(p0, p1, t);
-				XMVECTOR Q = XMQuaternionSlerp(q0, q1, t);
+	float t = (dt - timePos[key]) / (timePos[key + 1] - timePos[key]);
 
-				XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-				XMMATRIX A = XMMatrixAffineTransformation(S, zero, Q, P);
-				XMStoreFloat4x4(&M, A);
+	XMStoreFloat3(&S, XMVectorLerp(XMLoadFloat3(&k0.Scale), XMLoadFloat3(&k1.Scale), t));
+	XMStoreFloat4(&Q, XMQuaternionSlerp(XMLoadFloat4(&k0.RotationQuat), XMLoadFloat4(&k1.RotationQuat), t));
+	XMStoreFloat3(&T, XMVectorLerp(XMLoadFloat3(&k0.Translation), XMLoadFloat3(&k1.Translation), t));
+}
 
-				break;
-			}
+// Both searches expect timePos.front() < dt < timePos.back() and return i with
+// timePos[i] <= dt < timePos[i + 1].
+size_t BoneAnimation::FindKey(float dt) const
+{
+	size_t upper = std::upper_bound(timePos.begin(), timePos.end(), dt) - timePos.begin();
+	return upper - 1;
+}
+
+size_t BoneAnimation::FindKey(float dt, AnimationCursor& cursor) const
+{
+	size_t last = timePos.size() - 2;
+	size_t key = (cursor.Key < last) ? cursor.Key : last;
+
+	// Playing forward the time is still in the same span or has moved on to the next one; playing
+	// backwards it may have moved to the previous one. Anything further away is a seek.
+	if (dt >= timePos[key])
+	{
+		if (dt < timePos[key + 1])
+		{
+			cursor.Key = key;
+			return key;
 		}
+
+		if (key < last && dt < timePos[key + 2])
+		{
+			cursor.Key = key + 1;
+			return key + 1;
+		}
+	}
+	else if (key > 0 && dt >= timePos[key - 1])
+	{
+		cursor.Key = key - 1;
+		return key - 1;
+	}
+
+	cursor.Key = FindKey(dt);
+	return cursor.Key;
+}
+
+void BoneAnimation::Pose(const Keyframe& key, DirectX::XMFLOAT4X4& M) const
+{
+	XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	XMVECTOR S = XMLoadFloat3(&key.Scale);
+	XMVECTOR P = XMLoadFloat3(&key.Translation);
+	XMVECTOR Q = XMLoadFloat4(&key.RotationQuat);
+
+	XMMATRIX A = XMMatrixAffineTransformation(S, zero, Q, P);
+	XMStoreFloat4x4(&M, A);
+}
+
+void BoneAnimation::Blend(size_t key, float dt, DirectX::XMFLOAT4X4& M) const
+{
+	const Keyframe& k0 = keyFrames[key];
+	const Keyframe& k1 = keyFrames[key + 1];
+
+	float t = (dt - timePos[key]) / (timePos[key + 1] - timePos[key]);
+
+	XMVECTOR s0 = XMLoadFloat3(&k0.Scale);
+	XMVECTOR p0 = XMLoadFloat3(&k0.Translation);
+	XMVECTOR q0 = XMLoadFloat4(&k0.RotationQuat);
+
+	XMVECTOR s1 = XMLoadFloat3(&k1.Scale);
+	XMVECTOR p1 = XMLoadFloat3(&k1.Translation);
+	XMVECTOR q1 = XMLoadFloat4(&k1.RotationQuat);
+
+	XMVECTOR S = XMVectorLerp(s0, s1, t);
+	XMVECTOR P = XMVectorLerp(p0, p1, t);
+	XMVECTOR Q = XMQuaternionSlerp(q0, q1, t);
+
+	XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	XMMATRIX A = XMMatrixAffineTransformation(S, zero, Q, P);
+	XMStoreFloat4x4(&M, A);
+}
+
+float AnimationClip::GetClipStartTime() const
+{
+	float t = FLT_MAX;
+	for (const BoneAnimation& bone : boneAnimations)
+	{
+		t = (std::min)(t, bone.GetStartTime());
+	}
+
+	return t;
+}
+
+float AnimationClip::GetClipEndTime() const
+{
+	float t = -FLT_MAX;
+	for (const BoneAnimation& bone : boneAnimations)
+	{
+		t = (std::max)(t, bone.GetEndTime());
+	}
+
+	return t;
+}
+
+void AnimationClip::BuildTimeTables()
+{
+	for (BoneAnimation& bone : boneAnimations)
+	{
+		bone.BuildTimeTable();
+	}
+}
+
+float AnimationClip::WrapTime(float dt) const
+{
+	float start = GetClipStartTime();
+	float duration = GetClipEndTime() - start;
+
+	if (duration <= 0.0f)
+	{
+		return start;
+	}
+
+	float t = std::fmod(dt - start, duration);
+	if (t < 0.0f)
+	{
+		t += duration;
+	}
+
+	return start + t;
+}
+
+void AnimationClip::Interpolate(float dt, DirectX::XMFLOAT4X4* boneTransforms, AnimationCursor* cursors) const
+{
+	for (size_t i = 0; i < boneAnimations.size(); ++i)
+	{
+		boneAnimations[i].Interpolate(dt, boneTransforms[i], cursors[i]);
 	}
 }
 
@@ -67,6 +242,7 @@ QuaternionManager::QuaternionManager()
 {
 	m_BoneAnimator = {};
 	m_AnimateFrame = 0.0f;
+	m_PlaybackRate = 1.0f;
 }
 
 QuaternionManager::~QuaternionManager()
@@ -105,16 +281,17 @@ void QuaternionManager::Initailize()
 	m_BoneAnimator.keyFrames[4].Translation = XMFLOAT3(-10.0f, 0.0f, 0.0f);
 	m_BoneAnimator.keyFrames[4].Scale = XMFLOAT3(1.25f, 1.25f, 1.25f);
 	XMStoreFloat4(&m_BoneAnimator.keyFrames[4].RotationQuat, q0);
+
+	m_BoneAnimator.BuildTimeTable();
 }
 
 void QuaternionManager::Update(float dt, DirectX::XMFLOAT4X4& M)
 {
-	m_AnimateFrame += dt;
-
-	if (m_AnimateFrame >= m_BoneAnimator.GetEndTime())
-	{
-		m_AnimateFrame = 0.0f;
-	}
+	m_AnimateFrame = m_BoneAnimator.WrapTime(m_AnimateFrame + dt * m_PlaybackRate);
+	m_BoneAnimator.Interpolate(m_AnimateFrame, M, m_Cursor);
+}
 
-	m_BoneAnimator.Interpolate(m_AnimateFrame, M);
+void QuaternionManager::SetPlaybackRate(float rate)
+{
+	m_PlaybackRate = rate;
 }
@@ -0,0 +1,214 @@
+#include "RayTriangle.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		// The edge functions below are a plain multiply and subtract so that two triangles sharing an edge
+		// get exactly opposite values for it; fusing them into FMAs would open cracks along shared edges.
+
+		// Bit i of the result is set when lane i is hit with T in [0, tMax); outT/outU/outV are filled for
+		// every lane that got past the edge tests.
+		UINT TestLanes(const RayTriangle::Ray& ray, const TrianglePacket& packet, float tMax,
+			float* outT, float* outU, float* outV) {
+			const float* origin = &ray.Origin.x;
+			UINT mask = 0;
+
+#if defined(__AVX2__)
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 ox = _mm256_set1_ps(origin[ray.Kx]);
+			const __m256 oy = _mm256_set1_ps(origin[ray.Ky]);
+			const __m256 oz = _mm256_set1_ps(origin[ray.Kz]);
+			const __m256 sx = _mm256_set1_ps(ray.Sx);
+			const __m256 sy = _mm256_set1_ps(ray.Sy);
+
+			// Vertices relative to the origin, sheared so the ray runs down +z.
+			__m256 az = _mm256_sub_ps(_mm256_load_ps(packet.V[0][ray.Kz]), oz);
+			__m256 bz = _mm256_sub_ps(_mm256_load_ps(packet.V[1][ray.Kz]), oz);
+			__m256 cz = _mm256_sub_ps(_mm256_load_ps(packet.V[2][ray.Kz]), oz);
+			__m256 ax = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(packet.V[0][ray.Kx]), ox), _mm256_mul_ps(sx, az));
+			__m256 ay = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(packet.V[0][ray.Ky]), oy), _mm256_mul_ps(sy, az));
+			__m256 bx = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(packet.V[1][ray.Kx]), ox), _mm256_mul_ps(sx, bz));
+			__m256 by = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(packet.V[1][ray.Ky]), oy), _mm256_mul_ps(sy, bz));
+			__m256 cx = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(packet.V[2][ray.Kx]), ox), _mm256_mul_ps(sx, cz));
+			__m256 cy = _mm256_sub_ps(_mm256_sub_ps(_mm256_load_ps(packet.V[2][ray.Ky]), oy), _mm256_mul_ps(sy, cz));
+
+			__m256 u = _mm256_sub_ps(_mm256_mul_ps(cx, by), _mm256_mul_ps(cy, bx));
+			__m256 v = _mm256_sub_ps(_mm256_mul_ps(ax, cy), _mm256_mul_ps(ay, cx));
+			__m256 w = _mm256_sub_ps(_mm256_mul_ps(bx, ay), _mm256_mul_ps(by, ax));
+
+			// Mixed signs miss; a zero on an edge counts for both triangles that share it.
+			__m256 negative = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_LT_OQ), _mm256_cmp_ps(v, zero, _CMP_LT_OQ)),
+				_mm256_cmp_ps(w, zero, _CMP_LT_OQ));
+			__m256 positive = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_GT_OQ), _mm256_cmp_ps(v, zero, _CMP_GT_OQ)),
+				_mm256_cmp_ps(w, zero, _CMP_GT_OQ));
+			__m256 det = _mm256_add_ps(_mm256_add_ps(u, v), w);
+			__m256 reject = _mm256_or_ps(_mm256_and_ps(negative, positive), _mm256_cmp_ps(det, zero, _CMP_EQ_OQ));
+
+			mask = ~(UINT)_mm256_movemask_ps(reject) & 0xff;
+			if (mask == 0) return 0;
+
+			const __m256 sz = _mm256_set1_ps(ray.Sz);
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(u, _mm256_mul_ps(sz, az)),
+				_mm256_mul_ps(v, _mm256_mul_ps(sz, bz))),
+				_mm256_mul_ps(w, _mm256_mul_ps(sz, cz)));
+
+			__m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+			__m256 t = _mm256_mul_ps(distance, invDet);
+
+			__m256 inRange = _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GE_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LT_OQ));
+			mask &= (UINT)_mm256_movemask_ps(inRange);
+
+			_mm256_storeu_ps(outT, t);
+			_mm256_storeu_ps(outU, _mm256_mul_ps(v, invDet));
+			_mm256_storeu_ps(outV, _mm256_mul_ps(w, invDet));
+#else
+			const XMVECTOR zero = XMVectorZero();
+			const XMVECTOR ox = XMVectorReplicate(origin[ray.Kx]);
+			const XMVECTOR oy = XMVectorReplicate(origin[ray.Ky]);
+			const XMVECTOR oz = XMVectorReplicate(origin[ray.Kz]);
+			const XMVECTOR sx = XMVectorReplicate(ray.Sx);
+			const XMVECTOR sy = XMVectorReplicate(ray.Sy);
+			const XMVECTOR sz = XMVectorReplicate(ray.Sz);
+			const XMVECTOR maxT = XMVectorReplicate(tMax);
+
+			for (UINT first = 0; first < RayTriangle::PacketWidth; first += 4) {
+				auto load = [&](int vertex, int axis) {
+					return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&packet.V[vertex][axis][first]));
+				};
+
+				XMVECTOR az = XMVectorSubtract(load(0, ray.Kz), oz);
+				XMVECTOR bz = XMVectorSubtract(load(1, ray.Kz), oz);
+				XMVECTOR cz = XMVectorSubtract(load(2, ray.Kz), oz);
+				XMVECTOR ax = XMVectorSubtract(XMVectorSubtract(load(0, ray.Kx), ox), XMVectorMultiply(sx, az));
+				XMVECTOR ay = XMVectorSubtract(XMVectorSubtract(load(0, ray.Ky), oy), XMVectorMultiply(sy, az));
+				XMVECTOR bx = XMVectorSubtract(XMVectorSubtract(load(1, ray.Kx), ox), XMVectorMultiply(sx, bz));
+				XMVECTOR by = XMVectorSubtract(XMVectorSubtract(load(1, ray.Ky), oy), XMVectorMultiply(sy, bz));
+				XMVECTOR cx = XMVectorSubtract(XMVectorSubtract(load(2, ray.Kx), ox), XMVectorMultiply(sx, cz));
+				XMVECTOR cy = XMVectorSubtract(XMVectorSubtract(load(2, ray.Ky), oy), XMVectorMultiply(sy, cz));
+
+				XMVECTOR u = XMVectorSubtract(XMVectorMultiply(cx, by), XMVectorMultiply(cy, bx));
+				XMVECTOR v = XMVectorSubtract(XMVectorMultiply(ax, cy), XMVectorMultiply(ay, cx));
+				XMVECTOR w = XMVectorSubtract(XMVectorMultiply(bx, ay), XMVectorMultiply(by, ax));
+
+				XMVECTOR negative = XMVectorOrInt(XMVectorOrInt(XMVectorLess(u, zero), XMVectorLess(v, zero)), XMVectorLess(w, zero));
+				XMVECTOR positive = XMVectorOrInt(XMVectorOrInt(XMVectorGreater(u, zero), XMVectorGreater(v, zero)), XMVectorGreater(w, zero));
+				XMVECTOR det = XMVectorAdd(XMVectorAdd(u, v), w);
+				XMVECTOR reject = XMVectorOrInt(XMVectorAndInt(negative, positive), XMVectorEqual(det, zero));
+
+				if (XMVector4EqualInt(reject, XMVectorTrueInt())) continue;
+
+				XMVECTOR distance = XMVectorAdd(XMVectorAdd(
+					XMVectorMultiply(u, XMVectorMultiply(sz, az)),
+					XMVectorMultiply(v, XMVectorMultiply(sz, bz))),
+					XMVectorMultiply(w, XMVectorMultiply(sz, cz)));
+
+				XMVECTOR invDet = XMVectorReciprocal(det);
+				XMVECTOR t = XMVectorMultiply(distance, invDet);
+
+				XMVECTOR hit = XMVectorAndCInt(XMVectorAndInt(XMVectorGreaterOrEqual(t, zero), XMVectorLess(t, maxT)), reject);
+
+				uint32_t lanes[4];
+				XMStoreInt4(lanes, hit);
+				for (UINT i = 0; i < 4; ++i) {
+					if (lanes[i] != 0) mask |= 1u << (first + i);
+				}
+
+				XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(outT + first), t);
+				XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(outU + first), XMVectorMultiply(v, invDet));
+				XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(outV + first), XMVectorMultiply(w, invDet));
+			}
+#endif
+
+			return mask;
+		}
+	}
+
+	RayTriangle::Ray RayTriangle::PrepareRay(FXMVECTOR origin, FXMVECTOR direction) {
+		Ray ray;
+		XMStoreFloat3(&ray.Origin, origin);
+
+		XMFLOAT3 d;
+		XMStoreFloat3(&d, direction);
+		const float* dir = &d.x;
+
+		// z is the dominant axis; x and y swap when it points backwards to keep the winding.
+		const float ax = std::fabs(d.x);
+		const float ay = std::fabs(d.y);
+		const float az = std::fabs(d.z);
+		ray.Kz = (ax > ay && ax > az) ? 0 : ((ay > az) ? 1 : 2);
+		ray.Kx = (ray.Kz + 1) % 3;
+		ray.Ky = (ray.Kx + 1) % 3;
+		if (dir[ray.Kz] < 0.0f) {
+			std::swap(ray.Kx, ray.Ky);
+		}
+
+		ray.Sx = dir[ray.Kx] / dir[ray.Kz];
+		ray.Sy = dir[ray.Ky] / dir[ray.Kz];
+		ray.Sz = 1.0f / dir[ray.Kz];
+		return ray;
+	}
+
+	void RayTriangle::ClearPacket(TrianglePacket& packet) {
+		std::fill(&packet.V[0][0][0], &packet.V[0][0][0] + 3 * 3 * PacketWidth, 0.0f);
+	}
+
+	void RayTriangle::SetTriangle(TrianglePacket& packet, UINT lane, const XMFLOAT3& v0, const XMFLOAT3& v1,
+		const XMFLOAT3& v2) {
+		const XMFLOAT3* vertices[3] = { &v0, &v1, &v2 };
+		for (int vertex = 0; vertex < 3; ++vertex) {
+			packet.V[vertex][0][lane] = vertices[vertex]->x;
+			packet.V[vertex][1][lane] = vertices[vertex]->y;
+			packet.V[vertex][2][lane] = vertices[vertex]->z;
+		}
+	}
+
+	int RayTriangle::Intersect(const Ray& ray, const TrianglePacket& packet, float tMax,
+		float& outT, float& outU, float& outV) {
+		float t[PacketWidth], u[PacketWidth], v[PacketWidth];
+		UINT mask = TestLanes(ray, packet, tMax, t, u, v);
+
+		int closest = -1;
+		for (UINT lane = 0; mask != 0; ++lane, mask >>= 1) {
+			if ((mask & 1) && (closest < 0 || t[lane] < t[closest])) {
+				closest = (int)lane;
+			}
+		}
+
+		if (closest >= 0) {
+			outT = t[closest];
+			outU = u[closest];
+			outV = v[closest];
+		}
+		return closest;
+	}
+
+	bool RayTriangle::IntersectAny(const Ray& ray, const TrianglePacket& packet, float tMax) {
+		float t[PacketWidth], u[PacketWidth], v[PacketWidth];
+		return TestLanes(ray, packet, tMax, t, u, v) != 0;
+	}
+
+	bool RayTriangle::Intersect(const Ray& ray, const TrianglePacket* packets, size_t packetCount, float tMax,
+		float& outT, float& outU, float& outV, UINT& outTriangle) {
+		bool hit = false;
+		float closest = tMax;
+
+		for (size_t p = 0; p < packetCount; ++p) {
+			int lane = Intersect(ray, packets[p], closest, outT, outU, outV);
+			if (lane >= 0) {
+				hit = true;
+				closest = outT;
+				outTriangle = (UINT)(p * PacketWidth) + (UINT)lane;
+			}
+		}
+		return hit;
+	}
+}
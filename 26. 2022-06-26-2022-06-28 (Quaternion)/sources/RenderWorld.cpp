@@ -0,0 +1,243 @@
+#include "RenderWorld.h"
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		template <class T>
+		void MoveLast(std::vector<T>& values, UINT index) {
+			values[index] = values.back();
+			values.pop_back();
+		}
+	}
+
+	RenderWorld::RenderWorld(int frameResourceCount) : m_FrameResourceCount(frameResourceCount) {
+	}
+
+	RenderWorld::~RenderWorld() {
+	}
+
+	UINT RenderWorld::AddMesh(const Mesh& mesh) {
+		m_Meshes.push_back(mesh);
+		return (UINT)m_Meshes.size() - 1;
+	}
+
+	RenderWorld::Mesh& RenderWorld::GetMesh(UINT mesh) {
+		return m_Meshes[mesh];
+	}
+
+	const RenderWorld::Mesh& RenderWorld::GetMesh(UINT mesh) const {
+		return m_Meshes[mesh];
+	}
+
+	UINT RenderWorld::GetMeshCount() const {
+		return (UINT)m_Meshes.size();
+	}
+
+	RenderHandle RenderWorld::Create(const ItemDesc& desc) {
+		UINT slot = m_FreeSlot;
+		if (slot != NullIndex) {
+			m_FreeSlot = m_Slots[slot].Dense;
+		}
+		else {
+			slot = (UINT)m_Slots.size();
+			m_Slots.emplace_back();
+		}
+
+		const UINT index = (UINT)m_SlotOfItem.size();
+		m_Slots[slot].Dense = index;
+
+		m_SlotOfItem.push_back(slot);
+		m_World.push_back(desc.World);
+		m_TexTransform.push_back(desc.TexTransform);
+		m_Bounds.push_back(m_Meshes[desc.Mesh].Bounds);
+		m_SphereBounds.push_back(m_Meshes[desc.Mesh].SphereBounds);
+		m_Mesh.push_back(desc.Mesh);
+		m_Material.push_back(desc.Material);
+		m_Layer.push_back(desc.Layer);
+		m_Flags.push_back(desc.Flags);
+		m_DirtyFrames.push_back(m_FrameResourceCount);
+		m_InstanceDirty.push_back(1);
+		m_BoundsDirty.push_back(1);
+		m_CullProxy.push_back(-1);
+		m_SceneNode.push_back((UINT)NullIndex);
+
+		RenderHandle handle;
+		handle.Index = slot;
+		handle.Generation = m_Slots[slot].Generation;
+		return handle;
+	}
+
+	void RenderWorld::Destroy(RenderHandle handle) {
+		if (!IsAlive(handle)) return;
+
+		const UINT index = m_Slots[handle.Index].Dense;
+
+		// The last item fills the hole; its slot follows it.
+		m_Slots[m_SlotOfItem.back()].Dense = index;
+
+		MoveLast(m_SlotOfItem, index);
+		MoveLast(m_World, index);
+		MoveLast(m_TexTransform, index);
+		MoveLast(m_Bounds, index);
+		MoveLast(m_SphereBounds, index);
+		MoveLast(m_Mesh, index);
+		MoveLast(m_Material, index);
+		MoveLast(m_Layer, index);
+		MoveLast(m_Flags, index);
+		MoveLast(m_DirtyFrames, index);
+		MoveLast(m_InstanceDirty, index);
+		MoveLast(m_BoundsDirty, index);
+		MoveLast(m_CullProxy, index);
+		MoveLast(m_SceneNode, index);
+
+		++m_Slots[handle.Index].Generation;
+		m_Slots[handle.Index].Dense = m_FreeSlot;
+		m_FreeSlot = handle.Index;
+	}
+
+	bool RenderWorld::IsAlive(RenderHandle handle) const {
+		return handle.Index < (UINT)m_Slots.size() && m_Slots[handle.Index].Generation == handle.Generation;
+	}
+
+	UINT RenderWorld::GetIndex(RenderHandle handle) const {
+		return IsAlive(handle) ? m_Slots[handle.Index].Dense : NullIndex;
+	}
+
+	RenderHandle RenderWorld::GetHandle(UINT index) const {
+		RenderHandle handle;
+		handle.Index = m_SlotOfItem[index];
+		handle.Generation = m_Slots[handle.Index].Generation;
+		return handle;
+	}
+
+	UINT RenderWorld::GetCount() const {
+		return (UINT)m_SlotOfItem.size();
+	}
+
+	UINT RenderWorld::GetInstanceSlot(UINT index) const {
+		return m_SlotOfItem[index];
+	}
+
+	UINT RenderWorld::GetSlotCapacity() const {
+		return (UINT)m_Slots.size();
+	}
+
+	const XMFLOAT4X4& RenderWorld::GetWorld(UINT index) const {
+		return m_World[index];
+	}
+
+	void RenderWorld::SetWorld(UINT index, const XMFLOAT4X4& world) {
+		m_World[index] = world;
+		m_DirtyFrames[index] = m_FrameResourceCount;
+		m_InstanceDirty[index] = 1;
+		m_BoundsDirty[index] = 1;
+	}
+
+	const XMFLOAT4X4& RenderWorld::GetTexTransform(UINT index) const {
+		return m_TexTransform[index];
+	}
+
+	const BoundingBox& RenderWorld::GetBounds(UINT index) const {
+		return m_Bounds[index];
+	}
+
+	const BoundingSphere& RenderWorld::GetSphereBounds(UINT index) const {
+		return m_SphereBounds[index];
+	}
+
+	void RenderWorld::SetBounds(UINT index, const BoundingBox& bounds, const BoundingSphere& sphereBounds) {
+		m_Bounds[index] = bounds;
+		m_SphereBounds[index] = sphereBounds;
+		m_BoundsDirty[index] = 1;
+	}
+
+	UINT RenderWorld::GetMeshIndex(UINT index) const {
+		return m_Mesh[index];
+	}
+
+	UINT RenderWorld::GetMaterial(UINT index) const {
+		return m_Material[index];
+	}
+
+	void RenderWorld::SetMaterial(UINT index, UINT material) {
+		m_Material[index] = material;
+		m_InstanceDirty[index] = 1;
+	}
+
+	UINT RenderWorld::GetLayer(UINT index) const {
+		return m_Layer[index];
+	}
+
+	const XMFLOAT4X4* RenderWorld::GetWorldData() const {
+		return m_World.data();
+	}
+
+	const BoundingBox* RenderWorld::GetBoundsData() const {
+		return m_Bounds.data();
+	}
+
+	const XMFLOAT4X4* RenderWorld::GetTexTransformData() const {
+		return m_TexTransform.data();
+	}
+
+	const UINT* RenderWorld::GetMaterialData() const {
+		return m_Material.data();
+	}
+
+	UINT RenderWorld::GetFlags(UINT index) const {
+		return m_Flags[index];
+	}
+
+	void RenderWorld::SetFlags(UINT index, UINT flags) {
+		m_Flags[index] = flags;
+	}
+
+	int RenderWorld::GetDirtyFrames(UINT index) const {
+		return m_DirtyFrames[index];
+	}
+
+	void RenderWorld::MarkDirty(UINT index) {
+		m_DirtyFrames[index] = m_FrameResourceCount;
+		m_InstanceDirty[index] = 1;
+		m_BoundsDirty[index] = 1;
+	}
+
+	void RenderWorld::ConsumeDirtyFrame(UINT index) {
+		if (m_DirtyFrames[index] > 0) {
+			--m_DirtyFrames[index];
+		}
+	}
+
+	bool RenderWorld::IsInstanceDirty(UINT index) const {
+		return m_InstanceDirty[index] != 0;
+	}
+
+	void RenderWorld::ClearInstanceDirty(UINT index) {
+		m_InstanceDirty[index] = 0;
+	}
+
+	bool RenderWorld::IsBoundsDirty(UINT index) const {
+		return m_BoundsDirty[index] != 0;
+	}
+
+	void RenderWorld::ClearBoundsDirty(UINT index) {
+		m_BoundsDirty[index] = 0;
+	}
+
+	int RenderWorld::GetCullProxy(UINT index) const {
+		return m_CullProxy[index];
+	}
+
+	void RenderWorld::SetCullProxy(UINT index, int proxy) {
+		m_CullProxy[index] = proxy;
+	}
+
+	UINT RenderWorld::GetSceneNode(UINT index) const {
+		return m_SceneNode[index];
+	}
+
+	void RenderWorld::SetSceneNode(UINT index, UINT node) {
+		m_SceneNode[index] = node;
+	}
+}
@@ -0,0 +1,338 @@
+#include "SceneGraph.h"
+
+#include "JobSystem.h"
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		// Roots are cheap to walk; a job takes at least this many.
+		const size_t gMinRangesPerJob = 16;
+
+		// Parent of a removed node: neither a root nor anyone's child, so Sort leaves it out.
+		const UINT gFreeNode = SceneGraph::NullNode - 1;
+
+		inline bool HasParent(UINT parent) {
+			return parent != SceneGraph::NullNode && parent != gFreeNode;
+		}
+
+		template <class T>
+		void Permute(std::vector<T>& values, const std::vector<UINT>& oldSlots) {
+			std::vector<T> sorted(oldSlots.size());
+			for (size_t i = 0; i < oldSlots.size(); ++i) {
+				sorted[i] = values[oldSlots[i]];
+			}
+			values.swap(sorted);
+		}
+	}
+
+	SceneGraph::SceneGraph() {
+	}
+
+	SceneGraph::~SceneGraph() {
+	}
+
+	void SceneGraph::Clear() {
+		m_SlotOfNode.clear();
+		m_ParentNode.clear();
+		m_NodeOfSlot.clear();
+		m_ParentSlot.clear();
+		m_RangeOfSlot.clear();
+		m_UserData.clear();
+		m_Scale.clear();
+		m_Rotation.clear();
+		m_Translation.clear();
+		m_World.clear();
+		m_LocalDirty.clear();
+		m_WorldDirty.clear();
+		m_RootRanges.clear();
+		m_RangeDirty.clear();
+		m_DirtyRanges.clear();
+		m_ChangedNodes.clear();
+		m_FreeNodes.clear();
+		m_OrderDirty = false;
+	}
+
+	UINT SceneGraph::CreateNode(UINT parent, UINT userData) {
+		const UINT slot = (UINT)m_NodeOfSlot.size();
+		UINT node;
+
+		if (!m_FreeNodes.empty()) {
+			node = m_FreeNodes.back();
+			m_FreeNodes.pop_back();
+
+			m_SlotOfNode[node] = slot;
+			m_ParentNode[node] = parent;
+		}
+		else {
+			node = (UINT)m_SlotOfNode.size();
+
+			m_SlotOfNode.push_back(slot);
+			m_ParentNode.push_back(parent);
+		}
+
+		UINT parentSlot = NullNode;
+		UINT range = 0;
+
+		if (parent == NullNode) {
+			range = (UINT)m_RootRanges.size();
+			m_RootRanges.push_back(std::make_pair(slot, slot + 1));
+			m_RangeDirty.push_back(1);
+		}
+		else {
+			parentSlot = m_SlotOfNode[parent];
+			range = m_RangeOfSlot[parentSlot];
+
+			// Appending keeps the order only while the parent's root is the last one.
+			if (range + 1 == (UINT)m_RootRanges.size() && m_RootRanges[range].second == slot) {
+				++m_RootRanges[range].second;
+			}
+			else {
+				m_OrderDirty = true;
+			}
+			m_RangeDirty[range] = 1;
+		}
+
+		m_NodeOfSlot.push_back(node);
+		m_ParentSlot.push_back(parentSlot);
+		m_RangeOfSlot.push_back(range);
+		m_UserData.push_back(userData);
+		m_Scale.push_back(XMFLOAT3(1.0f, 1.0f, 1.0f));
+		m_Rotation.push_back(XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+		m_Translation.push_back(XMFLOAT3(0.0f, 0.0f, 0.0f));
+		m_World.push_back(XMFLOAT4X4(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f));
+		m_LocalDirty.push_back(1);
+		m_WorldDirty.push_back(0);
+
+		return node;
+	}
+
+	void SceneGraph::RemoveNode(UINT node) {
+		const UINT count = (UINT)m_ParentNode.size();
+
+		// Handles are recycled, so a child can come before its parent; grow the set until it stops.
+		std::vector<UINT8> removed(count, 0);
+		removed[node] = 1;
+
+		for (bool grew = true; grew;) {
+			grew = false;
+			for (UINT n = 0; n < count; ++n) {
+				if (!removed[n] && HasParent(m_ParentNode[n]) && removed[m_ParentNode[n]]) {
+					removed[n] = 1;
+					grew = true;
+				}
+			}
+		}
+
+		for (UINT n = 0; n < count; ++n) {
+			if (removed[n]) {
+				m_ParentNode[n] = gFreeNode;
+				m_FreeNodes.push_back(n);
+			}
+		}
+
+		// The slots stay until Sort drops them; Update sorts before it walks any range.
+		m_OrderDirty = true;
+	}
+
+	void SceneGraph::SetLocal(UINT node, const XMFLOAT3& scale, const XMFLOAT4& rotation, const XMFLOAT3& translation) {
+		const UINT slot = m_SlotOfNode[node];
+
+		m_Scale[slot] = scale;
+		m_Rotation[slot] = rotation;
+		m_Translation[slot] = translation;
+
+		m_LocalDirty[slot] = 1;
+		m_RangeDirty[m_RangeOfSlot[slot]] = 1;
+	}
+
+	void SceneGraph::SetLocal(UINT node, FXMMATRIX local) {
+		XMVECTOR S, Q, T;
+		XMMatrixDecompose(&S, &Q, &T, local);
+
+		XMFLOAT3 scale, translation;
+		XMFLOAT4 rotation;
+		XMStoreFloat3(&scale, S);
+		XMStoreFloat4(&rotation, Q);
+		XMStoreFloat3(&translation, T);
+
+		SetLocal(node, scale, rotation, translation);
+	}
+
+	void SceneGraph::Update() {
+		if (m_OrderDirty) {
+			Sort();
+		}
+
+		m_DirtyRanges.clear();
+		for (UINT r = 0; r < (UINT)m_RootRanges.size(); ++r) {
+			if (m_RangeDirty[r]) {
+				m_DirtyRanges.push_back(r);
+			}
+		}
+
+		// Roots never share slots, so their ranges are updated independently.
+		JobSystem::Get()->ParallelFor(m_DirtyRanges.size(), gMinRangesPerJob,
+			[this](size_t first, size_t last, size_t) {
+				for (size_t i = first; i < last; ++i) {
+					const auto& range = m_RootRanges[m_DirtyRanges[i]];
+					UpdateRange(range.first, range.second);
+				}
+			});
+
+		m_ChangedNodes.clear();
+		for (UINT r : m_DirtyRanges) {
+			for (UINT slot = m_RootRanges[r].first; slot < m_RootRanges[r].second; ++slot) {
+				if (m_WorldDirty[slot]) {
+					m_ChangedNodes.push_back(m_NodeOfSlot[slot]);
+					m_WorldDirty[slot] = 0;
+				}
+			}
+			m_RangeDirty[r] = 0;
+		}
+	}
+
+	void SceneGraph::UpdateRange(UINT first, UINT last) {
+		const XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+
+		for (UINT slot = first; slot < last; ++slot) {
+			const UINT parent = m_ParentSlot[slot];
+
+			// The parent precedes its children, so its flag is final by now.
+			UINT8 dirty = m_LocalDirty[slot] | (parent != NullNode ? m_WorldDirty[parent] : 0);
+			m_WorldDirty[slot] = dirty;
+			if (!dirty) continue;
+
+			m_LocalDirty[slot] = 0;
+
+			XMMATRIX world = XMMatrixAffineTransformation(XMLoadFloat3(&m_Scale[slot]), zero,
+				XMLoadFloat4(&m_Rotation[slot]), XMLoadFloat3(&m_Translation[slot]));
+
+			if (parent != NullNode) {
+				world = XMMatrixMultiply(world, XMLoadFloat4x4(&m_World[parent]));
+			}
+
+			XMStoreFloat4x4(&m_World[slot], world);
+		}
+	}
+
+	void SceneGraph::Sort() {
+		const UINT count = (UINT)m_SlotOfNode.size();
+
+		// Children of every node in handle order, as offsets into one array.
+		std::vector<UINT> childStart(count + 1, 0);
+		for (UINT node = 0; node < count; ++node) {
+			if (HasParent(m_ParentNode[node])) {
+				++childStart[m_ParentNode[node] + 1];
+			}
+		}
+		for (UINT node = 0; node < count; ++node) {
+			childStart[node + 1] += childStart[node];
+		}
+
+		std::vector<UINT> children(childStart[count]);
+		std::vector<UINT> cursor(childStart.begin(), childStart.end() - 1);
+		for (UINT node = 0; node < count; ++node) {
+			if (HasParent(m_ParentNode[node])) {
+				children[cursor[m_ParentNode[node]]++] = node;
+			}
+		}
+
+		std::vector<UINT> order;
+		std::vector<UINT> stack;
+		order.reserve(count);
+
+		m_RootRanges.clear();
+		for (UINT root = 0; root < count; ++root) {
+			if (m_ParentNode[root] != NullNode) continue;
+
+			const UINT first = (UINT)order.size();
+
+			stack.push_back(root);
+			while (!stack.empty()) {
+				UINT node = stack.back();
+				stack.pop_back();
+				order.push_back(node);
+
+				for (UINT c = childStart[node + 1]; c > childStart[node]; --c) {
+					stack.push_back(children[c - 1]);
+				}
+			}
+
+			m_RootRanges.push_back(std::make_pair(first, (UINT)order.size()));
+		}
+
+		// Removed nodes are in no subtree, so only live nodes keep a slot.
+		const UINT liveCount = (UINT)order.size();
+
+		std::vector<UINT> oldSlots(liveCount);
+		for (UINT slot = 0; slot < liveCount; ++slot) {
+			oldSlots[slot] = m_SlotOfNode[order[slot]];
+		}
+
+		Permute(m_UserData, oldSlots);
+		Permute(m_Scale, oldSlots);
+		Permute(m_Rotation, oldSlots);
+		Permute(m_Translation, oldSlots);
+		Permute(m_World, oldSlots);
+		Permute(m_LocalDirty, oldSlots);
+		Permute(m_WorldDirty, oldSlots);
+
+		m_NodeOfSlot.resize(liveCount);
+		m_ParentSlot.resize(liveCount);
+		m_RangeOfSlot.resize(liveCount);
+
+		for (UINT node = 0; node < count; ++node) {
+			if (m_ParentNode[node] == gFreeNode) {
+				m_SlotOfNode[node] = NullNode;
+			}
+		}
+
+		for (UINT slot = 0; slot < liveCount; ++slot) {
+			m_NodeOfSlot[slot] = order[slot];
+			m_SlotOfNode[order[slot]] = slot;
+		}
+
+		for (UINT slot = 0; slot < liveCount; ++slot) {
+			UINT parent = m_ParentNode[m_NodeOfSlot[slot]];
+			m_ParentSlot[slot] = (parent != NullNode) ? m_SlotOfNode[parent] : NullNode;
+		}
+
+		for (UINT r = 0; r < (UINT)m_RootRanges.size(); ++r) {
+			for (UINT slot = m_RootRanges[r].first; slot < m_RootRanges[r].second; ++slot) {
+				m_RangeOfSlot[slot] = r;
+			}
+		}
+
+		m_RangeDirty.assign(m_RootRanges.size(), 1);
+		m_OrderDirty = false;
+	}
+
+	const XMFLOAT4X4& SceneGraph::GetWorld(UINT node) const {
+		return m_World[m_SlotOfNode[node]];
+	}
+
+	UINT SceneGraph::GetParent(UINT node) const {
+		return m_ParentNode[node];
+	}
+
+	UINT SceneGraph::GetUserData(UINT node) const {
+		return m_UserData[m_SlotOfNode[node]];
+	}
+
+	void SceneGraph::SetUserData(UINT node, UINT userData) {
+		m_UserData[m_SlotOfNode[node]] = userData;
+	}
+
+	UINT SceneGraph::GetNodeCount() const {
+		return (UINT)(m_SlotOfNode.size() - m_FreeNodes.size());
+	}
+
+	const std::vector<UINT>& SceneGraph::GetChangedNodes() const {
+		return m_ChangedNodes;
+	}
+}
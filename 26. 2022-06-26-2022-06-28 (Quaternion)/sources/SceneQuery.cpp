@@ -0,0 +1,204 @@
+#include "SceneQuery.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		// Sorted casts are handed out in runs of at least this many, each a packet of neighbours.
+		const size_t gCastsPerPacket = 64;
+
+		const size_t gOverlapsPerJob = 16;
+
+		// Spreads the low 10 bits of v three apart.
+		inline std::uint64_t Part1By2(std::uint64_t v) {
+			v &= 0x3ff;
+			v = (v | (v << 16)) & 0x30000ff;
+			v = (v | (v << 8)) & 0x300f00f;
+			v = (v | (v << 4)) & 0x30c30c3;
+			v = (v | (v << 2)) & 0x9249249;
+			return v;
+		}
+
+		inline std::uint64_t Quantize(float value, float minValue, float scale) {
+			float q = (value - minValue) * scale;
+			return (std::uint64_t)(std::min)((std::max)(q, 0.0f), 1023.0f);
+		}
+	}
+
+	void SceneQuery::Batch::Clear() {
+		Casts.clear();
+		Overlaps.clear();
+		Order.clear();
+		Hits.clear();
+		Found.clear();
+
+		// The inner vectors keep their capacity for the next batch.
+		for (auto& hits : OverlapHits) {
+			hits.clear();
+		}
+	}
+
+	SceneQuery::SceneQuery() {
+	}
+
+	SceneQuery::~SceneQuery() {
+		Collect();
+	}
+
+	UINT SceneQuery::Raycast(FXMVECTOR origin, FXMVECTOR direction, float tMax) {
+		return AddCast(origin, direction, tMax, 0.0f, CastRay);
+	}
+
+	UINT SceneQuery::SweepSphere(FXMVECTOR center, FXMVECTOR direction, float radius, float tMax) {
+		return AddCast(center, direction, tMax, radius, CastSweep);
+	}
+
+	UINT SceneQuery::LineOfSight(FXMVECTOR from, FXMVECTOR to) {
+		// The segment itself is the direction, so it ends at T = 1.
+		return AddCast(from, XMVectorSubtract(to, from), 1.0f, 0.0f, CastLineOfSight);
+	}
+
+	UINT SceneQuery::AddCast(FXMVECTOR origin, FXMVECTOR direction, float tMax, float radius, UINT kind) {
+		Cast cast;
+		XMStoreFloat3(&cast.Origin, origin);
+		XMStoreFloat3(&cast.Direction, direction);
+		cast.TMax = tMax;
+		cast.Radius = radius;
+		cast.Kind = kind;
+
+		m_Pending.Casts.push_back(cast);
+		return (UINT)m_Pending.Casts.size() - 1;
+	}
+
+	UINT SceneQuery::Overlap(const BoundingBox& box) {
+		m_Pending.Overlaps.push_back(box);
+		return (UINT)m_Pending.Overlaps.size() - 1;
+	}
+
+	std::shared_future<void> SceneQuery::Kick(const InstanceBVH& scene) {
+		Collect();
+
+		// m_Running holds the batch two Collects old by now; it becomes the next pending one.
+		std::swap(m_Pending, m_Running);
+		m_Pending.Clear();
+
+		// An empty batch is not worth a thread; it runs on Collect instead.
+		Batch* batch = &m_Running;
+		const InstanceBVH* target = &scene;
+		const bool empty = batch->Casts.empty() && batch->Overlaps.empty();
+		m_InFlight = std::async(empty ? std::launch::deferred : std::launch::async,
+			[batch, target]() { Execute(*batch, *target); }).share();
+
+		return m_InFlight;
+	}
+
+	void SceneQuery::Collect() {
+		if (!m_InFlight.valid()) return;
+
+		m_InFlight.get();
+		m_InFlight = std::shared_future<void>();
+
+		std::swap(m_Running, m_Done);
+	}
+
+	void SceneQuery::Execute(Batch& batch, const InstanceBVH& scene) {
+		const size_t castCount = batch.Casts.size();
+
+		batch.Hits.assign(castCount, InstanceBVH::Hit());
+		batch.Found.assign(castCount, 0);
+
+		// Casts that start close together and point the same way walk the same nodes. Ordering by
+		// direction octant, then by the Morton code of the origin within the scene, makes every run
+		// a job takes a coherent packet.
+		const BoundingBox bounds = scene.GetBounds();
+		const XMFLOAT3 sceneMin(bounds.Center.x - bounds.Extents.x, bounds.Center.y - bounds.Extents.y,
+			bounds.Center.z - bounds.Extents.z);
+		const float scaleX = 511.5f / (std::max)(bounds.Extents.x, 1e-6f);
+		const float scaleY = 511.5f / (std::max)(bounds.Extents.y, 1e-6f);
+		const float scaleZ = 511.5f / (std::max)(bounds.Extents.z, 1e-6f);
+
+		batch.Order.resize(castCount);
+		for (size_t c = 0; c < castCount; ++c) {
+			const Cast& cast = batch.Casts[c];
+
+			std::uint64_t octant = (cast.Direction.x < 0.0f ? 1 : 0) | (cast.Direction.y < 0.0f ? 2 : 0) |
+				(cast.Direction.z < 0.0f ? 4 : 0);
+			std::uint64_t morton = Part1By2(Quantize(cast.Origin.x, sceneMin.x, scaleX)) |
+				(Part1By2(Quantize(cast.Origin.y, sceneMin.y, scaleY)) << 1) |
+				(Part1By2(Quantize(cast.Origin.z, sceneMin.z, scaleZ)) << 2);
+
+			batch.Order[c] = std::make_pair((octant << 30) | morton, (UINT)c);
+		}
+		std::sort(batch.Order.begin(), batch.Order.end());
+
+		JobSystem::Get()->ParallelFor(castCount, gCastsPerPacket, [&](size_t first, size_t last, size_t) {
+			for (size_t i = first; i < last; ++i) {
+				const UINT c = batch.Order[i].second;
+				const Cast& cast = batch.Casts[c];
+
+				XMVECTOR origin = XMLoadFloat3(&cast.Origin);
+				XMVECTOR direction = XMLoadFloat3(&cast.Direction);
+
+				bool found = false;
+				switch (cast.Kind) {
+				case CastRay:
+					found = scene.ClosestHit(origin, direction, cast.TMax, batch.Hits[c]);
+					break;
+				case CastSweep:
+					found = scene.SweepSphere(origin, direction, cast.Radius, cast.TMax, batch.Hits[c]);
+					break;
+				case CastLineOfSight:
+					found = scene.AnyHit(origin, direction, cast.TMax);
+					break;
+				}
+
+				batch.Found[c] = found ? 1 : 0;
+			}
+		});
+
+		const size_t overlapCount = batch.Overlaps.size();
+		batch.OverlapHits.resize(overlapCount);
+
+		JobSystem::Get()->ParallelFor(overlapCount, gOverlapsPerJob, [&](size_t first, size_t last, size_t) {
+			std::vector<UINT> ids;
+
+			for (size_t o = first; o < last; ++o) {
+				ids.clear();
+				scene.Overlap(batch.Overlaps[o], ids);
+
+				std::vector<OverlapHit>& hits = batch.OverlapHits[o];
+				hits.resize(ids.size());
+				for (size_t i = 0; i < ids.size(); ++i) {
+					hits[i].Item = scene.GetItem(ids[i]);
+					hits[i].Instance = scene.GetInstanceIndex(ids[i]);
+				}
+			}
+		});
+	}
+
+	bool SceneQuery::IsHit(UINT cast) const {
+		return m_Done.Found[cast] != 0;
+	}
+
+	const InstanceBVH::Hit& SceneQuery::GetHit(UINT cast) const {
+		return m_Done.Hits[cast];
+	}
+
+	UINT SceneQuery::GetOverlaps(UINT overlap, const OverlapHit*& outHits) const {
+		const std::vector<OverlapHit>& hits = m_Done.OverlapHits[overlap];
+		outHits = hits.data();
+		return (UINT)hits.size();
+	}
+
+	UINT SceneQuery::GetCastCount() const {
+		return (UINT)m_Done.Casts.size();
+	}
+
+	UINT SceneQuery::GetOverlapCount() const {
+		return (UINT)m_Done.Overlaps.size();
+	}
+}
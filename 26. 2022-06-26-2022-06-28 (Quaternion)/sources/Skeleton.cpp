@@ -0,0 +1,74 @@
+#include "Skeleton.h"
+
+#include <stdexcept>
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	Skeleton::Skeleton() {
+	}
+
+	Skeleton::~Skeleton() {
+	}
+
+	void Skeleton::Clear() {
+		m_Parents.clear();
+		m_BoneOffsets.clear();
+	}
+
+	UINT Skeleton::AddBone(UINT parent, CXMMATRIX boneOffset) {
+		if (parent != NullBone && parent >= (UINT)m_Parents.size()) {
+			throw std::runtime_error("@@@ Error: Skeleton bone added before its parent");
+		}
+
+		XMFLOAT4X4 offset;
+		XMStoreFloat4x4(&offset, boneOffset);
+
+		m_Parents.push_back(parent);
+		m_BoneOffsets.push_back(offset);
+		return (UINT)m_Parents.size() - 1;
+	}
+
+	UINT Skeleton::GetBoneCount() const {
+		return (UINT)m_Parents.size();
+	}
+
+	UINT Skeleton::GetParent(UINT bone) const {
+		return m_Parents[bone];
+	}
+
+	const XMFLOAT4X4& Skeleton::GetBoneOffset(UINT bone) const {
+		return m_BoneOffsets[bone];
+	}
+
+	void Skeleton::ToModel(const XMFLOAT4X4* local, XMFLOAT4X4* model) const {
+		const UINT boneCount = GetBoneCount();
+
+		// A parent's to-root transform is final before any of its children reads it.
+		for (UINT i = 0; i < boneCount; ++i) {
+			XMMATRIX toParent = XMLoadFloat4x4(&local[i]);
+			const UINT parent = m_Parents[i];
+
+			if (parent == NullBone) {
+				XMStoreFloat4x4(&model[i], toParent);
+			}
+			else {
+				XMStoreFloat4x4(&model[i], XMMatrixMultiply(toParent, XMLoadFloat4x4(&model[parent])));
+			}
+		}
+	}
+
+	void Skeleton::BuildPalette(const XMFLOAT4X4* model, XMFLOAT4X4* palette) const {
+		const UINT boneCount = GetBoneCount();
+
+		for (UINT i = 0; i < boneCount; ++i) {
+			XMMATRIX offset = XMLoadFloat4x4(&m_BoneOffsets[i]);
+			XMStoreFloat4x4(&palette[i], XMMatrixMultiply(offset, XMLoadFloat4x4(&model[i])));
+		}
+	}
+
+	void Skeleton::BuildPalette(const XMFLOAT4X4* local, XMFLOAT4X4* model, XMFLOAT4X4* palette) const {
+		ToModel(local, model);
+		BuildPalette(model, palette);
+	}
+}
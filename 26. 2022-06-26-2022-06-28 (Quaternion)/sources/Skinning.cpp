@@ -0,0 +1,115 @@
+#include "Skinning.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		// Weighted sum of the four influences' palette matrices, scalar.
+		void BlendPalette(const XMFLOAT4X4* palette, const SkinInfluence& influence, float M[4][4]) {
+			for (int r = 0; r < 4; ++r) {
+				for (int c = 0; c < 4; ++c) {
+					M[r][c] = 0.0f;
+				}
+			}
+
+			for (int k = 0; k < 4; ++k) {
+				const float w = influence.Weights[k];
+				const XMFLOAT4X4& P = palette[influence.Bones[k]];
+
+				for (int r = 0; r < 4; ++r) {
+					for (int c = 0; c < 4; ++c) {
+						M[r][c] += w * P.m[r][c];
+					}
+				}
+			}
+		}
+
+		// Row vector times matrix, as XMVector3Transform (w = 1) and XMVector3TransformNormal (w = 0).
+		XMFLOAT3 TransformScalar(const XMFLOAT3& v, float w, const float M[4][4]) {
+			return XMFLOAT3(
+				v.x * M[0][0] + v.y * M[1][0] + v.z * M[2][0] + w * M[3][0],
+				v.x * M[0][1] + v.y * M[1][1] + v.z * M[2][1] + w * M[3][1],
+				v.x * M[0][2] + v.y * M[1][2] + v.z * M[2][2] + w * M[3][2]);
+		}
+
+#if defined(__AVX2__)
+		// The kernel below reads and writes a Vertex as three 16 byte rows:
+		// (Pos, Normal.x), (Normal.yz, TexC), (Tangent).
+		static_assert(sizeof(Vertex) == 48, "Skinning expects the 48 byte Vertex layout");
+
+		// v * M for the xyz at src, with w as the fourth component. M is split into rows (0 | 1) and
+		// (2 | 3) so that x * r0 + y * r1 and z * r2 + w * r3 are single 8 lane operations.
+		inline __m128 TransformAVX(const float* src, __m256 m01, __m256 m23, __m256 w) {
+			const __m256i selectXY = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+			const __m256i selectZ = _mm256_set1_epi32(2);
+
+			__m256 v = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(src));
+			__m256 xy = _mm256_permutevar_ps(v, selectXY);
+			__m256 zw = _mm256_blend_ps(_mm256_permutevar_ps(v, selectZ), w, 0xf0);
+
+			__m256 sum = _mm256_fmadd_ps(zw, m23, _mm256_mul_ps(xy, m01));
+			return _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+		}
+#endif
+	}
+
+	void Skinning::Skin(const XMFLOAT4X4* palette, const Vertex* bindVertices,
+		const SkinInfluence* influences, size_t count, Vertex* out) {
+#if defined(__AVX2__)
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 zero = _mm256_setzero_ps();
+
+		for (size_t i = 0; i < count; ++i) {
+			const SkinInfluence& influence = influences[i];
+
+			// Unused slots weigh zero, so all four are summed without a branch.
+			__m256 m01 = zero;
+			__m256 m23 = zero;
+			for (int k = 0; k < 4; ++k) {
+				const float* P = &palette[influence.Bones[k]].m[0][0];
+				const __m256 w = _mm256_set1_ps(influence.Weights[k]);
+
+				m01 = _mm256_fmadd_ps(w, _mm256_loadu_ps(P), m01);
+				m23 = _mm256_fmadd_ps(w, _mm256_loadu_ps(P + 8), m23);
+			}
+
+			const float* src = &bindVertices[i].Pos.x;
+			__m128 pos = TransformAVX(src, m01, m23, one);
+			__m128 normal = TransformAVX(src + 3, m01, m23, zero);
+			__m128 tangent = TransformAVX(src + 8, m01, m23, zero);
+
+			__m128 texC = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(src + 6)));
+			__m128 tangentW = _mm_load_ss(src + 11);
+
+			float* dst = &out[i].Pos.x;
+			_mm_storeu_ps(dst, _mm_insert_ps(pos, normal, (0 << 6) | (3 << 4)));
+			_mm_storeu_ps(dst + 4, _mm_shuffle_ps(normal, texC, _MM_SHUFFLE(1, 0, 2, 1)));
+			_mm_storeu_ps(dst + 8, _mm_insert_ps(tangent, tangentW, (0 << 6) | (3 << 4)));
+		}
+#else
+		SkinReference(palette, bindVertices, influences, count, out);
+#endif
+	}
+
+	void Skinning::SkinReference(const XMFLOAT4X4* palette, const Vertex* bindVertices,
+		const SkinInfluence* influences, size_t count, Vertex* out) {
+		for (size_t i = 0; i < count; ++i) {
+			const Vertex& bind = bindVertices[i];
+
+			float M[4][4];
+			BlendPalette(palette, influences[i], M);
+
+			XMFLOAT3 tangent = TransformScalar(XMFLOAT3(bind.Tangent.x, bind.Tangent.y, bind.Tangent.z), 0.0f, M);
+
+			Vertex& skinned = out[i];
+			skinned.Pos = TransformScalar(bind.Pos, 1.0f, M);
+			skinned.Normal = TransformScalar(bind.Normal, 0.0f, M);
+			skinned.TexC = bind.TexC;
+			skinned.Tangent = XMFLOAT4(tangent.x, tangent.y, tangent.z, bind.Tangent.w);
+		}
+	}
+}
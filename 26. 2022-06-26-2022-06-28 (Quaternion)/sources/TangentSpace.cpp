@@ -0,0 +1,307 @@
+#include "TangentSpace.h"
+
+#include <unordered_map>
+
+namespace Mawi1e {
+	namespace {
+		const size_t gTrianglesPerJob = 2048;
+		const size_t gVerticesPerJob = 4096;
+
+		struct CornerFrame {
+			DirectX::XMFLOAT4 Tangent;		// unit tangent of the face, w = corner angle
+			DirectX::XMFLOAT4 Bitangent;	// unit bitangent of the face, w = sign of the uv winding
+			DirectX::XMFLOAT4 Normal;		// unit face normal, w = corner angle
+		};
+
+		float CornerAngle(FXMVECTOR toA, FXMVECTOR toB) {
+			XMVECTOR lenSq = XMVectorMultiply(XMVector3LengthSq(toA), XMVector3LengthSq(toB));
+			if (XMVectorGetX(lenSq) <= FLT_MIN) {
+				return 0.0f;
+			}
+
+			return XMVectorGetX(XMVector3AngleBetweenNormals(XMVector3Normalize(toA), XMVector3Normalize(toB)));
+		}
+
+		// Projects t onto the plane of n; falls back to any perpendicular axis for degenerate uvs.
+		XMVECTOR OrthogonalTangent(FXMVECTOR t, FXMVECTOR n) {
+			XMVECTOR projected = XMVectorSubtract(t, XMVectorMultiply(n, XMVector3Dot(n, t)));
+
+			if (XMVectorGetX(XMVector3LengthSq(projected)) > 1e-12f) {
+				return XMVector3Normalize(projected);
+			}
+
+			XMVECTOR axis = (fabsf(XMVectorGetX(n)) < 0.9f) ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+			return XMVector3Normalize(XMVector3Cross(XMVector3Cross(n, axis), n));
+		}
+
+		// One welded vertex: full position/uv/normal indices; an absent uv or normal is 0 with its flag clear.
+		struct CornerKey {
+			std::uint32_t Position = 0;
+			std::uint32_t TexC = 0;
+			std::uint32_t Normal = 0;
+			bool HasTexC = false;
+			bool HasNormal = false;
+
+			bool operator==(const CornerKey& other) const {
+				return Position == other.Position && TexC == other.TexC && Normal == other.Normal &&
+					HasTexC == other.HasTexC && HasNormal == other.HasNormal;
+			}
+		};
+
+		struct CornerKeyHash {
+			size_t operator()(const CornerKey& key) const {
+				// An absent stream keeps index 0 and counts as one past every real index.
+				std::uint64_t h = key.Position;
+				h = h * 0x9E3779B97F4A7C15ull ^ (key.HasTexC ? (std::uint64_t)key.TexC : 0x100000000ull);
+				h = h * 0x9E3779B97F4A7C15ull ^ (key.HasNormal ? (std::uint64_t)key.Normal : 0x100000000ull);
+				return (size_t)(h ^ (h >> 32));
+			}
+		};
+	}
+
+	void TangentSpace::Generate(std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices, const Options& options) {
+		const size_t vertexCount = vertices.size();
+		const size_t cornerCount = indices.size() - (indices.size() % 3);
+		const size_t triangleCount = cornerCount / 3;
+
+		if (vertexCount == 0 || triangleCount == 0) {
+			return;
+		}
+
+		auto jobs = JobSystem::Get();
+
+		/* ---------------------------------------------------------------------------------
+		[                    Per triangle: face frame + corner angle weights               ]
+		--------------------------------------------------------------------------------- */
+		std::vector<CornerFrame> corners(cornerCount);
+
+		jobs->ParallelFor(triangleCount, gTrianglesPerJob, [&](size_t first, size_t last, size_t) {
+			for (size_t t = first; t < last; ++t) {
+				const Vertex& v0 = vertices[indices[t * 3 + 0]];
+				const Vertex& v1 = vertices[indices[t * 3 + 1]];
+				const Vertex& v2 = vertices[indices[t * 3 + 2]];
+
+				XMVECTOR p0 = XMLoadFloat3(&v0.Pos);
+				XMVECTOR p1 = XMLoadFloat3(&v1.Pos);
+				XMVECTOR p2 = XMLoadFloat3(&v2.Pos);
+
+				XMVECTOR e1 = XMVectorSubtract(p1, p0);
+				XMVECTOR e2 = XMVectorSubtract(p2, p0);
+
+				XMVECTOR faceNormal = XMVector3Cross(e1, e2);
+				if (XMVectorGetX(XMVector3LengthSq(faceNormal)) > 1e-20f) {
+					faceNormal = XMVector3Normalize(faceNormal);
+				}
+				else {
+					faceNormal = XMVectorZero();
+				}
+
+				float du1 = v1.TexC.x - v0.TexC.x;
+				float dv1 = v1.TexC.y - v0.TexC.y;
+				float du2 = v2.TexC.x - v0.TexC.x;
+				float dv2 = v2.TexC.y - v0.TexC.y;
+				float det = du1 * dv2 - du2 * dv1;
+
+				XMVECTOR tangent = XMVectorZero();
+				XMVECTOR bitangent = XMVectorZero();
+				float winding = 1.0f;
+
+				if (fabsf(det) > 1e-12f) {
+					float invDet = 1.0f / det;
+					tangent = XMVectorScale(XMVectorSubtract(XMVectorScale(e1, dv2), XMVectorScale(e2, dv1)), invDet);
+					bitangent = XMVectorScale(XMVectorSubtract(XMVectorScale(e2, du1), XMVectorScale(e1, du2)), invDet);
+
+					tangent = XMVector3Normalize(tangent);
+					bitangent = XMVector3Normalize(bitangent);
+					winding = (det < 0.0f) ? -1.0f : 1.0f;
+				}
+
+				float angles[3] = {
+					CornerAngle(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)),
+					CornerAngle(XMVectorSubtract(p2, p1), XMVectorSubtract(p0, p1)),
+					CornerAngle(XMVectorSubtract(p0, p2), XMVectorSubtract(p1, p2)),
+				};
+
+				for (int k = 0; k < 3; ++k) {
+					CornerFrame& c = corners[t * 3 + k];
+					XMStoreFloat4(&c.Tangent, XMVectorSetW(tangent, angles[k]));
+					XMStoreFloat4(&c.Bitangent, XMVectorSetW(bitangent, winding));
+					XMStoreFloat4(&c.Normal, XMVectorSetW(faceNormal, angles[k]));
+				}
+			}
+		});
+
+		/* ---------------------------------------------------------------------------------
+		[             Vertex -> corner adjacency (counting sort, no atomics needed)        ]
+		--------------------------------------------------------------------------------- */
+		std::vector<std::uint32_t> firstCorner(vertexCount + 1, 0);
+		for (size_t c = 0; c < cornerCount; ++c) {
+			++firstCorner[indices[c] + 1];
+		}
+		for (size_t v = 0; v < vertexCount; ++v) {
+			firstCorner[v + 1] += firstCorner[v];
+		}
+
+		std::vector<std::uint32_t> vertexCorners(cornerCount);
+		{
+			std::vector<std::uint32_t> cursor(firstCorner.begin(), firstCorner.end() - 1);
+			for (size_t c = 0; c < cornerCount; ++c) {
+				vertexCorners[cursor[indices[c]]++] = (std::uint32_t)c;
+			}
+		}
+
+		/* ---------------------------------------------------------------------------------
+		[                 Mirrored vertices get a second copy (one per handedness)         ]
+		--------------------------------------------------------------------------------- */
+		std::vector<std::uint32_t> mirrorVertex(vertexCount, UINT32_MAX);
+
+		if (options.SplitMirroredVertices) {
+			std::uint32_t nextVertex = (std::uint32_t)vertexCount;
+
+			for (size_t v = 0; v < vertexCount; ++v) {
+				bool positive = false;
+				bool negative = false;
+
+				for (std::uint32_t i = firstCorner[v]; i < firstCorner[v + 1]; ++i) {
+					if (corners[vertexCorners[i]].Bitangent.w < 0.0f) {
+						negative = true;
+					}
+					else {
+						positive = true;
+					}
+				}
+
+				if (positive && negative) {
+					mirrorVertex[v] = nextVertex++;
+				}
+			}
+
+			vertices.resize(nextVertex);
+		}
+
+		/* ---------------------------------------------------------------------------------
+		[          Per vertex: angle weighted normal, then MikkTSpace style tangent        ]
+		--------------------------------------------------------------------------------- */
+		jobs->ParallelFor(vertexCount, gVerticesPerJob, [&](size_t first, size_t last, size_t) {
+			for (size_t v = first; v < last; ++v) {
+				const std::uint32_t begin = firstCorner[v];
+				const std::uint32_t end = firstCorner[v + 1];
+
+				XMVECTOR normal = XMVectorZero();
+
+				if (options.RecomputeNormals) {
+					for (std::uint32_t i = begin; i < end; ++i) {
+						const CornerFrame& c = corners[vertexCorners[i]];
+						normal = XMVectorMultiplyAdd(XMLoadFloat4(&c.Normal), XMVectorReplicate(c.Normal.w), normal);
+					}
+				}
+				else {
+					normal = XMLoadFloat3(&vertices[v].Normal);
+				}
+
+				if (XMVectorGetX(XMVector3LengthSq(normal)) > 1e-20f) {
+					normal = XMVectorSetW(XMVector3Normalize(normal), 0.0f);
+				}
+				else {
+					normal = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+				}
+
+				// [0] = positive winding (or everything when not splitting), [1] = negative winding.
+				XMVECTOR tangentSum[2] = { XMVectorZero(), XMVectorZero() };
+				XMVECTOR bitangentSum[2] = { XMVectorZero(), XMVectorZero() };
+
+				for (std::uint32_t i = begin; i < end; ++i) {
+					const CornerFrame& c = corners[vertexCorners[i]];
+					const int group = (mirrorVertex[v] != UINT32_MAX && c.Bitangent.w < 0.0f) ? 1 : 0;
+
+					XMVECTOR weight = XMVectorReplicate(c.Tangent.w);
+					XMVECTOR t = XMLoadFloat4(&c.Tangent);
+					XMVECTOR b = XMLoadFloat4(&c.Bitangent);
+
+					t = XMVectorSubtract(t, XMVectorMultiply(normal, XMVector3Dot(normal, t)));
+					b = XMVectorSubtract(b, XMVectorMultiply(normal, XMVector3Dot(normal, b)));
+
+					tangentSum[group] = XMVectorMultiplyAdd(XMVectorSetW(t, 0.0f), weight, tangentSum[group]);
+					bitangentSum[group] = XMVectorMultiplyAdd(XMVectorSetW(b, 0.0f), weight, bitangentSum[group]);
+				}
+
+				const size_t targets[2] = { v, (size_t)mirrorVertex[v] };
+				const int groupCount = (mirrorVertex[v] != UINT32_MAX) ? 2 : 1;
+
+				if (groupCount == 2) {
+					vertices[targets[1]] = vertices[v];
+				}
+
+				for (int g = 0; g < groupCount; ++g) {
+					XMVECTOR t = OrthogonalTangent(tangentSum[g], normal);
+					float sign = (XMVectorGetX(XMVector3Dot(XMVector3Cross(normal, t), bitangentSum[g])) < 0.0f) ? -1.0f : 1.0f;
+
+					Vertex& out = vertices[targets[g]];
+					XMStoreFloat3(&out.Normal, normal);
+					XMStoreFloat4(&out.Tangent, XMVectorSetW(t, sign));
+				}
+			}
+		});
+
+		if (options.SplitMirroredVertices) {
+			jobs->ParallelFor(cornerCount, gTrianglesPerJob * 3, [&](size_t first, size_t last, size_t) {
+				for (size_t c = first; c < last; ++c) {
+					std::uint32_t mirrored = mirrorVertex[indices[c]];
+					if (mirrored != UINT32_MAX && corners[c].Bitangent.w < 0.0f) {
+						indices[c] = mirrored;
+					}
+				}
+			});
+		}
+	}
+
+	void TangentSpace::BuildFromCorners(
+		const std::vector<DirectX::XMFLOAT3>& positions,
+		const std::vector<DirectX::XMFLOAT2>& texCoords,
+		const std::vector<DirectX::XMFLOAT3>& normals,
+		const std::vector<CornerIndex>& corners,
+		std::vector<Vertex>& outVertices,
+		std::vector<std::uint32_t>& outIndices,
+		const Options& options) {
+		outVertices.clear();
+		outIndices.clear();
+		outIndices.reserve(corners.size());
+
+		Options generateOptions = options;
+		generateOptions.RecomputeNormals = options.RecomputeNormals || normals.empty();
+
+		// Normals only split vertices when they are kept (hard edges from the file).
+		const bool keyOnNormal = !generateOptions.RecomputeNormals;
+
+		std::unordered_map<CornerKey, std::uint32_t, CornerKeyHash> welded;
+		welded.reserve(corners.size());
+
+		for (const CornerIndex& corner : corners) {
+			CornerKey key;
+			key.Position = corner.Position;
+			key.HasTexC = corner.TexC < texCoords.size();
+			key.TexC = key.HasTexC ? corner.TexC : 0;
+			key.HasNormal = keyOnNormal && corner.Normal < normals.size();
+			key.Normal = key.HasNormal ? corner.Normal : 0;
+
+			auto found = welded.find(key);
+			if (found != welded.end()) {
+				outIndices.push_back(found->second);
+				continue;
+			}
+
+			Vertex v;
+			v.Pos = positions[corner.Position];
+			v.TexC = key.HasTexC ? texCoords[key.TexC] : DirectX::XMFLOAT2(0.0f, 0.0f);
+			v.Normal = key.HasNormal ? normals[key.Normal] : DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+			v.Tangent = DirectX::XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f);
+
+			std::uint32_t index = (std::uint32_t)outVertices.size();
+			outVertices.push_back(v);
+			outIndices.push_back(index);
+			welded.emplace(key, index);
+		}
+
+		Generate(outVertices, outIndices, generateOptions);
+	}
+}
@@ -0,0 +1,333 @@
+#include "Terrain.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <stdexcept>
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	Terrain::Terrain() {
+	}
+
+	Terrain::~Terrain() {
+	}
+
+	void Terrain::Initialize(const Settings& settings, const HeightField* heightField) {
+		m_Settings = settings;
+
+		if (m_Settings.LodCount == 0) {
+			m_Settings.LodCount = 1;
+		}
+
+		m_LodRanges.resize(m_Settings.LodCount);
+		float range = m_Settings.FinestRange;
+		for (UINT lod = 0; lod < m_Settings.LodCount; ++lod) {
+			m_LodRanges[lod] = range;
+			range *= 2.0f;
+		}
+
+		BuildHeights(heightField);
+		BuildMinMaxHeights();
+
+		m_Patches.clear();
+		m_Patches.reserve(m_Settings.MaxPatches);
+	}
+
+	void Terrain::BuildHeights(const HeightField* heightField) {
+		m_SampleCount = GetNodeCount(0) * GridDim + 1;
+		m_SampleSpacing = m_Settings.Size / (float)(m_SampleCount - 1);
+
+		const size_t sampleCount = (size_t)m_SampleCount * m_SampleCount;
+		m_Heights.assign(sampleCount, 0.0f);
+
+		if (heightField == nullptr) {
+			return;
+		}
+
+		std::vector<float> xs(sampleCount);
+		std::vector<float> zs(sampleCount);
+
+		for (UINT z = 0; z < m_SampleCount; ++z) {
+			for (UINT x = 0; x < m_SampleCount; ++x) {
+				xs[(size_t)z * m_SampleCount + x] = m_Settings.Origin.x + x * m_SampleSpacing;
+				zs[(size_t)z * m_SampleCount + x] = m_Settings.Origin.y + z * m_SampleSpacing;
+			}
+		}
+
+		heightField->GetHeights(xs.data(), zs.data(), sampleCount, m_Heights.data());
+	}
+
+	void Terrain::UploadHeights(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+		D3D12_CPU_DESCRIPTOR_HANDLE srvHandle) {
+		D3D12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_FLOAT,
+			m_SampleCount, m_SampleCount, 1, 1);
+
+		D3D12_HEAP_PROPERTIES defaultHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		if (FAILED(device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &textureDesc,
+			D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(m_HeightTexture.GetAddressOf())))) {
+			throw std::runtime_error("@@@ Error: Terrain height texture");
+		}
+
+		D3D12_HEAP_PROPERTIES uploadHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+		auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(GetRequiredIntermediateSize(m_HeightTexture.Get(), 0, 1));
+		if (FAILED(device->CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &uploadDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(m_HeightUploader.GetAddressOf())))) {
+			throw std::runtime_error("@@@ Error: Terrain height upload buffer");
+		}
+
+		D3D12_SUBRESOURCE_DATA subResourceData;
+		subResourceData.pData = m_Heights.data();
+		subResourceData.RowPitch = (LONG_PTR)m_SampleCount * sizeof(float);
+		subResourceData.SlicePitch = subResourceData.RowPitch * m_SampleCount;
+
+		UpdateSubresources<1>(cmdList, m_HeightTexture.Get(), m_HeightUploader.Get(), 0, 0, 1, &subResourceData);
+
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_HeightTexture.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		cmdList->ResourceBarrier(1, &barrier);
+
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = 1;
+		srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+
+		device->CreateShaderResourceView(m_HeightTexture.Get(), &srvDesc, srvHandle);
+	}
+
+	void Terrain::ReleaseUploader() {
+		m_HeightUploader = nullptr;
+	}
+
+	void Terrain::BuildMinMaxHeights() {
+		m_MinMaxHeights.assign(m_Settings.LodCount, {});
+
+		// Leaves: every sample of the height grid under the node, the vertices its patches can take
+		// at any morph, plus a margin.
+		const UINT leafCount = GetNodeCount(0);
+
+		std::vector<XMFLOAT2>& leaves = m_MinMaxHeights[0];
+		leaves.resize((size_t)leafCount * leafCount);
+
+		JobSystem::Get()->ParallelFor(leaves.size(), 16, [&](size_t first, size_t last, size_t) {
+			for (size_t i = first; i < last; ++i) {
+				const UINT x0 = (UINT)(i % leafCount) * GridDim;
+				const UINT z0 = (UINT)(i / leafCount) * GridDim;
+
+				float minH = +FLT_MAX;
+				float maxH = -FLT_MAX;
+
+				for (UINT z = z0; z <= z0 + GridDim; ++z) {
+					const float* row = &m_Heights[(size_t)z * m_SampleCount + x0];
+					auto minMaxH = std::minmax_element(row, row + GridDim + 1);
+					minH = (std::min)(minH, *minMaxH.first);
+					maxH = (std::max)(maxH, *minMaxH.second);
+				}
+
+				minH += m_Settings.BaseHeight;
+				maxH += m_Settings.BaseHeight;
+
+				float margin = 0.05f * (maxH - minH) + 0.5f;
+				leaves[i] = XMFLOAT2(minH - margin, maxH + margin);
+			}
+		});
+
+		for (UINT lod = 1; lod < m_Settings.LodCount; ++lod) {
+			const UINT count = GetNodeCount(lod);
+			const UINT childCount = count * 2;
+			const std::vector<XMFLOAT2>& children = m_MinMaxHeights[lod - 1];
+
+			std::vector<XMFLOAT2>& nodes = m_MinMaxHeights[lod];
+			nodes.resize((size_t)count * count);
+
+			for (UINT z = 0; z < count; ++z) {
+				for (UINT x = 0; x < count; ++x) {
+					XMFLOAT2 minMax(+FLT_MAX, -FLT_MAX);
+
+					for (UINT c = 0; c < 4; ++c) {
+						const XMFLOAT2& child = children[(size_t)(z * 2 + (c >> 1)) * childCount + (x * 2 + (c & 1))];
+						minMax.x = (std::min)(minMax.x, child.x);
+						minMax.y = (std::max)(minMax.y, child.y);
+					}
+
+					nodes[(size_t)z * count + x] = minMax;
+				}
+			}
+		}
+	}
+
+	void Terrain::Select(const XMFLOAT3& eyePosW, const BoundingFrustum& frustumW) {
+		m_EyePosW = eyePosW;
+		m_FrustumW = frustumW;
+		m_Patches.clear();
+
+		const UINT root = m_Settings.LodCount - 1;
+
+		// Beyond the coarsest range the root is still drawn, fully morphed.
+		if (!SelectNode(root, 0, 0, false)) {
+			AddPatch(root, 0, 0);
+		}
+	}
+
+	bool Terrain::SelectNode(UINT lod, UINT x, UINT z, bool insideFrustum) {
+		BoundingBox box = GetNodeBox(lod, x, z);
+
+		if (!box.Intersects(BoundingSphere(m_EyePosW, m_LodRanges[lod]))) {
+			return false;
+		}
+
+		if (!insideFrustum) {
+			ContainmentType containment = m_FrustumW.Contains(box);
+
+			if (containment == DirectX::DISJOINT) {
+				// Culled: handled, nothing to draw.
+				return true;
+			}
+			insideFrustum = (containment == DirectX::CONTAINS);
+		}
+
+		if (lod == 0 || !box.Intersects(BoundingSphere(m_EyePosW, m_LodRanges[lod - 1]))) {
+			AddPatch(lod, x, z);
+			return true;
+		}
+
+		// Children the finer lod does not take are drawn as quarters of this node.
+		// They lie beyond range[lod - 1], so their vertices end fully morphed to this lod's grid.
+		for (UINT c = 0; c < 4; ++c) {
+			UINT cx = x * 2 + (c & 1);
+			UINT cz = z * 2 + (c >> 1);
+
+			if (!SelectNode(lod - 1, cx, cz, insideFrustum)) {
+				AddPatch(lod - 1, cx, cz);
+			}
+		}
+
+		return true;
+	}
+
+	void Terrain::AddPatch(UINT lod, UINT x, UINT z) {
+		if (m_Patches.size() >= m_Settings.MaxPatches) {
+			return;
+		}
+
+		const float size = GetNodeSize(lod);
+		const float prevRange = (lod == 0) ? 0.0f : m_LodRanges[lod - 1];
+
+		TerrainPatch patch;
+		patch.Offset = XMFLOAT2(m_Settings.Origin.x + x * size, m_Settings.Origin.y + z * size);
+		patch.Scale = size;
+		patch.BaseHeight = m_Settings.BaseHeight;
+		patch.MorphEnd = m_LodRanges[lod];
+		patch.MorphStart = prevRange + (m_LodRanges[lod] - prevRange) * m_Settings.MorphStartRatio;
+		patch.Lod = lod;
+		patch.MaterialIndex = m_Settings.MaterialIndex;
+
+		// Sample i sits at the centre of texel i.
+		const float invCount = 1.0f / (float)m_SampleCount;
+		patch.HeightUVScale = invCount / m_SampleSpacing;
+		patch.HeightUVOffset = XMFLOAT2(
+			(0.5f - m_Settings.Origin.x / m_SampleSpacing) * invCount,
+			(0.5f - m_Settings.Origin.y / m_SampleSpacing) * invCount);
+		patch.SampleSpacing = m_SampleSpacing;
+
+		m_Patches.push_back(patch);
+	}
+
+	const std::vector<TerrainPatch>& Terrain::GetPatches() const {
+		return m_Patches;
+	}
+
+	const Terrain::Settings& Terrain::GetSettings() const {
+		return m_Settings;
+	}
+
+	float Terrain::GetHeight(float x, float z) const {
+		// Clamped to the grid, as the shader's clamp sampler does.
+		const float last = (float)(m_SampleCount - 1);
+		const float gx = (std::min)((std::max)((x - m_Settings.Origin.x) / m_SampleSpacing, 0.0f), last);
+		const float gz = (std::min)((std::max)((z - m_Settings.Origin.y) / m_SampleSpacing, 0.0f), last);
+
+		const UINT ix = (std::min)((UINT)gx, m_SampleCount - 2);
+		const UINT iz = (std::min)((UINT)gz, m_SampleCount - 2);
+		const float fx = gx - (float)ix;
+		const float fz = gz - (float)iz;
+
+		const float* row0 = &m_Heights[(size_t)iz * m_SampleCount + ix];
+		const float* row1 = row0 + m_SampleCount;
+
+		const float h0 = row0[0] + (row0[1] - row0[0]) * fx;
+		const float h1 = row1[0] + (row1[1] - row1[0]) * fx;
+
+		return m_Settings.BaseHeight + h0 + (h1 - h0) * fz;
+	}
+
+	float Terrain::GetLodRange(UINT lod) const {
+		return m_LodRanges[(std::min)(lod, m_Settings.LodCount - 1)];
+	}
+
+	UINT Terrain::GetSampleCount() const {
+		return m_SampleCount;
+	}
+
+	float Terrain::GetSampleSpacing() const {
+		return m_SampleSpacing;
+	}
+
+	float Terrain::GetNodeSize(UINT lod) const {
+		return m_Settings.Size / (float)GetNodeCount(lod);
+	}
+
+	UINT Terrain::GetNodeCount(UINT lod) const {
+		return 1u << (m_Settings.LodCount - 1 - lod);
+	}
+
+	BoundingBox Terrain::GetNodeBox(UINT lod, UINT x, UINT z) const {
+		const float size = GetNodeSize(lod);
+		const XMFLOAT2& minMax = m_MinMaxHeights[lod][(size_t)z * GetNodeCount(lod) + x];
+
+		BoundingBox box;
+		box.Center = XMFLOAT3(
+			m_Settings.Origin.x + (x + 0.5f) * size,
+			0.5f * (minMax.x + minMax.y),
+			m_Settings.Origin.y + (z + 0.5f) * size);
+		box.Extents = XMFLOAT3(0.5f * size, 0.5f * (minMax.y - minMax.x), 0.5f * size);
+
+		return box;
+	}
+
+	void Terrain::BuildGridMesh(std::vector<Vertex>& vertices, std::vector<std::uint16_t>& indices) const {
+		const UINT vertexPerSide = GridDim + 1;
+		const float invDim = 1.0f / GridDim;
+
+		vertices.resize((size_t)vertexPerSide * vertexPerSide);
+		for (UINT z = 0; z < vertexPerSide; ++z) {
+			for (UINT x = 0; x < vertexPerSide; ++x) {
+				float u = x * invDim;
+				float v = z * invDim;
+
+				vertices[(size_t)z * vertexPerSide + x] = Vertex(
+					u, 0.0f, v,
+					0.0f, 1.0f, 0.0f,
+					u, 1.0f - v,
+					1.0f, 0.0f, 0.0f);
+			}
+		}
+
+		indices.clear();
+		indices.reserve((size_t)GridDim * GridDim * 6);
+		for (UINT z = 0; z < GridDim; ++z) {
+			for (UINT x = 0; x < GridDim; ++x) {
+				std::uint16_t i0 = (std::uint16_t)(z * vertexPerSide + x);
+				std::uint16_t i1 = (std::uint16_t)(i0 + 1);
+				std::uint16_t i2 = (std::uint16_t)(i0 + vertexPerSide);
+				std::uint16_t i3 = (std::uint16_t)(i2 + 1);
+
+				indices.push_back(i0); indices.push_back(i2); indices.push_back(i1);
+				indices.push_back(i1); indices.push_back(i2); indices.push_back(i3);
+			}
+		}
+	}
+}
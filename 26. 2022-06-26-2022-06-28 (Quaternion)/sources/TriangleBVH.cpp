@@ -0,0 +1,672 @@
+#include "TriangleBVH.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace Mawi1e {
+	namespace {
+		const int gSahBins = 12;
+
+		// Past this depth the build splits at the median so degenerate inputs stay O(log n) deep.
+		const int gMaxSahDepth = 48;
+
+		// Deeper than any tree the build can produce.
+		const int gMaxTraversalStack = 128;
+
+		// Slab distances are off by up to three roundings; widening the exit by that much keeps rays through
+		// a shared vertex or edge from slipping between sibling boxes (Ize, Robust BVH Ray Traversal).
+		const float gBoxExitScale = 1.0f + 2.0f * 1.7881393e-7f;
+
+		inline XMFLOAT3 Min3(const XMFLOAT3& a, const XMFLOAT3& b) {
+			return XMFLOAT3((std::min)(a.x, b.x), (std::min)(a.y, b.y), (std::min)(a.z, b.z));
+		}
+
+		inline XMFLOAT3 Max3(const XMFLOAT3& a, const XMFLOAT3& b) {
+			return XMFLOAT3((std::max)(a.x, b.x), (std::max)(a.y, b.y), (std::max)(a.z, b.z));
+		}
+
+		inline float Area(const XMFLOAT3& mn, const XMFLOAT3& mx) {
+			float dx = mx.x - mn.x;
+			float dy = mx.y - mn.y;
+			float dz = mx.z - mn.z;
+			return 2.0f * (dx * dy + dy * dz + dz * dx);
+		}
+
+		inline float Axis(const XMFLOAT3& v, int axis) {
+			return (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
+		}
+
+		// Slab test; outEntry is where the ray enters the box, clamped to 0.
+		inline bool IntersectBox(const TriangleBVH::Node& node, FXMVECTOR origin, FXMVECTOR invDirection, float tMax,
+			float& outEntry) {
+			XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&node.Min), origin), invDirection);
+			XMVECTOR t2 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&node.Max), origin), invDirection);
+
+			XMFLOAT3 tNear, tFar;
+			XMStoreFloat3(&tNear, XMVectorMin(t1, t2));
+			XMStoreFloat3(&tFar, XMVectorMax(t1, t2));
+
+			float entry = (std::max)((std::max)(tNear.x, tNear.y), (std::max)(tNear.z, 0.0f));
+			float exit = (std::min)((std::min)(tFar.x, tFar.y), (std::min)(tFar.z, tMax));
+
+			outEntry = entry;
+			return entry <= exit * gBoxExitScale;
+		}
+
+		// The same test against the box grown by grow on every side.
+		inline bool IntersectGrownBox(const TriangleBVH::Node& node, FXMVECTOR origin, FXMVECTOR invDirection,
+			FXMVECTOR grow, float tMax, float& outEntry) {
+			TriangleBVH::Node grown = node;
+			XMStoreFloat3(&grown.Min, XMVectorSubtract(XMLoadFloat3(&node.Min), grow));
+			XMStoreFloat3(&grown.Max, XMVectorAdd(XMLoadFloat3(&node.Max), grow));
+			return IntersectBox(grown, origin, invDirection, tMax, outEntry);
+		}
+
+		inline float Dot3(FXMVECTOR a, FXMVECTOR b) {
+			return XMVectorGetX(XMVector3Dot(a, b));
+		}
+
+		// Weights of b and c in the point of triangle abc closest to p (Ericson, Real-Time Collision
+		// Detection 5.1.5).
+		void ClosestPointWeights(FXMVECTOR p, FXMVECTOR a, FXMVECTOR b, GXMVECTOR c, float& outU, float& outV) {
+			const XMVECTOR ab = XMVectorSubtract(b, a);
+			const XMVECTOR ac = XMVectorSubtract(c, a);
+
+			const XMVECTOR ap = XMVectorSubtract(p, a);
+			const float d1 = Dot3(ab, ap);
+			const float d2 = Dot3(ac, ap);
+			if (d1 <= 0.0f && d2 <= 0.0f) {
+				outU = 0.0f;
+				outV = 0.0f;
+				return;
+			}
+
+			const XMVECTOR bp = XMVectorSubtract(p, b);
+			const float d3 = Dot3(ab, bp);
+			const float d4 = Dot3(ac, bp);
+			if (d3 >= 0.0f && d4 <= d3) {
+				outU = 1.0f;
+				outV = 0.0f;
+				return;
+			}
+
+			const float vc = d1 * d4 - d3 * d2;
+			if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+				outU = d1 / (d1 - d3);
+				outV = 0.0f;
+				return;
+			}
+
+			const XMVECTOR cp = XMVectorSubtract(p, c);
+			const float d5 = Dot3(ab, cp);
+			const float d6 = Dot3(ac, cp);
+			if (d6 >= 0.0f && d5 <= d6) {
+				outU = 0.0f;
+				outV = 1.0f;
+				return;
+			}
+
+			const float vb = d5 * d2 - d1 * d6;
+			if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+				outU = 0.0f;
+				outV = d2 / (d2 - d6);
+				return;
+			}
+
+			const float va = d3 * d6 - d5 * d4;
+			if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+				outV = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+				outU = 1.0f - outV;
+				return;
+			}
+
+			const float denom = 1.0f / (va + vb + vc);
+			outU = vb * denom;
+			outV = vc * denom;
+		}
+
+		// First T in [0, tMax) at which the sphere of radius centred at origin + T * direction touches
+		// triangle v0 v1 v2; 0 when it already does. The face is tried first: if the sphere reaches the
+		// plane inside the triangle nothing else can come earlier. Otherwise the first contact is with an
+		// edge, swept as a cylinder, or a corner, swept as a sphere.
+		bool SweepSphereTriangle(FXMVECTOR origin, FXMVECTOR direction, float radius, GXMVECTOR v0, HXMVECTOR v1,
+			HXMVECTOR v2, float tMax, float& outT) {
+			const float dd = Dot3(direction, direction);
+
+			// Most triangles of a leaf are dismissed by their bounding sphere alone.
+			const XMVECTOR centroid = XMVectorScale(XMVectorAdd(v0, XMVectorAdd(v1, v2)), 1.0f / 3.0f);
+			const float spread = std::sqrt((std::max)(XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(v0, centroid))),
+				(std::max)(XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(v1, centroid))),
+					XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(v2, centroid))))));
+			{
+				const XMVECTOR m = XMVectorSubtract(origin, centroid);
+				const float reach = radius + spread;
+				const float b = Dot3(m, direction);
+				const float c = Dot3(m, m) - reach * reach;
+				if (c > 0.0f) {
+					if (b >= 0.0f) return false;
+
+					const float disc = b * b - dd * c;
+					if (disc < 0.0f || (-b - std::sqrt(disc)) >= tMax * dd) return false;
+				}
+			}
+
+			const float radiusSq = radius * radius;
+			const XMVECTOR normal = XMVector3Cross(XMVectorSubtract(v1, v0), XMVectorSubtract(v2, v0));
+			const float normalLength = XMVectorGetX(XMVector3Length(normal));
+
+			if (normalLength > 0.0f) {
+				const XMVECTOR n = XMVectorScale(normal, 1.0f / normalLength);
+				const float distance = Dot3(n, XMVectorSubtract(origin, v0));
+				const float speed = Dot3(n, direction);
+
+				float tPlane = 0.0f;
+				if (std::fabs(distance) > radius) {
+					// Never reaches the plane, so never the triangle either.
+					if (distance * speed >= 0.0f) return false;
+					tPlane = (std::fabs(distance) - radius) / std::fabs(speed);
+				}
+
+				if (tPlane >= tMax) return false;
+
+				const XMVECTOR center = XMVectorMultiplyAdd(XMVectorReplicate(tPlane), direction, origin);
+				const XMVECTOR onPlane = XMVectorSubtract(center, XMVectorScale(n, Dot3(n, XMVectorSubtract(center, v0))));
+
+				const float c0 = Dot3(n, XMVector3Cross(XMVectorSubtract(v1, v0), XMVectorSubtract(onPlane, v0)));
+				const float c1 = Dot3(n, XMVector3Cross(XMVectorSubtract(v2, v1), XMVectorSubtract(onPlane, v1)));
+				const float c2 = Dot3(n, XMVector3Cross(XMVectorSubtract(v0, v2), XMVectorSubtract(onPlane, v2)));
+				if (c0 >= 0.0f && c1 >= 0.0f && c2 >= 0.0f) {
+					outT = tPlane;
+					return true;
+				}
+			}
+
+			bool hit = false;
+			float closest = tMax;
+
+			const XMVECTOR corners[3] = { v0, v1, v2 };
+			for (int i = 0; i < 3; ++i) {
+				const XMVECTOR a = corners[i];
+				const XMVECTOR e = XMVectorSubtract(corners[(i + 1) % 3], a);
+				const XMVECTOR m = XMVectorSubtract(origin, a);
+
+				// Corner a: |m + t * direction| = radius.
+				const float md = Dot3(m, direction);
+				const float mm = Dot3(m, m);
+				const float cc = mm - radiusSq;
+				if (cc <= 0.0f) {
+					outT = 0.0f;
+					return true;
+				}
+
+				if (md < 0.0f && dd > 0.0f) {
+					const float disc = md * md - dd * cc;
+					if (disc >= 0.0f) {
+						const float t = (-md - std::sqrt(disc)) / dd;
+						if (t < closest) {
+							hit = true;
+							closest = t;
+						}
+					}
+				}
+
+				// Edge a -> a + e: distance to the line is radius and the foot lies on the segment.
+				const float ee = Dot3(e, e);
+				if (ee <= 0.0f) continue;
+
+				const float ed = Dot3(e, direction);
+				const float em = Dot3(e, m);
+				const float qa = ee * dd - ed * ed;
+				const float qb = ee * md - em * ed;
+				const float qc = ee * cc - em * em;
+
+				if (qc <= 0.0f) {
+					if (em >= 0.0f && em <= ee) {
+						outT = 0.0f;
+						return true;
+					}
+					continue;
+				}
+
+				// Moving along the edge, only its corners can be met.
+				if (qa <= 0.0f) continue;
+
+				const float disc = qb * qb - qa * qc;
+				if (disc < 0.0f) continue;
+
+				const float t = (-qb - std::sqrt(disc)) / qa;
+				if (t < 0.0f || t >= closest) continue;
+
+				const float foot = em + t * ed;
+				if (foot >= 0.0f && foot <= ee) {
+					hit = true;
+					closest = t;
+				}
+			}
+
+			if (hit) {
+				outT = closest;
+			}
+			return hit;
+		}
+	}
+
+	TriangleBVH::TriangleBVH() {
+	}
+
+	TriangleBVH::~TriangleBVH() {
+	}
+
+	void TriangleBVH::Clear() {
+		m_Nodes.clear();
+		m_Packets.clear();
+		m_TriangleIds.clear();
+		m_TriangleCount = 0;
+	}
+
+	void TriangleBVH::Build(const XMFLOAT3* positions, size_t stride, const std::uint32_t* indices, size_t triangleCount) {
+		BuildIndexed(positions, stride, indices, triangleCount);
+	}
+
+	void TriangleBVH::Build(const XMFLOAT3* positions, size_t stride, const std::uint16_t* indices, size_t triangleCount) {
+		BuildIndexed(positions, stride, indices, triangleCount);
+	}
+
+	template <class Index>
+	void TriangleBVH::BuildIndexed(const XMFLOAT3* positions, size_t stride, const Index* indices, size_t triangleCount) {
+		Clear();
+
+		if (triangleCount == 0) return;
+
+		auto position = [&](Index i) {
+			return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const BYTE*>(positions) + i * stride));
+		};
+
+		std::vector<XMFLOAT3> vertices(triangleCount * 3);
+
+		BuildInput input;
+		input.Min.resize(triangleCount);
+		input.Max.resize(triangleCount);
+		input.Centroid.resize(triangleCount);
+
+		m_TriangleIds.resize(triangleCount);
+
+		for (size_t t = 0; t < triangleCount; ++t) {
+			XMVECTOR p0 = position(indices[t * 3 + 0]);
+			XMVECTOR p1 = position(indices[t * 3 + 1]);
+			XMVECTOR p2 = position(indices[t * 3 + 2]);
+
+			XMStoreFloat3(&vertices[t * 3 + 0], p0);
+			XMStoreFloat3(&vertices[t * 3 + 1], p1);
+			XMStoreFloat3(&vertices[t * 3 + 2], p2);
+
+			XMVECTOR mn = XMVectorMin(p0, XMVectorMin(p1, p2));
+			XMVECTOR mx = XMVectorMax(p0, XMVectorMax(p1, p2));
+			XMStoreFloat3(&input.Min[t], mn);
+			XMStoreFloat3(&input.Max[t], mx);
+			XMStoreFloat3(&input.Centroid[t], XMVectorScale(XMVectorAdd(mn, mx), 0.5f));
+
+			m_TriangleIds[t] = (UINT)t;
+		}
+
+		m_Nodes.reserve(2 * triangleCount);
+		m_Nodes.emplace_back();
+		BuildRange(input, 0, 0, triangleCount, 0);
+
+		// Every leaf becomes one packet; its Offset moves from the id range to the packet.
+		std::vector<UINT> leafIds;
+		leafIds.swap(m_TriangleIds);
+
+		for (Node& n : m_Nodes) {
+			if (n.Count == 0) continue;
+
+			const UINT packet = (UINT)m_Packets.size();
+			m_Packets.emplace_back();
+			m_TriangleIds.resize(m_TriangleIds.size() + RayTriangle::PacketWidth, (UINT)NullTriangle);
+
+			RayTriangle::ClearPacket(m_Packets[packet]);
+			for (UINT lane = 0; lane < n.Count; ++lane) {
+				const UINT t = leafIds[n.Offset + lane];
+				RayTriangle::SetTriangle(m_Packets[packet], lane, vertices[t * 3 + 0], vertices[t * 3 + 1], vertices[t * 3 + 2]);
+				m_TriangleIds[packet * RayTriangle::PacketWidth + lane] = t;
+			}
+
+			n.Offset = packet;
+		}
+
+		m_TriangleCount = triangleCount;
+	}
+
+	void TriangleBVH::BuildRange(const BuildInput& input, UINT node, size_t first, size_t last, int depth) {
+		const size_t count = last - first;
+
+		XMFLOAT3 bMin(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+		XMFLOAT3 bMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		XMFLOAT3 cMin(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+		XMFLOAT3 cMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (size_t i = first; i < last; ++i) {
+			const UINT t = m_TriangleIds[i];
+			bMin = Min3(bMin, input.Min[t]);
+			bMax = Max3(bMax, input.Max[t]);
+			cMin = Min3(cMin, input.Centroid[t]);
+			cMax = Max3(cMax, input.Centroid[t]);
+		}
+
+		m_Nodes[node].Min = bMin;
+		m_Nodes[node].Max = bMax;
+
+		auto makeLeaf = [&]() {
+			m_Nodes[node].Offset = (UINT)first;
+			m_Nodes[node].Count = (UINT)count;
+		};
+
+		// A whole packet costs one kernel call, so splitting it further only adds box tests.
+		if (count <= MaxLeafTriangles) {
+			makeLeaf();
+			return;
+		}
+
+		XMFLOAT3 extent(cMax.x - cMin.x, cMax.y - cMin.y, cMax.z - cMin.z);
+		int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : ((extent.y > extent.z) ? 1 : 2);
+		const float axisMin = Axis(cMin, axis);
+		const float axisExtent = Axis(extent, axis);
+
+		size_t mid = first + count / 2;
+		bool sahSplit = false;
+
+		if (axisExtent > 0.0f && depth < gMaxSahDepth) {
+			struct Bin {
+				XMFLOAT3 Min = XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+				XMFLOAT3 Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				size_t Count = 0;
+			};
+
+			Bin bins[gSahBins];
+			const float binScale = gSahBins / axisExtent;
+
+			auto binOf = [&](UINT t) {
+				int b = (int)((Axis(input.Centroid[t], axis) - axisMin) * binScale);
+				return (std::min)((std::max)(b, 0), gSahBins - 1);
+			};
+
+			for (size_t i = first; i < last; ++i) {
+				const UINT t = m_TriangleIds[i];
+				Bin& bin = bins[binOf(t)];
+				bin.Min = Min3(bin.Min, input.Min[t]);
+				bin.Max = Max3(bin.Max, input.Max[t]);
+				++bin.Count;
+			}
+
+			// Sweep from the right for suffix areas, then from the left for the cost of each split plane.
+			float rightArea[gSahBins];
+			size_t rightCount[gSahBins];
+			XMFLOAT3 accMin(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+			XMFLOAT3 accMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			size_t accCount = 0;
+
+			for (int b = gSahBins - 1; b > 0; --b) {
+				accMin = Min3(accMin, bins[b].Min);
+				accMax = Max3(accMax, bins[b].Max);
+				accCount += bins[b].Count;
+				rightArea[b] = (accCount > 0) ? Area(accMin, accMax) : 0.0f;
+				rightCount[b] = accCount;
+			}
+
+			int bestSplit = -1;
+			float bestCost = FLT_MAX;
+			accMin = XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+			accMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			accCount = 0;
+
+			for (int b = 0; b < gSahBins - 1; ++b) {
+				accMin = Min3(accMin, bins[b].Min);
+				accMax = Max3(accMax, bins[b].Max);
+				accCount += bins[b].Count;
+
+				if (accCount == 0 || rightCount[b + 1] == 0) continue;
+
+				float cost = accCount * Area(accMin, accMax) + rightCount[b + 1] * rightArea[b + 1];
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestSplit = b;
+				}
+			}
+
+			if (bestSplit >= 0) {
+				auto it = std::partition(m_TriangleIds.begin() + first, m_TriangleIds.begin() + last,
+					[&](UINT t) { return binOf(t) <= bestSplit; });
+				mid = (size_t)(it - m_TriangleIds.begin());
+				sahSplit = (mid != first && mid != last);
+			}
+		}
+
+		if (!sahSplit) {
+			mid = first + count / 2;
+			std::nth_element(m_TriangleIds.begin() + first, m_TriangleIds.begin() + mid, m_TriangleIds.begin() + last,
+				[&](UINT lhs, UINT rhs) { return Axis(input.Centroid[lhs], axis) < Axis(input.Centroid[rhs], axis); });
+		}
+
+		// The left child follows its parent; the right one comes after the whole left subtree.
+		m_Nodes[node].Count = 0;
+
+		const UINT left = (UINT)m_Nodes.size();
+		m_Nodes.emplace_back();
+		BuildRange(input, left, first, mid, depth + 1);
+
+		const UINT right = (UINT)m_Nodes.size();
+		m_Nodes.emplace_back();
+		m_Nodes[node].Offset = right;
+		BuildRange(input, right, mid, last, depth + 1);
+	}
+
+	template <bool AnyHitOnly>
+	bool TriangleBVH::Traverse(FXMVECTOR origin, FXMVECTOR direction, float tMax, Hit& outHit) const {
+		if (m_Nodes.empty()) return false;
+
+		const XMVECTOR invDirection = XMVectorReciprocal(direction);
+		const RayTriangle::Ray ray = RayTriangle::PrepareRay(origin, direction);
+
+		float entry = 0.0f;
+		if (!IntersectBox(m_Nodes[0], origin, invDirection, tMax, entry)) return false;
+
+		// Nodes still to visit with the distance their box was entered at.
+		UINT stackNode[gMaxTraversalStack];
+		float stackEntry[gMaxTraversalStack];
+		int top = 0;
+
+		bool hit = false;
+		float closest = tMax;
+		UINT node = 0;
+
+		for (;;) {
+			const Node& n = m_Nodes[node];
+
+			if (n.Count > 0) {
+				const TrianglePacket& packet = m_Packets[n.Offset];
+
+				if (AnyHitOnly) {
+					if (RayTriangle::IntersectAny(ray, packet, closest)) return true;
+				}
+				else {
+					float t, u, v;
+					int lane = RayTriangle::Intersect(ray, packet, closest, t, u, v);
+					if (lane >= 0) {
+						hit = true;
+						closest = t;
+
+						outHit.T = t;
+						outHit.U = u;
+						outHit.V = v;
+						outHit.Triangle = m_TriangleIds[n.Offset * RayTriangle::PacketWidth + lane];
+					}
+				}
+			}
+			else {
+				UINT nearNode = node + 1;
+				UINT farNode = n.Offset;
+
+				float nearEntry = 0.0f;
+				float farEntry = 0.0f;
+				bool nearHit = IntersectBox(m_Nodes[nearNode], origin, invDirection, closest, nearEntry);
+				bool farHit = IntersectBox(m_Nodes[farNode], origin, invDirection, closest, farEntry);
+
+				if (nearHit && farHit) {
+					if (farEntry < nearEntry) {
+						std::swap(nearNode, farNode);
+						std::swap(nearEntry, farEntry);
+					}
+
+					stackNode[top] = farNode;
+					stackEntry[top] = farEntry;
+					++top;
+
+					node = nearNode;
+					continue;
+				}
+
+				if (nearHit || farHit) {
+					node = nearHit ? nearNode : farNode;
+					continue;
+				}
+			}
+
+			// Boxes entered beyond the closest hit so far cannot hold a closer one.
+			do {
+				if (top == 0) return hit;
+				--top;
+			} while (stackEntry[top] > closest);
+
+			node = stackNode[top];
+		}
+	}
+
+	bool TriangleBVH::ClosestHit(FXMVECTOR origin, FXMVECTOR direction, float tMax, Hit& outHit) const {
+		return Traverse<false>(origin, direction, tMax, outHit);
+	}
+
+	bool TriangleBVH::AnyHit(FXMVECTOR origin, FXMVECTOR direction, float tMax) const {
+		Hit hit;
+		return Traverse<true>(origin, direction, tMax, hit);
+	}
+
+	bool TriangleBVH::ClosestHit(FXMVECTOR originW, FXMVECTOR directionW, CXMMATRIX world, float tMax, Hit& outHit) const {
+		XMMATRIX invWorld = XMMatrixInverse(nullptr, world);
+		return ClosestHit(XMVector3TransformCoord(originW, invWorld), XMVector3TransformNormal(directionW, invWorld),
+			tMax, outHit);
+	}
+
+	bool TriangleBVH::AnyHit(FXMVECTOR originW, FXMVECTOR directionW, CXMMATRIX world, float tMax) const {
+		XMMATRIX invWorld = XMMatrixInverse(nullptr, world);
+		return AnyHit(XMVector3TransformCoord(originW, invWorld), XMVector3TransformNormal(directionW, invWorld), tMax);
+	}
+
+	bool TriangleBVH::SweepSphere(FXMVECTOR originW, FXMVECTOR directionW, float radius, CXMMATRIX world,
+		CXMMATRIX invWorld, float tMax, Hit& outHit) const {
+		if (m_Nodes.empty()) return false;
+
+		// Boxes are tested in mesh space, where the sphere is an ellipsoid; a sphere grown by the largest
+		// stretch of the inverse (bounded by its Frobenius norm) holds it. Triangles go to world space.
+		const XMVECTOR origin = XMVector3TransformCoord(originW, invWorld);
+		const XMVECTOR direction = XMVector3TransformNormal(directionW, invWorld);
+		const XMVECTOR invDirection = XMVectorReciprocal(direction);
+
+		const float stretch = std::sqrt(XMVectorGetX(XMVector3LengthSq(invWorld.r[0])) +
+			XMVectorGetX(XMVector3LengthSq(invWorld.r[1])) + XMVectorGetX(XMVector3LengthSq(invWorld.r[2])));
+		const XMVECTOR grow = XMVectorReplicate(radius * stretch);
+
+		float entry = 0.0f;
+		if (!IntersectGrownBox(m_Nodes[0], origin, invDirection, grow, tMax, entry)) return false;
+
+		UINT stackNode[gMaxTraversalStack];
+		float stackEntry[gMaxTraversalStack];
+		int top = 0;
+
+		bool hit = false;
+		float closest = tMax;
+		UINT node = 0;
+
+		for (;;) {
+			const Node& n = m_Nodes[node];
+
+			if (n.Count > 0) {
+				const TrianglePacket& packet = m_Packets[n.Offset];
+
+				for (UINT lane = 0; lane < n.Count; ++lane) {
+					XMVECTOR v[3];
+					for (int k = 0; k < 3; ++k) {
+						v[k] = XMVector3Transform(XMVectorSet(packet.V[k][0][lane], packet.V[k][1][lane],
+							packet.V[k][2][lane], 1.0f), world);
+					}
+
+					float t;
+					if (!SweepSphereTriangle(originW, directionW, radius, v[0], v[1], v[2], closest, t)) continue;
+
+					hit = true;
+					closest = t;
+
+					// Where the sphere touches the triangle, as weights of v1 and v2.
+					XMVECTOR center = XMVectorMultiplyAdd(XMVectorReplicate(t), directionW, originW);
+					ClosestPointWeights(center, v[0], v[1], v[2], outHit.U, outHit.V);
+
+					outHit.T = t;
+					outHit.Triangle = m_TriangleIds[n.Offset * RayTriangle::PacketWidth + lane];
+				}
+			}
+			else {
+				UINT nearNode = node + 1;
+				UINT farNode = n.Offset;
+
+				float nearEntry = 0.0f;
+				float farEntry = 0.0f;
+				bool nearHit = IntersectGrownBox(m_Nodes[nearNode], origin, invDirection, grow, closest, nearEntry);
+				bool farHit = IntersectGrownBox(m_Nodes[farNode], origin, invDirection, grow, closest, farEntry);
+
+				if (nearHit && farHit) {
+					if (farEntry < nearEntry) {
+						std::swap(nearNode, farNode);
+						std::swap(nearEntry, farEntry);
+					}
+
+					stackNode[top] = farNode;
+					stackEntry[top] = farEntry;
+					++top;
+
+					node = nearNode;
+					continue;
+				}
+
+				if (nearHit || farHit) {
+					node = nearHit ? nearNode : farNode;
+					continue;
+				}
+			}
+
+			do {
+				if (top == 0) return hit;
+				--top;
+			} while (stackEntry[top] > closest);
+
+			node = stackNode[top];
+		}
+	}
+
+	BoundingBox TriangleBVH::GetBounds() const {
+		BoundingBox box;
+		if (m_Nodes.empty()) return box;
+
+		const Node& root = m_Nodes[0];
+		box.Center = XMFLOAT3(0.5f * (root.Min.x + root.Max.x), 0.5f * (root.Min.y + root.Max.y), 0.5f * (root.Min.z + root.Max.z));
+		box.Extents = XMFLOAT3(0.5f * (root.Max.x - root.Min.x), 0.5f * (root.Max.y - root.Min.y), 0.5f * (root.Max.z - root.Min.z));
+		return box;
+	}
+
+	size_t TriangleBVH::GetNodeCount() const {
+		return m_Nodes.size();
+	}
+
+	size_t TriangleBVH::GetTriangleCount() const {
+		return m_TriangleCount;
+	}
+}